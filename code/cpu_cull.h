@@ -0,0 +1,659 @@
+
+// NOTE: cpu version of draw_cull.comp. Draw spheres are kept as structure of arrays so the frustum
+// test runs on 8 draws at once with AVX2, lod selection uses the formula of the shader and the output
+// is the non instanced command stream the shader emits with the fields of both paths, in draw order.
+// Draws are split into fixed chunks: the first pass tests every chunk and counts its visible draws,
+// the second one writes every chunk at its prefix sum offset, so the stream doesn't depend on threads.
+// Without AVX2 the same arithmetic runs one draw at a time
+#define CPU_CULL_CHUNK 16384
+
+struct draw_soa
+{
+	u32 Count;
+
+	// NOTE: padded to a multiple of 8 draws so the last batch can be loaded whole
+	std::vector<float> CenterX;
+	std::vector<float> CenterY;
+	std::vector<float> CenterZ;
+	std::vector<float> Radius;
+	std::vector<u32> MeshIndex;
+};
+
+struct cpu_cull_result
+{
+	u32 CommandCount;
+	std::vector<mesh_draw_command> Commands;
+	std::vector<u32> InstanceIds;
+
+	std::vector<u8> Visibility;
+	std::vector<u32> ChunkOffsets;
+};
+
+internal bool
+IsAvx2Supported()
+{
+	s32 Info[4];
+	__cpuid(Info, 1);
+
+	bool IsOsxSaveSupported = (Info[2] & (1 << 27)) != 0;
+	bool IsAvxSupported = (Info[2] & (1 << 28)) != 0;
+	if(!IsOsxSaveSupported || !IsAvxSupported || (_xgetbv(0) & 6) != 6)
+	{
+		return false;
+	}
+
+	__cpuidex(Info, 7, 0);
+	return (Info[1] & (1 << 5)) != 0;
+}
+
+internal void
+ResizeDrawSoA(draw_soa& Soa, u32 Count)
+{
+	u32 PaddedCount = (Count + 7) & ~7;
+
+	Soa.Count = Count;
+	Soa.CenterX.assign(PaddedCount, 0.0f);
+	Soa.CenterY.assign(PaddedCount, 0.0f);
+	Soa.CenterZ.assign(PaddedCount, 0.0f);
+	Soa.Radius.assign(PaddedCount, 0.0f);
+	Soa.MeshIndex.assign(PaddedCount, 0);
+}
+
+internal void
+BuildDrawSoA(draw_soa& Soa, worker_pool& Pool, const std::vector<mesh_offset>& Draws)
+{
+	ResizeDrawSoA(Soa, u32(Draws.size()));
+
+	u32 ChunkCount = (Soa.Count + CPU_CULL_CHUNK - 1) / CPU_CULL_CHUNK;
+	ParallelFor(Pool, ChunkCount, [&](u32 ChunkIndex)
+	{
+		u32 FirstDraw = ChunkIndex * CPU_CULL_CHUNK;
+		u32 LastDraw  = min(FirstDraw + CPU_CULL_CHUNK, Soa.Count);
+		for(u32 DrawIndex = FirstDraw;
+			DrawIndex < LastDraw;
+			++DrawIndex)
+		{
+			glm::vec3 Center;
+			float Radius;
+			GetDrawSphere(Draws[DrawIndex], Center, Radius);
+
+			Soa.CenterX[DrawIndex] = Center.x;
+			Soa.CenterY[DrawIndex] = Center.y;
+			Soa.CenterZ[DrawIndex] = Center.z;
+			Soa.Radius[DrawIndex]  = Radius;
+			Soa.MeshIndex[DrawIndex] = Draws[DrawIndex].MeshIndex;
+		}
+	});
+}
+
+// NOTE: has to run again for every draw that moves, the sphere stream is in world space.
+// Draws outside of the packed cell range get a zeroed packed transform, their count is returned
+// and the packed stream can't be used when it isn't 0
+internal u32
+BuildDrawStreams(std::vector<draw_sphere>& Spheres, std::vector<draw_transform>& Transforms, std::vector<packed_transform>& PackedTransforms, 
+				 worker_pool& Pool, const std::vector<mesh_offset>& Draws)
+{
+	u32 DrawCount = u32(Draws.size());
+	Spheres.resize(DrawCount);
+	Transforms.resize(DrawCount);
+	PackedTransforms.resize(DrawCount);
+
+	volatile LONG UnpackableCount = 0;
+	u32 ChunkCount = (DrawCount + CPU_CULL_CHUNK - 1) / CPU_CULL_CHUNK;
+	ParallelFor(Pool, ChunkCount, [&](u32 ChunkIndex)
+	{
+		u32 FirstDraw = ChunkIndex * CPU_CULL_CHUNK;
+		u32 LastDraw  = min(FirstDraw + CPU_CULL_CHUNK, DrawCount);
+		LONG ChunkUnpackableCount = 0;
+		for(u32 DrawIndex = FirstDraw;
+			DrawIndex < LastDraw;
+			++DrawIndex)
+		{
+			const mesh_offset& Draw = Draws[DrawIndex];
+			GetDrawSphere(Draw, Spheres[DrawIndex].Center, Spheres[DrawIndex].Radius);
+
+			draw_transform& Transform = Transforms[DrawIndex];
+			Transform.Pos[0] = Draw.Pos[0];
+			Transform.Pos[1] = Draw.Pos[1];
+			Transform.Pos[2] = Draw.Pos[2];
+			Transform.Scale = Draw.Scale;
+			Transform.Orient = Draw.Orient;
+			Transform.MeshIndex = Draw.MeshIndex;
+			Transform.VertexOffset = Draw.VertexOffset;
+
+			if(IsDrawTransformPackable(Transform))
+			{
+				PackedTransforms[DrawIndex] = PackDrawTransform(Transform);
+			}
+			else
+			{
+				PackedTransforms[DrawIndex] = {};
+				ChunkUnpackableCount++;
+			}
+		}
+
+		if(ChunkUnpackableCount)
+		{
+			InterlockedExchangeAdd(&UnpackableCount, ChunkUnpackableCount);
+		}
+	});
+
+	return u32(UnpackableCount);
+}
+
+// NOTE: dot(Plane, vec4(Center, 1)) > -Radius for all planes, summed in the same order as the avx2 version
+internal void
+TestFrustumScalar(const draw_soa& Soa, const draw_cull_data& CullData, u32 FirstDraw, u32 LastDraw, u8* Visibility)
+{
+	for(u32 DrawIndex = FirstDraw;
+		DrawIndex < LastDraw;
+		++DrawIndex)
+	{
+		bool IsVisible = true;
+		for(u32 PlaneIndex = 0;
+			PlaneIndex < 6;
+			++PlaneIndex)
+		{
+			const glm::vec4& Plane = CullData.Frustrum[PlaneIndex];
+			float Distance = Plane.x * Soa.CenterX[DrawIndex] + Plane.y * Soa.CenterY[DrawIndex] + Plane.z * Soa.CenterZ[DrawIndex] + Plane.w;
+			IsVisible = IsVisible && (Distance > -Soa.Radius[DrawIndex]);
+		}
+
+		Visibility[DrawIndex] = IsVisible;
+	}
+}
+
+internal void
+TestFrustumAvx2(const draw_soa& Soa, const draw_cull_data& CullData, u32 FirstDraw, u32 LastDraw, u8* Visibility)
+{
+	__m256 PlaneX[6], PlaneY[6], PlaneZ[6], PlaneW[6];
+	for(u32 PlaneIndex = 0;
+		PlaneIndex < 6;
+		++PlaneIndex)
+	{
+		PlaneX[PlaneIndex] = _mm256_set1_ps(CullData.Frustrum[PlaneIndex].x);
+		PlaneY[PlaneIndex] = _mm256_set1_ps(CullData.Frustrum[PlaneIndex].y);
+		PlaneZ[PlaneIndex] = _mm256_set1_ps(CullData.Frustrum[PlaneIndex].z);
+		PlaneW[PlaneIndex] = _mm256_set1_ps(CullData.Frustrum[PlaneIndex].w);
+	}
+
+	__m256 Zero = _mm256_setzero_ps();
+	for(u32 DrawIndex = FirstDraw;
+		DrawIndex < LastDraw;
+		DrawIndex += 8)
+	{
+		__m256 X = _mm256_loadu_ps(&Soa.CenterX[DrawIndex]);
+		__m256 Y = _mm256_loadu_ps(&Soa.CenterY[DrawIndex]);
+		__m256 Z = _mm256_loadu_ps(&Soa.CenterZ[DrawIndex]);
+		__m256 NegRadius = _mm256_sub_ps(Zero, _mm256_loadu_ps(&Soa.Radius[DrawIndex]));
+
+		__m256 Mask = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for(u32 PlaneIndex = 0;
+			PlaneIndex < 6;
+			++PlaneIndex)
+		{
+			__m256 Distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(PlaneX[PlaneIndex], X), _mm256_mul_ps(PlaneY[PlaneIndex], Y)),
+														  _mm256_mul_ps(PlaneZ[PlaneIndex], Z)), PlaneW[PlaneIndex]);
+			Mask = _mm256_and_ps(Mask, _mm256_cmp_ps(Distance, NegRadius, _CMP_GT_OQ));
+		}
+
+		u32 Bits = u32(_mm256_movemask_ps(Mask));
+		u32 LaneCount = min(8u, LastDraw - DrawIndex);
+		for(u32 Lane = 0;
+			Lane < LaneCount;
+			++Lane)
+		{
+			Visibility[DrawIndex + Lane] = (Bits >> Lane) & 1;
+		}
+	}
+}
+
+internal u32
+SelectLod(const draw_soa& Soa, const mesh& Mesh, u32 DrawIndex)
+{
+	float X = Soa.CenterX[DrawIndex], Y = Soa.CenterY[DrawIndex], Z = Soa.CenterZ[DrawIndex];
+	float LodDistance = log2f(max(1.0f, sqrtf(X * X + Y * Y + Z * Z) - Soa.Radius[DrawIndex]));
+	return u32(min(max(s32(LodDistance), 0), s32(Mesh.LodCount) - 1));
+}
+
+// NOTE: IsSphereBelowContribution of cull_headers.hlsl with the same float order. The shader tests the
+// global threshold before it reads the mesh, so a mesh scale above 1 doesn't drop more draws
+internal bool
+IsDrawBelowContribution(const draw_soa& Soa, const mesh& Mesh, const draw_cull_data& CullData, u32 DrawIndex)
+{
+	float Radius = Soa.Radius[DrawIndex];
+	float Z = Soa.CenterZ[DrawIndex];
+	return Radius < CullData.ContributionThreshold * Z && Radius < CullData.ContributionThreshold * Mesh.ContributionScale * Z;
+}
+
+// NOTE: Flags are draw_cull_flags. Occlusion needs a cpu pyramid, instancing isn't supported and
+// every visible draw gets its own command like draw_cull.comp does without it
+internal void
+CullDrawsCpu(cpu_cull_result& Result, worker_pool& Pool, const draw_soa& Soa, const std::vector<mesh>& Meshes,
+			 const draw_cull_data& CullData, u32 Flags, const depth_pyramid* Pyramid = 0, bool IsAvx2Enabled = true)
+{
+	u32 ChunkCount = (Soa.Count + CPU_CULL_CHUNK - 1) / CPU_CULL_CHUNK;
+	Result.Visibility.resize(Soa.Count);
+	Result.ChunkOffsets.resize(ChunkCount + 1);
+
+	ParallelFor(Pool, ChunkCount, [&](u32 ChunkIndex)
+	{
+		u32 FirstDraw = ChunkIndex * CPU_CULL_CHUNK;
+		u32 LastDraw  = min(FirstDraw + CPU_CULL_CHUNK, Soa.Count);
+		u8* Visibility = Result.Visibility.data();
+
+		if(!(Flags & DrawCullFlag_Cull))
+		{
+			memset(Visibility + FirstDraw, 1, LastDraw - FirstDraw);
+		}
+		else if(IsAvx2Enabled)
+		{
+			TestFrustumAvx2(Soa, CullData, FirstDraw, LastDraw, Visibility);
+		}
+		else
+		{
+			TestFrustumScalar(Soa, CullData, FirstDraw, LastDraw, Visibility);
+		}
+
+		u32 VisibleCount = 0;
+		for(u32 DrawIndex = FirstDraw;
+			DrawIndex < LastDraw;
+			++DrawIndex)
+		{
+			if(Visibility[DrawIndex] && (Flags & DrawCullFlag_Cull) && IsDrawBelowContribution(Soa, Meshes[Soa.MeshIndex[DrawIndex]], CullData, DrawIndex))
+			{
+				Visibility[DrawIndex] = 0;
+			}
+
+			if(Visibility[DrawIndex] && (Flags & DrawCullFlag_Occlusion) && Pyramid)
+			{
+				glm::vec3 Center(Soa.CenterX[DrawIndex], Soa.CenterY[DrawIndex], Soa.CenterZ[DrawIndex]);
+				float Radius = Soa.Radius[DrawIndex];
+
+				glm::vec4 AABB;
+				if(ProjectSphere(Center, Radius, CullData.znear, CullData.P00, CullData.P11, AABB))
+				{
+					float DepthSphere = CullData.znear / (Center.z - Radius);
+					Visibility[DrawIndex] = !IsOccludedConservative(*Pyramid, AABB, DepthSphere);
+				}
+			}
+
+			VisibleCount += Visibility[DrawIndex];
+		}
+
+		Result.ChunkOffsets[ChunkIndex + 1] = VisibleCount;
+	});
+
+	Result.ChunkOffsets[0] = 0;
+	for(u32 ChunkIndex = 0;
+		ChunkIndex < ChunkCount;
+		++ChunkIndex)
+	{
+		Result.ChunkOffsets[ChunkIndex + 1] += Result.ChunkOffsets[ChunkIndex];
+	}
+
+	Result.CommandCount = Result.ChunkOffsets[ChunkCount];
+	Result.Commands.resize(Result.CommandCount);
+	Result.InstanceIds.resize(Result.CommandCount);
+
+	ParallelFor(Pool, ChunkCount, [&](u32 ChunkIndex)
+	{
+		u32 FirstDraw = ChunkIndex * CPU_CULL_CHUNK;
+		u32 LastDraw  = min(FirstDraw + CPU_CULL_CHUNK, Soa.Count);
+		u32 CommandIndex = Result.ChunkOffsets[ChunkIndex];
+		for(u32 DrawIndex = FirstDraw;
+			DrawIndex < LastDraw;
+			++DrawIndex)
+		{
+			if(!Result.Visibility[DrawIndex])
+			{
+				continue;
+			}
+
+			const mesh& Mesh = Meshes[Soa.MeshIndex[DrawIndex]];
+			u32 LodIndex = (Flags & DrawCullFlag_Lod) ? SelectLod(Soa, Mesh, DrawIndex) : 0;
+			const mesh_lod& Lod = Mesh.Lods[LodIndex];
+
+			mesh_draw_command& Command = Result.Commands[CommandIndex];
+			Command.DrawIndex = DrawIndex;
+			Command.DrawCommand.indexCount = Lod.IndexCount;
+			Command.DrawCommand.instanceCount = 1;
+			Command.DrawCommand.firstIndex = Lod.IndexOffset;
+			Command.DrawCommand.vertexOffset = s32(Mesh.VertexOffset);
+			Command.DrawCommand.firstInstance = CommandIndex;
+			Command.MeshletGroupCount = (Lod.MeshletCount + 31) / 32;
+			Command.MeshletDrawCommand.taskCount = (Lod.MeshletCount + 31) / 32;
+			Command.MeshletDrawCommand.firstTask = Lod.MeshletOffset / 32;
+
+			Result.InstanceIds[CommandIndex] = DrawIndex;
+			CommandIndex++;
+		}
+	});
+}
+
+// NOTE: draws where float differences between implementations can flip the result:
+// a sphere touching a frustum plane, a projected size next to the contribution threshold
+// or a lod distance next to a whole number
+internal bool
+IsCullResultAmbiguous(const draw_soa& Soa, const mesh& Mesh, const draw_cull_data& CullData, u32 DrawIndex)
+{
+	float Epsilon = 1e-4f;
+	float Radius = Soa.Radius[DrawIndex];
+	for(u32 PlaneIndex = 0;
+		PlaneIndex < 6;
+		++PlaneIndex)
+	{
+		const glm::vec4& Plane = CullData.Frustrum[PlaneIndex];
+		float Distance = Plane.x * Soa.CenterX[DrawIndex] + Plane.y * Soa.CenterY[DrawIndex] + Plane.z * Soa.CenterZ[DrawIndex] + Plane.w;
+		if(fabsf(Distance + Radius) <= Epsilon * max(1.0f, fabsf(Plane.w) + Radius))
+		{
+			return true;
+		}
+	}
+
+	float X = Soa.CenterX[DrawIndex], Y = Soa.CenterY[DrawIndex], Z = Soa.CenterZ[DrawIndex];
+	float ContributionRadius = CullData.ContributionThreshold * min(1.0f, Mesh.ContributionScale) * Z;
+	if(fabsf(Radius - ContributionRadius) <= Epsilon * Radius)
+	{
+		return true;
+	}
+
+	float LodDistance = log2f(max(1.0f, sqrtf(X * X + Y * Y + Z * Z) - Radius));
+	return Mesh.LodCount > 1 && fabsf(LodDistance - roundf(LodDistance)) <= Epsilon * max(1.0f, LodDistance);
+}
+
+// NOTE: compares two command streams by draw index, order doesn't matter. Returns the number of draws
+// that differ and aren't ambiguous
+internal u32
+CompareCullResults(const draw_soa& Soa, const std::vector<mesh>& Meshes, const draw_cull_data& CullData,
+				   const mesh_draw_command* Expected, u32 ExpectedCount, const mesh_draw_command* Actual, u32 ActualCount, u32* AmbiguousCount = 0)
+{
+	std::vector<const mesh_draw_command*> ExpectedByDraw(Soa.Count), ActualByDraw(Soa.Count);
+	for(u32 CommandIndex = 0;
+		CommandIndex < ExpectedCount;
+		++CommandIndex)
+	{
+		ExpectedByDraw[Expected[CommandIndex].DrawIndex] = &Expected[CommandIndex];
+	}
+	for(u32 CommandIndex = 0;
+		CommandIndex < ActualCount;
+		++CommandIndex)
+	{
+		if(Actual[CommandIndex].DrawIndex < Soa.Count)
+		{
+			ActualByDraw[Actual[CommandIndex].DrawIndex] = &Actual[CommandIndex];
+		}
+	}
+
+	u32 MismatchCount = 0;
+	u32 AmbiguousMismatchCount = 0;
+	for(u32 DrawIndex = 0;
+		DrawIndex < Soa.Count;
+		++DrawIndex)
+	{
+		const mesh_draw_command* A = ExpectedByDraw[DrawIndex];
+		const mesh_draw_command* B = ActualByDraw[DrawIndex];
+
+		bool IsSame = (!A && !B) || (A && B &&
+					  A->DrawCommand.indexCount == B->DrawCommand.indexCount &&
+					  A->DrawCommand.instanceCount == B->DrawCommand.instanceCount &&
+					  A->DrawCommand.firstIndex == B->DrawCommand.firstIndex &&
+					  A->DrawCommand.vertexOffset == B->DrawCommand.vertexOffset &&
+					  A->MeshletDrawCommand.taskCount == B->MeshletDrawCommand.taskCount &&
+					  A->MeshletDrawCommand.firstTask == B->MeshletDrawCommand.firstTask &&
+					  A->MeshletGroupCount == B->MeshletGroupCount);
+		if(IsSame)
+		{
+			continue;
+		}
+
+		if(IsCullResultAmbiguous(Soa, Meshes[Soa.MeshIndex[DrawIndex]], CullData, DrawIndex))
+		{
+			AmbiguousMismatchCount++;
+		}
+		else
+		{
+			MismatchCount++;
+		}
+	}
+
+	if(AmbiguousCount)
+	{
+		*AmbiguousCount = AmbiguousMismatchCount;
+	}
+
+	return MismatchCount;
+}
+
+// NOTE: rebuilds the commands of both paths from the indexed command and draw id streams of a non instanced
+// cull, the draw index is the instance id the command points to
+internal void
+UnpackDrawCommands(std::vector<mesh_draw_command>& Commands, const draw_soa& Soa, const std::vector<mesh>& Meshes,
+				   const VkDrawIndexedIndirectCommand* DrawCommands, const u32* DrawIds, const u32* InstanceIds, u32 CommandCount)
+{
+	Commands.resize(CommandCount);
+	for(u32 CommandIndex = 0;
+		CommandIndex < CommandCount;
+		++CommandIndex)
+	{
+		mesh_draw_command& Command = Commands[CommandIndex];
+		Command = {};
+		Command.DrawIndex = ~0u;
+		Command.DrawCommand = DrawCommands[CommandIndex];
+
+		u32 FirstInstance = DrawIds[CommandIndex] & DRAW_ID_INSTANCE_MASK;
+		u32 LodIndex = DrawIds[CommandIndex] >> DRAW_ID_LOD_SHIFT;
+		if(FirstInstance >= CommandCount || InstanceIds[FirstInstance] >= Soa.Count)
+		{
+			continue;
+		}
+
+		Command.DrawIndex = InstanceIds[FirstInstance];
+
+		const mesh& Mesh = Meshes[Soa.MeshIndex[Command.DrawIndex]];
+		const mesh_lod& Lod = Mesh.Lods[LodIndex];
+		Command.MeshletGroupCount = (Lod.MeshletCount + 31) / 32;
+		Command.MeshletDrawCommand.taskCount = (Lod.MeshletCount + 31) / 32;
+		Command.MeshletDrawCommand.firstTask = Lod.MeshletOffset / 32;
+	}
+}
+
+// NOTE: random draws of the loaded meshes around the camera, culled with every combination of
+// avx2 and threads for growing draw counts. The avx2 and scalar streams have to be the same.
+// Without avx2 only the scalar variants run
+internal void
+BenchmarkCpuCulling(worker_pool& Pool, const geometry& Geometries, const draw_cull_data& CullData, u32 MaxDrawCount)
+{
+	u32 RandomState = 0x6a09e667;
+	auto Random = [&RandomState]() -> float
+	{
+		RandomState ^= RandomState << 13;
+		RandomState ^= RandomState >> 17;
+		RandomState ^= RandomState << 5;
+		return float(RandomState >> 8) / float(1 << 24);
+	};
+
+	draw_soa Soa = {};
+	ResizeDrawSoA(Soa, MaxDrawCount);
+
+	float SceneRadius = 200.0f;
+	for(u32 DrawIndex = 0;
+		DrawIndex < MaxDrawCount;
+		++DrawIndex)
+	{
+		u32 MeshIndex = u32(Random() * Geometries.Meshes.size()) % u32(Geometries.Meshes.size());
+		Soa.CenterX[DrawIndex] = (Random() * 2 - 1) * SceneRadius;
+		Soa.CenterY[DrawIndex] = (Random() * 2 - 1) * SceneRadius;
+		Soa.CenterZ[DrawIndex] = (Random() * 2 - 1) * SceneRadius;
+		Soa.Radius[DrawIndex]  = Geometries.Meshes[MeshIndex].Radius * (Random() + 1) * 2.0f;
+		Soa.MeshIndex[DrawIndex] = MeshIndex;
+	}
+
+	LARGE_INTEGER TimeFreq;
+	QueryPerformanceFrequency(&TimeFreq);
+
+	bool IsAvx2Enabled = IsAvx2Supported();
+	worker_pool SerialPool = {};
+	cpu_cull_result Result = {}, ScalarResult = {};
+	u32 Flags = DrawCullFlag_Cull | DrawCullFlag_Lod;
+
+	printf("Cpu culling benchmark, %u worker threads, avx2 %s\n", Pool.ThreadCount, IsAvx2Enabled ? "supported" : "not supported");
+	for(u32 DrawCount = 1000;
+		DrawCount <= MaxDrawCount;
+		DrawCount *= 10)
+	{
+		Soa.Count = DrawCount;
+
+		// NOTE: best of a few runs, the first one also grows the result arrays
+		double Times[4] = {DBL_MAX, DBL_MAX, DBL_MAX, DBL_MAX};
+		for(u32 RunIndex = 0;
+			RunIndex < 4;
+			++RunIndex)
+		{
+			for(u32 Variant = IsAvx2Enabled ? 0 : 2;
+				Variant < 4;
+				++Variant)
+			{
+				bool IsThreaded = (Variant & 1) == 0;
+				bool IsAvx2 = (Variant & 2) == 0;
+
+				LARGE_INTEGER BegTime, EndTime;
+				QueryPerformanceCounter(&BegTime);
+				CullDrawsCpu(IsAvx2 ? Result : ScalarResult, IsThreaded ? Pool : SerialPool, Soa, Geometries.Meshes, CullData, Flags, 0, IsAvx2);
+				QueryPerformanceCounter(&EndTime);
+
+				Times[Variant] = min(Times[Variant], double(EndTime.QuadPart - BegTime.QuadPart) * 1000.0 / double(TimeFreq.QuadPart));
+			}
+		}
+
+		if(!IsAvx2Enabled)
+		{
+			printf("%9u draws, %8u commands: avx2      n/a threaded,      n/a serial; scalar %8.3f ms threaded, %8.3f ms serial\n",
+				   DrawCount, ScalarResult.CommandCount, Times[2], Times[3]);
+			continue;
+		}
+
+		u32 MismatchCount = CompareCullResults(Soa, Geometries.Meshes, CullData, ScalarResult.Commands.data(), ScalarResult.CommandCount, Result.Commands.data(), Result.CommandCount);
+		printf("%9u draws, %8u commands: avx2 %8.3f ms threaded, %8.3f ms serial; scalar %8.3f ms threaded, %8.3f ms serial; %u mismatches\n",
+			   DrawCount, Result.CommandCount, Times[0], Times[1], Times[2], Times[3], MismatchCount);
+		assert(MismatchCount == 0);
+	}
+
+	Soa.Count = MaxDrawCount;
+}
+
+// NOTE: frustum test over every draw, once reading whole mesh_offset records and transforming the
+// local sphere like draw_cull.comp used to, once reading the draw_sphere stream it reads now.
+// Both have to count the same draws, the bandwidth is the size of the records that were read
+internal void
+BenchmarkDrawStreams(worker_pool& Pool, const geometry& Geometries, const draw_cull_data& CullData, u32 MaxDrawCount)
+{
+	u32 RandomState = 0xbb67ae85;
+	auto Random = [&RandomState]() -> float
+	{
+		RandomState ^= RandomState << 13;
+		RandomState ^= RandomState >> 17;
+		RandomState ^= RandomState << 5;
+		return float(RandomState >> 8) / float(1 << 24);
+	};
+
+	std::vector<mesh_offset> Draws(MaxDrawCount);
+
+	float SceneRadius = 200.0f;
+	for(u32 DrawIndex = 0;
+		DrawIndex < MaxDrawCount;
+		++DrawIndex)
+	{
+		mesh_offset& Draw = Draws[DrawIndex];
+		u32 MeshIndex = u32(Random() * Geometries.Meshes.size()) % u32(Geometries.Meshes.size());
+		const mesh& Mesh = Geometries.Meshes[MeshIndex];
+
+		Draw.Pos[0] = (Random() * 2 - 1) * SceneRadius;
+		Draw.Pos[1] = (Random() * 2 - 1) * SceneRadius;
+		Draw.Pos[2] = (Random() * 2 - 1) * SceneRadius;
+		Draw.Scale  = Random() + 1.0f;
+		Draw.Orient = glm::normalize(glm::quat(Random() * 2 - 1, Random() * 2 - 1, Random() * 2 - 1, Random() * 2 - 1));
+		Draw.Center = Mesh.Center;
+		Draw.Radius = Mesh.Radius;
+		Draw.MeshIndex = MeshIndex;
+		Draw.VertexOffset = Mesh.VertexOffset;
+	}
+
+	std::vector<draw_sphere> Spheres;
+	std::vector<draw_transform> Transforms;
+	std::vector<packed_transform> PackedTransforms;
+	BuildDrawStreams(Spheres, Transforms, PackedTransforms, Pool, Draws);
+
+	LARGE_INTEGER TimeFreq;
+	QueryPerformanceFrequency(&TimeFreq);
+
+	u32 ChunkCount = (MaxDrawCount + CPU_CULL_CHUNK - 1) / CPU_CULL_CHUNK;
+	std::vector<u32> ChunkCounts(ChunkCount);
+
+	printf("Draw stream benchmark, %u worker threads, %u byte records against %u byte spheres\n", Pool.ThreadCount, u32(sizeof(mesh_offset)), u32(sizeof(draw_sphere)));
+	for(u32 DrawCount = 1024 * 1024;
+		DrawCount <= MaxDrawCount;
+		DrawCount *= 4)
+	{
+		u32 DrawChunkCount = (DrawCount + CPU_CULL_CHUNK - 1) / CPU_CULL_CHUNK;
+
+		// NOTE: best of a few runs
+		double Times[2] = {DBL_MAX, DBL_MAX};
+		u32 VisibleCounts[2] = {};
+		for(u32 RunIndex = 0;
+			RunIndex < 4;
+			++RunIndex)
+		{
+			for(u32 Variant = 0;
+				Variant < 2;
+				++Variant)
+			{
+				LARGE_INTEGER BegTime, EndTime;
+				QueryPerformanceCounter(&BegTime);
+				ParallelFor(Pool, DrawChunkCount, [&](u32 ChunkIndex)
+				{
+					u32 FirstDraw = ChunkIndex * CPU_CULL_CHUNK;
+					u32 LastDraw  = min(FirstDraw + CPU_CULL_CHUNK, DrawCount);
+
+					u32 VisibleCount = 0;
+					for(u32 DrawIndex = FirstDraw;
+						DrawIndex < LastDraw;
+						++DrawIndex)
+					{
+						if(Variant == 0)
+						{
+							glm::vec3 Center;
+							float Radius;
+							GetDrawSphere(Draws[DrawIndex], Center, Radius);
+							VisibleCount += IsSphereInFrustum(CullData, Center, Radius);
+						}
+						else
+						{
+							VisibleCount += IsSphereInFrustum(CullData, Spheres[DrawIndex].Center, Spheres[DrawIndex].Radius);
+						}
+					}
+
+					ChunkCounts[ChunkIndex] = VisibleCount;
+				});
+				QueryPerformanceCounter(&EndTime);
+
+				Times[Variant] = min(Times[Variant], double(EndTime.QuadPart - BegTime.QuadPart) * 1000.0 / double(TimeFreq.QuadPart));
+
+				VisibleCounts[Variant] = 0;
+				for(u32 ChunkIndex = 0;
+					ChunkIndex < DrawChunkCount;
+					++ChunkIndex)
+				{
+					VisibleCounts[Variant] += ChunkCounts[ChunkIndex];
+				}
+			}
+		}
+
+		double RecordBytes = double(DrawCount) * sizeof(mesh_offset);
+		double SphereBytes = double(DrawCount) * sizeof(draw_sphere);
+		printf("%9u draws, %8u visible: records %8.3f ms %6.2f GB/s, spheres %8.3f ms %6.2f GB/s\n",
+			   DrawCount, VisibleCounts[1], 
+			   Times[0], RecordBytes / (Times[0] * 1e6), Times[1], SphereBytes / (Times[1] * 1e6));
+		assert(VisibleCounts[0] == VisibleCounts[1]);
+	}
+}
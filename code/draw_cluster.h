@@ -0,0 +1,137 @@
+
+// NOTE: draws are sorted along a morton curve of their world centers and split into clusters of
+// at most DRAW_CLUSTER_SIZE consecutive draws. cluster_cull.comp tests the cluster spheres and appends
+// the survivors to a list, draw_cull.comp then runs one group per listed cluster through an indirect
+// dispatch, so a cluster has to fit into one group of it
+#define DRAW_CLUSTER_SIZE 64
+
+// NOTE: set on list entries of clusters that were outside of the frustum last frame.
+// Draw visibility isn't updated for culled clusters, so it is stale for their draws
+#define DRAW_CLUSTER_NEWLY_VISIBLE 0x80000000
+
+struct draw_cluster
+{
+	glm::vec3 Center;
+	float Radius;
+
+	u32 FirstDraw;
+	u32 DrawCount;
+};
+
+internal u32
+SpreadMortonBits(u32 Value)
+{
+	Value &= 0x3ff;
+	Value = (Value | (Value << 16)) & 0x030000ff;
+	Value = (Value | (Value <<  8)) & 0x0300f00f;
+	Value = (Value | (Value <<  4)) & 0x030c30c3;
+	Value = (Value | (Value <<  2)) & 0x09249249;
+	return Value;
+}
+
+// NOTE: clusters keep their draws when instances move, only the bounds have to be refit.
+// The sphere is centered on the bounding box of the draw spheres and encloses all of them
+internal void
+RefitDrawClusters(std::vector<draw_cluster>& Clusters, worker_pool& Pool, const std::vector<mesh_offset>& Draws)
+{
+	ParallelFor(Pool, u32(Clusters.size()), [&](u32 ClusterIndex)
+	{
+		draw_cluster& Cluster = Clusters[ClusterIndex];
+
+		glm::vec3 BoxMin( FLT_MAX), BoxMax(-FLT_MAX);
+		for(u32 DrawIndex = Cluster.FirstDraw;
+			DrawIndex < Cluster.FirstDraw + Cluster.DrawCount;
+			++DrawIndex)
+		{
+			glm::vec3 Center;
+			float Radius;
+			GetDrawSphere(Draws[DrawIndex], Center, Radius);
+
+			for(u32 Axis = 0;
+				Axis < 3;
+				++Axis)
+			{
+				BoxMin[Axis] = min(BoxMin[Axis], Center[Axis] - Radius);
+				BoxMax[Axis] = max(BoxMax[Axis], Center[Axis] + Radius);
+			}
+		}
+
+		Cluster.Center = (BoxMin + BoxMax) * 0.5f;
+		Cluster.Radius = 0.0f;
+		for(u32 DrawIndex = Cluster.FirstDraw;
+			DrawIndex < Cluster.FirstDraw + Cluster.DrawCount;
+			++DrawIndex)
+		{
+			glm::vec3 Center;
+			float Radius;
+			GetDrawSphere(Draws[DrawIndex], Center, Radius);
+
+			Cluster.Radius = max(Cluster.Radius, glm::length(Center - Cluster.Center) + Radius);
+		}
+	});
+}
+
+// NOTE: reorders Draws so that every cluster is a contiguous range of them
+internal void
+BuildDrawClusters(std::vector<draw_cluster>& Clusters, worker_pool& Pool, std::vector<mesh_offset>& Draws)
+{
+	u32 DrawCount = u32(Draws.size());
+
+	std::vector<glm::vec3> Centers(DrawCount);
+	glm::vec3 SceneMin( FLT_MAX), SceneMax(-FLT_MAX);
+	for(u32 DrawIndex = 0;
+		DrawIndex < DrawCount;
+		++DrawIndex)
+	{
+		float Radius;
+		GetDrawSphere(Draws[DrawIndex], Centers[DrawIndex], Radius);
+
+		for(u32 Axis = 0;
+			Axis < 3;
+			++Axis)
+		{
+			SceneMin[Axis] = min(SceneMin[Axis], Centers[DrawIndex][Axis]);
+			SceneMax[Axis] = max(SceneMax[Axis], Centers[DrawIndex][Axis]);
+		}
+	}
+
+	glm::vec3 SceneScale;
+	for(u32 Axis = 0;
+		Axis < 3;
+		++Axis)
+	{
+		SceneScale[Axis] = 1023.0f / max(SceneMax[Axis] - SceneMin[Axis], FLT_EPSILON);
+	}
+
+	// NOTE: the draw index breaks ties, so equal codes keep their order
+	std::vector<u64> SortKeys(DrawCount);
+	for(u32 DrawIndex = 0;
+		DrawIndex < DrawCount;
+		++DrawIndex)
+	{
+		glm::vec3 Cell = (Centers[DrawIndex] - SceneMin) * SceneScale;
+		u32 Code = (SpreadMortonBits(u32(Cell.x)) << 2) | (SpreadMortonBits(u32(Cell.y)) << 1) | SpreadMortonBits(u32(Cell.z));
+		SortKeys[DrawIndex] = (u64(Code) << 32) | DrawIndex;
+	}
+	std::sort(SortKeys.begin(), SortKeys.end());
+
+	std::vector<mesh_offset> SortedDraws(DrawCount);
+	for(u32 DrawIndex = 0;
+		DrawIndex < DrawCount;
+		++DrawIndex)
+	{
+		SortedDraws[DrawIndex] = Draws[u32(SortKeys[DrawIndex])];
+	}
+	Draws.swap(SortedDraws);
+
+	Clusters.resize((DrawCount + DRAW_CLUSTER_SIZE - 1) / DRAW_CLUSTER_SIZE);
+	for(u32 ClusterIndex = 0;
+		ClusterIndex < Clusters.size();
+		++ClusterIndex)
+	{
+		Clusters[ClusterIndex].FirstDraw = ClusterIndex * DRAW_CLUSTER_SIZE;
+		Clusters[ClusterIndex].DrawCount = min(u32(DRAW_CLUSTER_SIZE), DrawCount - ClusterIndex * DRAW_CLUSTER_SIZE);
+	}
+
+	RefitDrawClusters(Clusters, Pool, Draws);
+}
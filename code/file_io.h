@@ -0,0 +1,344 @@
+
+// NOTE: batched file reads. All files are opened and their reads are issued at once as overlapped
+// reads on one io completion port, so the latency of slow storage overlaps instead of adding up.
+// Callers take the results in completion order or wait for a specific file. Every read buffer gets
+// a zero terminator so text parsers can work on it in place
+enum file_read_mode
+{
+	FileReadMode_Overlapped,
+
+	// NOTE: fallback for storage without overlapped io, blocking reads run on system thread pool
+	// workers and post their completion to the same port
+	FileReadMode_Threaded,
+
+	// NOTE: reads files one after another with blocking reads when they are waited for, to compare against
+	FileReadMode_Sequential,
+};
+
+struct file_read
+{
+	const char* Path;
+	HANDLE File;
+	OVERLAPPED Overlapped;
+
+	u8* Data;
+	size_t Size;
+
+	// NOTE: bypasses the page cache, the buffer is page aligned and the read rounded up to whole pages
+	bool IsUnbuffered;
+
+	bool IsCompleted;
+	bool IsTaken;
+	bool IsFailed;
+};
+
+struct file_read_batch
+{
+	HANDLE CompletionPort;
+	std::vector<file_read> Reads;
+
+	u32 CompletedCount;
+	u32 TakenCount;
+
+	file_read_mode Mode;
+	bool IsUnbuffered;
+
+	// NOTE: every thread pool work item takes the next read of the batch
+	volatile LONG NextThreadedRead;
+};
+
+#define FILE_READ_UNBUFFERED_ALIGNMENT 4096
+
+internal u32
+AddFileRead(file_read_batch& Batch, const char* Path)
+{
+	assert(!Batch.CompletionPort);
+
+	file_read NewRead = {};
+	NewRead.Path = Path;
+	NewRead.File = INVALID_HANDLE_VALUE;
+	NewRead.IsUnbuffered = Batch.IsUnbuffered;
+
+	Batch.Reads.push_back(NewRead);
+	return u32(Batch.Reads.size() - 1);
+}
+
+internal bool
+OpenFileRead(file_read& Read, bool IsOverlapped)
+{
+	Read.File = CreateFileA(Read.Path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+							FILE_FLAG_SEQUENTIAL_SCAN | (IsOverlapped ? FILE_FLAG_OVERLAPPED : 0) | (Read.IsUnbuffered ? FILE_FLAG_NO_BUFFERING : 0), 0);
+	if(Read.File == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	// NOTE: a single read is limited to 4GB; larger sources go through the streaming paths instead
+	LARGE_INTEGER FileSize;
+	if(!GetFileSizeEx(Read.File, &FileSize) || u64(FileSize.QuadPart) >= MAXDWORD)
+	{
+		return false;
+	}
+
+	Read.Size = size_t(FileSize.QuadPart);
+	if(Read.IsUnbuffered)
+	{
+		size_t BufferSize = (Read.Size + FILE_READ_UNBUFFERED_ALIGNMENT) & ~size_t(FILE_READ_UNBUFFERED_ALIGNMENT - 1);
+		Read.Data = (u8*)VirtualAlloc(0, BufferSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+	else
+	{
+		Read.Data = (u8*)malloc(Read.Size + 1);
+	}
+
+	if(!Read.Data)
+	{
+		return false;
+	}
+	Read.Data[Read.Size] = 0;
+
+	return true;
+}
+
+internal DWORD
+GetFileReadLength(const file_read& Read)
+{
+	if(Read.IsUnbuffered)
+	{
+		return DWORD((Read.Size + FILE_READ_UNBUFFERED_ALIGNMENT - 1) & ~size_t(FILE_READ_UNBUFFERED_ALIGNMENT - 1));
+	}
+
+	return DWORD(Read.Size);
+}
+
+internal void CALLBACK
+ThreadedFileReadProc(PTP_CALLBACK_INSTANCE Instance, void* Param)
+{
+	file_read_batch& Batch = *(file_read_batch*)Param;
+	u32 ReadIndex = u32(InterlockedIncrement(&Batch.NextThreadedRead) - 1);
+	file_read& Read = Batch.Reads[ReadIndex];
+
+	DWORD ReadSize = 0;
+	bool IsRead = OpenFileRead(Read, false) && (!Read.Size || ReadFile(Read.File, Read.Data, GetFileReadLength(Read), &ReadSize, 0));
+
+	// NOTE: files are smaller than MAXDWORD, so a failed read posts a size no read can have.
+	// Nothing of the batch is touched after the post, the main thread may free it then
+	PostQueuedCompletionStatus(Batch.CompletionPort, IsRead ? ReadSize : MAXDWORD, ReadIndex, &Read.Overlapped);
+}
+
+internal void
+CompleteFileRead(file_read_batch& Batch, file_read& Read, bool IsFailed)
+{
+	if(Read.File != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(Read.File);
+		Read.File = INVALID_HANDLE_VALUE;
+	}
+
+	Read.IsFailed = IsFailed;
+	Read.IsCompleted = true;
+	Batch.CompletedCount++;
+}
+
+internal void
+SubmitFileReads(file_read_batch& Batch)
+{
+	if(Batch.Mode == FileReadMode_Sequential)
+	{
+		return;
+	}
+
+	Batch.CompletionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, 0, 0, 1);
+	assert(Batch.CompletionPort);
+
+	if(Batch.Mode == FileReadMode_Threaded)
+	{
+		for(u32 ReadIndex = 0;
+			ReadIndex < Batch.Reads.size();
+			++ReadIndex)
+		{
+			BOOL IsSubmitted = TrySubmitThreadpoolCallback(ThreadedFileReadProc, &Batch, 0);
+			assert(IsSubmitted);
+		}
+		return;
+	}
+
+	for(u32 ReadIndex = 0;
+		ReadIndex < Batch.Reads.size();
+		++ReadIndex)
+	{
+		file_read& Read = Batch.Reads[ReadIndex];
+		if(!OpenFileRead(Read, true) || !CreateIoCompletionPort(Read.File, Batch.CompletionPort, ReadIndex, 0))
+		{
+			CompleteFileRead(Batch, Read, true);
+			continue;
+		}
+
+		if(!Read.Size)
+		{
+			CompleteFileRead(Batch, Read, false);
+			continue;
+		}
+
+		// NOTE: reads that finish synchronously still post their completion to the port
+		if(!ReadFile(Read.File, Read.Data, GetFileReadLength(Read), 0, &Read.Overlapped) && GetLastError() != ERROR_IO_PENDING)
+		{
+			CompleteFileRead(Batch, Read, true);
+		}
+	}
+}
+
+internal void
+WaitNextFileRead(file_read_batch& Batch)
+{
+	assert(Batch.CompletedCount < Batch.Reads.size());
+
+	if(Batch.Mode == FileReadMode_Sequential)
+	{
+		for(file_read& Read : Batch.Reads)
+		{
+			if(Read.IsCompleted)
+			{
+				continue;
+			}
+
+			DWORD ReadSize = 0;
+			bool IsRead = OpenFileRead(Read, false) && (!Read.Size || ReadFile(Read.File, Read.Data, GetFileReadLength(Read), &ReadSize, 0));
+			CompleteFileRead(Batch, Read, !IsRead || ReadSize != Read.Size);
+			return;
+		}
+	}
+
+	DWORD ReadSize = 0;
+	ULONG_PTR ReadIndex = 0;
+	OVERLAPPED* Overlapped = 0;
+	BOOL IsRead = GetQueuedCompletionStatus(Batch.CompletionPort, &ReadSize, &ReadIndex, &Overlapped, INFINITE);
+	assert(Overlapped);
+
+	file_read& Read = Batch.Reads[ReadIndex];
+	CompleteFileRead(Batch, Read, !IsRead || ReadSize != Read.Size);
+}
+
+// NOTE: returns the next completed read of [FirstRead, FirstRead + ReadCount) that wasn't taken yet,
+// in completion order, or 0 when all of them were taken
+internal file_read*
+TakeNextFileRead(file_read_batch& Batch, u32 FirstRead, u32 ReadCount)
+{
+	for(;;)
+	{
+		bool IsPending = false;
+		for(u32 ReadIndex = FirstRead;
+			ReadIndex < FirstRead + ReadCount;
+			++ReadIndex)
+		{
+			file_read& Read = Batch.Reads[ReadIndex];
+			if(Read.IsCompleted && !Read.IsTaken)
+			{
+				Read.IsTaken = true;
+				Batch.TakenCount++;
+				return &Read;
+			}
+
+			IsPending = IsPending || !Read.IsCompleted;
+		}
+
+		if(!IsPending)
+		{
+			return 0;
+		}
+
+		WaitNextFileRead(Batch);
+	}
+}
+
+internal file_read*
+TakeFileRead(file_read_batch& Batch, u32 ReadIndex)
+{
+	file_read& Read = Batch.Reads[ReadIndex];
+	while(!Read.IsCompleted)
+	{
+		WaitNextFileRead(Batch);
+	}
+
+	assert(!Read.IsTaken);
+	Read.IsTaken = true;
+	Batch.TakenCount++;
+
+	return &Read;
+}
+
+internal void
+FreeFileRead(file_read& Read)
+{
+	if(Read.IsUnbuffered)
+	{
+		if(Read.Data)
+		{
+			VirtualFree(Read.Data, 0, MEM_RELEASE);
+		}
+	}
+	else
+	{
+		free(Read.Data);
+	}
+	Read.Data = 0;
+	Read.Size = 0;
+}
+
+internal void
+FreeFileReads(file_read_batch& Batch)
+{
+	// NOTE: pending overlapped reads still write into their buffers
+	while(Batch.Mode != FileReadMode_Sequential && Batch.CompletedCount < Batch.Reads.size())
+	{
+		WaitNextFileRead(Batch);
+	}
+
+	for(file_read& Read : Batch.Reads)
+	{
+		FreeFileRead(Read);
+	}
+
+	if(Batch.CompletionPort)
+	{
+		CloseHandle(Batch.CompletionPort);
+	}
+
+	Batch = {};
+}
+
+// NOTE: reads the files of Batch again in Mode without the page cache and gives the time until
+// all of them are in memory in ms. Lets every mode be compared in one run, none of them is helped
+// by the pages another mode already brought in. Returns false when a read failed
+internal bool
+TimeUncachedFileReads(const file_read_batch& Batch, file_read_mode Mode, LARGE_INTEGER TimeFreq, double* Time)
+{
+	file_read_batch TimedReads = {};
+	TimedReads.Mode = Mode;
+	TimedReads.IsUnbuffered = true;
+	for(const file_read& Read : Batch.Reads)
+	{
+		AddFileRead(TimedReads, Read.Path);
+	}
+
+	LARGE_INTEGER BegTime = {}, EndTime = {};
+	QueryPerformanceCounter(&BegTime);
+
+	SubmitFileReads(TimedReads);
+	while(TimedReads.CompletedCount < TimedReads.Reads.size())
+	{
+		WaitNextFileRead(TimedReads);
+	}
+
+	QueryPerformanceCounter(&EndTime);
+
+	bool IsRead = true;
+	for(const file_read& Read : TimedReads.Reads)
+	{
+		IsRead = IsRead && !Read.IsFailed;
+	}
+	FreeFileReads(TimedReads);
+
+	*Time = double(EndTime.QuadPart - BegTime.QuadPart) * 1000.0 / double(TimeFreq.QuadPart);
+	return IsRead;
+}
@@ -0,0 +1,564 @@
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "glbparser.h"
+#include "meshoptimizer/meshoptimizer.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+// minimal json dom; strings are not unescaped since glTF keys and enums we look at are plain ascii
+struct JsonNode
+{
+	char type; // o(bject), a(rray), s(tring), n(umber), l(iteral)
+
+	const char* key;
+	size_t key_size;
+
+	const char* str;
+	size_t str_size;
+	double number;
+
+	int first; // first child for objects and arrays
+	int next; // next sibling
+};
+
+static const char* skipSpace(const char* s, const char* end)
+{
+	while (s < end && (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n'))
+		s++;
+
+	return s;
+}
+
+static const char* parseString(const char* s, const char* end, const char** str, size_t* str_size)
+{
+	if (s >= end || *s != '"')
+		return 0;
+	s++;
+
+	*str = s;
+
+	while (s < end && *s != '"')
+		s += (*s == '\\') ? 2 : 1;
+
+	if (s >= end)
+		return 0;
+
+	*str_size = s - *str;
+	return s + 1;
+}
+
+static const char* parseValue(std::vector<JsonNode>& nodes, int& index, const char* s, const char* end, int depth)
+{
+	s = skipSpace(s, end);
+	if (s >= end || depth > 64)
+		return 0;
+
+	JsonNode node = {};
+	node.first = -1;
+	node.next = -1;
+
+	index = int(nodes.size());
+	nodes.push_back(node);
+
+	if (*s == '{' || *s == '[')
+	{
+		bool object = *s == '{';
+		char close = object ? '}' : ']';
+
+		nodes[index].type = object ? 'o' : 'a';
+
+		s = skipSpace(s + 1, end);
+		if (s < end && *s == close)
+			return s + 1;
+
+		int last = -1;
+
+		for (;;)
+		{
+			const char* key = 0;
+			size_t key_size = 0;
+
+			if (object)
+			{
+				s = parseString(skipSpace(s, end), end, &key, &key_size);
+				if (!s)
+					return 0;
+
+				s = skipSpace(s, end);
+				if (s >= end || *s != ':')
+					return 0;
+				s++;
+			}
+
+			int child = -1;
+			s = parseValue(nodes, child, s, end, depth + 1);
+			if (!s)
+				return 0;
+
+			nodes[child].key = key;
+			nodes[child].key_size = key_size;
+
+			if (last < 0)
+				nodes[index].first = child;
+			else
+				nodes[last].next = child;
+
+			last = child;
+
+			s = skipSpace(s, end);
+			if (s >= end)
+				return 0;
+
+			if (*s == close)
+				return s + 1;
+
+			if (*s != ',')
+				return 0;
+			s++;
+		}
+	}
+	else if (*s == '"')
+	{
+		nodes[index].type = 's';
+		return parseString(s, end, &nodes[index].str, &nodes[index].str_size);
+	}
+	else if (*s == '-' || unsigned(*s - '0') < 10)
+	{
+		// the json buffer isn't zero-terminated, so copy the number out for strtod
+		char number[64];
+		size_t length = 0;
+
+		while (s + length < end && length < sizeof(number) - 1 && strchr("+-.eE0123456789", s[length]))
+			length++;
+
+		memcpy(number, s, length);
+		number[length] = 0;
+
+		nodes[index].type = 'n';
+		nodes[index].number = strtod(number, 0);
+
+		return s + length;
+	}
+	else
+	{
+		// true, false, null
+		nodes[index].type = 'l';
+		nodes[index].str = s;
+
+		while (s < end && unsigned((*s | ' ') - 'a') < 26)
+			s++;
+
+		nodes[index].str_size = s - nodes[index].str;
+		return s;
+	}
+}
+
+static int jsonMember(const std::vector<JsonNode>& nodes, int object, const char* key)
+{
+	if (object < 0 || nodes[object].type != 'o')
+		return -1;
+
+	size_t key_size = strlen(key);
+
+	for (int child = nodes[object].first; child >= 0; child = nodes[child].next)
+		if (nodes[child].key_size == key_size && memcmp(nodes[child].key, key, key_size) == 0)
+			return child;
+
+	return -1;
+}
+
+static int jsonElement(const std::vector<JsonNode>& nodes, int array, size_t element)
+{
+	if (array < 0 || nodes[array].type != 'a')
+		return -1;
+
+	int child = nodes[array].first;
+
+	for (size_t i = 0; i < element && child >= 0; ++i)
+		child = nodes[child].next;
+
+	return child;
+}
+
+static size_t jsonCount(const std::vector<JsonNode>& nodes, int array)
+{
+	if (array < 0 || nodes[array].type != 'a')
+		return 0;
+
+	size_t count = 0;
+
+	for (int child = nodes[array].first; child >= 0; child = nodes[child].next)
+		count++;
+
+	return count;
+}
+
+static double jsonNumber(const std::vector<JsonNode>& nodes, int node, double fallback)
+{
+	return (node >= 0 && nodes[node].type == 'n') ? nodes[node].number : fallback;
+}
+
+// sizes, offsets and counts have to be non-negative integers; glb files are limited to 4 GB
+static bool jsonSize(const std::vector<JsonNode>& nodes, int node, size_t* result)
+{
+	double value = jsonNumber(nodes, node, 0);
+
+	if (!(value >= 0 && value <= 4294967295.0) || value != double(size_t(value)))
+		return false;
+
+	*result = size_t(value);
+	return true;
+}
+
+// index of an element of a top level array, -1 if missing; invalid indices give -2
+static int jsonIndex(const std::vector<JsonNode>& nodes, int node)
+{
+	if (node < 0)
+		return -1;
+
+	double value = jsonNumber(nodes, node, -2);
+
+	if (!(value >= 0 && value <= 2147483647.0) || value != double(int(value)))
+		return -2;
+
+	return int(value);
+}
+
+// offset + length <= size, without overflowing
+static bool rangeFits(size_t offset, size_t length, size_t size)
+{
+	return offset <= size && length <= size - offset;
+}
+
+static bool jsonEquals(const std::vector<JsonNode>& nodes, int node, const char* str)
+{
+	return node >= 0 && (nodes[node].type == 's' || nodes[node].type == 'l') && nodes[node].str_size == strlen(str) && memcmp(nodes[node].str, str, nodes[node].str_size) == 0;
+}
+
+static int componentCount(const std::vector<JsonNode>& nodes, int type)
+{
+	static const char* types[] = {"SCALAR", "VEC2", "VEC3", "VEC4"};
+
+	for (int i = 0; i < 4; ++i)
+		if (jsonEquals(nodes, type, types[i]))
+			return i + 1;
+
+	return 0;
+}
+
+static size_t componentSize(int component_type)
+{
+	switch (component_type)
+	{
+	case 5120:
+	case 5121:
+		return 1;
+	case 5122:
+	case 5123:
+		return 2;
+	case 5125:
+	case 5126:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+static unsigned int readUint(const unsigned char* data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | (unsigned(data[3]) << 24);
+}
+
+// EXT_meshopt_compression; the index sequence mode isn't supported by the bundled index codec
+static bool decodeView(GlbBufferView& view, const std::vector<JsonNode>& nodes, int extension, const unsigned char* source, size_t source_size)
+{
+	size_t offset = 0, length = 0, stride = 0, count = 0;
+
+	if (!jsonSize(nodes, jsonMember(nodes, extension, "byteOffset"), &offset) ||
+	    !jsonSize(nodes, jsonMember(nodes, extension, "byteLength"), &length) ||
+	    !jsonSize(nodes, jsonMember(nodes, extension, "byteStride"), &stride) ||
+	    !jsonSize(nodes, jsonMember(nodes, extension, "count"), &count))
+		return false;
+
+	int mode = jsonMember(nodes, extension, "mode");
+	int filter = jsonMember(nodes, extension, "filter");
+
+	if (!source || !rangeFits(offset, length, source_size) || stride == 0 || count > size_t(-1) / stride)
+		return false;
+
+	view.decoded.resize(count * stride);
+
+	if (jsonEquals(nodes, mode, "ATTRIBUTES"))
+	{
+		if (meshopt_decodeVertexBuffer(view.decoded.data(), count, stride, source + offset, length) != 0)
+			return false;
+	}
+	else if (jsonEquals(nodes, mode, "TRIANGLES"))
+	{
+		if (meshopt_decodeIndexBuffer(view.decoded.data(), count, stride, source + offset, length) != 0)
+			return false;
+	}
+	else
+	{
+		return false;
+	}
+
+	if (jsonEquals(nodes, filter, "OCTAHEDRAL") && (stride == 4 || stride == 8))
+		meshopt_decodeFilterOct(view.decoded.data(), count, stride);
+	else if (jsonEquals(nodes, filter, "QUATERNION") && stride == 8)
+		meshopt_decodeFilterQuat(view.decoded.data(), count, stride);
+	else if (jsonEquals(nodes, filter, "EXPONENTIAL") && stride % 4 == 0)
+		meshopt_decodeFilterExp(view.decoded.data(), count, stride);
+	else if (filter >= 0 && !jsonEquals(nodes, filter, "NONE"))
+		return false;
+
+	view.data = view.decoded.data();
+	view.size = view.decoded.size();
+	view.stride = stride;
+
+	return true;
+}
+
+bool glbParse(GlbFile& result, const void* data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+	// header: magic, version, length; then json chunk and optional binary chunk
+	if (size < 20 || readUint(bytes) != 0x46546C67 || readUint(bytes + 4) != 2)
+		return false;
+
+	size_t json_size = readUint(bytes + 12);
+	if (readUint(bytes + 16) != 0x4E4F534A || 20 + json_size > size)
+		return false;
+
+	const char* json = reinterpret_cast<const char*>(bytes + 20);
+
+	const unsigned char* bin = 0;
+	size_t bin_size = 0;
+
+	size_t bin_offset = 20 + ((json_size + 3) & ~size_t(3));
+	if (bin_offset + 8 <= size && readUint(bytes + bin_offset + 4) == 0x004E4942)
+	{
+		bin = bytes + bin_offset + 8;
+		bin_size = readUint(bytes + bin_offset);
+
+		if (bin_offset + 8 + bin_size > size)
+			return false;
+	}
+
+	std::vector<JsonNode> nodes;
+	int root = -1;
+
+	if (!parseValue(nodes, root, json, json + json_size, 0) || nodes[root].type != 'o')
+		return false;
+
+	// only the binary chunk is supported as a buffer source; buffers with uri or fallback buffers have no data
+	int buffers = jsonMember(nodes, root, "buffers");
+	int bufferViews = jsonMember(nodes, root, "bufferViews");
+	int accessors = jsonMember(nodes, root, "accessors");
+	int meshes = jsonMember(nodes, root, "meshes");
+
+	result.views.resize(jsonCount(nodes, bufferViews));
+
+	for (size_t i = 0; i < result.views.size(); ++i)
+	{
+		int node = jsonElement(nodes, bufferViews, i);
+		GlbBufferView& view = result.views[i];
+
+		int extension = jsonMember(nodes, jsonMember(nodes, node, "extensions"), "EXT_meshopt_compression");
+
+		if (extension >= 0)
+		{
+			size_t buffer = 0;
+			if (!jsonSize(nodes, jsonMember(nodes, extension, "buffer"), &buffer))
+				return false;
+
+			bool embedded = buffer == 0 && jsonMember(nodes, jsonElement(nodes, buffers, 0), "uri") < 0;
+
+			if (!decodeView(view, nodes, extension, embedded ? bin : 0, embedded ? bin_size : 0))
+				return false;
+		}
+		else
+		{
+			size_t buffer = 0, offset = 0, length = 0, stride = 0;
+
+			if (!jsonSize(nodes, jsonMember(nodes, node, "buffer"), &buffer) ||
+			    !jsonSize(nodes, jsonMember(nodes, node, "byteOffset"), &offset) ||
+			    !jsonSize(nodes, jsonMember(nodes, node, "byteLength"), &length) ||
+			    !jsonSize(nodes, jsonMember(nodes, node, "byteStride"), &stride))
+				return false;
+
+			bool embedded = buffer == 0 && jsonMember(nodes, jsonElement(nodes, buffers, 0), "uri") < 0;
+
+			if (!embedded || !bin || !rangeFits(offset, length, bin_size))
+				return false;
+
+			view.data = bin + offset;
+			view.size = length;
+			view.stride = stride;
+		}
+	}
+
+	result.accessors.resize(jsonCount(nodes, accessors));
+
+	for (size_t i = 0; i < result.accessors.size(); ++i)
+	{
+		int node = jsonElement(nodes, accessors, i);
+		GlbAccessor& accessor = result.accessors[i];
+
+		accessor.view = jsonIndex(nodes, jsonMember(nodes, node, "bufferView"));
+
+		if (accessor.view < -1 ||
+		    !jsonSize(nodes, jsonMember(nodes, node, "byteOffset"), &accessor.offset) ||
+		    !jsonSize(nodes, jsonMember(nodes, node, "count"), &accessor.count))
+			return false;
+
+		accessor.component_type = int(jsonNumber(nodes, jsonMember(nodes, node, "componentType"), 0));
+		accessor.components = componentCount(nodes, jsonMember(nodes, node, "type"));
+		accessor.normalized = jsonEquals(nodes, jsonMember(nodes, node, "normalized"), "true");
+
+		size_t element_size = componentSize(accessor.component_type) * accessor.components;
+
+		if (element_size == 0 || accessor.view >= int(result.views.size()))
+			return false;
+
+		if (accessor.view >= 0)
+		{
+			const GlbBufferView& view = result.views[accessor.view];
+
+			accessor.stride = view.stride ? view.stride : element_size;
+
+			// offset + (count - 1) * stride + element_size <= view.size
+			size_t last = accessor.count ? accessor.count - 1 : 0;
+
+			if (accessor.count && (last > view.size / accessor.stride || !rangeFits(accessor.offset, last * accessor.stride, view.size) ||
+			                       !rangeFits(accessor.offset + last * accessor.stride, element_size, view.size)))
+				return false;
+		}
+	}
+
+	for (size_t i = 0, mesh_count = jsonCount(nodes, meshes); i < mesh_count; ++i)
+	{
+		int primitives = jsonMember(nodes, jsonElement(nodes, meshes, i), "primitives");
+
+		GlbMesh mesh = {};
+		mesh.primitive_offset = result.primitives.size();
+		mesh.primitive_count = jsonCount(nodes, primitives);
+
+		for (size_t j = 0; j < mesh.primitive_count; ++j)
+		{
+			int node = jsonElement(nodes, primitives, j);
+			int attributes = jsonMember(nodes, node, "attributes");
+
+			GlbPrimitive primitive = {};
+			int mode = jsonMember(nodes, node, "mode");
+			primitive.mode = mode < 0 ? 4 : jsonIndex(nodes, mode);
+			primitive.position = jsonIndex(nodes, jsonMember(nodes, attributes, "POSITION"));
+			primitive.normal = jsonIndex(nodes, jsonMember(nodes, attributes, "NORMAL"));
+			primitive.texcoord = jsonIndex(nodes, jsonMember(nodes, attributes, "TEXCOORD_0"));
+			primitive.indices = jsonIndex(nodes, jsonMember(nodes, node, "indices"));
+
+			int accessor_count = int(result.accessors.size());
+
+			if (primitive.mode < 0 || primitive.position < -1 || primitive.normal < -1 || primitive.texcoord < -1 || primitive.indices < -1)
+				return false;
+
+			if (primitive.position >= accessor_count || primitive.normal >= accessor_count || primitive.texcoord >= accessor_count || primitive.indices >= accessor_count)
+				return false;
+
+			// index data can't be left out, and has to be scalar unsigned integers
+			if (primitive.indices >= 0)
+			{
+				const GlbAccessor& indices = result.accessors[primitive.indices];
+
+				if (indices.view < 0 || indices.components != 1 || (indices.component_type != 5121 && indices.component_type != 5123 && indices.component_type != 5125))
+					return false;
+			}
+
+			result.primitives.push_back(primitive);
+		}
+
+		result.meshes.push_back(mesh);
+	}
+
+	return true;
+}
+
+void glbReadFloat(const GlbFile& file, const GlbAccessor& accessor, size_t index, float* result, int components)
+{
+	for (int i = 0; i < components; ++i)
+		result[i] = 0.f;
+
+	if (accessor.view < 0)
+		return;
+
+	const GlbBufferView& view = file.views[accessor.view];
+	const unsigned char* element = view.data + accessor.offset + index * accessor.stride;
+
+	for (int i = 0; i < components && i < accessor.components; ++i)
+	{
+		switch (accessor.component_type)
+		{
+		case 5126:
+			memcpy(&result[i], element + i * 4, 4);
+			break;
+		case 5120:
+		{
+			float value = float(reinterpret_cast<const signed char*>(element)[i]);
+			result[i] = accessor.normalized ? (value < -127.f ? -1.f : value / 127.f) : value;
+			break;
+		}
+		case 5121:
+			result[i] = accessor.normalized ? element[i] / 255.f : float(element[i]);
+			break;
+		case 5122:
+		{
+			short value;
+			memcpy(&value, element + i * 2, 2);
+			result[i] = accessor.normalized ? (value < -32767 ? -1.f : value / 32767.f) : float(value);
+			break;
+		}
+		case 5123:
+		{
+			unsigned short value;
+			memcpy(&value, element + i * 2, 2);
+			result[i] = accessor.normalized ? value / 65535.f : float(value);
+			break;
+		}
+		case 5125:
+		{
+			unsigned int value;
+			memcpy(&value, element + i * 4, 4);
+			result[i] = float(value);
+			break;
+		}
+		}
+	}
+}
+
+unsigned int glbReadIndex(const GlbFile& file, const GlbAccessor& accessor, size_t index)
+{
+	// glbParse rejects index accessors without a view
+	assert(accessor.view >= 0);
+	if (accessor.view < 0)
+		return 0;
+
+	const GlbBufferView& view = file.views[accessor.view];
+	const unsigned char* element = view.data + accessor.offset + index * accessor.stride;
+
+	switch (accessor.component_type)
+	{
+	case 5121:
+		return element[0];
+	case 5123:
+		return element[0] | (element[1] << 8);
+	case 5125:
+		return readUint(element);
+	default:
+		return 0;
+	}
+}
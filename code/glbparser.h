@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+struct GlbBufferView
+{
+	const unsigned char* data; // points into the file, or into decoded when the view is compressed
+	size_t size;
+	size_t stride; // 0 if elements are tightly packed
+
+	std::vector<unsigned char> decoded;
+};
+
+struct GlbAccessor
+{
+	int view; // -1 if the accessor has no data
+	size_t offset;
+	size_t count;
+	size_t stride;
+
+	int component_type; // 5120..5126 as in glTF
+	int components;
+	bool normalized;
+};
+
+struct GlbPrimitive
+{
+	int mode; // 4 = triangles
+
+	// accessor indices, -1 if missing
+	int position;
+	int normal;
+	int texcoord;
+	int indices;
+};
+
+struct GlbMesh
+{
+	size_t primitive_offset;
+	size_t primitive_count;
+};
+
+struct GlbFile
+{
+	std::vector<GlbBufferView> views;
+	std::vector<GlbAccessor> accessors;
+	std::vector<GlbPrimitive> primitives;
+	std::vector<GlbMesh> meshes;
+};
+
+// data has to stay alive while result is used; uncompressed buffer views point into it
+bool glbParse(GlbFile& result, const void* data, size_t size);
+
+// reads up to 4 components of an element of the accessor as float, normalized integers are converted to [-1..1]/[0..1]
+void glbReadFloat(const GlbFile& file, const GlbAccessor& accessor, size_t index, float* result, int components);
+unsigned int glbReadIndex(const GlbFile& file, const GlbAccessor& accessor, size_t index);
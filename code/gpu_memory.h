@@ -0,0 +1,322 @@
+
+// NOTE: device memory is allocated in blocks per memory type and resources get ranges of them. Drivers
+// limit the count of allocations and every one of them has a cost, so only resources the driver wants
+// on their own memory or that would take most of a block get a dedicated allocation.
+// Buffers and images never share a block, so bufferImageGranularity doesn't apply between neighbours
+#define GPU_MEMORY_BLOCK_SIZE (64ull * 1024 * 1024)
+
+// NOTE: static resources live until shutdown and are allocated linearly, freeing one only updates the
+// statistics. Buffers that only exist while a benchmark runs go to the buffers pool, the render targets
+// and the transient heap of the render graph are recreated on resize and go to the images pool.
+// Both keep a free list
+enum gpu_pool_usage
+{
+	GpuPool_Static,
+	GpuPool_Buffers,
+	GpuPool_Images,
+
+	GpuPool_Count,
+};
+
+global_variable const char* GpuPoolNames[GpuPool_Count] = {"static", "buffers", "images"};
+
+struct gpu_memory_range
+{
+	VkDeviceSize Offset;
+	VkDeviceSize Size;
+};
+
+struct gpu_memory_block
+{
+	VkDeviceMemory Memory;
+	VkDeviceSize Size;
+	u8* Data;
+
+	// NOTE: linear pools only move the offset, free list pools keep the free ranges sorted by offset
+	VkDeviceSize LinearOffset;
+	std::vector<gpu_memory_range> FreeRanges;
+};
+
+struct gpu_memory_pool
+{
+	std::vector<gpu_memory_block> Blocks;
+
+	u32 AllocationCount;
+	u32 DedicatedCount;
+	VkDeviceSize UsedSize;
+	VkDeviceSize DedicatedSize;
+};
+
+struct gpu_memory
+{
+	VkPhysicalDeviceMemoryProperties Properties;
+	gpu_memory_pool Pools[GpuPool_Count][VK_MAX_MEMORY_TYPES];
+
+	u32 DeviceAllocationCount;
+};
+
+// NOTE: BlockIndex is ~0u for dedicated allocations, they own Memory
+struct gpu_allocation
+{
+	VkDeviceMemory Memory;
+	VkDeviceSize Offset;
+	VkDeviceSize Size;
+	void* Data;
+
+	gpu_pool_usage Usage;
+	u32 MemoryTypeIndex;
+	u32 BlockIndex;
+};
+
+u32 SelectMemoryType(const VkPhysicalDeviceMemoryProperties& MemoryProperties, u32 MemoryTypeBits, VkMemoryPropertyFlags Flags)
+{
+	for(u32 PropertyIndex = 0;
+		PropertyIndex < MemoryProperties.memoryTypeCount;
+		++PropertyIndex)
+	{
+		if((MemoryTypeBits & (1 << PropertyIndex)) != 0 && (MemoryProperties.memoryTypes[PropertyIndex].propertyFlags & Flags) == Flags)
+		{
+			return PropertyIndex;
+		}
+	}
+
+	return ~0u;
+}
+
+internal VkDeviceSize
+AlignGpuOffset(VkDeviceSize Offset, VkDeviceSize Alignment)
+{
+	return (Offset + Alignment - 1) / Alignment * Alignment;
+}
+
+internal VkDeviceMemory
+AllocateDeviceMemory(gpu_memory& Memory, VkDevice Device, u32 MemoryTypeIndex, VkDeviceSize Size, VkBuffer DedicatedBuffer, VkImage DedicatedImage, u8** Data)
+{
+	VkMemoryDedicatedAllocateInfo DedicatedInfo = {VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO};
+	DedicatedInfo.buffer = DedicatedBuffer;
+	DedicatedInfo.image = DedicatedImage;
+
+	VkMemoryAllocateInfo AllocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+	AllocateInfo.pNext = (DedicatedBuffer || DedicatedImage) ? &DedicatedInfo : 0;
+	AllocateInfo.memoryTypeIndex = MemoryTypeIndex;
+	AllocateInfo.allocationSize = Size;
+
+	VkDeviceMemory Result = 0;
+	VK_CHECK(vkAllocateMemory(Device, &AllocateInfo, 0, &Result));
+	Memory.DeviceAllocationCount++;
+
+	// NOTE: host visible memory stays mapped, a block can only be mapped once for all of its ranges
+	*Data = 0;
+	if(Memory.Properties.memoryTypes[MemoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		VK_CHECK(vkMapMemory(Device, Result, 0, VK_WHOLE_SIZE, 0, (void**)Data));
+	}
+
+	return Result;
+}
+
+internal bool
+AllocateFromBlock(gpu_memory_block& Block, gpu_pool_usage Usage, VkDeviceSize Size, VkDeviceSize Alignment, VkDeviceSize* Offset)
+{
+	if(Usage == GpuPool_Static)
+	{
+		VkDeviceSize AlignedOffset = AlignGpuOffset(Block.LinearOffset, Alignment);
+		if(AlignedOffset + Size > Block.Size)
+		{
+			return false;
+		}
+
+		Block.LinearOffset = AlignedOffset + Size;
+		*Offset = AlignedOffset;
+		return true;
+	}
+
+	// NOTE: first fit, the padding in front of an aligned range stays free
+	for(u32 RangeIndex = 0;
+		RangeIndex < Block.FreeRanges.size();
+		++RangeIndex)
+	{
+		gpu_memory_range Range = Block.FreeRanges[RangeIndex];
+		VkDeviceSize AlignedOffset = AlignGpuOffset(Range.Offset, Alignment);
+		if(AlignedOffset + Size > Range.Offset + Range.Size)
+		{
+			continue;
+		}
+
+		Block.FreeRanges.erase(Block.FreeRanges.begin() + RangeIndex);
+
+		VkDeviceSize RangeEnd = Range.Offset + Range.Size;
+		if(AlignedOffset + Size < RangeEnd)
+		{
+			Block.FreeRanges.insert(Block.FreeRanges.begin() + RangeIndex, {AlignedOffset + Size, RangeEnd - (AlignedOffset + Size)});
+		}
+		if(AlignedOffset > Range.Offset)
+		{
+			Block.FreeRanges.insert(Block.FreeRanges.begin() + RangeIndex, {Range.Offset, AlignedOffset - Range.Offset});
+		}
+
+		*Offset = AlignedOffset;
+		return true;
+	}
+
+	return false;
+}
+
+// NOTE: puts the range back in offset order and merges it with the free ranges right before and after it
+internal void
+FreeToBlock(gpu_memory_block& Block, VkDeviceSize Offset, VkDeviceSize Size)
+{
+	u32 RangeIndex = 0;
+	while(RangeIndex < Block.FreeRanges.size() && Block.FreeRanges[RangeIndex].Offset < Offset)
+	{
+		++RangeIndex;
+	}
+	Block.FreeRanges.insert(Block.FreeRanges.begin() + RangeIndex, {Offset, Size});
+
+	if(RangeIndex + 1 < Block.FreeRanges.size() && Offset + Size == Block.FreeRanges[RangeIndex + 1].Offset)
+	{
+		Block.FreeRanges[RangeIndex].Size += Block.FreeRanges[RangeIndex + 1].Size;
+		Block.FreeRanges.erase(Block.FreeRanges.begin() + RangeIndex + 1);
+	}
+	if(RangeIndex > 0 && Block.FreeRanges[RangeIndex - 1].Offset + Block.FreeRanges[RangeIndex - 1].Size == Offset)
+	{
+		Block.FreeRanges[RangeIndex - 1].Size += Block.FreeRanges[RangeIndex].Size;
+		Block.FreeRanges.erase(Block.FreeRanges.begin() + RangeIndex);
+	}
+}
+
+// NOTE: the dedicated handle is the buffer or image the driver prefers its own memory for, or null
+internal gpu_allocation
+AllocateGpuMemory(gpu_memory& Memory, VkDevice Device, const VkMemoryRequirements& Requirements, VkMemoryPropertyFlags Flags, gpu_pool_usage Usage,
+				  VkBuffer DedicatedBuffer = 0, VkImage DedicatedImage = 0)
+{
+	gpu_allocation Result = {};
+	Result.Usage = Usage;
+	Result.Size = Requirements.size;
+	Result.MemoryTypeIndex = SelectMemoryType(Memory.Properties, Requirements.memoryTypeBits, Flags);
+	assert(Result.MemoryTypeIndex != ~0u);
+
+	gpu_memory_pool& Pool = Memory.Pools[Usage][Result.MemoryTypeIndex];
+	Pool.AllocationCount++;
+	Pool.UsedSize += Requirements.size;
+
+	if(DedicatedBuffer || DedicatedImage || Requirements.size > GPU_MEMORY_BLOCK_SIZE / 2)
+	{
+		u8* Data = 0;
+		Result.Memory = AllocateDeviceMemory(Memory, Device, Result.MemoryTypeIndex, Requirements.size, DedicatedBuffer, DedicatedImage, &Data);
+		Result.Data = Data;
+		Result.BlockIndex = ~0u;
+
+		Pool.DedicatedCount++;
+		Pool.DedicatedSize += Requirements.size;
+		return Result;
+	}
+
+	for(u32 BlockIndex = 0;
+		BlockIndex < Pool.Blocks.size();
+		++BlockIndex)
+	{
+		gpu_memory_block& Block = Pool.Blocks[BlockIndex];
+		if(AllocateFromBlock(Block, Usage, Requirements.size, Requirements.alignment, &Result.Offset))
+		{
+			Result.Memory = Block.Memory;
+			Result.Data = Block.Data ? Block.Data + Result.Offset : 0;
+			Result.BlockIndex = BlockIndex;
+			return Result;
+		}
+	}
+
+	gpu_memory_block NewBlock = {};
+	NewBlock.Size = GPU_MEMORY_BLOCK_SIZE;
+	NewBlock.Memory = AllocateDeviceMemory(Memory, Device, Result.MemoryTypeIndex, NewBlock.Size, 0, 0, &NewBlock.Data);
+	NewBlock.FreeRanges.push_back({0, NewBlock.Size});
+	Pool.Blocks.push_back(NewBlock);
+
+	gpu_memory_block& Block = Pool.Blocks.back();
+	bool IsAllocated = AllocateFromBlock(Block, Usage, Requirements.size, Requirements.alignment, &Result.Offset);
+	assert(IsAllocated);
+
+	Result.Memory = Block.Memory;
+	Result.Data = Block.Data ? Block.Data + Result.Offset : 0;
+	Result.BlockIndex = u32(Pool.Blocks.size() - 1);
+	return Result;
+}
+
+internal void
+FreeGpuMemory(gpu_memory& Memory, VkDevice Device, gpu_allocation& Allocation)
+{
+	if(!Allocation.Memory)
+	{
+		return;
+	}
+
+	gpu_memory_pool& Pool = Memory.Pools[Allocation.Usage][Allocation.MemoryTypeIndex];
+	Pool.AllocationCount--;
+	Pool.UsedSize -= Allocation.Size;
+
+	if(Allocation.BlockIndex == ~0u)
+	{
+		vkFreeMemory(Device, Allocation.Memory, 0);
+		Memory.DeviceAllocationCount--;
+
+		Pool.DedicatedCount--;
+		Pool.DedicatedSize -= Allocation.Size;
+	}
+	else if(Allocation.Usage != GpuPool_Static)
+	{
+		FreeToBlock(Pool.Blocks[Allocation.BlockIndex], Allocation.Offset, Allocation.Size);
+	}
+
+	Allocation = {};
+}
+
+internal void
+PrintGpuMemoryStats(const gpu_memory& Memory)
+{
+	printf("Gpu memory: %u device allocations\n", Memory.DeviceAllocationCount);
+	for(u32 Usage = 0;
+		Usage < GpuPool_Count;
+		++Usage)
+	{
+		for(u32 MemoryTypeIndex = 0;
+			MemoryTypeIndex < Memory.Properties.memoryTypeCount;
+			++MemoryTypeIndex)
+		{
+			const gpu_memory_pool& Pool = Memory.Pools[Usage][MemoryTypeIndex];
+			if(Pool.Blocks.empty() && !Pool.DedicatedCount)
+			{
+				continue;
+			}
+
+			VkDeviceSize ReservedSize = Pool.Blocks.size() * GPU_MEMORY_BLOCK_SIZE + Pool.DedicatedSize;
+			printf("  %-7s type %2u: %3u allocations, %2u blocks, %2u dedicated, %9.2f MB used of %9.2f MB reserved\n",
+				   GpuPoolNames[Usage], MemoryTypeIndex, Pool.AllocationCount, u32(Pool.Blocks.size()), Pool.DedicatedCount,
+				   double(Pool.UsedSize) / (1024 * 1024), double(ReservedSize) / (1024 * 1024));
+		}
+	}
+}
+
+// NOTE: every resource has to be destroyed before, dedicated allocations are freed with them
+internal void
+DestroyGpuMemory(gpu_memory& Memory, VkDevice Device)
+{
+	for(u32 Usage = 0;
+		Usage < GpuPool_Count;
+		++Usage)
+	{
+		for(u32 MemoryTypeIndex = 0;
+			MemoryTypeIndex < VK_MAX_MEMORY_TYPES;
+			++MemoryTypeIndex)
+		{
+			gpu_memory_pool& Pool = Memory.Pools[Usage][MemoryTypeIndex];
+			assert(Pool.DedicatedCount == 0);
+
+			for(gpu_memory_block& Block : Pool.Blocks)
+			{
+				vkFreeMemory(Device, Block.Memory, 0);
+				Memory.DeviceAllocationCount--;
+			}
+			Pool.Blocks.clear();
+		}
+	}
+}
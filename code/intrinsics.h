@@ -1,10 +1,14 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <float.h>
 #include <string.h>
 #include <vector>
 #include <algorithm>
+#include <immintrin.h>
+#include <intrin.h>
 #include <windows.h>
+#include <psapi.h>
 #define VK_NO_PROTOTYPES
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_win32.h>
@@ -27,14 +31,18 @@
 #include "meshoptimizer/overdrawanalyzer.cpp"
 #include "meshoptimizer/overdrawoptimizer.cpp"
 #include "meshoptimizer/simplifier.cpp"
+#include "meshoptimizer/spatialorder.cpp"
 #include "meshoptimizer/vcacheanalyzer.cpp"
 #include "meshoptimizer/vcacheoptimizer.cpp"
 #include "meshoptimizer/vertexcodec.cpp"
+#include "meshoptimizer/vertexfilter.cpp"
 #include "meshoptimizer/vfetchanalyzer.cpp"
 #include "meshoptimizer/vfetchoptimizer.cpp"
 
 #include "objparser.h"
 #include "objparser.cpp"
+#include "glbparser.h"
+#include "glbparser.cpp"
 
 typedef char					s8;
 typedef short					s16;
@@ -67,6 +75,19 @@ global_variable bool IsRtxEnabled;
 global_variable bool IsLodEnabled = true;
 global_variable bool IsCullEnabled = true;
 global_variable bool IsOcclusionEnabled = true;
+global_variable bool IsInstancingEnabled = true;
+global_variable bool IsDepthPyramidSinglePass = true;
+global_variable bool IsSoftwareOcclusionEnabled;
+global_variable bool IsClusterCullEnabled = true;
+global_variable bool IsTransformPackingEnabled;
+global_variable bool IsTransformPackingSupported = true;
+global_variable bool IsDepthSortEnabled;
+global_variable bool IsSortBenchmarkRequested;
+global_variable float ContributionCullPixels = 1.0f;
+global_variable bool IsCullValidationRequested;
+global_variable bool IsCullBenchmarkRequested;
+global_variable bool IsViewCullBenchmarkRequested;
+global_variable bool IsFileReadAsync = true;
 global_variable bool IsPyramidVisualized;
 global_variable u32 VisualizedPyramidLevel;
 global_variable u32 LastVisualizedPyramidLevel;
@@ -79,23 +100,30 @@ struct shader_layout
 	VkDescriptorSetLayout DescriptorSetLayout;
 };
 
+#include "file_io.h"
+#include "parallel_for.h"
 #include "shader.h"
 #include "shader.cpp"
 #include "mesh_loader.h"
 
+// NOTE: the release semaphore of an image is waited on by its present, so it can only be signaled
+// again once that image is acquired again. A frame slot's fence doesn't cover the present's wait
 struct swapchain
 {
 	VkSwapchainKHR Handle;
 	std::vector<VkImage> Images;
+	std::vector<VkSemaphore> ReleaseSemaphores;
 	u32 Width, Height;
 };
 
 #include "swapchain.cpp"
+#include "gpu_memory.h"
+#include "render_graph.h"
 
 struct buffer
 {
 	VkBuffer Handle;
-	VkDeviceMemory Memory;
+	gpu_allocation Allocation;
 	void* Data;
 	size_t Size;
 };
@@ -104,7 +132,7 @@ struct image
 {
 	VkImage Handle;
 	VkImageView View;
-	VkDeviceMemory Memory;
+	gpu_allocation Allocation;
 };
 
 internal void DispatchMessages();
@@ -3,12 +3,114 @@
 struct alignas(16) draw_cull_data
 {
 	glm::vec4 Frustrum[6];
-	u32 LodEnabled;
-	u32 CullEnabled;
-	u32 OcclusionEnabled;
 
 	float P00, P11, znear;
 	float PyramidWidth, PyramidHeight;
+
+	u32 DrawCount;
+	u32 ClusterCount;
+
+	// NOTE: minimum projected diameter in pixels divided by P11 * ScreenHeight, 0 disables contribution culling.
+	// It fills the 128 bytes of push constants every device has
+	float ContributionThreshold;
+};
+
+// NOTE: draw_cull_views.comp tests every draw against up to this many views in one dispatch
+#define MAX_CULL_VIEWS 8
+
+// NOTE: frustum planes in the space of the draws, commands of the view start at CommandOffset
+struct alignas(16) draw_cull_view
+{
+	glm::vec4 Frustrum[6];
+
+	glm::vec3 Origin;
+	u32 CommandOffset;
+};
+
+struct alignas(16) draw_cull_views_data
+{
+	u32 DrawCount;
+	u32 FirstView;
+	u32 ViewCount;
+};
+
+// NOTE: every combination is its own specialized pipeline of draw_cull.comp, bit i is constant_id i
+enum draw_cull_flags
+{
+	DrawCullFlag_Late       = 1 << 0,
+	DrawCullFlag_Cull       = 1 << 1,
+	DrawCullFlag_Lod        = 1 << 2,
+	DrawCullFlag_Occlusion  = 1 << 3,
+	DrawCullFlag_Instancing = 1 << 4,
+	DrawCullFlag_Clustered  = 1 << 5,
+	DrawCullFlag_MeshTasks  = 1 << 6,
+
+	DrawCullFlag_Count      = 1 << 7,
+};
+
+// NOTE: specializations of the object pipelines, bit i is constant_id i. The vertex shader only
+// declares the transform constant, the late and occlusion ones select meshlet occlusion in the task shader
+enum object_flags
+{
+	ObjectFlag_Cull             = 1 << 0,
+	ObjectFlag_PackedTransforms = 1 << 1,
+	ObjectFlag_Late             = 1 << 2,
+	ObjectFlag_Occlusion        = 1 << 3,
+
+	ObjectFlag_Count            = 1 << 4,
+};
+
+struct alignas(16) draw_emit_data
+{
+	u32 BucketCount;
+};
+
+// NOTE: draw_sort.comp sorts by 16 bit keys, its passes are selected with Pass
+#define DRAW_SORT_KEY_COUNT 65536
+
+enum draw_sort_pass
+{
+	DrawSortPass_Count,
+	DrawSortPass_Scan,
+	DrawSortPass_Scatter,
+};
+
+struct alignas(16) draw_sort_data
+{
+	float KeyScale;
+	u32 Pass;
+};
+
+// NOTE: frames rendered unsorted and then sorted by the sort comparison
+#define SORT_BENCHMARK_FRAMES 64
+
+// NOTE: dispatches over draws and clusters go over the 65535 groups x is guaranteed to have with a large
+// enough scene, they are laid out in rows of this many groups, see GetFlatGroupIndex in mesh_headers.hlsl
+#define DISPATCH_ROW_GROUPS 32768
+
+// NOTE: -stress on the command line replaces the scene with this many instances
+#define STRESS_INSTANCE_COUNT (20 * 1000 * 1000)
+
+// NOTE: the early cull pass lists every draw in the frustum for the late pass and counts the groups
+// the late pass needs for it, so the late pass is dispatched indirectly over just that list
+struct late_dispatch
+{
+	VkDispatchIndirectCommand Dispatch;
+	u32 DrawCount;
+};
+
+// NOTE: cluster culling lists the clusters for the early pass the same way
+struct cluster_dispatch
+{
+	VkDispatchIndirectCommand Dispatch;
+	u32 ClusterCount;
+};
+
+// NOTE: visible instances of one (mesh, lod) pair, bucket index is MeshIndex * MAX_LODS + LodIndex
+struct draw_bucket
+{
+	u32 InstanceOffset;
+	u32 InstanceCount;
 };
 
 struct alignas(16) depth_reduce_data
@@ -16,6 +118,44 @@ struct alignas(16) depth_reduce_data
 	glm::vec2 Dims;
 };
 
+struct alignas(16) depth_pyramid_data
+{
+	glm::vec2 SourceSize;
+	u32 PyramidWidth;
+	u32 PyramidHeight;
+	u32 LevelCount;
+	u32 GroupCount;
+};
+
+// NOTE: depth_pyramid.comp has one storage image binding per level after the source depth
+#define DEPTH_PYRAMID_SINGLE_PASS_LEVELS 12
+
+// NOTE: -frames N on the command line sets how many frames the cpu records ahead of the gpu, 1 to this
+#define MAX_FRAMES_IN_FLIGHT 3
+
+// NOTE: everything a frame writes from the cpu or reads back. Device buffers are shared by all frames,
+// a frame waits for the one before it on the gpu and only the cpu runs ahead
+struct frame
+{
+	VkCommandPool CommandPool;
+	VkCommandBuffer CommandBuffer;
+	VkFence Fence;
+	VkSemaphore AcquireSemaphore;
+
+	VkQueryPool TimestampsQueryPool;
+	VkQueryPool PipelineQueryPool;
+
+	buffer SoftwareVisibilityBuffer;
+	buffer ContributionReadbackBuffer;
+
+	// NOTE: what the frame was recorded with, its results are read when its slot comes around again
+	bool IsSubmitted;
+	bool IsCullValidationFrame;
+	bool IsViewCullBenchmarkFrame;
+	u32 SortBenchmarkHalf;
+	draw_cull_data DrawCullData;
+};
+
 VkBool32 DebugReportCallback(VkDebugReportFlagsEXT Flags, VkDebugReportObjectTypeEXT ObjectType, u64 Object, size_t Location, s32 MessageCode, const char* pLayerPrefix, const char* pMessage, void* pUserData)
 {
 	const char* ErrorType = (Flags & VK_DEBUG_REPORT_ERROR_BIT_EXT) ? "Error" :
@@ -120,6 +260,7 @@ CreateDevice(const VkPhysicalDevice& PhysicalDevice, u32* FamilyIndex)
 
 	VkPhysicalDeviceFeatures2 Features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
 	Features.features.multiDrawIndirect = true;
+	Features.features.drawIndirectFirstInstance = true;
 	Features.features.pipelineStatisticsQuery = true;
 
 	VkPhysicalDevice8BitStorageFeatures Features8 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_8BIT_STORAGE_FEATURES};
@@ -209,6 +350,16 @@ CreateSemaphore(VkDevice Device)
 	return Semaphore;
 }
 
+internal VkFence
+CreateFence(VkDevice Device, VkFenceCreateFlags Flags)
+{
+	VkFenceCreateInfo FenceCreateInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+	FenceCreateInfo.flags = Flags;
+	VkFence Fence = 0;
+	VK_CHECK(vkCreateFence(Device, &FenceCreateInfo, 0, &Fence));
+	return Fence;
+}
+
 internal bool
 SupportsPresentation(VkPhysicalDevice PhysicalDevice, u32 FamilyIndex)
 {
@@ -289,23 +440,9 @@ GetSwapchainFormat(VkPhysicalDevice PhysicalDevice, VkSurfaceKHR Surface)
 	return Result;
 }
 
-u32 SelectMemoryType(const VkPhysicalDeviceMemoryProperties& MemoryProperties, u32 MemoryTypeBits, VkMemoryPropertyFlags Flags)
-{
-	for(u32 PropertyIndex = 0;
-		PropertyIndex < MemoryProperties.memoryTypeCount;
-		++PropertyIndex)
-	{
-		if((MemoryTypeBits & (1 << PropertyIndex)) != 0 && (MemoryProperties.memoryTypes[PropertyIndex].propertyFlags & Flags) == Flags)
-		{
-			return PropertyIndex;
-		}
-	}
-
-	return ~0u;
-}
-
+// NOTE: buffers that live until shutdown go to the static pools, see gpu_memory.h
 internal void
-CreateBuffer(buffer& Buffer, VkDevice Device, const VkPhysicalDeviceMemoryProperties& MemoryProperties, size_t Size, VkBufferUsageFlags Usage, VkMemoryPropertyFlags MemoryFlags)
+CreateBuffer(buffer& Buffer, VkDevice Device, gpu_memory& Memory, size_t Size, VkBufferUsageFlags Usage, VkMemoryPropertyFlags MemoryFlags, gpu_pool_usage PoolUsage = GpuPool_Static)
 {
 	VkBufferCreateInfo CreateInfo = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
 	CreateInfo.usage = Usage;
@@ -313,24 +450,21 @@ CreateBuffer(buffer& Buffer, VkDevice Device, const VkPhysicalDeviceMemoryProper
 	VK_CHECK(vkCreateBuffer(Device, &CreateInfo, 0, &Buffer.Handle));
 	Buffer.Size = Size;
 
-	VkMemoryRequirements Requirements;
-	vkGetBufferMemoryRequirements(Device, Buffer.Handle, &Requirements);
-
-	u32 MemoryTypeIndex = SelectMemoryType(MemoryProperties, Requirements.memoryTypeBits, MemoryFlags);
-	assert(MemoryTypeIndex != ~0u);
+	VkMemoryDedicatedRequirements DedicatedRequirements = {VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS};
+	VkMemoryRequirements2 Requirements = {VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
+	Requirements.pNext = &DedicatedRequirements;
 
-	VkMemoryAllocateInfo AllocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-	AllocateInfo.memoryTypeIndex = MemoryTypeIndex;
-	AllocateInfo.allocationSize = Requirements.size;
+	VkBufferMemoryRequirementsInfo2 RequirementsInfo = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2};
+	RequirementsInfo.buffer = Buffer.Handle;
+	vkGetBufferMemoryRequirements2(Device, &RequirementsInfo, &Requirements);
 
-	VK_CHECK(vkAllocateMemory(Device, &AllocateInfo, 0, &Buffer.Memory));
+	bool IsDedicated = DedicatedRequirements.prefersDedicatedAllocation || DedicatedRequirements.requiresDedicatedAllocation;
+	Buffer.Allocation = AllocateGpuMemory(Memory, Device, Requirements.memoryRequirements, MemoryFlags, PoolUsage, IsDedicated ? Buffer.Handle : 0);
 
-	VK_CHECK(vkBindBufferMemory(Device, Buffer.Handle, Buffer.Memory, 0));
+	VK_CHECK(vkBindBufferMemory(Device, Buffer.Handle, Buffer.Allocation.Memory, Buffer.Allocation.Offset));
 
-	if (MemoryFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) 
-	{
-		VK_CHECK(vkMapMemory(Device, Buffer.Memory, 0, Size, 0, &Buffer.Data));
-	}
+	Buffer.Data = Buffer.Allocation.Data;
+	assert(!(MemoryFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) || Buffer.Data);
 }
 
 internal VkBufferMemoryBarrier
@@ -348,43 +482,52 @@ CreateBufferBarrier(VkBuffer Handle, VkAccessFlags SrcAccess, VkAccessFlags DstA
 	return CopyBarrier;
 }
 
+// NOTE: data larger than the scratch buffer is uploaded in pages of its size, one submit per page
 internal void
 CopyBuffer(buffer& Src, buffer& Dst, const void* Data, size_t Size, VkDevice Device, VkCommandPool CommandPool, VkCommandBuffer CommandBuffer, VkQueue Queue)
 {
 	assert(Src.Data);
-	assert(Src.Size >= Size);
-	memcpy(Src.Data, Data, Size);
+	assert(Dst.Size >= Size);
+
+	for(size_t PageOffset = 0;
+		PageOffset < Size;
+		PageOffset += Src.Size)
+	{
+		size_t PageSize = min(Size - PageOffset, size_t(Src.Size));
+		memcpy(Src.Data, (const u8*)Data + PageOffset, PageSize);
 
-	VK_CHECK(vkResetCommandPool(Device, CommandPool, 0));
-	VkCommandBufferBeginInfo CommandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
-	CommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	vkBeginCommandBuffer(CommandBuffer, &CommandBufferBeginInfo);
+		VK_CHECK(vkResetCommandPool(Device, CommandPool, 0));
+		VkCommandBufferBeginInfo CommandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+		CommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(CommandBuffer, &CommandBufferBeginInfo);
 
-	VkBufferCopy Region = {0, 0, VkDeviceSize(Size)};
-	vkCmdCopyBuffer(CommandBuffer, Src.Handle, Dst.Handle, 1, &Region);
+		VkBufferCopy Region = {0, VkDeviceSize(PageOffset), VkDeviceSize(PageSize)};
+		vkCmdCopyBuffer(CommandBuffer, Src.Handle, Dst.Handle, 1, &Region);
 
-	VkBufferMemoryBarrier CopyBarrier = CreateBufferBarrier(Dst.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
-	vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 1, &CopyBarrier, 0, 0);
+		VkBufferMemoryBarrier CopyBarrier = CreateBufferBarrier(Dst.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+		vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 1, &CopyBarrier, 0, 0);
 
-	vkEndCommandBuffer(CommandBuffer);
+		vkEndCommandBuffer(CommandBuffer);
 
-	VkSubmitInfo SubmitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-	SubmitInfo.commandBufferCount = 1;
-	SubmitInfo.pCommandBuffers = &CommandBuffer;
-	VK_CHECK(vkQueueSubmit(Queue, 1, &SubmitInfo, VK_NULL_HANDLE));
+		VkSubmitInfo SubmitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+		SubmitInfo.commandBufferCount = 1;
+		SubmitInfo.pCommandBuffers = &CommandBuffer;
+		VK_CHECK(vkQueueSubmit(Queue, 1, &SubmitInfo, VK_NULL_HANDLE));
 
-	VK_CHECK(vkDeviceWaitIdle(Device));
+		VK_CHECK(vkDeviceWaitIdle(Device));
+	}
 }
 
 internal void
-DestroyBuffer(buffer& Buffer, VkDevice Device)
+DestroyBuffer(buffer& Buffer, VkDevice Device, gpu_memory& Memory)
 {
-	vkFreeMemory(Device, Buffer.Memory, 0);
 	vkDestroyBuffer(Device, Buffer.Handle, 0);
+	FreeGpuMemory(Memory, Device, Buffer.Allocation);
+	Buffer = {};
 }
 
-internal void
-CreateImage(image& Result, VkDevice Device, const VkPhysicalDeviceMemoryProperties& MemoryProperties, u32 Width, u32 Height, VkFormat Format, VkImageUsageFlags Usage, u32 MipLevels = 1)
+internal VkImage
+CreateImageHandle(VkDevice Device, u32 Width, u32 Height, VkFormat Format, VkImageUsageFlags Usage, u32 MipLevels)
 {
 	VkImageCreateInfo CreateInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
 	CreateInfo.format = Format;
@@ -397,31 +540,50 @@ CreateImage(image& Result, VkDevice Device, const VkPhysicalDeviceMemoryProperti
 	CreateInfo.usage = Usage;
 	CreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-	VK_CHECK(vkCreateImage(Device, &CreateInfo, 0, &Result.Handle));
+	VkImage Result = 0;
+	VK_CHECK(vkCreateImage(Device, &CreateInfo, 0, &Result));
+	return Result;
+}
 
-	VkMemoryRequirements Requirements;
-	vkGetImageMemoryRequirements(Device, Result.Handle, &Requirements);
+internal void
+CreateImage(image& Result, VkDevice Device, gpu_memory& Memory, u32 Width, u32 Height, VkFormat Format, VkImageUsageFlags Usage, u32 MipLevels = 1)
+{
+	Result.Handle = CreateImageHandle(Device, Width, Height, Format, Usage, MipLevels);
 
-	u32 MemoryTypeIndex = SelectMemoryType(MemoryProperties, Requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	assert(MemoryTypeIndex != ~0u);
+	VkMemoryDedicatedRequirements DedicatedRequirements = {VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS};
+	VkMemoryRequirements2 Requirements = {VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
+	Requirements.pNext = &DedicatedRequirements;
 
-	VkMemoryAllocateInfo AllocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-	AllocateInfo.memoryTypeIndex = MemoryTypeIndex;
-	AllocateInfo.allocationSize = Requirements.size;
+	VkImageMemoryRequirementsInfo2 RequirementsInfo = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2};
+	RequirementsInfo.image = Result.Handle;
+	vkGetImageMemoryRequirements2(Device, &RequirementsInfo, &Requirements);
 
-	VK_CHECK(vkAllocateMemory(Device, &AllocateInfo, 0, &Result.Memory));
+	// NOTE: images are recreated with the swapchain, so they always go to the free list pool
+	bool IsDedicated = DedicatedRequirements.prefersDedicatedAllocation || DedicatedRequirements.requiresDedicatedAllocation;
+	Result.Allocation = AllocateGpuMemory(Memory, Device, Requirements.memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GpuPool_Images, 0, IsDedicated ? Result.Handle : 0);
 
-	VK_CHECK(vkBindImageMemory(Device, Result.Handle, Result.Memory, 0));
+	VK_CHECK(vkBindImageMemory(Device, Result.Handle, Result.Allocation.Memory, Result.Allocation.Offset));
 
 	Result.View = CreateImageView(Device, Result.Handle, Format, 0, MipLevels);
 }
 
+// NOTE: transient images get their memory when BindRenderGraphImages placed all of them, the view is created after
 internal void
-DestroyImage(image& Image, VkDevice& Device)
+CreateTransientImage(image& Result, render_graph& Graph, u32 GraphImage, VkDevice Device, u32 Width, u32 Height, VkFormat Format, VkImageUsageFlags Usage)
+{
+	Result.Handle = CreateImageHandle(Device, Width, Height, Format, Usage, 1);
+
+	VkMemoryRequirements Requirements = {};
+	vkGetImageMemoryRequirements(Device, Result.Handle, &Requirements);
+	SetRenderGraphImage(Graph, GraphImage, Result.Handle, 1, Requirements);
+}
+
+internal void
+DestroyImage(image& Image, VkDevice Device, gpu_memory& Memory)
 {
-	vkFreeMemory(Device, Image.Memory, 0);
 	vkDestroyImageView(Device, Image.View, 0);
 	vkDestroyImage(Device, Image.Handle, 0);
+	FreeGpuMemory(Memory, Device, Image.Allocation);
 }
 
 VkSampler CreateSampler(VkDevice Device, VkSamplerReductionModeEXT Reduction)
@@ -457,7 +619,7 @@ CreateQueryPool(VkDevice Device, VkQueryType Type, uint32_t QueryCount)
 
 	if(Type == VK_QUERY_TYPE_PIPELINE_STATISTICS)
 	{
-		CreateInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT;
+		CreateInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
 	}
 
 	VkQueryPool Result = 0;
@@ -465,32 +627,42 @@ CreateQueryPool(VkDevice Device, VkQueryType Type, uint32_t QueryCount)
 	return Result;
 }
 
-internal VkImageMemoryBarrier
-CreateImageBarrier(VkImage Image, VkAccessFlags SrcAccess, VkAccessFlags DstAccess, 
-				   VkImageLayout SrcImageLayout, VkImageLayout DstImageLayout, VkImageAspectFlags AspectMask = VK_IMAGE_ASPECT_COLOR_BIT)
+// NOTE: pipelines are created the first time a combination of toggles is used
+internal VkPipeline
+GetDrawCullPipeline(VkPipeline (&Pipelines)[DrawCullFlag_Count], VkDevice Device, VkPipelineCache PipelineCache, VkPipelineLayout Layout, const shader& Shader, u32 Flags)
 {
-	VkImageMemoryBarrier ImageMemoryBarrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
-	ImageMemoryBarrier.srcAccessMask = SrcAccess;
-	ImageMemoryBarrier.dstAccessMask = DstAccess;
-	ImageMemoryBarrier.oldLayout = SrcImageLayout;
-	ImageMemoryBarrier.newLayout = DstImageLayout;
-	ImageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	ImageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	ImageMemoryBarrier.image = Image;
-	ImageMemoryBarrier.subresourceRange.aspectMask = AspectMask;
-	ImageMemoryBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
-	ImageMemoryBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
-	return ImageMemoryBarrier;
+	assert(Flags < DrawCullFlag_Count);
+	if(!Pipelines[Flags])
+	{
+		Pipelines[Flags] = CreateComputePipeline(Device, PipelineCache, Layout, Shader, 
+												 {(Flags & DrawCullFlag_Late) != 0, 
+												  (Flags & DrawCullFlag_Cull) != 0, 
+												  (Flags & DrawCullFlag_Lod) != 0, 
+												  (Flags & DrawCullFlag_Occlusion) != 0, 
+												  (Flags & DrawCullFlag_Instancing) != 0, 
+												  (Flags & DrawCullFlag_Clustered) != 0, 
+												  (Flags & DrawCullFlag_MeshTasks) != 0});
+		assert(Pipelines[Flags]);
+	}
+
+	return Pipelines[Flags];
 }
 
-internal void
-ImageBarrier(VkCommandBuffer CommandBuffer, 
-					 VkPipelineStageFlags SrcStageMask, VkPipelineStageFlags DstStageMask,
-					 const std::vector<VkImageMemoryBarrier>& ImageMemoryBarriers)
+internal VkPipeline
+GetObjectPipeline(VkPipeline (&Pipelines)[ObjectFlag_Count], VkDevice Device, VkPipelineCache PipelineCache, VkPipelineLayout Layout, VkRenderPass RenderPass, shaders Shaders, u32 Flags)
 {
-	vkCmdPipelineBarrier(CommandBuffer, SrcStageMask, DstStageMask, 
-						 VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 
-						 (u32)ImageMemoryBarriers.size(), ImageMemoryBarriers.data());
+	assert(Flags < ObjectFlag_Count);
+	if(!Pipelines[Flags])
+	{
+		Pipelines[Flags] = CreateGraphicsPipeline(Device, PipelineCache, Layout, RenderPass, Shaders, 
+												  {(Flags & ObjectFlag_Cull) != 0, 
+												   (Flags & ObjectFlag_PackedTransforms) != 0, 
+												   (Flags & ObjectFlag_Late) != 0, 
+												   (Flags & ObjectFlag_Occlusion) != 0});
+		assert(Pipelines[Flags]);
+	}
+
+	return Pipelines[Flags];
 }
 
 glm::mat4x4 GetProjection(float FovY, float Aspect, float ZNear)
@@ -512,6 +684,44 @@ glm::vec4 NormalizePlane(glm::vec4 P)
 	return P / glm::length(glm::vec3(P));
 }
 
+// NOTE: view space frustum planes of the projection plus a far plane at DrawDistance
+draw_cull_data GetDrawCullData(const glm::mat4x4& Projection, float ZNear, float DrawDistance)
+{
+	draw_cull_data Result = {};
+
+	glm::mat4 ProjectionT = glm::transpose(Projection);
+	Result.Frustrum[0] = NormalizePlane(ProjectionT[3] + ProjectionT[0]);
+	Result.Frustrum[1] = NormalizePlane(ProjectionT[3] - ProjectionT[0]);
+	Result.Frustrum[2] = NormalizePlane(ProjectionT[3] + ProjectionT[1]);
+	Result.Frustrum[3] = NormalizePlane(ProjectionT[3] - ProjectionT[1]);
+	Result.Frustrum[4] = NormalizePlane(ProjectionT[3] - ProjectionT[2]);
+	Result.Frustrum[5] = glm::vec4(0, 0, -1, DrawDistance);
+	Result.P00 = Projection[0][0];
+	Result.P11 = Projection[1][1];
+	Result.znear = ZNear;
+
+	return Result;
+}
+
+// NOTE: the view space CullData was made for is placed at Origin with Orientation in the space of the draws.
+// The planes are rotated and moved along with it, a rigid move keeps them normalized
+draw_cull_view GetDrawCullView(const draw_cull_data& CullData, const glm::quat& Orientation, const glm::vec3& Origin, u32 CommandOffset)
+{
+	draw_cull_view Result = {};
+
+	for(u32 PlaneIndex = 0;
+		PlaneIndex < 6;
+		++PlaneIndex)
+	{
+		glm::vec3 Normal = Orientation * glm::vec3(CullData.Frustrum[PlaneIndex]);
+		Result.Frustrum[PlaneIndex] = glm::vec4(Normal, CullData.Frustrum[PlaneIndex].w - glm::dot(Normal, Origin));
+	}
+	Result.Origin = Origin;
+	Result.CommandOffset = CommandOffset;
+
+	return Result;
+}
+
 u32 GetImageMipLevels(u32 Width, u32 Height)
 {
 	u32 Result = 1;
@@ -531,6 +741,62 @@ u32 GetGroupCount(u32 ThreadCount, u32 LocalSize)
 	return (ThreadCount + LocalSize - 1) / LocalSize;
 }
 
+// NOTE: the shader has to flatten the group id with GetFlatGroupIndex and skip the groups past the count
+internal void
+DispatchGroupRows(VkCommandBuffer CommandBuffer, u32 GroupCount)
+{
+	vkCmdDispatch(CommandBuffer, min(GroupCount, u32(DISPATCH_ROW_GROUPS)), (GroupCount + DISPATCH_ROW_GROUPS - 1) / DISPATCH_ROW_GROUPS, 1);
+}
+
+// NOTE: Descriptors are the draw_sort.comp bindings, the counts of the last pass are left in SortOffsets.
+// The sorted commands and draw ids go to their own buffers, so the previous draws of them have to be done
+internal void
+SortDrawCommands(VkCommandBuffer CommandBuffer, const program& Program, VkPipeline Pipeline, const descriptor_template* Descriptors, 
+				 VkBuffer SortOffsetBuffer, VkBuffer SortedCommandBuffer, VkBuffer SortedDrawIdBuffer, VkPipelineStageFlags DrawReadStages, 
+				 u32 LocalSizeX, u32 MaxDrawCount, float KeyScale)
+{
+	VkBufferMemoryBarrier BeginBarriers[] = 
+	{
+		CreateBufferBarrier(SortOffsetBuffer, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT),
+		CreateBufferBarrier(SortedCommandBuffer, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT),
+		CreateBufferBarrier(SortedDrawIdBuffer, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT),
+	};
+	vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | DrawReadStages, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, ArraySize(BeginBarriers), BeginBarriers, 0, 0);
+
+	vkCmdFillBuffer(CommandBuffer, SortOffsetBuffer, 0, sizeof(u32) * DRAW_SORT_KEY_COUNT, 0);
+
+	// NOTE: the cull output is only made visible to the draws before, the sort reads it in compute
+	VkMemoryBarrier ReadBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+	ReadBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	ReadBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &ReadBarrier, 0, 0, 0, 0);
+
+	vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline);
+	vkCmdPushDescriptorSetWithTemplateKHR(CommandBuffer, Program.DescriptorTemplate, Program.Layout, 0, Descriptors);
+
+	for(u32 Pass = DrawSortPass_Count;
+		Pass <= DrawSortPass_Scatter;
+		++Pass)
+	{
+		draw_sort_data SortData = {KeyScale, Pass};
+		vkCmdPushConstants(CommandBuffer, Program.Layout, Program.Stages, 0, sizeof(draw_sort_data), &SortData);
+		DispatchGroupRows(CommandBuffer, (Pass == DrawSortPass_Scan) ? 1 : GetGroupCount(MaxDrawCount, LocalSizeX));
+
+		if(Pass != DrawSortPass_Scatter)
+		{
+			VkBufferMemoryBarrier OffsetBarrier = CreateBufferBarrier(SortOffsetBuffer, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, 1, &OffsetBarrier, 0, 0);
+		}
+	}
+
+	VkBufferMemoryBarrier EndBarriers[] = 
+	{
+		CreateBufferBarrier(SortedCommandBuffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+		CreateBufferBarrier(SortedDrawIdBuffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+	};
+	vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, DrawReadStages, 0, 0, 0, ArraySize(EndBarriers), EndBarriers, 0, 0);
+}
+
 u32 GetPreviousPowerOfTwo(u32 Val)
 {
 	if(Val == 0) return 0;
@@ -547,15 +813,16 @@ u32 GetPreviousPowerOfTwo(u32 Val)
 	return Val;
 }
 
-glm::vec4 
-GetAxisAlignedBoundingBox(const glm::vec3& C, // camera-space sphere center
-						  float r, // sphere radius
-						  float NearZ, // near clipping plane position (negative)
-						  float P00,
-						  float P11)
+internal bool
+ProjectSphere(const glm::vec3& C, // camera-space sphere center
+			  float r, // sphere radius
+			  float NearZ, // near clipping plane position
+			  float P00,
+			  float P11,
+			  glm::vec4& AABB)
 {
 	if(C.z < r + NearZ)
-		return glm::vec4(); // TODO: return boolean
+		return false;
 
 	glm::vec2 cx(-C.x, -C.z);
 	glm::vec2 vx = glm::vec2(sqrt(dot(cx, cx) - r * r), r) / length(cx);
@@ -567,290 +834,1530 @@ GetAxisAlignedBoundingBox(const glm::vec3& C, // camera-space sphere center
 	glm::vec2 miny = glm::mat2(vy.x, -vy.y, vy.y, vy.x) * cy;
 	glm::vec2 maxy = glm::mat2(vy.x, vy.y, -vy.y, vy.x) * cy;
 
-	return glm::vec4(minx.x / minx.y * P00, miny.x / miny.y * P11, maxx.x / maxx.y * P00, maxy.x / maxy.y * P11) * 
+	AABB = glm::vec4(minx.x / minx.y * P00, miny.x / miny.y * P11, maxx.x / maxx.y * P00, maxy.x / maxy.y * P11) * 
 		   glm::vec4(0.5f, -0.5f, 0.5f, -0.5f) + glm::vec4(0.5f);
+	return true;
 }
 
-LRESULT CALLBACK WindowProc(HWND Wnd, UINT Msg, WPARAM wParam, LPARAM lParam);
+#include "software_occlusion.h"
+#include "cpu_cull.h"
+#include "draw_cluster.h"
 
-int WINAPI 
-WinMain(HINSTANCE CurrInst, 
-		HINSTANCE PrevInst, 
-		PSTR Cmd, 
-		int CmdShow) 
+#if VK_DEBUG
+// NOTE: the previous test: one min-filtered tap at the center of the box at level floor(log2(size))
+internal bool
+IsOccludedSingleTap(const depth_pyramid& Pyramid, const glm::vec4& AABB, float DepthSphere)
 {
-	LARGE_INTEGER TimeFreq = {};
-	QueryPerformanceFrequency(&TimeFreq);
-	LARGE_INTEGER BegTime = {}, EndTime = {};
+	float Width  = (AABB.z - AABB.x) * Pyramid.Width;
+	float Height = (AABB.w - AABB.y) * Pyramid.Height;
 
-	const char ClassName[] = "Vulkan Win32 Engine";
-	WNDCLASS WinClass = {};
-	WinClass.lpfnWndProc = WindowProc;
-	WinClass.lpszClassName = ClassName;
-	WinClass.hInstance = CurrInst;
+	float MaxLevel = float(Pyramid.Levels.size() - 1);
+	u32 Level = u32(min(max(floorf(log2f(max(Width, Height))), 0.0f), MaxLevel));
 
-	RegisterClass(&WinClass);
+	s32 LevelWidth  = max(1, s32(Pyramid.Width  >> Level));
+	s32 LevelHeight = max(1, s32(Pyramid.Height >> Level));
+	float U = (AABB.x + AABB.z) * 0.5f * LevelWidth  - 0.5f;
+	float V = (AABB.y + AABB.w) * 0.5f * LevelHeight - 0.5f;
+	s32 X = s32(floorf(U)), Y = s32(floorf(V));
 
-	u32 WindowWidth = 1280;
-	u32 WindowHeight = 720;
-	HWND Window = CreateWindowEx(0, ClassName, "Vulkan Engine", WS_OVERLAPPEDWINDOW, 
-								 CW_USEDEFAULT, CW_USEDEFAULT, WindowWidth, WindowHeight, 
-								 0, 0, CurrInst, 0);
+	float Depth = min(min(GetPyramidDepth(Pyramid, Level, X, Y), GetPyramidDepth(Pyramid, Level, X + 1, Y)), 
+					  min(GetPyramidDepth(Pyramid, Level, X, Y + 1), GetPyramidDepth(Pyramid, Level, X + 1, Y + 1)));
+	return DepthSphere <= Depth;
+}
 
-	if(!Window)
+// NOTE: reference: every finest level texel the box touches
+internal bool
+IsOccludedExact(const depth_pyramid& Pyramid, const glm::vec4& AABB, float DepthSphere)
+{
+	s32 MinX = s32(min(AABB.x, AABB.z) * Pyramid.Width), MinY = s32(min(AABB.y, AABB.w) * Pyramid.Height);
+	s32 MaxX = s32(max(AABB.x, AABB.z) * Pyramid.Width), MaxY = s32(max(AABB.y, AABB.w) * Pyramid.Height);
+	MinX = max(MinX, 0); MaxX = min(MaxX, s32(Pyramid.Width)  - 1);
+	MinY = max(MinY, 0); MaxY = min(MaxY, s32(Pyramid.Height) - 1);
+
+	for(s32 Y = MinY; Y <= MaxY; ++Y)
 	{
-		return 1;
+		for(s32 X = MinX; X <= MaxX; ++X)
+		{
+			if(DepthSphere > Pyramid.Levels[0][Y * Pyramid.Width + X])
+			{
+				return false;
+			}
+		}
 	}
-	IsRunning = true;
-	ShowWindow(Window, CmdShow);
-
-	RECT ClientRect = {};
-	GetClientRect(Window, &ClientRect);
-	u32 ClientWidth = ClientRect.right - ClientRect.left;
-	u32 ClientHeight = ClientRect.bottom - ClientRect.top;
-
-	geometry Geometries;
-	bool IsMeshLoaded = LoadMesh(Geometries, "..\\assets\\kitten.obj", true);
-	assert(IsMeshLoaded);
-	//IsMeshLoaded = LoadMesh(Geometries, "..\\assets\\f22.obj", true);
-	//assert(IsMeshLoaded);
-
-	VK_CHECK(volkInitialize());
-	VkInstance Instance = CreateInstance(ClassName);
-
-	VkDebugReportCallbackEXT Callback = 0;
-	VkDebugReportCallbackCreateInfoEXT DebugReportCreateInfo = {VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT};
-	DebugReportCreateInfo.pfnCallback = DebugReportCallback;
-	DebugReportCreateInfo.flags = VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT | VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_DEBUG_BIT_EXT | VK_DEBUG_REPORT_INFORMATION_BIT_EXT;
-	VK_CHECK(vkCreateDebugReportCallbackEXT(Instance, &DebugReportCreateInfo, 0, &Callback));
 
-	u32 PhysicalDeviceCount = 0;
-	vkEnumeratePhysicalDevices(Instance, &PhysicalDeviceCount, 0);
-	std::vector<VkPhysicalDevice> PhysicalDevices(PhysicalDeviceCount);
-	VK_CHECK(vkEnumeratePhysicalDevices(Instance, &PhysicalDeviceCount, PhysicalDevices.data()));
+	return true;
+}
 
-	u32 FamilyIndex = 0;
-	VkPhysicalDevice PhysicalDevice = PickPhysicalDevice(PhysicalDevices, &FamilyIndex);
-	assert(PhysicalDevice);
+// NOTE: randomized check of the occlusion test against the exact footprint on random occluders.
+// The conservative test must never reject a sphere the exact test keeps
+internal void
+ValidateOcclusionTest(u32 SphereCount)
+{
+	u32 RandomState = 0x9e3779b9;
+	auto Random = [&RandomState]() -> float
+	{
+		RandomState ^= RandomState << 13;
+		RandomState ^= RandomState >> 17;
+		RandomState ^= RandomState << 5;
+		return float(RandomState >> 8) / float(1 << 24);
+	};
 
-	VkPhysicalDeviceProperties Props;
-	vkGetPhysicalDeviceProperties(PhysicalDevice, &Props);
-	assert(Props.limits.timestampPeriod);
+	float ZNear = 1.0f;
+	glm::mat4x4 Projection = GetProjection(70.0f, 9.0f / 16.0f, ZNear);
 
-	u32 ExtensionCount = 0;
-	vkEnumerateDeviceExtensionProperties(PhysicalDevice, 0, &ExtensionCount, 0);
-	std::vector<VkExtensionProperties> SupportedExtensions(ExtensionCount);
-	vkEnumerateDeviceExtensionProperties(PhysicalDevice, 0, &ExtensionCount, SupportedExtensions.data());
+	depth_pyramid Pyramid = {};
+	Pyramid.Width  = 512;
+	Pyramid.Height = 256;
+	Pyramid.Levels.resize(1);
+	Pyramid.Levels[0].assign(Pyramid.Width * Pyramid.Height, 0.0f);
 
-	for(const auto& Extension : SupportedExtensions)
+	for(u32 OccluderIndex = 0;
+		OccluderIndex < 64;
+		++OccluderIndex)
 	{
-		if(strcmp(Extension.extensionName, "VK_NV_mesh_shader") == 0)
+		u32 MinX = u32(Random() * Pyramid.Width), SizeX = u32(Random() * Pyramid.Width  / 4);
+		u32 MinY = u32(Random() * Pyramid.Height), SizeY = u32(Random() * Pyramid.Height / 4);
+		float Depth = ZNear / (2.0f + Random() * 20.0f);
+		for(u32 Y = MinY; Y < min(MinY + SizeY, Pyramid.Height); ++Y)
 		{
-			IsRtxSupported = true;
-			break;
+			for(u32 X = MinX; X < min(MinX + SizeX, Pyramid.Width); ++X)
+			{
+				float& Texel = Pyramid.Levels[0][Y * Pyramid.Width + X];
+				Texel = max(Texel, Depth);
+			}
 		}
 	}
-	IsRtxEnabled = IsRtxSupported;
-
-	VkDevice Device = CreateDevice(PhysicalDevice, &FamilyIndex);
-	assert(Device);
-
-	u32 Count = 0;
-	vkEnumerateDeviceExtensionProperties(PhysicalDevice, nullptr, &Count, 0);
-	std::vector<VkExtensionProperties> Extensions(Count);
-	vkEnumerateDeviceExtensionProperties(PhysicalDevice, nullptr, &Count, Extensions.data());
+	BuildDepthPyramid(Pyramid);
+
+	u32 ProjectedCount = 0, ExactCullCount = 0;
+	u32 ConservativeCullCount = 0, ConservativeFalseRejects = 0;
+	u32 SingleTapCullCount = 0, SingleTapFalseRejects = 0;
+	for(u32 SphereIndex = 0;
+		SphereIndex < SphereCount;
+		++SphereIndex)
+	{
+		glm::vec3 Center((Random() * 2 - 1) * 20.0f, (Random() * 2 - 1) * 12.0f, 2.0f + Random() * 40.0f);
+		float Radius = 0.05f + Random() * Random() * 4.0f;
 
-	VkWin32SurfaceCreateInfoKHR SurfaceCreateInfo = {VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR};
-	SurfaceCreateInfo.hinstance = CurrInst;
-	SurfaceCreateInfo.hwnd = Window;
-	VkSurfaceKHR Surface = 0;
-	VK_CHECK(vkCreateWin32SurfaceKHR(Instance, &SurfaceCreateInfo, 0, &Surface));
-	assert(Surface);
+		glm::vec4 AABB;
+		if(!ProjectSphere(Center, Radius, ZNear, Projection[0][0], Projection[1][1], AABB))
+		{
+			continue;
+		}
 
-	VkSurfaceCapabilitiesKHR SurfaceCaps;
-	VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(PhysicalDevice, Surface, &SurfaceCaps));
+		float DepthSphere = ZNear / (Center.z - Radius);
 
-	VkSurfaceFormatKHR SurfaceFormat = GetSwapchainFormat(PhysicalDevice, Surface);
+		bool IsExactCulled = IsOccludedExact(Pyramid, AABB, DepthSphere);
+		bool IsConservativeCulled = IsOccludedConservative(Pyramid, AABB, DepthSphere);
+		bool IsSingleTapCulled = IsOccludedSingleTap(Pyramid, AABB, DepthSphere);
 
-	VkSemaphore AcquireSemaphore = CreateSemaphore(Device);
-	assert(AcquireSemaphore);
-	VkSemaphore ReleaseSemaphore = CreateSemaphore(Device);
-	assert(ReleaseSemaphore);
+		ProjectedCount++;
+		ExactCullCount += IsExactCulled;
+		ConservativeCullCount += IsConservativeCulled;
+		ConservativeFalseRejects += IsConservativeCulled && !IsExactCulled;
+		SingleTapCullCount += IsSingleTapCulled;
+		SingleTapFalseRejects += IsSingleTapCulled && !IsExactCulled;
+	}
 
-	VkQueue Queue = 0;
-	vkGetDeviceQueue(Device, FamilyIndex, 0, &Queue);
-	assert(Queue);
+	float Scale = 100.0f / float(max(ProjectedCount, 1u));
+	printf("Occlusion test on %u spheres: exact culls %.1f%%, 2x2 culls %.1f%% (%u false rejects), single tap culls %.1f%% (%u false rejects)\n", 
+		   ProjectedCount, ExactCullCount * Scale, 
+		   ConservativeCullCount * Scale, ConservativeFalseRejects, 
+		   SingleTapCullCount * Scale, SingleTapFalseRejects);
+	assert(ConservativeFalseRejects == 0);
+}
 
-	shader ObjectMeshShader = {};
-	shader ObjectTaskShader = {};
+// NOTE: software occlusion of random quads. The result must be the same with and without worker threads,
+// and the simd rasterizer has to match a scalar rasterizer that tests every pixel of every triangle
+internal void
+ValidateSoftwareOcclusion(worker_pool& Pool, u32 DrawCount)
+{
+	u32 RandomState = 0x2545f491;
+	auto Random = [&RandomState]() -> float
+	{
+		RandomState ^= RandomState << 13;
+		RandomState ^= RandomState >> 17;
+		RandomState ^= RandomState << 5;
+		return float(RandomState >> 8) / float(1 << 24);
+	};
 
-	if(IsRtxSupported)
+	geometry Geometries = {};
+	float QuadCorners[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+	for(u32 CornerIndex = 0;
+		CornerIndex < 4;
+		++CornerIndex)
+	{
+		vertex Vertex = {};
+		Vertex.vx = QuadCorners[CornerIndex][0];
+		Vertex.vy = QuadCorners[CornerIndex][1];
+		Geometries.Vertices.push_back(Vertex);
+	}
+	Geometries.Indices = {0, 1, 2, 0, 2, 3};
+
+	mesh Quad = {};
+	Quad.Radius = sqrtf(2.0f);
+	Quad.VertexCount = 4;
+	Quad.LodCount = 1;
+	Quad.Lods[0].IndexCount = 6;
+	Quad.Lods[0].VertexCount = 4;
+	Geometries.Meshes.push_back(Quad);
+
+	std::vector<mesh_offset> Draws(DrawCount);
+	for(mesh_offset& Draw : Draws)
 	{
-		LoadShader(ObjectMeshShader, Device, "..\\shaders\\object.mesh.spv");
-		LoadShader(ObjectTaskShader, Device, "..\\shaders\\object.task.spv");
+		Draw.Pos[0] = (Random() * 2 - 1) * 20.0f;
+		Draw.Pos[1] = (Random() * 2 - 1) * 12.0f;
+		Draw.Pos[2] = 2.0f + Random() * 40.0f;
+		Draw.Scale  = 0.05f + Random() * Random() * 4.0f;
+
+		glm::vec3 Axis(Random() * 2 - 1, Random() * 2 - 1, 1.0f);
+		Draw.Orient = glm::rotate(glm::quat(1, 0, 0, 0), glm::radians(Random() * 60.0f), Axis);
+		Draw.Center = Quad.Center;
+		Draw.Radius = Quad.Radius;
 	}
 
-	shader ObjectVertexShader = {};
-	LoadShader(ObjectVertexShader, Device, "..\\shaders\\object.vert.spv");
-	shader ObjectFragmentShader = {};
-	LoadShader(ObjectFragmentShader, Device, "..\\shaders\\object.frag.spv");
-	shader DrawCullCommandComputeShader = {};
-	LoadShader(DrawCullCommandComputeShader, Device, "..\\shaders\\draw_cull.comp.spv");
-	shader DrawCullateCommandComputeShader = {};
-	LoadShader(DrawCullateCommandComputeShader, Device, "..\\shaders\\draw_cullate.comp.spv");
-	shader DepthReduceComputeShader = {};
-	LoadShader(DepthReduceComputeShader, Device, "..\\shaders\\depth_reduce.comp.spv");
+	float ZNear = 1.0f;
+	glm::mat4x4 Projection = GetProjection(70.0f, 9.0f / 16.0f, ZNear);
+	draw_cull_data CullData = GetDrawCullData(Projection, ZNear, 100.0f);
 
-	VkRenderPass RenderPass = CreateRenderPass(Device, SurfaceFormat.format, VK_FORMAT_D32_SFLOAT, false);
-	assert(RenderPass);
-	VkRenderPass RenderPassLate = CreateRenderPass(Device, SurfaceFormat.format, VK_FORMAT_D32_SFLOAT, true);
-	assert(RenderPassLate);
-	swapchain Swapchain;
-	CreateSwapchain(Swapchain, RenderPass, Device, Surface, SurfaceFormat, SurfaceCaps, ClientWidth, ClientHeight, &FamilyIndex);
+	worker_pool SerialPool = {};
+	software_occlusion Serial = {}, Parallel = {};
+	SelectOccluders(Serial, Geometries, Draws, SOFTWARE_OCCLUDER_COUNT);
+	SelectOccluders(Parallel, Geometries, Draws, SOFTWARE_OCCLUDER_COUNT);
 
-	program DrawCullComputeProgram = CreateProgram(Device, VK_PIPELINE_BIND_POINT_COMPUTE, {&DrawCullCommandComputeShader}, sizeof(draw_cull_data));
-	program DrawCullateComputeProgram = CreateProgram(Device, VK_PIPELINE_BIND_POINT_COMPUTE, {&DrawCullateCommandComputeShader}, sizeof(draw_cull_data));
-	program DepthReduceProgram = CreateProgram(Device, VK_PIPELINE_BIND_POINT_COMPUTE, {&DepthReduceComputeShader}, sizeof(depth_reduce_data));
-	program MeshProgram = CreateProgram(Device, VK_PIPELINE_BIND_POINT_GRAPHICS, {&ObjectVertexShader, &ObjectFragmentShader}, sizeof(globals));
+	std::vector<u32> SerialWords((DrawCount + 31) / 32), ParallelWords((DrawCount + 31) / 32);
+	RasterizeOccluders(Serial, SerialPool, Geometries, Draws, CullData);
+	TestSoftwareOcclusion(Serial, SerialPool, Draws, CullData, SerialWords.data());
+	RasterizeOccluders(Parallel, Pool, Geometries, Draws, CullData);
+	TestSoftwareOcclusion(Parallel, Pool, Draws, CullData, ParallelWords.data());
 
-	VkPipelineCache PipelineCache = 0;
-	VkPipeline DrawCullCmdPipeline = CreateComputePipeline(Device, PipelineCache, DrawCullComputeProgram.Layout, DrawCullCommandComputeShader);
-	assert(DrawCullCmdPipeline);
-	VkPipeline DrawCullateCmdPipeline = CreateComputePipeline(Device, PipelineCache, DrawCullateComputeProgram.Layout, DrawCullateCommandComputeShader);
-	assert(DrawCullateCmdPipeline);
-	VkPipeline DepthReducePipeline = CreateComputePipeline(Device, PipelineCache, DepthReduceProgram.Layout, DepthReduceComputeShader);
-	assert(DepthReducePipeline);
+	assert(Serial.Pyramid.Levels == Parallel.Pyramid.Levels);
+	assert(SerialWords == ParallelWords);
+	assert(Serial.VisibleCount == Parallel.VisibleCount);
 
-	VkPipeline MeshPipeline = CreateGraphicsPipeline(Device, PipelineCache, MeshProgram.Layout, RenderPass, {&ObjectVertexShader, &ObjectFragmentShader});
-	assert(MeshPipeline);
+	// NOTE: the simd rasterizer works on aligned groups of 4 pixels, so the reference walks the same pixels
+	std::vector<float> Reference(SOFTWARE_OCCLUSION_WIDTH * SOFTWARE_OCCLUSION_HEIGHT, 0.0f);
+	for(const occluder_triangle& Triangle : Parallel.Triangles)
+	{
+		for(s32 Y = Triangle.MinY; Y <= Triangle.MaxY; ++Y)
+		{
+			for(s32 X = Triangle.MinX & ~3; X <= min(Triangle.MaxX | 3, SOFTWARE_OCCLUSION_WIDTH - 1); ++X)
+			{
+				float PixelX = float(X) + 0.5f;
+				float PixelY = float(Y) + 0.5f;
+
+				bool IsCovered = true;
+				for(u32 EdgeIndex = 0;
+					EdgeIndex < 3;
+					++EdgeIndex)
+				{
+					IsCovered = IsCovered && (Triangle.EdgeA[EdgeIndex] * PixelX + (Triangle.EdgeB[EdgeIndex] * PixelY + Triangle.EdgeC[EdgeIndex]) >= 0.0f);
+				}
+
+				if(IsCovered)
+				{
+					float& Texel = Reference[Y * SOFTWARE_OCCLUSION_WIDTH + X];
+					Texel = max(Texel, Triangle.DepthA * PixelX + (Triangle.DepthB * PixelY + Triangle.DepthC));
+				}
+			}
+		}
+	}
+	assert(Reference == Parallel.Pyramid.Levels[0]);
+
+	printf("Software occlusion on %u draws: %u occluders, %u triangles, %u visible\n",
+		   DrawCount, u32(Parallel.Occluders.size()), u32(Parallel.Triangles.size()), Parallel.VisibleCount);
+}
+
+// NOTE: clusters of random draws have to hold every draw once and enclose their draw spheres,
+// and a cluster outside of the frustum can't have a draw inside of it
+internal void
+ValidateDrawClusters(worker_pool& Pool, u32 DrawCount)
+{
+	u32 RandomState = 0x6c8e9cf5;
+	auto Random = [&RandomState]() -> float
+	{
+		RandomState ^= RandomState << 13;
+		RandomState ^= RandomState >> 17;
+		RandomState ^= RandomState << 5;
+		return float(RandomState >> 8) / float(1 << 24);
+	};
+
+	std::vector<mesh_offset> Draws(DrawCount);
+	for(u32 DrawIndex = 0;
+		DrawIndex < DrawCount;
+		++DrawIndex)
+	{
+		mesh_offset& Draw = Draws[DrawIndex];
+		Draw.Pos[0] = (Random() * 2 - 1) * 100.0f;
+		Draw.Pos[1] = (Random() * 2 - 1) * 100.0f;
+		Draw.Pos[2] = (Random() * 2 - 1) * 100.0f;
+		Draw.Scale  = 0.1f + Random() * 2.0f;
+
+		glm::vec3 Axis(Random() * 2 - 1, Random() * 2 - 1, 1.0f);
+		Draw.Orient = glm::rotate(glm::quat(1, 0, 0, 0), glm::radians(Random() * 90.0f), Axis);
+		Draw.Center = glm::vec3(Random(), Random(), Random());
+		Draw.Radius = 0.5f + Random();
+
+		// NOTE: keeps the index the draw had before it was reordered
+		Draw.VertexOffset = DrawIndex;
+	}
+
+	std::vector<draw_cluster> Clusters;
+	BuildDrawClusters(Clusters, Pool, Draws);
+
+	float ZNear = 1.0f;
+	glm::mat4x4 Projection = GetProjection(70.0f, 9.0f / 16.0f, ZNear);
+	draw_cull_data CullData = GetDrawCullData(Projection, ZNear, 100.0f);
+
+	std::vector<bool> IsDrawSeen(DrawCount);
+	u32 NextDraw = 0;
+	u32 VisibleClusterCount = 0, TestedDrawCount = 0, VisibleDrawCount = 0;
+	for(const draw_cluster& Cluster : Clusters)
+	{
+		assert(Cluster.FirstDraw == NextDraw && Cluster.DrawCount > 0 && Cluster.DrawCount <= DRAW_CLUSTER_SIZE);
+		NextDraw += Cluster.DrawCount;
+
+		bool IsClusterVisible = IsSphereInFrustum(CullData, Cluster.Center, Cluster.Radius);
+		VisibleClusterCount += IsClusterVisible;
+		TestedDrawCount += IsClusterVisible ? Cluster.DrawCount : 0;
+
+		for(u32 DrawIndex = Cluster.FirstDraw;
+			DrawIndex < Cluster.FirstDraw + Cluster.DrawCount;
+			++DrawIndex)
+		{
+			assert(!IsDrawSeen[Draws[DrawIndex].VertexOffset]);
+			IsDrawSeen[Draws[DrawIndex].VertexOffset] = true;
+
+			glm::vec3 Center;
+			float Radius;
+			GetDrawSphere(Draws[DrawIndex], Center, Radius);
+			assert(glm::length(Center - Cluster.Center) + Radius <= Cluster.Radius * 1.0001f);
+
+			bool IsDrawVisible = IsSphereInFrustum(CullData, Center, Radius);
+			assert(IsClusterVisible || !IsDrawVisible);
+			VisibleDrawCount += IsDrawVisible;
+		}
+	}
+	assert(NextDraw == DrawCount);
+
+	printf("Draw clusters on %u draws: %u of %u clusters in the frustum, %u draws tested for %u visible\n",
+		   DrawCount, VisibleClusterCount, u32(Clusters.size()), TestedDrawCount, VisibleDrawCount);
+}
+
+// NOTE: random transforms have to come back from the packed encoding within the precision of its fields:
+// half a step of the cell offsets, the relative error of a half and a small angle for the quaternion
+internal void
+ValidateTransformPacking(u32 TransformCount)
+{
+	u32 RandomState = 0x3c6ef372;
+	auto Random = [&RandomState]() -> float
+	{
+		RandomState ^= RandomState << 13;
+		RandomState ^= RandomState >> 17;
+		RandomState ^= RandomState << 5;
+		return float(RandomState >> 8) / float(1 << 24);
+	};
+
+	float MaxPositionError = 0.0f, MaxScaleError = 0.0f, MaxAngleError = 0.0f;
+	for(u32 TransformIndex = 0;
+		TransformIndex < TransformCount;
+		++TransformIndex)
+	{
+		draw_transform Transform = {};
+		for(u32 Axis = 0;
+			Axis < 3;
+			++Axis)
+		{
+			Transform.Pos[Axis] = (Random() * 2 - 1) * TRANSFORM_CELL_SIZE * (TRANSFORM_CELL_BIAS - 1);
+		}
+		Transform.Scale  = 0.01f + Random() * 100.0f;
+		Transform.Orient = glm::normalize(glm::quat(Random() * 2 - 1, Random() * 2 - 1, Random() * 2 - 1, Random() * 2 - 1));
+		Transform.MeshIndex = RandomState;
+		Transform.VertexOffset = RandomState >> 8;
+
+		draw_transform Unpacked = UnpackDrawTransform(PackDrawTransform(Transform), Transform.VertexOffset);
+		assert(Unpacked.MeshIndex == Transform.MeshIndex);
+		assert(Unpacked.VertexOffset == Transform.VertexOffset);
+
+		for(u32 Axis = 0;
+			Axis < 3;
+			++Axis)
+		{
+			MaxPositionError = max(MaxPositionError, fabsf(Unpacked.Pos[Axis] - Transform.Pos[Axis]));
+		}
+		MaxScaleError = max(MaxScaleError, fabsf(Unpacked.Scale - Transform.Scale) / Transform.Scale);
+
+		// NOTE: q and -q are the same rotation
+		float Dot = fabsf(glm::dot(Unpacked.Orient, Transform.Orient)) / glm::length(Unpacked.Orient);
+		MaxAngleError = max(MaxAngleError, 2.0f * acosf(Dot < 1.0f ? Dot : 1.0f));
+	}
+
+	printf("Transform packing on %u transforms: max position error %f, max relative scale error %f, max angle error %f degrees\n",
+		   TransformCount, MaxPositionError, MaxScaleError, glm::degrees(MaxAngleError));
+	assert(MaxPositionError <= TRANSFORM_CELL_SIZE / 65535.0f);
+	assert(MaxScaleError <= 1.0f / 2048.0f);
+	assert(glm::degrees(MaxAngleError) <= 0.3f);
+}
+
+struct chunk_position
+{
+	float X, Y, Z;
+	u32 MeshIndex;
+};
+
+internal bool
+IsChunkPositionLess(const chunk_position& A, const chunk_position& B)
+{
+	if(A.X != B.X) return A.X < B.X;
+	if(A.Y != B.Y) return A.Y < B.Y;
+	if(A.Z != B.Z) return A.Z < B.Z;
+	return A.MeshIndex < B.MeshIndex;
+}
+
+internal void
+GetChunkPositions(std::vector<chunk_position>& Result, const geometry& Geometries, const mesh_group& Group, u32 LodIndex)
+{
+	Result.clear();
+	for(u32 MeshIndex = Group.MeshOffset;
+		MeshIndex < Group.MeshOffset + Group.MeshCount;
+		++MeshIndex)
+	{
+		const mesh& Mesh = Geometries.Meshes[MeshIndex];
+		if(LodIndex >= Mesh.LodCount)
+		{
+			continue;
+		}
+
+		const mesh_lod& Lod = Mesh.Lods[LodIndex];
+		for(u32 Index = Lod.IndexOffset;
+			Index < Lod.IndexOffset + Lod.IndexCount;
+			++Index)
+		{
+			const vertex& Vertex = Geometries.Vertices[Mesh.VertexOffset + Geometries.Indices[Index]];
+			Result.push_back({Vertex.vx, Vertex.vy, Vertex.vz, MeshIndex});
+		}
+	}
+
+	std::sort(Result.begin(), Result.end(), IsChunkPositionLess);
+	Result.erase(std::unique(Result.begin(), Result.end(), [](const chunk_position& A, const chunk_position& B) { return !IsChunkPositionLess(A, B) && !IsChunkPositionLess(B, A); }), Result.end());
+}
+
+// NOTE: a position that more than one chunk of a group uses at lod 0 is on a chunk border. Every chunk
+// has to keep using all of its border positions in every lod, or the borders of neighbouring lods open up.
+// Returns how many times a chunk lod lost one of them
+internal u32
+CountMovedChunkBorders(const geometry& Geometries, u32& BorderCount)
+{
+	u32 MovedCount = 0;
+	BorderCount = 0;
+
+	std::vector<chunk_position> Positions, Border;
+	for(const mesh_group& Group : Geometries.MeshGroups)
+	{
+		if(Group.MeshCount < 2)
+		{
+			continue;
+		}
+
+		GetChunkPositions(Positions, Geometries, Group, 0);
+
+		// NOTE: positions are sorted with the chunks of a position next to each other
+		Border.clear();
+		for(size_t First = 0, Last = 0;
+			First < Positions.size();
+			First = Last)
+		{
+			for(Last = First + 1;
+				Last < Positions.size() && Positions[Last].X == Positions[First].X && Positions[Last].Y == Positions[First].Y && Positions[Last].Z == Positions[First].Z;
+				++Last);
+
+			if(Last - First > 1)
+			{
+				Border.insert(Border.end(), Positions.begin() + First, Positions.begin() + Last);
+			}
+		}
+		BorderCount += u32(Border.size());
+
+		for(u32 LodIndex = 1;
+			LodIndex < MAX_LODS;
+			++LodIndex)
+		{
+			GetChunkPositions(Positions, Geometries, Group, LodIndex);
+			for(const chunk_position& Position : Border)
+			{
+				if(LodIndex < Geometries.Meshes[Position.MeshIndex].LodCount && !std::binary_search(Positions.begin(), Positions.end(), Position, IsChunkPositionLess))
+				{
+					MovedCount++;
+				}
+			}
+		}
+	}
+
+	return MovedCount;
+}
+
+// NOTE: chunk borders are locked by appending unreferenced copies of their positions, which relies on how
+// the simplifier classifies positions with more wedges than a seam. A flat grid simplifies as far as the
+// locks let it, and its uv seams cross the chunk borders so border positions have up to four wedges.
+// The loaded meshes are checked the same way
+internal void
+ValidateChunkBorders(const geometry& Geometries, u32 GridSize)
+{
+	u32 SeamX = GridSize / 2;
+	u32 SeamY = GridSize / 3;
+
+	// NOTE: four wedges per grid point, the second and third are the other side of the seams
+	std::vector<vertex> Vertices((GridSize + 1) * (GridSize + 1) * 4);
+	for(u32 Y = 0;
+		Y <= GridSize;
+		++Y)
+	{
+		for(u32 X = 0;
+			X <= GridSize;
+			++X)
+		{
+			for(u32 Wedge = 0;
+				Wedge < 4;
+				++Wedge)
+			{
+				float Position[3] = {float(X) / GridSize, float(Y) / GridSize, 0.0f};
+				float TextureCoord[2] = {Position[0] + (Wedge & 1) * 0.5f, Position[1] + (Wedge >> 1) * 0.5f};
+				float Normal[3] = {0.0f, 0.0f, 1.0f};
+				Vertices[((Y * (GridSize + 1)) + X) * 4 + Wedge] = MakeVertex(Position, TextureCoord, Normal);
+			}
+		}
+	}
+
+	auto GetGridIndex = [&](u32 X, u32 Y, u32 CellX, u32 CellY) -> u32
+	{
+		u32 Wedge = (X == SeamX && CellX >= SeamX) + (Y == SeamY && CellY >= SeamY) * 2;
+		return ((Y * (GridSize + 1)) + X) * 4 + Wedge;
+	};
+
+	std::vector<u32> Indices;
+	Indices.reserve(GridSize * GridSize * 6);
+	for(u32 CellY = 0;
+		CellY < GridSize;
+		++CellY)
+	{
+		for(u32 CellX = 0;
+			CellX < GridSize;
+			++CellX)
+		{
+			u32 Corners[4] = 
+			{
+				GetGridIndex(CellX, CellY, CellX, CellY), GetGridIndex(CellX + 1, CellY, CellX, CellY),
+				GetGridIndex(CellX + 1, CellY + 1, CellX, CellY), GetGridIndex(CellX, CellY + 1, CellX, CellY),
+			};
+			Indices.insert(Indices.end(), {Corners[0], Corners[1], Corners[2], Corners[0], Corners[2], Corners[3]});
+		}
+	}
+
+	mesh_cook_options Options = {};
+	Options.IsVertexOrderProgressive = true;
+	Options.ChunkTriangleThreshold = GridSize * GridSize / 3;
+
+	geometry Grid = {};
+	CookMeshGroup(Grid, Vertices, Indices, false, Options);
+
+	u32 GridBorderCount = 0, LoadedBorderCount = 0;
+	u32 GridMovedCount = CountMovedChunkBorders(Grid, GridBorderCount);
+	u32 LoadedMovedCount = CountMovedChunkBorders(Geometries, LoadedBorderCount);
+
+	printf("Chunk borders: %u border positions in a grid of %u chunks lost %u times over the lods, %u in the loaded meshes lost %u times\n",
+		   GridBorderCount, u32(Grid.Meshes.size()), GridMovedCount, LoadedBorderCount, LoadedMovedCount);
+	assert(Grid.Meshes.size() > 1 && Grid.Meshes[0].LodCount > 1);
+	assert(GridMovedCount == 0);
+	assert(LoadedMovedCount == 0);
+}
+
+// NOTE: a frame shaped like the real one recorded without a device. The first frame has no lifetimes to
+// place the transient images by, from the second one the ones never alive together share memory.
+// No frame may leave a hazard and a frame that lost a batch has to be caught
+internal void
+ValidateRenderGraphBarriers()
+{
+	VkPipelineStageFlags DrawStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+	VkPipelineStageFlags DepthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	VkAccessFlags DepthAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	u32 PyramidLevels = 8;
+
+	render_graph Graph = {};
+	u32 ColorImage     = AddRenderGraphImage(Graph, "color", VK_IMAGE_ASPECT_COLOR_BIT, true);
+	u32 DepthImage     = AddRenderGraphImage(Graph, "depth", VK_IMAGE_ASPECT_DEPTH_BIT, true);
+	u32 CullImage      = AddRenderGraphImage(Graph, "cull scratch", VK_IMAGE_ASPECT_COLOR_BIT, true);
+	u32 PostImage      = AddRenderGraphImage(Graph, "post scratch", VK_IMAGE_ASPECT_COLOR_BIT, true);
+	u32 PyramidImage   = AddRenderGraphImage(Graph, "pyramid", VK_IMAGE_ASPECT_COLOR_BIT, false);
+	u32 SwapchainImage = AddRenderGraphImage(Graph, "swapchain", VK_IMAGE_ASPECT_COLOR_BIT, false);
+
+	SetRenderGraphImage(Graph, ColorImage, VkImage(u64(1)), 1, {8 << 20, 4096, 3});
+	SetRenderGraphImage(Graph, DepthImage, VkImage(u64(2)), 1, {8 << 20, 65536, 3});
+	SetRenderGraphImage(Graph, CullImage, VkImage(u64(3)), 1, {2 << 20, 4096, 1});
+	SetRenderGraphImage(Graph, PostImage, VkImage(u64(4)), 1, {2 << 20, 4096, 1});
+	SetRenderGraphImage(Graph, PyramidImage, VkImage(u64(5)), PyramidLevels);
+
+	VkDeviceSize ImageSize = 0;
+	for(const render_graph_image& Image : Graph.Images)
+	{
+		ImageSize += Image.Requirements.size;
+	}
+
+	VkDeviceSize HeapSize = PlaceRenderGraphImages(Graph);
+	assert(HeapSize == ImageSize);
+
+	u32 HazardCount = 0;
+	for(u32 FrameIndex = 0;
+		FrameIndex < 3;
+		++FrameIndex)
+	{
+		if(FrameIndex > 0)
+		{
+			HeapSize = PlaceRenderGraphImages(Graph);
+		}
+
+		BeginRenderGraph(Graph);
+		ImportRenderGraphImage(Graph, SwapchainImage, VkImage(u64(6 + FrameIndex % 2)), VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		UseRenderGraphImage(Graph, PyramidImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | DrawStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+		UseRenderGraphImage(Graph, CullImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+		FlushRenderGraph(Graph, 0);
+
+		UseRenderGraphImage(Graph, CullImage, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+		UseRenderGraphImage(Graph, ColorImage, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		UseRenderGraphImage(Graph, DepthImage, DepthStages, DepthAccess, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+		FlushRenderGraph(Graph, 0);
+
+		for(u32 PyramidIndex = 0;
+			PyramidIndex < PyramidLevels;
+			++PyramidIndex)
+		{
+			if(PyramidIndex == 0)
+			{
+				UseRenderGraphImage(Graph, DepthImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			}
+			else
+			{
+				UseRenderGraphImage(Graph, PyramidImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, PyramidIndex - 1, 1);
+			}
+			UseRenderGraphImage(Graph, PyramidImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, PyramidIndex, 1);
+			FlushRenderGraph(Graph, 0);
+		}
+
+		UseRenderGraphImage(Graph, PyramidImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+		FlushRenderGraph(Graph, 0);
+
+		UseRenderGraphImage(Graph, PyramidImage, DrawStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+		UseRenderGraphImage(Graph, ColorImage, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 
+							VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		UseRenderGraphImage(Graph, DepthImage, DepthStages, DepthAccess, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+		FlushRenderGraph(Graph, 0);
+
+		UseRenderGraphImage(Graph, ColorImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		UseRenderGraphImage(Graph, PostImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+		FlushRenderGraph(Graph, 0);
+
+		UseRenderGraphImage(Graph, PostImage, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		UseRenderGraphImage(Graph, SwapchainImage, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		FlushRenderGraph(Graph, 0);
+
+		UseRenderGraphImage(Graph, SwapchainImage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		FlushRenderGraph(Graph, 0);
+
+		HazardCount += ValidateRenderGraph(Graph, true);
+	}
+	assert(HazardCount == 0);
+	assert(HeapSize < ImageSize);
+
+	// NOTE: the copy to the swapchain image loses its barriers
+	render_graph BrokenGraph = Graph;
+	BrokenGraph.Batches[BrokenGraph.Batches.size() - 2].DstStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	u32 BrokenHazardCount = ValidateRenderGraph(BrokenGraph, false);
+	assert(BrokenHazardCount > 0);
+
+	printf("Render graph on %u passes: %u barrier batches with %u image barriers, %.2f MB of transient images in %.2f MB, %u hazards in a frame missing a batch\n",
+		   Graph.PassIndex, u32(Graph.Batches.size()), Graph.BarrierCount, double(ImageSize) / (1024 * 1024), double(HeapSize) / (1024 * 1024), BrokenHazardCount);
+}
+#endif
+
+LRESULT CALLBACK WindowProc(HWND Wnd, UINT Msg, WPARAM wParam, LPARAM lParam);
+
+int WINAPI 
+WinMain(HINSTANCE CurrInst, 
+		HINSTANCE PrevInst, 
+		PSTR Cmd, 
+		int CmdShow) 
+{
+	LARGE_INTEGER TimeFreq = {};
+	QueryPerformanceFrequency(&TimeFreq);
+	LARGE_INTEGER BegTime = {}, EndTime = {};
+
+	// NOTE: every mesh and shader read is issued here in one batch, before the window and the device
+	// are created. Meshes are parsed in the order their reads complete, shaders once the device exists
+	const char* MeshPaths[] = 
+	{
+		"..\\assets\\kitten.obj",
+		//"..\\assets\\f22.obj",
+		"..\\assets\\kitten.glb",
+		"..\\assets\\kitten_compressed.glb",
+	};
+
+	// NOTE: per asset override of the contribution threshold, see mesh::ContributionScale
+	float MeshContributionScales[] = 
+	{
+		1.0f,
+		//0.0f,
+		1.0f,
+		1.0f,
+	};
+	assert(ArraySize(MeshContributionScales) == ArraySize(MeshPaths));
+
+	const char* ShaderPaths[] = 
+	{
+		"..\\shaders\\object.mesh.spv",
+		"..\\shaders\\object.task.spv",
+		"..\\shaders\\object.vert.spv",
+		"..\\shaders\\object.frag.spv",
+		"..\\shaders\\draw_cull.comp.spv",
+		"..\\shaders\\draw_emit.comp.spv",
+		"..\\shaders\\depth_reduce.comp.spv",
+		"..\\shaders\\depth_pyramid.comp.spv",
+		"..\\shaders\\cluster_cull.comp.spv",
+		"..\\shaders\\draw_cull_views.comp.spv",
+		"..\\shaders\\draw_sort.comp.spv",
+	};
+
+	// NOTE: -budget N on the command line cooks obj meshes out of core in N MB. They are streamed from
+	// their files then, reading them whole would take more than the budget, so they are not in the batch
+	size_t MeshMemoryBudget = 0;
+	if(const char* BudgetArgument = strstr(GetCommandLineA(), "-budget"))
+	{
+		MeshMemoryBudget = size_t(strtoull(BudgetArgument + strlen("-budget"), 0, 10)) << 20;
+	}
+	u32 MeshReadCount = MeshMemoryBudget ? 0 : u32(ArraySize(MeshPaths));
+
+	LARGE_INTEGER FileReadBegTime = {}, FileReadEndTime = {};
+	QueryPerformanceCounter(&FileReadBegTime);
+
+	file_read_batch FileReads = {};
+	FileReads.Mode = IsFileReadAsync ? FileReadMode_Overlapped : FileReadMode_Threaded;
+	for(u32 MeshIndex = 0;
+		MeshIndex < MeshReadCount;
+		++MeshIndex)
+	{
+		AddFileRead(FileReads, MeshPaths[MeshIndex]);
+	}
+	u32 FirstShaderRead = u32(FileReads.Reads.size());
+	for(const char* Path : ShaderPaths)
+	{
+		AddFileRead(FileReads, Path);
+	}
+	SubmitFileReads(FileReads);
+
+	const char ClassName[] = "Vulkan Win32 Engine";
+	WNDCLASS WinClass = {};
+	WinClass.lpfnWndProc = WindowProc;
+	WinClass.lpszClassName = ClassName;
+	WinClass.hInstance = CurrInst;
+
+	RegisterClass(&WinClass);
+
+	u32 WindowWidth = 1280;
+	u32 WindowHeight = 720;
+	HWND Window = CreateWindowEx(0, ClassName, "Vulkan Engine", WS_OVERLAPPEDWINDOW, 
+								 CW_USEDEFAULT, CW_USEDEFAULT, WindowWidth, WindowHeight, 
+								 0, 0, CurrInst, 0);
+
+	if(!Window)
+	{
+		return 1;
+	}
+	IsRunning = true;
+	ShowWindow(Window, CmdShow);
+
+	RECT ClientRect = {};
+	GetClientRect(Window, &ClientRect);
+	u32 ClientWidth = ClientRect.right - ClientRect.left;
+	u32 ClientHeight = ClientRect.bottom - ClientRect.top;
+
+	mesh_cook_options CookOptions = {};
+	CookOptions.IsVertexOrderProgressive = true;
+	CookOptions.ChunkTriangleThreshold = 16384;
+	CookOptions.MemoryBudget = MeshMemoryBudget;
+
+	geometry Geometries;
+	for(u32 PathIndex = 0;
+		PathIndex < ArraySize(MeshPaths);
+		++PathIndex)
+	{
+		size_t FirstMesh = Geometries.Meshes.size();
+		float ContributionScale = MeshContributionScales[PathIndex];
+		const char* MeshPath = MeshPaths[PathIndex];
+
+		LARGE_INTEGER MeshBegTime = {}, MeshEndTime = {};
+		QueryPerformanceCounter(&MeshBegTime);
+		if(MeshReadCount)
+		{
+			// NOTE: mesh reads are the first of the batch, in the order of MeshPaths, and are taken in completion order
+			file_read* MeshRead = TakeNextFileRead(FileReads, 0, MeshReadCount);
+			assert(MeshRead && !MeshRead->IsFailed);
+			bool IsMeshLoaded = LoadMeshFromMemory(Geometries, MeshRead->Path, MeshRead->Data, MeshRead->Size, true, CookOptions);
+			assert(IsMeshLoaded);
+
+			ContributionScale = MeshContributionScales[MeshRead - FileReads.Reads.data()];
+			MeshPath = MeshRead->Path;
+			FreeFileRead(*MeshRead);
+		}
+		else
+		{
+			bool IsMeshLoaded = LoadMesh(Geometries, MeshPath, true, CookOptions);
+			assert(IsMeshLoaded);
+		}
+		QueryPerformanceCounter(&MeshEndTime);
+
+		// NOTE: parse and cook time of the asset, batched reads are already in memory here
+		printf("%s loaded in %.2f ms\n", MeshPath, double(MeshEndTime.QuadPart - MeshBegTime.QuadPart) * 1000.0 / double(TimeFreq.QuadPart));
+
+		for(size_t MeshIndex = FirstMesh;
+			MeshIndex < Geometries.Meshes.size();
+			++MeshIndex)
+		{
+			Geometries.Meshes[MeshIndex].ContributionScale = ContributionScale;
+		}
+	}
+
+	VK_CHECK(volkInitialize());
+	VkInstance Instance = CreateInstance(ClassName);
+
+	VkDebugReportCallbackEXT Callback = 0;
+	VkDebugReportCallbackCreateInfoEXT DebugReportCreateInfo = {VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT};
+	DebugReportCreateInfo.pfnCallback = DebugReportCallback;
+	DebugReportCreateInfo.flags = VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT | VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_DEBUG_BIT_EXT | VK_DEBUG_REPORT_INFORMATION_BIT_EXT;
+	VK_CHECK(vkCreateDebugReportCallbackEXT(Instance, &DebugReportCreateInfo, 0, &Callback));
+
+	u32 PhysicalDeviceCount = 0;
+	vkEnumeratePhysicalDevices(Instance, &PhysicalDeviceCount, 0);
+	std::vector<VkPhysicalDevice> PhysicalDevices(PhysicalDeviceCount);
+	VK_CHECK(vkEnumeratePhysicalDevices(Instance, &PhysicalDeviceCount, PhysicalDevices.data()));
+
+	u32 FamilyIndex = 0;
+	VkPhysicalDevice PhysicalDevice = PickPhysicalDevice(PhysicalDevices, &FamilyIndex);
+	assert(PhysicalDevice);
+
+	VkPhysicalDeviceProperties Props;
+	vkGetPhysicalDeviceProperties(PhysicalDevice, &Props);
+	assert(Props.limits.timestampPeriod);
+
+	u32 ExtensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(PhysicalDevice, 0, &ExtensionCount, 0);
+	std::vector<VkExtensionProperties> SupportedExtensions(ExtensionCount);
+	vkEnumerateDeviceExtensionProperties(PhysicalDevice, 0, &ExtensionCount, SupportedExtensions.data());
+
+	for(const auto& Extension : SupportedExtensions)
+	{
+		if(strcmp(Extension.extensionName, "VK_NV_mesh_shader") == 0)
+		{
+			IsRtxSupported = true;
+			break;
+		}
+	}
+	IsRtxEnabled = IsRtxSupported;
+
+	VkDevice Device = CreateDevice(PhysicalDevice, &FamilyIndex);
+	assert(Device);
+
+	u32 Count = 0;
+	vkEnumerateDeviceExtensionProperties(PhysicalDevice, nullptr, &Count, 0);
+	std::vector<VkExtensionProperties> Extensions(Count);
+	vkEnumerateDeviceExtensionProperties(PhysicalDevice, nullptr, &Count, Extensions.data());
+
+	VkWin32SurfaceCreateInfoKHR SurfaceCreateInfo = {VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR};
+	SurfaceCreateInfo.hinstance = CurrInst;
+	SurfaceCreateInfo.hwnd = Window;
+	VkSurfaceKHR Surface = 0;
+	VK_CHECK(vkCreateWin32SurfaceKHR(Instance, &SurfaceCreateInfo, 0, &Surface));
+	assert(Surface);
+
+	VkSurfaceCapabilitiesKHR SurfaceCaps;
+	VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(PhysicalDevice, Surface, &SurfaceCaps));
+
+	VkSurfaceFormatKHR SurfaceFormat = GetSwapchainFormat(PhysicalDevice, Surface);
+
+	VkQueue Queue = 0;
+	vkGetDeviceQueue(Device, FamilyIndex, 0, &Queue);
+	assert(Queue);
+
+	shader ObjectMeshShader = {};
+	shader ObjectTaskShader = {};
+	shader ObjectVertexShader = {};
+	shader ObjectFragmentShader = {};
+	shader DrawCullCommandComputeShader = {};
+	shader DrawEmitCommandComputeShader = {};
+	shader DepthReduceComputeShader = {};
+	shader DepthPyramidComputeShader = {};
+	shader ClusterCullComputeShader = {};
+	shader DrawCullViewsComputeShader = {};
+	shader DrawSortComputeShader = {};
+
+	// NOTE: same order as ShaderPaths
+	shader* Shaders[] = 
+	{
+		&ObjectMeshShader,
+		&ObjectTaskShader,
+		&ObjectVertexShader,
+		&ObjectFragmentShader,
+		&DrawCullCommandComputeShader,
+		&DrawEmitCommandComputeShader,
+		&DepthReduceComputeShader,
+		&DepthPyramidComputeShader,
+		&ClusterCullComputeShader,
+		&DrawCullViewsComputeShader,
+		&DrawSortComputeShader,
+	};
+	static_assert(ArraySize(Shaders) == ArraySize(ShaderPaths), "Shader paths and shaders are out of sync");
+
+	while(file_read* ShaderRead = TakeNextFileRead(FileReads, FirstShaderRead, ArraySize(ShaderPaths)))
+	{
+		u32 ShaderIndex = u32(ShaderRead - &FileReads.Reads[FirstShaderRead]);
+		bool IsMeshletShader = (Shaders[ShaderIndex] == &ObjectMeshShader) || (Shaders[ShaderIndex] == &ObjectTaskShader);
+		if(!IsMeshletShader || IsRtxSupported)
+		{
+			assert(!ShaderRead->IsFailed);
+			bool IsShaderLoaded = LoadShaderFromMemory(*Shaders[ShaderIndex], Device, ShaderRead->Data, ShaderRead->Size);
+			assert(IsShaderLoaded);
+		}
+		FreeFileRead(*ShaderRead);
+	}
+
+	QueryPerformanceCounter(&FileReadEndTime);
+	printf("Startup assets read and parsed in %.2f ms (%s reads)\n", 
+		   double(FileReadEndTime.QuadPart - FileReadBegTime.QuadPart) * 1000.0 / double(TimeFreq.QuadPart), 
+		   FileReads.Mode == FileReadMode_Overlapped ? "overlapped" : "thread pool");
+
+	// NOTE: -readbench on the command line reads the same files once more in every mode, past the
+	// page cache so the order doesn't matter
+	if(strstr(GetCommandLineA(), "-readbench"))
+	{
+		file_read_mode BenchModes[] = {FileReadMode_Sequential, FileReadMode_Threaded, FileReadMode_Overlapped};
+		const char* BenchModeNames[] = {"sequential", "thread pool", "overlapped"};
+		for(u32 ModeIndex = 0;
+			ModeIndex < ArraySize(BenchModes);
+			++ModeIndex)
+		{
+			double ReadTime = 0;
+			bool IsRead = TimeUncachedFileReads(FileReads, BenchModes[ModeIndex], TimeFreq, &ReadTime);
+			printf("Startup reads without page cache, %-11s: %8.2f ms%s\n", BenchModeNames[ModeIndex], ReadTime, IsRead ? "" : " (a read failed)");
+		}
+	}
+	FreeFileReads(FileReads);
+
+	VkRenderPass RenderPass = CreateRenderPass(Device, SurfaceFormat.format, VK_FORMAT_D32_SFLOAT, false);
+	assert(RenderPass);
+	VkRenderPass RenderPassLate = CreateRenderPass(Device, SurfaceFormat.format, VK_FORMAT_D32_SFLOAT, true);
+	assert(RenderPassLate);
+	swapchain Swapchain;
+	CreateSwapchain(Swapchain, RenderPass, Device, Surface, SurfaceFormat, SurfaceCaps, ClientWidth, ClientHeight, &FamilyIndex);
+
+	program DrawCullComputeProgram = CreateProgram(Device, VK_PIPELINE_BIND_POINT_COMPUTE, {&DrawCullCommandComputeShader}, sizeof(draw_cull_data));
+	program ClusterCullComputeProgram = CreateProgram(Device, VK_PIPELINE_BIND_POINT_COMPUTE, {&ClusterCullComputeShader}, sizeof(draw_cull_data));
+	program DrawCullViewsComputeProgram = CreateProgram(Device, VK_PIPELINE_BIND_POINT_COMPUTE, {&DrawCullViewsComputeShader}, sizeof(draw_cull_views_data));
+	program DrawEmitComputeProgram = CreateProgram(Device, VK_PIPELINE_BIND_POINT_COMPUTE, {&DrawEmitCommandComputeShader}, sizeof(draw_emit_data));
+	program DrawSortComputeProgram = CreateProgram(Device, VK_PIPELINE_BIND_POINT_COMPUTE, {&DrawSortComputeShader}, sizeof(draw_sort_data));
+	program DepthReduceProgram = CreateProgram(Device, VK_PIPELINE_BIND_POINT_COMPUTE, {&DepthReduceComputeShader}, sizeof(depth_reduce_data));
+	program DepthPyramidProgram = CreateProgram(Device, VK_PIPELINE_BIND_POINT_COMPUTE, {&DepthPyramidComputeShader}, sizeof(depth_pyramid_data));
+	program MeshProgram = CreateProgram(Device, VK_PIPELINE_BIND_POINT_GRAPHICS, {&ObjectVertexShader, &ObjectFragmentShader}, sizeof(globals));
+
+	VkPipelineCache PipelineCache = 0;
+	VkPipeline DrawCullCmdPipelines[DrawCullFlag_Count] = {};
+	VkPipeline ClusterCullCmdPipelines[DrawCullFlag_Count] = {};
+	VkPipeline DrawCullViewsCmdPipelines[DrawCullFlag_Count] = {};
+	VkPipeline DrawEmitCmdPipelines[DrawCullFlag_Count] = {};
+	VkPipeline DrawSortCmdPipelines[DrawCullFlag_Count] = {};
+	VkPipeline DepthReducePipeline = CreateComputePipeline(Device, PipelineCache, DepthReduceProgram.Layout, DepthReduceComputeShader);
+	assert(DepthReducePipeline);
+	VkPipeline DepthPyramidPipeline = CreateComputePipeline(Device, PipelineCache, DepthPyramidProgram.Layout, DepthPyramidComputeShader);
+	assert(DepthPyramidPipeline);
+
+	VkPipeline MeshPipelines[ObjectFlag_Count] = {};
 
 	program RtxProgram = {};
-	VkPipeline RtxPipeline = 0;
+	VkPipeline RtxPipelines[ObjectFlag_Count] = {};
 	if(IsRtxSupported)
 	{
 		RtxProgram = CreateProgram(Device, VK_PIPELINE_BIND_POINT_GRAPHICS, {&ObjectTaskShader, &ObjectMeshShader, &ObjectFragmentShader}, sizeof(globals));
-		
-		RtxPipeline = CreateGraphicsPipeline(Device, PipelineCache, RtxProgram.Layout, RenderPass, {&ObjectTaskShader, &ObjectMeshShader, &ObjectFragmentShader});
-		assert(RtxPipeline);
 	}
 
 	VkCommandPoolCreateInfo CommandPoolCreateInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
 	CommandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 	CommandPoolCreateInfo.queueFamilyIndex = FamilyIndex;
-	VkCommandPool CommandPool = 0;
-	vkCreateCommandPool(Device, &CommandPoolCreateInfo, 0, &CommandPool);
-	assert(CommandPool);
+	VkCommandPool UploadCommandPool = 0;
+	vkCreateCommandPool(Device, &CommandPoolCreateInfo, 0, &UploadCommandPool);
+	assert(UploadCommandPool);
 
 	VkCommandBufferAllocateInfo CommandBufferAllocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
 	CommandBufferAllocateInfo.commandBufferCount = 1;
-	CommandBufferAllocateInfo.commandPool = CommandPool;
+	CommandBufferAllocateInfo.commandPool = UploadCommandPool;
 	CommandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	VkCommandBuffer CommandBuffer = 0;
-	vkAllocateCommandBuffers(Device, &CommandBufferAllocateInfo, &CommandBuffer);
+	VkCommandBuffer UploadCommandBuffer = 0;
+	vkAllocateCommandBuffers(Device, &CommandBufferAllocateInfo, &UploadCommandBuffer);
 
-	VkQueryPool TimestampsQueryPool = CreateQueryPool(Device, VK_QUERY_TYPE_TIMESTAMP, 128);
-	assert(TimestampsQueryPool);
+	u32 FramesInFlight = 2;
+	const char* FramesArgument = strstr(GetCommandLineA(), "-frames ");
+	if(FramesArgument)
+	{
+		FramesInFlight = max(1u, min(u32(atoi(FramesArgument + strlen("-frames "))), u32(MAX_FRAMES_IN_FLIGHT)));
+	}
 
-	VkQueryPool PipelineQueryPool = CreateQueryPool(Device, VK_QUERY_TYPE_PIPELINE_STATISTICS, 1);
-	assert(PipelineQueryPool);
+	// NOTE: fences start signaled, so the first wait on every frame returns right away
+	frame Frames[MAX_FRAMES_IN_FLIGHT] = {};
+	for(u32 FrameIndex = 0;
+		FrameIndex < FramesInFlight;
+		++FrameIndex)
+	{
+		frame& Frame = Frames[FrameIndex];
 
-	VkPhysicalDeviceMemoryProperties MemoryProperties;
-	vkGetPhysicalDeviceMemoryProperties(PhysicalDevice, &MemoryProperties);
+		vkCreateCommandPool(Device, &CommandPoolCreateInfo, 0, &Frame.CommandPool);
+		assert(Frame.CommandPool);
+
+		CommandBufferAllocateInfo.commandPool = Frame.CommandPool;
+		vkAllocateCommandBuffers(Device, &CommandBufferAllocateInfo, &Frame.CommandBuffer);
+
+		Frame.Fence = CreateFence(Device, VK_FENCE_CREATE_SIGNALED_BIT);
+		assert(Frame.Fence);
+		Frame.AcquireSemaphore = CreateSemaphore(Device);
+		assert(Frame.AcquireSemaphore);
+
+		Frame.TimestampsQueryPool = CreateQueryPool(Device, VK_QUERY_TYPE_TIMESTAMP, 128);
+		assert(Frame.TimestampsQueryPool);
+
+		Frame.PipelineQueryPool = CreateQueryPool(Device, VK_QUERY_TYPE_PIPELINE_STATISTICS, 1);
+		assert(Frame.PipelineQueryPool);
+	}
+
+	gpu_memory GpuMemory = {};
+	vkGetPhysicalDeviceMemoryProperties(PhysicalDevice, &GpuMemory.Properties);
 
 	buffer ScratchBuffer = {};
-	CreateBuffer(ScratchBuffer, Device, MemoryProperties, 128 * 1024 * 1024, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CreateBuffer(ScratchBuffer, Device, GpuMemory, 128 * 1024 * 1024, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	buffer VertexBuffer = {}, IndexBuffer = {}, MeshBuffer = {}, MeshletBuffer = {}, MeshletDataBuffer = {}, DrawSphereBuffer = {}, DrawTransformBuffer = {}, PackedTransformBuffer = {}, DrawCommandBuffer = {};
+
+	CreateBuffer(VertexBuffer, Device, GpuMemory, sizeof(vertex) * Geometries.Vertices.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CopyBuffer(ScratchBuffer, VertexBuffer, Geometries.Vertices.data(), sizeof(vertex) * Geometries.Vertices.size(), Device, UploadCommandPool, UploadCommandBuffer, Queue);
+
+	CreateBuffer(IndexBuffer, Device, GpuMemory, sizeof(u32) * Geometries.Indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CopyBuffer(ScratchBuffer, IndexBuffer, Geometries.Indices.data(), sizeof(u32) * Geometries.Indices.size(), Device, UploadCommandPool, UploadCommandBuffer, Queue);
+
+	CreateBuffer(MeshBuffer, Device, GpuMemory, sizeof(mesh) * Geometries.Meshes.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CopyBuffer(ScratchBuffer, MeshBuffer, Geometries.Meshes.data(), sizeof(mesh) * Geometries.Meshes.size(), Device, UploadCommandPool, UploadCommandBuffer, Queue);
+
+	if(IsRtxSupported)
+	{
+		CreateBuffer(MeshletBuffer, Device, GpuMemory, sizeof(meshlet) * Geometries.Meshlets.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		CopyBuffer(ScratchBuffer, MeshletBuffer, Geometries.Meshlets.data(), sizeof(meshlet) * Geometries.Meshlets.size(), Device, UploadCommandPool, UploadCommandBuffer, Queue);
+	}
+
+	VkSampler DepthSampler = CreateSampler(Device, VK_SAMPLER_REDUCTION_MODE_MIN_EXT);
+	assert(DepthSampler);
+
+	buffer DrawCommandCountBuffer = {};
+	CreateBuffer(DrawCommandCountBuffer, Device, GpuMemory, 4, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	bool IsVisibilityBufferCleared = false;
+
+	// NOTE: groups of the single pass downsampler that finished their tile; the last one resets it
+	buffer DepthPyramidCounterBuffer = {};
+	CreateBuffer(DepthPyramidCounterBuffer, Device, GpuMemory, 4, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	VkFramebuffer TargetFramebuffer = 0;
+	image ColorTarget = {}, DepthTarget = {}, DepthPyramid = {};
+
+	// NOTE: the targets are cleared every frame, the pyramid is read by the next one
+	render_graph RenderGraph = {};
+	u32 ColorTargetImage  = AddRenderGraphImage(RenderGraph, "color target", VK_IMAGE_ASPECT_COLOR_BIT, true);
+	u32 DepthTargetImage  = AddRenderGraphImage(RenderGraph, "depth target", VK_IMAGE_ASPECT_DEPTH_BIT, true);
+	u32 DepthPyramidImage = AddRenderGraphImage(RenderGraph, "depth pyramid", VK_IMAGE_ASPECT_COLOR_BIT, false);
+	u32 SwapchainImage    = AddRenderGraphImage(RenderGraph, "swapchain image", VK_IMAGE_ASPECT_COLOR_BIT, false);
+
+	double CpuAvgTime = 0;
+	double GpuAvgTime = 0;
+	double PyramidAvgTime = 0;
+	double SoftwareOcclusionAvgTime = 0;
+
+	worker_pool WorkerPool = {};
+	CreateWorkerPool(WorkerPool);
+
+#if VK_DEBUG
+	ValidateOcclusionTest(1 << 16);
+	ValidateSoftwareOcclusion(WorkerPool, 1 << 14);
+	ValidateDrawClusters(WorkerPool, 1 << 16);
+	ValidateTransformPacking(1 << 16);
+	ValidateChunkBorders(Geometries, 128);
+	ValidateRenderGraphBarriers();
+#endif
+
+	srand(512);
+	
+	u64 TriangleCount = 0;
+	u64 FragmentCount = 0;
+	u32 InstanceCount = 1;
+	if(strstr(GetCommandLineA(), "-stress"))
+	{
+		InstanceCount = STRESS_INSTANCE_COUNT;
+	}
+	InstanceCount = (InstanceCount + 31) & ~31;
+
+	std::vector<mesh_offset> DrawOffsets;
+	DrawOffsets.reserve(InstanceCount);
+
+	// NOTE: the scene grows with the instance count so that the density of it stays the same
+	float SceneScale   = max(cbrtf(InstanceCount / 32.0f), 1.0f);
+	float SceneRadius  = 5 * SceneScale;
+	float DrawDistance = 5 * SceneScale;
+	for(u32 InstanceIndex = 0;
+		InstanceIndex < InstanceCount;
+		++InstanceIndex)
+	{
+		const mesh_group& Group = Geometries.MeshGroups[rand() % Geometries.MeshGroups.size()];
+
+		mesh_offset Instance = {};
+		Instance.Pos[0] =  float(rand()) / RAND_MAX * SceneRadius * 2 - SceneRadius;
+		Instance.Pos[1] =  float(rand()) / RAND_MAX * SceneRadius * 2 - SceneRadius;
+		Instance.Pos[2] =  float(rand()) / RAND_MAX * SceneRadius * 2 - SceneRadius;
+		Instance.Scale  = (float(rand()) / RAND_MAX) + 1;
+		Instance.Scale *= 2.0f;
+
+		glm::vec3 Axis{(float(rand()) / RAND_MAX) * 2 - 1, (float(rand()) / RAND_MAX) * 2 - 1, (float(rand()) / RAND_MAX) * 2 - 1};
+		float Angle = glm::radians((float(rand()) / RAND_MAX) * 90.0f);
+
+		Instance.Orient = glm::rotate(glm::quat(1, 0, 0, 0), Angle, Axis);
+
+		// NOTE: every mesh of a chunked group is its own draw, so chunks are culled and lod selected separately
+		for(u32 MeshIndex = Group.MeshOffset;
+			MeshIndex < Group.MeshOffset + Group.MeshCount;
+			++MeshIndex)
+		{
+			const mesh& Mesh = Geometries.Meshes[MeshIndex];
+
+			Instance.Center       = Mesh.Center;
+			Instance.Radius       = Mesh.Radius;
+			Instance.VertexOffset = Mesh.VertexOffset;
+			Instance.MeshIndex    = MeshIndex;
+
+			DrawOffsets.push_back(Instance);
+		}
+	}
+
+	// NOTE: draws are reordered by their cluster, so this has to happen before anything keeps draw indices
+	std::vector<draw_cluster> DrawClusters;
+	BuildDrawClusters(DrawClusters, WorkerPool, DrawOffsets);
+
+	u32 DrawCount = u32(DrawOffsets.size());
+	u32 ClusterCount = u32(DrawClusters.size());
+
+	// NOTE: clustered culling launches one group of draw_cull.comp per visible cluster. There is no limit on
+	// the cluster count from the dispatch, the groups are laid out in rows, see DispatchGroupRows
+	assert(DrawCullCommandComputeShader.LocalSizeX == DRAW_CLUSTER_SIZE);
+	assert(GetGroupCount(DrawCount, DrawCullCommandComputeShader.LocalSizeX) <= DISPATCH_ROW_GROUPS * Props.limits.maxComputeWorkGroupCount[1]);
+
+	// NOTE: the largest per draw streams have to be addressable from one descriptor
+	assert(sizeof(draw_transform) * DrawCount <= Props.limits.maxStorageBufferRange);
+	assert(sizeof(VkDrawIndexedIndirectCommand) * DrawCount <= Props.limits.maxStorageBufferRange);
+
+	// NOTE: built after the clusters reordered the draws, culling reads DrawSphereBuffer for every draw
+	// and DrawTransformBuffer only for the visible ones, rendering reads just the transforms.
+	// Both encodings of the transforms are uploaded so they can be switched at runtime
+	std::vector<draw_sphere> DrawSpheres;
+	std::vector<draw_transform> DrawTransforms;
+	std::vector<packed_transform> PackedTransforms;
+	u32 UnpackableTransformCount = BuildDrawStreams(DrawSpheres, DrawTransforms, PackedTransforms, WorkerPool, DrawOffsets);
+	IsTransformPackingSupported = UnpackableTransformCount == 0;
+	if(!IsTransformPackingSupported)
+	{
+		printf("%u of %u draws are outside of the packed transform cells, packed transforms are disabled\n", UnpackableTransformCount, DrawCount);
+	}
+
+	CreateBuffer(DrawSphereBuffer, Device, GpuMemory, sizeof(draw_sphere) * DrawCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CopyBuffer(ScratchBuffer, DrawSphereBuffer, DrawSpheres.data(), sizeof(draw_sphere) * DrawCount, Device, UploadCommandPool, UploadCommandBuffer, Queue);
 
-	buffer VertexBuffer = {}, IndexBuffer = {}, MeshBuffer = {}, MeshletBuffer = {}, MeshletDataBuffer = {}, DrawBuffer = {}, DrawVisibilityBuffer = {}, DrawCommandBuffer = {};
+	CreateBuffer(DrawTransformBuffer, Device, GpuMemory, sizeof(draw_transform) * DrawCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CopyBuffer(ScratchBuffer, DrawTransformBuffer, DrawTransforms.data(), sizeof(draw_transform) * DrawCount, Device, UploadCommandPool, UploadCommandBuffer, Queue);
+
+	CreateBuffer(PackedTransformBuffer, Device, GpuMemory, sizeof(packed_transform) * DrawCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CopyBuffer(ScratchBuffer, PackedTransformBuffer, PackedTransforms.data(), sizeof(packed_transform) * DrawCount, Device, UploadCommandPool, UploadCommandBuffer, Queue);
+
+	// NOTE: visibility is kept as bits, one per draw and one per meshlet of a draw. Lods of a mesh share
+	// the meshlet bits of its draws, so a draw gets as many as its lod with the most meshlet groups has.
+	// Draws start on a word, the offsets are in words so they don't overflow with large scenes
+	u32 DrawVisibilityWordCount = (DrawCount + 31) / 32;
+
+	std::vector<u32> MeshletVisibilityOffsets(DrawCount);
+	u32 MeshletVisibilityWordCount = 0;
+	for(u32 DrawIndex = 0;
+		DrawIndex < DrawCount;
+		++DrawIndex)
+	{
+		const mesh& Mesh = Geometries.Meshes[DrawOffsets[DrawIndex].MeshIndex];
+
+		u32 MaxMeshletCount = 0;
+		for(u32 LodIndex = 0;
+			LodIndex < Mesh.LodCount;
+			++LodIndex)
+		{
+			MaxMeshletCount = max(MaxMeshletCount, (Mesh.Lods[LodIndex].MeshletCount + 31) & ~31u);
+		}
+
+		MeshletVisibilityOffsets[DrawIndex] = MeshletVisibilityWordCount;
+		MeshletVisibilityWordCount += MaxMeshletCount / 32;
+	}
+	MeshletVisibilityWordCount = max(MeshletVisibilityWordCount, 1u);
+
+	buffer DrawVisibilityBuffer = {}, MeshletVisibilityBuffer = {}, MeshletVisibilityOffsetBuffer = {};
+	CreateBuffer(DrawVisibilityBuffer, Device, GpuMemory, sizeof(u32) * DrawVisibilityWordCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CreateBuffer(MeshletVisibilityBuffer, Device, GpuMemory, sizeof(u32) * MeshletVisibilityWordCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CreateBuffer(MeshletVisibilityOffsetBuffer, Device, GpuMemory, sizeof(u32) * DrawCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CopyBuffer(ScratchBuffer, MeshletVisibilityOffsetBuffer, MeshletVisibilityOffsets.data(), sizeof(u32) * DrawCount, Device, UploadCommandPool, UploadCommandBuffer, Queue);
+
+	printf("Visibility: %llu bytes for %u draws, %llu bytes for meshlets\n", 
+		   u64(sizeof(u32)) * DrawVisibilityWordCount, DrawCount, u64(sizeof(u32)) * MeshletVisibilityWordCount);
+
+	// NOTE: culling writes the tightly packed commands of the active path, the indexed ones are the larger.
+	// Instanced commands never outnumber the draws, so both paths fit into one command per draw
+	buffer DrawIdBuffer = {};
+	CreateBuffer(DrawCommandBuffer, Device, GpuMemory, sizeof(VkDrawIndexedIndirectCommand) * DrawCount, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CreateBuffer(DrawIdBuffer, Device, GpuMemory, sizeof(u32) * DrawCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	// NOTE: front to back copies of the two streams above, see draw_sort.comp
+	buffer SortedDrawCommandBuffer = {}, SortedDrawIdBuffer = {}, SortOffsetBuffer = {};
+	CreateBuffer(SortedDrawCommandBuffer, Device, GpuMemory, sizeof(VkDrawIndexedIndirectCommand) * DrawCount, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CreateBuffer(SortedDrawIdBuffer, Device, GpuMemory, sizeof(u32) * DrawCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CreateBuffer(SortOffsetBuffer, Device, GpuMemory, sizeof(u32) * DRAW_SORT_KEY_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	// NOTE: every mesh reserves room for all of its instances in each lod it has, so culling can
+	// append to a bucket without knowing how the instances split between lods. Culling clamps the
+	// lod to the mesh's count, the buckets past it stay empty and get no room
+	std::vector<u32> MeshInstanceCounts(Geometries.Meshes.size());
+	for(const mesh_offset& Draw : DrawOffsets)
+	{
+		MeshInstanceCounts[Draw.MeshIndex]++;
+	}
+
+	std::vector<draw_bucket> DrawBuckets(Geometries.Meshes.size() * MAX_LODS);
+	u32 BucketInstanceOffset = 0;
+	for(u32 MeshIndex = 0;
+		MeshIndex < Geometries.Meshes.size();
+		++MeshIndex)
+	{
+		for(u32 LodIndex = 0;
+			LodIndex < MAX_LODS;
+			++LodIndex)
+		{
+			DrawBuckets[MeshIndex * MAX_LODS + LodIndex].InstanceOffset = BucketInstanceOffset;
+			if(LodIndex < Geometries.Meshes[MeshIndex].LodCount)
+			{
+				BucketInstanceOffset += MeshInstanceCounts[MeshIndex];
+			}
+		}
+	}
+	printf("Instance buckets: %u slots for %u draws\n", BucketInstanceOffset, DrawCount);
+
+	buffer DrawBucketBuffer = {}, InstanceIdBuffer = {};
+	CreateBuffer(DrawBucketBuffer, Device, GpuMemory, sizeof(draw_bucket) * DrawBuckets.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CopyBuffer(ScratchBuffer, DrawBucketBuffer, DrawBuckets.data(), sizeof(draw_bucket) * DrawBuckets.size(), Device, UploadCommandPool, UploadCommandBuffer, Queue);
+
+	CreateBuffer(InstanceIdBuffer, Device, GpuMemory, sizeof(u32) * max(BucketInstanceOffset, DrawCount), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	// NOTE: draws dropped by contribution culling, counted per mesh and lod like the buckets above
+	buffer ContributionCulledBuffer = {};
+	CreateBuffer(ContributionCulledBuffer, Device, GpuMemory, sizeof(u32) * DrawBuckets.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	for(u32 FrameIndex = 0;
+		FrameIndex < FramesInFlight;
+		++FrameIndex)
+	{
+		CreateBuffer(Frames[FrameIndex].ContributionReadbackBuffer, Device, GpuMemory, sizeof(u32) * DrawBuckets.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	}
+	u32 ContributionCulledDraws = 0;
+	u64 ContributionCulledTriangles = 0;
+
+	// NOTE: anything that moves instances has to refit their clusters and upload them again, see RefitDrawClusters
+	buffer ClusterBuffer = {}, ClusterVisibilityBuffer = {}, ClusterListBuffer = {}, ClusterDispatchBuffer = {};
+	CreateBuffer(ClusterBuffer, Device, GpuMemory, sizeof(draw_cluster) * ClusterCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CopyBuffer(ScratchBuffer, ClusterBuffer, DrawClusters.data(), sizeof(draw_cluster) * ClusterCount, Device, UploadCommandPool, UploadCommandBuffer, Queue);
+
+	CreateBuffer(ClusterVisibilityBuffer, Device, GpuMemory, sizeof(u32) * ClusterCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CreateBuffer(ClusterListBuffer, Device, GpuMemory, sizeof(u32) * ClusterCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CreateBuffer(ClusterDispatchBuffer, Device, GpuMemory, sizeof(cluster_dispatch), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	// NOTE: cluster culling appends to the list and grows the rows of the dispatch to cover it
+	cluster_dispatch EmptyClusterDispatch = {{0, 1, 1}, 0};
+
+	buffer LateListBuffer = {}, LateDispatchBuffer = {};
+	CreateBuffer(LateListBuffer, Device, GpuMemory, sizeof(u32) * DrawCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CreateBuffer(LateDispatchBuffer, Device, GpuMemory, sizeof(late_dispatch), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	late_dispatch EmptyLateDispatch = {{0, 1, 1}, 0};
+
+	// NOTE: every view of the multi-view cull has room for all draws in the command and instance id streams.
+	// The benchmark only takes the first draws of large scenes, all views of them have to fit into one buffer.
+	// Those three streams are created when the benchmark is requested and freed once its results are read back
+	u32 ViewCullDrawCount = min(DrawCount, u32(4 * 1024 * 1024));
+	buffer CullViewBuffer = {}, ViewCommandBuffer = {}, ViewInstanceIdBuffer = {}, ViewDrawIdBuffer = {}, ViewDrawCountBuffer = {}, ViewCountReadbackBuffer = {};
+	CreateBuffer(CullViewBuffer, Device, GpuMemory, sizeof(draw_cull_view) * MAX_CULL_VIEWS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CreateBuffer(ViewDrawCountBuffer, Device, GpuMemory, sizeof(u32) * MAX_CULL_VIEWS, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	// NOTE: the benchmark doubles the view count up to MAX_CULL_VIEWS, every step reads back the counts of
+	// the batched dispatch and of the dispatches per view
+	u32 ViewCullStepCount = 0;
+	for(u32 ViewCount = 1;
+		ViewCount <= MAX_CULL_VIEWS;
+		ViewCount *= 2)
+	{
+		ViewCullStepCount++;
+	}
+	CreateBuffer(ViewCountReadbackBuffer, Device, GpuMemory, sizeof(u32) * MAX_CULL_VIEWS * 2 * ViewCullStepCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	// NOTE: cpu occlusion culling overwrites the visibility of last frame before the early pass, see software_occlusion.h
+	software_occlusion SoftwareOcclusion = {};
+	SelectOccluders(SoftwareOcclusion, Geometries, DrawOffsets, SOFTWARE_OCCLUDER_COUNT);
+
+	for(u32 FrameIndex = 0;
+		FrameIndex < FramesInFlight;
+		++FrameIndex)
+	{
+		CreateBuffer(Frames[FrameIndex].SoftwareVisibilityBuffer, Device, GpuMemory, sizeof(u32) * DrawVisibilityWordCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	}
+
+	// NOTE: cpu culling runs on the same draws for validation of the gpu result and for benchmarks, see cpu_cull.h
+	draw_soa CpuCullDraws = {};
+	BuildDrawSoA(CpuCullDraws, WorkerPool, DrawOffsets);
+	cpu_cull_result CpuCullResult = {};
+
+	buffer CullReadbackBuffer = {};
+	// NOTE: the count, then the indexed commands, their draw ids and the instance ids they point to
+	VkDeviceSize CullReadbackCommandOffset = 16;
+	VkDeviceSize CullReadbackDrawIdOffset = CullReadbackCommandOffset + sizeof(VkDrawIndexedIndirectCommand) * DrawCount;
+	VkDeviceSize CullReadbackInstanceIdOffset = CullReadbackDrawIdOffset + sizeof(u32) * DrawCount;
+	CreateBuffer(CullReadbackBuffer, Device, GpuMemory, CullReadbackInstanceIdOffset + sizeof(u32) * DrawCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	std::vector<mesh_draw_command> GpuCullCommands;
+
+	VkPipelineStageFlags DrawReadStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | (IsRtxSupported ? VK_PIPELINE_STAGE_TASK_SHADER_BIT_NV : 0);
+
+	VkImageView DepthPyramidMips[16] = {};
+	u32 DepthPyramidLevels = 0;
+
+	float ZNear = 1.f;
+	u32 DepthPyramidWidth  = 0;
+	u32 DepthPyramidHeight = 0;
+	draw_cull_data DrawCullData = {};
+
+	u32 SortBenchmarkFrame = 0;
+	bool IsSortBenchmarkDepthSortEnabled = false;
+	bool IsSortBenchmarkInstancingEnabled = false;
+	double SortBenchmarkGpuTime[2] = {};
+	u64 SortBenchmarkFragmentCount[2] = {};
+	u32 SortBenchmarkSampleCount = 0;
+
+	bool IsDebugReadbackBusy = false;
+
+	u32 ImageIndex = 0;
+	u32 FrameIndex = 0;
+	while(IsRunning)
+	{
+		DispatchMessages();
+
+		// NOTE: the slot of this frame was last recorded FramesInFlight frames ago, its results are read
+		// here before anything of it is reused
+		frame& Frame = Frames[FrameIndex];
+		VK_CHECK(vkWaitForFences(Device, 1, &Frame.Fence, VK_TRUE, ~0ull));
+
+		VkCommandBuffer CommandBuffer = Frame.CommandBuffer;
+		VkQueryPool TimestampsQueryPool = Frame.TimestampsQueryPool;
+		VkQueryPool PipelineQueryPool = Frame.PipelineQueryPool;
+		buffer& SoftwareVisibilityBuffer = Frame.SoftwareVisibilityBuffer;
+		buffer& ContributionReadbackBuffer = Frame.ContributionReadbackBuffer;
+
+		if(Frame.IsSubmitted)
+		{
+			if(Frame.IsCullValidationFrame)
+			{
+				CullDrawsCpu(CpuCullResult, WorkerPool, CpuCullDraws, Geometries.Meshes, Frame.DrawCullData, DrawCullFlag_Cull | DrawCullFlag_Lod);
 
-	CreateBuffer(VertexBuffer, Device, MemoryProperties, 128 * 1024 * 1024, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	CopyBuffer(ScratchBuffer, VertexBuffer, Geometries.Vertices.data(), sizeof(vertex) * Geometries.Vertices.size(), Device, CommandPool, CommandBuffer, Queue);
+				const u8* Readback = (const u8*)CullReadbackBuffer.Data;
+				u32 GpuCommandCount = min(*(const u32*)Readback, DrawCount);
+				UnpackDrawCommands(GpuCullCommands, CpuCullDraws, Geometries.Meshes, (const VkDrawIndexedIndirectCommand*)(Readback + CullReadbackCommandOffset), 
+								   (const u32*)(Readback + CullReadbackDrawIdOffset), (const u32*)(Readback + CullReadbackInstanceIdOffset), GpuCommandCount);
 
-	CreateBuffer(IndexBuffer, Device, MemoryProperties, 128 * 1024 * 1024, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	CopyBuffer(ScratchBuffer, IndexBuffer, Geometries.Indices.data(), sizeof(u32) * Geometries.Indices.size(), Device, CommandPool, CommandBuffer, Queue);
+				u32 AmbiguousCount = 0;
+				u32 MismatchCount = CompareCullResults(CpuCullDraws, Geometries.Meshes, Frame.DrawCullData, CpuCullResult.Commands.data(), CpuCullResult.CommandCount, GpuCullCommands.data(), GpuCommandCount, &AmbiguousCount);
+				printf("Cull validation: %u gpu commands, %u cpu commands, %u mismatches, %u on frustum or lod boundaries\n", 
+					   GpuCommandCount, CpuCullResult.CommandCount, MismatchCount, AmbiguousCount);
+			}
 
-	CreateBuffer(MeshBuffer, Device, MemoryProperties, 128 * 1024 * 1024, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	CopyBuffer(ScratchBuffer, MeshBuffer, Geometries.Meshes.data(), sizeof(mesh) * Geometries.Meshes.size(), Device, CommandPool, CommandBuffer, Queue);
+			if(Frame.IsViewCullBenchmarkFrame)
+			{
+				u64 ViewTimeResults[4 * 4] = {};
+				assert(ViewCullStepCount * 4 <= ArraySize(ViewTimeResults));
+				vkGetQueryPoolResults(Device, TimestampsQueryPool, 4, ViewCullStepCount * 4, sizeof(ViewTimeResults), ViewTimeResults, sizeof(ViewTimeResults[0]), VK_QUERY_RESULT_64_BIT);
 
-	if(IsRtxSupported)
-	{
-		CreateBuffer(MeshletBuffer, Device, MemoryProperties, 128 * 1024 * 1024, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		CopyBuffer(ScratchBuffer, MeshletBuffer, Geometries.Meshlets.data(), sizeof(meshlet) * Geometries.Meshlets.size(), Device, CommandPool, CommandBuffer, Queue);
-	}
+				const u32* ViewCounts = (const u32*)ViewCountReadbackBuffer.Data;
+				printf("Multi-view culling benchmark, %u of %u draws\n", ViewCullDrawCount, DrawCount);
 
-	VkSampler DepthSampler = CreateSampler(Device, VK_SAMPLER_REDUCTION_MODE_MIN_EXT);
-	assert(DepthSampler);
+				u32 StepIndex = 0;
+				for(u32 ViewCount = 1;
+					ViewCount <= MAX_CULL_VIEWS;
+					ViewCount *= 2, ++StepIndex)
+				{
+					double SeparateTime = double(ViewTimeResults[StepIndex * 4 + 1] - ViewTimeResults[StepIndex * 4 + 0]) * Props.limits.timestampPeriod * 1.e-6;
+					double BatchedTime  = double(ViewTimeResults[StepIndex * 4 + 3] - ViewTimeResults[StepIndex * 4 + 2]) * Props.limits.timestampPeriod * 1.e-6;
+
+					// NOTE: both ways have to find the same draws in every view
+					const u32* SeparateCounts = ViewCounts + MAX_CULL_VIEWS * (StepIndex * 2 + 0);
+					const u32* BatchedCounts  = ViewCounts + MAX_CULL_VIEWS * (StepIndex * 2 + 1);
+					u32 VisibleCount = 0;
+					u32 MismatchCount = 0;
+					for(u32 ViewIndex = 0;
+						ViewIndex < ViewCount;
+						++ViewIndex)
+					{
+						VisibleCount += BatchedCounts[ViewIndex];
+						MismatchCount += (BatchedCounts[ViewIndex] != SeparateCounts[ViewIndex]);
+					}
 
-	buffer DrawCommandCountBuffer = {};
-	CreateBuffer(DrawCommandCountBuffer, Device, MemoryProperties, 4, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+					printf("%u views, %8u commands: batched %8.3f ms (%8.3f ms per view, %8.1f M draw-views/s), per view %8.3f ms (%8.3f ms per view); %u count mismatches\n", 
+						   ViewCount, VisibleCount, BatchedTime, BatchedTime / ViewCount, double(ViewCullDrawCount) * ViewCount / max(BatchedTime, 1.e-6) * 1.e-3,
+						   SeparateTime, SeparateTime / ViewCount, MismatchCount);
+					assert(MismatchCount == 0);
+				}
 
-	CreateBuffer(DrawVisibilityBuffer, Device, MemoryProperties, 128 * 1024 * 1024, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	bool IsVisibilityBufferCleared = false;
+				DestroyBuffer(ViewCommandBuffer, Device, GpuMemory);
+				DestroyBuffer(ViewInstanceIdBuffer, Device, GpuMemory);
+				DestroyBuffer(ViewDrawIdBuffer, Device, GpuMemory);
+			}
 
-	VkFramebuffer TargetFramebuffer = 0;
-	image ColorTarget = {}, DepthTarget = {}, DepthPyramid = {};
+			u64 TimeResults[4] = {};
+			vkGetQueryPoolResults(Device, TimestampsQueryPool, 0, ArraySize(TimeResults), sizeof(TimeResults), TimeResults, sizeof(TimeResults[0]), VK_QUERY_RESULT_64_BIT);
 
-	double CpuAvgTime = 0;
-	double GpuAvgTime = 0;
+			// NOTE: clipping and fragment shader invocations, in the order of their bits
+			u64 PipelineResults[2] = {};
+			vkGetQueryPoolResults(Device, PipelineQueryPool, 0, 1, sizeof(PipelineResults), PipelineResults, sizeof(PipelineResults), VK_QUERY_RESULT_64_BIT);
 
-	srand(512);
-	
-	u64 TriangleCount = 0;
-	u32 DrawCount = 1;
-	DrawCount = (DrawCount + 31) & ~31;
+			TriangleCount = PipelineResults[0];
+			FragmentCount = PipelineResults[1];
 
-	std::vector<mesh_offset> DrawOffsets(DrawCount);
+			// NOTE: the triangles of the lod each dropped draw would have been drawn with
+			const u32* ContributionCounts = (const u32*)ContributionReadbackBuffer.Data;
+			ContributionCulledDraws = 0;
+			ContributionCulledTriangles = 0;
+			for(u32 BucketIndex = 0;
+				BucketIndex < DrawBuckets.size();
+				++BucketIndex)
+			{
+				const mesh_lod& Lod = Geometries.Meshes[BucketIndex / MAX_LODS].Lods[BucketIndex % MAX_LODS];
+				ContributionCulledDraws += ContributionCounts[BucketIndex];
+				ContributionCulledTriangles += u64(ContributionCounts[BucketIndex]) * (Lod.IndexCount / 3);
+			}
 
-	float SceneRadius  = 5;
-	float DrawDistance = 5;
-	for(u32 DrawIndex = 0;
-		DrawIndex < DrawCount;
-		++DrawIndex)
-	{
-		u32 MeshIndex = rand() % Geometries.Meshes.size();
-		const mesh& Mesh = Geometries.Meshes[MeshIndex];
+			GpuAvgTime = GpuAvgTime * 0.75f + ((float)(TimeResults[1] - TimeResults[0]) * (float)Props.limits.timestampPeriod * 1.e-6f) * 0.25f;
+			PyramidAvgTime = PyramidAvgTime * 0.75f + ((float)(TimeResults[3] - TimeResults[2]) * (float)Props.limits.timestampPeriod * 1.e-6f) * 0.25f;
 
-		DrawOffsets[DrawIndex].Pos[0] =  float(rand()) / RAND_MAX * SceneRadius * 2 - SceneRadius;
-		DrawOffsets[DrawIndex].Pos[1] =  float(rand()) / RAND_MAX * SceneRadius * 2 - SceneRadius;
-		DrawOffsets[DrawIndex].Pos[2] =  float(rand()) / RAND_MAX * SceneRadius * 2 - SceneRadius;
-		DrawOffsets[DrawIndex].Scale  = (float(rand()) / RAND_MAX) + 1;
-		DrawOffsets[DrawIndex].Scale *= 2.0f;
+			if(Frame.SortBenchmarkHalf)
+			{
+				u32 Half = Frame.SortBenchmarkHalf - 1;
+				SortBenchmarkGpuTime[Half] += double(TimeResults[1] - TimeResults[0]) * double(Props.limits.timestampPeriod) * 1.e-6;
+				SortBenchmarkFragmentCount[Half] += FragmentCount;
 
-		glm::vec3 Axis{(float(rand()) / RAND_MAX) * 2 - 1, (float(rand()) / RAND_MAX) * 2 - 1, (float(rand()) / RAND_MAX) * 2 - 1};
-		float Angle = glm::radians((float(rand()) / RAND_MAX) * 90.0f);
+				if(++SortBenchmarkSampleCount == 2 * SORT_BENCHMARK_FRAMES)
+				{
+					printf("Draw sort over %u frames of %u draws:\n", SORT_BENCHMARK_FRAMES, DrawCount);
+					printf("  unsorted: gpu %.3f ms, %llu fragment invocations\n", SortBenchmarkGpuTime[0] / SORT_BENCHMARK_FRAMES, SortBenchmarkFragmentCount[0] / SORT_BENCHMARK_FRAMES);
+					printf("  sorted:   gpu %.3f ms, %llu fragment invocations\n", SortBenchmarkGpuTime[1] / SORT_BENCHMARK_FRAMES, SortBenchmarkFragmentCount[1] / SORT_BENCHMARK_FRAMES);
+					SortBenchmarkSampleCount = 0;
+				}
+			}
 
-		DrawOffsets[DrawIndex].Orient = glm::rotate(glm::quat(1, 0, 0, 0), Angle, Axis);
+			if(Frame.IsCullValidationFrame || Frame.IsViewCullBenchmarkFrame)
+			{
+				IsDebugReadbackBusy = false;
+			}
+		}
 
-		DrawOffsets[DrawIndex].VertexOffset = Mesh.VertexOffset;
-		DrawOffsets[DrawIndex].MeshIndex    = MeshIndex;
-	}
+		if(IsCullBenchmarkRequested)
+		{
+			BenchmarkCpuCulling(WorkerPool, Geometries, GetDrawCullData(GetProjection(70.0f, (float)Swapchain.Height / (float)Swapchain.Width, ZNear), ZNear, 200.0f), 10000000);
+			BenchmarkDrawStreams(WorkerPool, Geometries, GetDrawCullData(GetProjection(70.0f, (float)Swapchain.Height / (float)Swapchain.Width, ZNear), ZNear, 200.0f), 16 * 1024 * 1024);
+			IsCullBenchmarkRequested = false;
+		}
 
-	CreateBuffer(DrawBuffer, Device, MemoryProperties, 128 * 1024 * 1024, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	CopyBuffer(ScratchBuffer, DrawBuffer, DrawOffsets.data(), sizeof(mesh_offset) * DrawOffsets.size(), Device, CommandPool, CommandBuffer, Queue);
+		// NOTE: the sort comparison renders SORT_BENCHMARK_FRAMES frames unsorted and then as many sorted, both
+		// without instancing since only the non instanced stream is sorted. The toggles are restored after it
+		if(IsSortBenchmarkRequested && !SortBenchmarkFrame && !SortBenchmarkSampleCount)
+		{
+			IsSortBenchmarkRequested = false;
+			IsSortBenchmarkDepthSortEnabled = IsDepthSortEnabled;
+			IsSortBenchmarkInstancingEnabled = IsInstancingEnabled;
+			memset(SortBenchmarkGpuTime, 0, sizeof(SortBenchmarkGpuTime));
+			memset(SortBenchmarkFragmentCount, 0, sizeof(SortBenchmarkFragmentCount));
+			SortBenchmarkFrame = 1;
+		}
 
-	CreateBuffer(DrawCommandBuffer, Device, MemoryProperties, 128 * 1024 * 1024, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if(SortBenchmarkFrame)
+		{
+			IsInstancingEnabled = false;
+			IsDepthSortEnabled = SortBenchmarkFrame > SORT_BENCHMARK_FRAMES;
+		}
 
-	VkImageView DepthPyramidMips[16] = {};
-	u32 DepthPyramidLevels = 0;
+		// NOTE: the buffers the validation and the view benchmark read back are large and only used on request,
+		// so they aren't per frame. A request waits until the frame that used them last was read back
+		bool IsCullValidationFrame = IsCullValidationRequested && !IsDebugReadbackBusy;
+		bool IsViewCullBenchmarkFrame = IsViewCullBenchmarkRequested && !IsDebugReadbackBusy;
+		if(IsCullValidationFrame || IsViewCullBenchmarkFrame)
+		{
+			IsCullValidationRequested = false;
+			IsViewCullBenchmarkRequested = false;
+			IsDebugReadbackBusy = true;
+		}
 
-	float ZNear = 1.f;
-	u32 DepthPyramidWidth  = 0;
-	u32 DepthPyramidHeight = 0;
-	draw_cull_data DrawCullData = {};
-	u32 ImageIndex = 0;
-	while(IsRunning)
-	{
-		DispatchMessages();
 		QueryPerformanceCounter(&BegTime);
-		DrawCullData.CullEnabled = IsCullEnabled;
-		DrawCullData.LodEnabled = IsLodEnabled;
-		DrawCullData.OcclusionEnabled = IsOcclusionEnabled;
+		// NOTE: the early pass never tests occlusion, so it doesn't need variants for it
+		u32 DrawCullFlags = (IsCullEnabled ? DrawCullFlag_Cull : 0) | (IsLodEnabled ? DrawCullFlag_Lod : 0) | (IsInstancingEnabled ? DrawCullFlag_Instancing : 0) | 
+							(IsClusterCullEnabled ? DrawCullFlag_Clustered : 0) | (IsRtxEnabled ? DrawCullFlag_MeshTasks : 0);
+		u32 DrawCullateFlags = (DrawCullFlags & ~DrawCullFlag_Clustered) | DrawCullFlag_Late | (IsOcclusionEnabled ? DrawCullFlag_Occlusion : 0);
+		VkPipeline DrawCullCmdPipeline = GetDrawCullPipeline(DrawCullCmdPipelines, Device, PipelineCache, DrawCullComputeProgram.Layout, DrawCullCommandComputeShader, DrawCullFlags);
+		VkPipeline DrawCullateCmdPipeline = GetDrawCullPipeline(DrawCullCmdPipelines, Device, PipelineCache, DrawCullComputeProgram.Layout, DrawCullCommandComputeShader, DrawCullateFlags);
+
+		// NOTE: draw_emit.comp only declares the command layout constant
+		VkPipeline DrawEmitCmdPipeline = GetDrawCullPipeline(DrawEmitCmdPipelines, Device, PipelineCache, DrawEmitComputeProgram.Layout, DrawEmitCommandComputeShader, DrawCullFlags & DrawCullFlag_MeshTasks);
+
+		// NOTE: cluster_cull.comp only declares the cull constant
+		VkPipeline ClusterCullCmdPipeline = GetDrawCullPipeline(ClusterCullCmdPipelines, Device, PipelineCache, ClusterCullComputeProgram.Layout, ClusterCullComputeShader, DrawCullFlags & DrawCullFlag_Cull);
+
+		// NOTE: only the non instanced stream is sorted, instanced commands stand for instances all over the scene
+		bool IsDepthSortActive = IsDepthSortEnabled && !IsInstancingEnabled;
+		VkPipeline DrawSortCmdPipeline = GetDrawCullPipeline(DrawSortCmdPipelines, Device, PipelineCache, DrawSortComputeProgram.Layout, DrawSortComputeShader, DrawCullFlags & DrawCullFlag_MeshTasks);
+		buffer& DrawCommandSource = IsDepthSortActive ? SortedDrawCommandBuffer : DrawCommandBuffer;
+		buffer& DrawIdSource = IsDepthSortActive ? SortedDrawIdBuffer : DrawIdBuffer;
+
+		descriptor_template SortDescriptors[] = {{DrawSphereBuffer.Handle}, {DrawCommandCountBuffer.Handle}, {DrawCommandBuffer.Handle}, {DrawCommandBuffer.Handle}, {DrawIdBuffer.Handle}, 
+												 {InstanceIdBuffer.Handle}, {SortOffsetBuffer.Handle}, {SortedDrawCommandBuffer.Handle}, {SortedDrawCommandBuffer.Handle}, {SortedDrawIdBuffer.Handle}};
+		float SortKeyScale = float(DRAW_SORT_KEY_COUNT - 1) / DrawDistance;
+
+		// NOTE: with occlusion the mesh task path keeps visibility per meshlet, see draw_cull.comp
+		u32 ObjectFlags = (IsTransformPackingEnabled ? ObjectFlag_PackedTransforms : 0);
+		u32 RtxFlags = ObjectFlags | (IsCullEnabled ? ObjectFlag_Cull : 0) | (IsOcclusionEnabled ? ObjectFlag_Occlusion : 0);
+
+		VkPipeline RtxPipeline = 0, RtxLatePipeline = 0;
+		if(IsRtxEnabled)
+		{
+			RtxPipeline = GetObjectPipeline(RtxPipelines, Device, PipelineCache, RtxProgram.Layout, RenderPass, {&ObjectTaskShader, &ObjectMeshShader, &ObjectFragmentShader}, RtxFlags);
+			RtxLatePipeline = GetObjectPipeline(RtxPipelines, Device, PipelineCache, RtxProgram.Layout, RenderPass, {&ObjectTaskShader, &ObjectMeshShader, &ObjectFragmentShader}, RtxFlags | ObjectFlag_Late);
+		}
+		VkPipeline MeshPipeline = GetObjectPipeline(MeshPipelines, Device, PipelineCache, MeshProgram.Layout, RenderPass, {&ObjectVertexShader, &ObjectFragmentShader}, ObjectFlags);
 
 		if(ResizeSwapchain(Swapchain, PhysicalDevice, RenderPass, Device, Surface, SurfaceFormat, SurfaceCaps, &FamilyIndex) || !TargetFramebuffer)
 		{
 			if(ColorTarget.Handle)
-				DestroyImage(ColorTarget, Device);
+				DestroyImage(ColorTarget, Device, GpuMemory);
 			if(DepthTarget.Handle)
-				DestroyImage(DepthTarget, Device);
+				DestroyImage(DepthTarget, Device, GpuMemory);
 			if(DepthPyramid.Handle)
 			{
 				for(u32 DepthPyramidIdx = 0;
@@ -859,20 +2366,24 @@ WinMain(HINSTANCE CurrInst,
 				{
 					vkDestroyImageView(Device, DepthPyramidMips[DepthPyramidIdx], 0);
 				}
-				DestroyImage(DepthPyramid, Device);
+				DestroyImage(DepthPyramid, Device, GpuMemory);
 			}
 			if(TargetFramebuffer)
 				vkDestroyFramebuffer(Device, TargetFramebuffer, 0);
 
-			CreateImage(ColorTarget, Device, MemoryProperties, Swapchain.Width, Swapchain.Height, SurfaceFormat.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
-			CreateImage(DepthTarget, Device, MemoryProperties, Swapchain.Width, Swapchain.Height, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+			CreateTransientImage(ColorTarget, RenderGraph, ColorTargetImage, Device, Swapchain.Width, Swapchain.Height, SurfaceFormat.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+			CreateTransientImage(DepthTarget, RenderGraph, DepthTargetImage, Device, Swapchain.Width, Swapchain.Height, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+			BindRenderGraphImages(RenderGraph, Device, GpuMemory);
+			ColorTarget.View = CreateImageView(Device, ColorTarget.Handle, SurfaceFormat.format, 0, 1);
+			DepthTarget.View = CreateImageView(Device, DepthTarget.Handle, VK_FORMAT_D32_SFLOAT, 0, 1);
 
 			DepthPyramidWidth  = GetPreviousPowerOfTwo(Swapchain.Width);
 			DepthPyramidHeight = GetPreviousPowerOfTwo(Swapchain.Height);
 			DepthPyramidLevels = GetImageMipLevels(DepthPyramidWidth, DepthPyramidHeight);
 			GlobalDepthPyramidLevels = DepthPyramidLevels;
 
-			CreateImage(DepthPyramid, Device, MemoryProperties, DepthPyramidWidth, DepthPyramidHeight, VK_FORMAT_R32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, DepthPyramidLevels);
+			CreateImage(DepthPyramid, Device, GpuMemory, DepthPyramidWidth, DepthPyramidHeight, VK_FORMAT_R32_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, DepthPyramidLevels);
+			SetRenderGraphImage(RenderGraph, DepthPyramidImage, DepthPyramid.Handle, DepthPyramidLevels);
 
 			for(u32 DepthPyramidIdx = 0;
 				DepthPyramidIdx < DepthPyramidLevels;
@@ -883,80 +2394,334 @@ WinMain(HINSTANCE CurrInst,
 			}
 
 			TargetFramebuffer = CreateFramebuffer(Device, RenderPass, ColorTarget.View, DepthTarget.View, Swapchain.Width, Swapchain.Height);
+
+			PrintGpuMemoryStats(GpuMemory);
 		}
 
-		VK_CHECK(vkAcquireNextImageKHR(Device, Swapchain.Handle, ~0ull, AcquireSemaphore, VK_NULL_HANDLE, &ImageIndex));
+		VK_CHECK(vkAcquireNextImageKHR(Device, Swapchain.Handle, ~0ull, Frame.AcquireSemaphore, VK_NULL_HANDLE, &ImageIndex));
 
-		VK_CHECK(vkResetCommandPool(Device, CommandPool, 0));
+		VK_CHECK(vkResetCommandPool(Device, Frame.CommandPool, 0));
 
 		VkCommandBufferBeginInfo CommandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
 		CommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 		vkBeginCommandBuffer(CommandBuffer, &CommandBufferBeginInfo);
 
+		// NOTE: the frame before can still be running, everything it wrote has to be done before this one
+		// starts. The gpu runs frames one after the other, only the recording of this one overlaps with it
+		VkMemoryBarrier FrameBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+		FrameBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+		FrameBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &FrameBarrier, 0, 0, 0, 0);
+
+		// NOTE: the copy to the swapchain image is the stage the submit waits for it at
+		BeginRenderGraph(RenderGraph);
+		ImportRenderGraphImage(RenderGraph, SwapchainImage, Swapchain.Images[ImageIndex], VK_PIPELINE_STAGE_TRANSFER_BIT);
+
 		vkCmdResetQueryPool(CommandBuffer, TimestampsQueryPool, 0, 128);
 		vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TimestampsQueryPool, 0);
 
 		if(!IsVisibilityBufferCleared)
 		{
-			vkCmdFillBuffer(CommandBuffer, DrawVisibilityBuffer.Handle, 0, 4 * DrawCount, 1);
+			vkCmdFillBuffer(CommandBuffer, DrawVisibilityBuffer.Handle, 0, 4 * DrawVisibilityWordCount, ~0u);
+			vkCmdFillBuffer(CommandBuffer, MeshletVisibilityBuffer.Handle, 0, 4 * MeshletVisibilityWordCount, ~0u);
+			vkCmdFillBuffer(CommandBuffer, DepthPyramidCounterBuffer.Handle, 0, 4, 0);
+			vkCmdFillBuffer(CommandBuffer, ClusterVisibilityBuffer.Handle, 0, 4 * ClusterCount, 1);
 
-			VkBufferMemoryBarrier ZeroInitBarrier = CreateBufferBarrier(DrawVisibilityBuffer.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
-			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, 1, &ZeroInitBarrier, 0, 0);
+			VkBufferMemoryBarrier ZeroInitBarriers[] = 
+			{
+				CreateBufferBarrier(DrawVisibilityBuffer.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+				CreateBufferBarrier(MeshletVisibilityBuffer.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+				CreateBufferBarrier(DepthPyramidCounterBuffer.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+				CreateBufferBarrier(ClusterVisibilityBuffer.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)
+			};
+			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | DrawReadStages, 0, 0, 0, ArraySize(ZeroInitBarriers), ZeroInitBarriers, 0, 0);
 			IsVisibilityBufferCleared = true;
 		}
 
+		// NOTE: culling and the early pass bind the pyramid the frame before built, a new one is transitioned here
+		UseRenderGraphImage(RenderGraph, DepthPyramidImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | DrawReadStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+		FlushRenderGraph(RenderGraph, CommandBuffer);
+
 		glm::mat4x4 Projection = GetProjection(70.0f, (float)Swapchain.Height / (float)Swapchain.Width, ZNear);
 
-		glm::mat4 ProjectionT = glm::transpose(Projection);
-		DrawCullData.Frustrum[0] = NormalizePlane(ProjectionT[3] + ProjectionT[0]);
-		DrawCullData.Frustrum[1] = NormalizePlane(ProjectionT[3] - ProjectionT[0]);
-		DrawCullData.Frustrum[2] = NormalizePlane(ProjectionT[3] + ProjectionT[1]);
-		DrawCullData.Frustrum[3] = NormalizePlane(ProjectionT[3] - ProjectionT[1]);
-		DrawCullData.Frustrum[4] = NormalizePlane(ProjectionT[3] - ProjectionT[2]);
-		DrawCullData.Frustrum[5] = glm::vec4(0, 0, -1, DrawDistance);
-		DrawCullData.P00 = Projection[0][0];
-		DrawCullData.P11 = Projection[1][1];
-		DrawCullData.znear = ZNear;
+		DrawCullData = GetDrawCullData(Projection, ZNear, DrawDistance);
 		DrawCullData.PyramidWidth  = float(DepthPyramidWidth);
 		DrawCullData.PyramidHeight = float(DepthPyramidHeight);
+		DrawCullData.DrawCount = DrawCount;
+		DrawCullData.ClusterCount = ClusterCount;
+		DrawCullData.ContributionThreshold = ContributionCullPixels / (DrawCullData.P11 * float(Swapchain.Height));
 
 		globals Globals = {};
 		Globals.Projection = Projection;
+		Globals.P00 = DrawCullData.P00;
+		Globals.P11 = DrawCullData.P11;
+		Globals.znear = DrawCullData.znear;
+		Globals.PyramidWidth  = DrawCullData.PyramidWidth;
+		Globals.PyramidHeight = DrawCullData.PyramidHeight;
 
-		// NOTE: this is early culling test. Frustrum culling and fill objects that were visible last frame
+		if(IsSoftwareOcclusionEnabled)
 		{
-			VkBufferMemoryBarrier ZeroInitBarrier = CreateBufferBarrier(DrawCommandCountBuffer.Handle, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
-			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 1, &ZeroInitBarrier, 0, 0);
+			LARGE_INTEGER SoftwareBegTime, SoftwareEndTime;
+			QueryPerformanceCounter(&SoftwareBegTime);
+
+			RasterizeOccluders(SoftwareOcclusion, WorkerPool, Geometries, DrawOffsets, DrawCullData);
+			// NOTE: the test chunks write their packed words straight into the seed buffer
+			TestSoftwareOcclusion(SoftwareOcclusion, WorkerPool, DrawOffsets, DrawCullData, (u32*)SoftwareVisibilityBuffer.Data);
+
+			QueryPerformanceCounter(&SoftwareEndTime);
+			SoftwareOcclusionAvgTime = SoftwareOcclusionAvgTime * 0.75f + ((float)(SoftwareEndTime.QuadPart - SoftwareBegTime.QuadPart) / (float)TimeFreq.QuadPart * 1000.0f) * 0.25f;
+
+			VkBufferMemoryBarrier SeedBarrier = CreateBufferBarrier(DrawVisibilityBuffer.Handle, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 1, &SeedBarrier, 0, 0);
 
+			VkBufferCopy SeedRegion = {0, 0, VkDeviceSize(sizeof(u32) * DrawVisibilityWordCount)};
+			vkCmdCopyBuffer(CommandBuffer, SoftwareVisibilityBuffer.Handle, DrawVisibilityBuffer.Handle, 1, &SeedRegion);
+
+			SeedBarrier = CreateBufferBarrier(DrawVisibilityBuffer.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, 1, &SeedBarrier, 0, 0);
+		}
+
+		// NOTE: golden test of the cpu culling. The early variant emits every draw in the frustum that is
+		// marked visible, so with all of them marked it emits the whole frustum and lod result.
+		// The stream is read back after the frame, the visibility it leaves is the frustum result
+		if(IsCullValidationFrame)
+		{
+			VkBufferMemoryBarrier ValidationBarriers[] = 
+			{
+				CreateBufferBarrier(DrawVisibilityBuffer.Handle, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT),
+				CreateBufferBarrier(DrawCommandCountBuffer.Handle, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT),
+				CreateBufferBarrier(LateDispatchBuffer.Handle, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT),
+			};
+			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, ArraySize(ValidationBarriers), ValidationBarriers, 0, 0);
+
+			// NOTE: the late list it appends to is reset again by the early pass below
+			vkCmdFillBuffer(CommandBuffer, DrawVisibilityBuffer.Handle, 0, 4 * DrawVisibilityWordCount, ~0u);
 			vkCmdFillBuffer(CommandBuffer, DrawCommandCountBuffer.Handle, 0, 4, 0);
+			vkCmdUpdateBuffer(CommandBuffer, LateDispatchBuffer.Handle, 0, sizeof(EmptyLateDispatch), &EmptyLateDispatch);
 
-			ZeroInitBarrier = CreateBufferBarrier(DrawCommandCountBuffer.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
-			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, 1, &ZeroInitBarrier, 0, 0);
+			ValidationBarriers[0] = CreateBufferBarrier(DrawVisibilityBuffer.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+			ValidationBarriers[1] = CreateBufferBarrier(DrawCommandCountBuffer.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+			ValidationBarriers[2] = CreateBufferBarrier(LateDispatchBuffer.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, ArraySize(ValidationBarriers), ValidationBarriers, 0, 0);
+
+			VkPipeline ValidationPipeline = GetDrawCullPipeline(DrawCullCmdPipelines, Device, PipelineCache, DrawCullComputeProgram.Layout, DrawCullCommandComputeShader, 
+																DrawCullFlag_Cull | DrawCullFlag_Lod);
+			vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ValidationPipeline);
+
+			descriptor_template PyramidDesc(DepthSampler, DepthPyramid.View, VK_IMAGE_LAYOUT_GENERAL);
+			descriptor_template ComputeDescriptors[] = {{DrawSphereBuffer.Handle}, {MeshBuffer.Handle}, {DrawCommandBuffer.Handle}, {DrawCommandCountBuffer.Handle}, {DrawVisibilityBuffer.Handle}, PyramidDesc, 
+														{InstanceIdBuffer.Handle}, {DrawBucketBuffer.Handle}, {ClusterBuffer.Handle}, {ClusterListBuffer.Handle}, 
+														{LateListBuffer.Handle}, {LateDispatchBuffer.Handle}, {DrawCommandBuffer.Handle}, {DrawIdBuffer.Handle}, 
+														{DrawTransformBuffer.Handle}, {ContributionCulledBuffer.Handle}, {ClusterDispatchBuffer.Handle}};
+			vkCmdPushDescriptorSetWithTemplateKHR(CommandBuffer, DrawCullComputeProgram.DescriptorTemplate, DrawCullComputeProgram.Layout, 0, ComputeDescriptors);
+
+			vkCmdPushConstants(CommandBuffer, DrawCullComputeProgram.Layout, DrawCullComputeProgram.Stages, 0, sizeof(draw_cull_data), &DrawCullData);
+			DispatchGroupRows(CommandBuffer, GetGroupCount(DrawCount, DrawCullCommandComputeShader.LocalSizeX));
+
+			VkBufferMemoryBarrier ReadbackBarriers[] = 
+			{
+				CreateBufferBarrier(DrawCommandBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT),
+				CreateBufferBarrier(DrawCommandCountBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT),
+				CreateBufferBarrier(DrawIdBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT),
+				CreateBufferBarrier(InstanceIdBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT),
+			};
+			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, ArraySize(ReadbackBarriers), ReadbackBarriers, 0, 0);
+
+			VkBufferCopy CountRegion = {0, 0, 4};
+			VkBufferCopy CommandRegion = {0, CullReadbackCommandOffset, sizeof(VkDrawIndexedIndirectCommand) * DrawCount};
+			VkBufferCopy DrawIdRegion = {0, CullReadbackDrawIdOffset, sizeof(u32) * DrawCount};
+			VkBufferCopy InstanceIdRegion = {0, CullReadbackInstanceIdOffset, sizeof(u32) * DrawCount};
+			vkCmdCopyBuffer(CommandBuffer, DrawCommandCountBuffer.Handle, CullReadbackBuffer.Handle, 1, &CountRegion);
+			vkCmdCopyBuffer(CommandBuffer, DrawCommandBuffer.Handle, CullReadbackBuffer.Handle, 1, &CommandRegion);
+			vkCmdCopyBuffer(CommandBuffer, DrawIdBuffer.Handle, CullReadbackBuffer.Handle, 1, &DrawIdRegion);
+			vkCmdCopyBuffer(CommandBuffer, InstanceIdBuffer.Handle, CullReadbackBuffer.Handle, 1, &InstanceIdRegion);
+
+			ReadbackBarriers[0] = CreateBufferBarrier(DrawCommandBuffer.Handle, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+			ReadbackBarriers[1] = CreateBufferBarrier(DrawCommandCountBuffer.Handle, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+			ReadbackBarriers[2] = CreateBufferBarrier(DrawIdBuffer.Handle, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+			ReadbackBarriers[3] = CreateBufferBarrier(InstanceIdBuffer.Handle, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, ArraySize(ReadbackBarriers), ReadbackBarriers, 0, 0);
+		}
+
+		// NOTE: multi-view culling benchmark. The views are the camera turned around the up axis, like the faces of a
+		// probe. Every step times one dispatch over all of its views against one dispatch per view, the
+		// timestamps start at 4 and the counts of both go to the readback buffer
+		if(IsViewCullBenchmarkFrame)
+		{
+			CreateBuffer(ViewCommandBuffer, Device, GpuMemory, sizeof(VkDrawIndexedIndirectCommand) * ViewCullDrawCount * MAX_CULL_VIEWS, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GpuPool_Buffers);
+			CreateBuffer(ViewInstanceIdBuffer, Device, GpuMemory, sizeof(u32) * ViewCullDrawCount * MAX_CULL_VIEWS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GpuPool_Buffers);
+			CreateBuffer(ViewDrawIdBuffer, Device, GpuMemory, sizeof(u32) * ViewCullDrawCount * MAX_CULL_VIEWS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GpuPool_Buffers);
+
+			draw_cull_view* Views = (draw_cull_view*)CullViewBuffer.Data;
+			for(u32 ViewIndex = 0;
+				ViewIndex < MAX_CULL_VIEWS;
+				++ViewIndex)
+			{
+				glm::quat Orientation = glm::rotate(glm::quat(1, 0, 0, 0), glm::radians(360.0f * ViewIndex / MAX_CULL_VIEWS), glm::vec3(0, 1, 0));
+				Views[ViewIndex] = GetDrawCullView(DrawCullData, Orientation, glm::vec3(0), ViewIndex * ViewCullDrawCount);
+			}
+
+			VkPipeline ViewCullPipeline = GetDrawCullPipeline(DrawCullViewsCmdPipelines, Device, PipelineCache, DrawCullViewsComputeProgram.Layout, DrawCullViewsComputeShader, 
+															  DrawCullFlag_Cull | DrawCullFlag_Lod | (IsRtxEnabled ? DrawCullFlag_MeshTasks : 0));
+			vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ViewCullPipeline);
+
+			descriptor_template ViewDescriptors[] = {{DrawSphereBuffer.Handle}, {MeshBuffer.Handle}, {CullViewBuffer.Handle}, {ViewCommandBuffer.Handle}, {ViewDrawCountBuffer.Handle}, {ViewInstanceIdBuffer.Handle}, 
+													 {ViewCommandBuffer.Handle}, {ViewDrawIdBuffer.Handle}, {DrawTransformBuffer.Handle}};
+			vkCmdPushDescriptorSetWithTemplateKHR(CommandBuffer, DrawCullViewsComputeProgram.DescriptorTemplate, DrawCullViewsComputeProgram.Layout, 0, ViewDescriptors);
+
+			u32 StepIndex = 0;
+			for(u32 ViewCount = 1;
+				ViewCount <= MAX_CULL_VIEWS;
+				ViewCount *= 2, ++StepIndex)
+			{
+				for(u32 IsBatched = 0;
+					IsBatched < 2;
+					++IsBatched)
+				{
+					VkBufferMemoryBarrier CountBarrier = CreateBufferBarrier(ViewDrawCountBuffer.Handle, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+					vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 1, &CountBarrier, 0, 0);
+
+					vkCmdFillBuffer(CommandBuffer, ViewDrawCountBuffer.Handle, 0, sizeof(u32) * MAX_CULL_VIEWS, 0);
+
+					CountBarrier = CreateBufferBarrier(ViewDrawCountBuffer.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+					vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, 1, &CountBarrier, 0, 0);
+
+					u32 QueryIndex = 4 + StepIndex * 4 + IsBatched * 2;
+					vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TimestampsQueryPool, QueryIndex);
+
+					u32 DispatchViewCount = IsBatched ? ViewCount : 1;
+					for(u32 FirstView = 0;
+						FirstView < ViewCount;
+						FirstView += DispatchViewCount)
+					{
+						draw_cull_views_data ViewsData = {ViewCullDrawCount, FirstView, DispatchViewCount};
+						vkCmdPushConstants(CommandBuffer, DrawCullViewsComputeProgram.Layout, DrawCullViewsComputeProgram.Stages, 0, sizeof(draw_cull_views_data), &ViewsData);
+						DispatchGroupRows(CommandBuffer, GetGroupCount(ViewCullDrawCount, DrawCullViewsComputeShader.LocalSizeX));
+					}
+
+					vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TimestampsQueryPool, QueryIndex + 1);
+
+					CountBarrier = CreateBufferBarrier(ViewDrawCountBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+					vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 1, &CountBarrier, 0, 0);
+
+					VkBufferCopy CountRegion = {0, sizeof(u32) * MAX_CULL_VIEWS * (StepIndex * 2 + IsBatched), sizeof(u32) * MAX_CULL_VIEWS};
+					vkCmdCopyBuffer(CommandBuffer, ViewDrawCountBuffer.Handle, ViewCountReadbackBuffer.Handle, 1, &CountRegion);
+				}
+			}
+		}
+
+		// NOTE: this is early culling test. Frustrum culling, fill objects that were visible last frame and list every draw in the frustum for the late pass
+		{
+			VkBufferMemoryBarrier ZeroInitBarriers[] = 
+			{
+				CreateBufferBarrier(DrawCommandCountBuffer.Handle, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT),
+				CreateBufferBarrier(LateDispatchBuffer.Handle, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT),
+				CreateBufferBarrier(ContributionCulledBuffer.Handle, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT),
+			};
+			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, ArraySize(ZeroInitBarriers), ZeroInitBarriers, 0, 0);
+
+			vkCmdFillBuffer(CommandBuffer, DrawCommandCountBuffer.Handle, 0, 4, 0);
+			vkCmdUpdateBuffer(CommandBuffer, LateDispatchBuffer.Handle, 0, sizeof(EmptyLateDispatch), &EmptyLateDispatch);
+			vkCmdFillBuffer(CommandBuffer, ContributionCulledBuffer.Handle, 0, sizeof(u32) * DrawBuckets.size(), 0);
+
+			ZeroInitBarriers[0] = CreateBufferBarrier(DrawCommandCountBuffer.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+			ZeroInitBarriers[1] = CreateBufferBarrier(LateDispatchBuffer.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+			ZeroInitBarriers[2] = CreateBufferBarrier(ContributionCulledBuffer.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, ArraySize(ZeroInitBarriers), ZeroInitBarriers, 0, 0);
+
+			// NOTE: cluster culling lists the clusters whose draws are tested below
+			if(IsClusterCullEnabled)
+			{
+				VkBufferMemoryBarrier ClusterResetBarrier = CreateBufferBarrier(ClusterDispatchBuffer.Handle, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+				vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 1, &ClusterResetBarrier, 0, 0);
+
+				vkCmdUpdateBuffer(CommandBuffer, ClusterDispatchBuffer.Handle, 0, sizeof(EmptyClusterDispatch), &EmptyClusterDispatch);
+
+				ClusterResetBarrier = CreateBufferBarrier(ClusterDispatchBuffer.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+				vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, 1, &ClusterResetBarrier, 0, 0);
+
+				vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ClusterCullCmdPipeline);
+
+				descriptor_template ClusterDescriptors[] = {{ClusterBuffer.Handle}, {ClusterVisibilityBuffer.Handle}, {ClusterListBuffer.Handle}, {ClusterDispatchBuffer.Handle}};
+				vkCmdPushDescriptorSetWithTemplateKHR(CommandBuffer, ClusterCullComputeProgram.DescriptorTemplate, ClusterCullComputeProgram.Layout, 0, ClusterDescriptors);
+
+				vkCmdPushConstants(CommandBuffer, ClusterCullComputeProgram.Layout, ClusterCullComputeProgram.Stages, 0, sizeof(draw_cull_data), &DrawCullData);
+				DispatchGroupRows(CommandBuffer, GetGroupCount(ClusterCount, ClusterCullComputeShader.LocalSizeX));
+
+				VkBufferMemoryBarrier ClusterListBarriers[] = 
+				{
+					CreateBufferBarrier(ClusterListBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+					CreateBufferBarrier(ClusterDispatchBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT),
+				};
+				vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, 0, ArraySize(ClusterListBarriers), ClusterListBarriers, 0, 0);
+			}
 
 			vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, DrawCullCmdPipeline);
 
-			descriptor_template ComputeDescriptors[] = {{DrawBuffer.Handle}, {MeshBuffer.Handle}, {DrawCommandBuffer.Handle}, {DrawCommandCountBuffer.Handle}, {DrawVisibilityBuffer.Handle}};
+			// NOTE: the early variant doesn't sample the depth pyramid, but the shader still declares it
+			descriptor_template PyramidDesc(DepthSampler, DepthPyramid.View, VK_IMAGE_LAYOUT_GENERAL);
+			descriptor_template ComputeDescriptors[] = {{DrawSphereBuffer.Handle}, {MeshBuffer.Handle}, {DrawCommandBuffer.Handle}, {DrawCommandCountBuffer.Handle}, {DrawVisibilityBuffer.Handle}, PyramidDesc, 
+														{InstanceIdBuffer.Handle}, {DrawBucketBuffer.Handle}, {ClusterBuffer.Handle}, {ClusterListBuffer.Handle}, 
+														{LateListBuffer.Handle}, {LateDispatchBuffer.Handle}, {DrawCommandBuffer.Handle}, {DrawIdBuffer.Handle}, 
+														{DrawTransformBuffer.Handle}, {ContributionCulledBuffer.Handle}, {ClusterDispatchBuffer.Handle}};
 			vkCmdPushDescriptorSetWithTemplateKHR(CommandBuffer, DrawCullComputeProgram.DescriptorTemplate, DrawCullComputeProgram.Layout, 0, ComputeDescriptors);
 
 			vkCmdPushConstants(CommandBuffer, DrawCullComputeProgram.Layout, DrawCullComputeProgram.Stages, 0, sizeof(draw_cull_data), &DrawCullData);
 			
-			vkCmdDispatch(CommandBuffer, GetGroupCount(DrawOffsets.size(), DrawCullCommandComputeShader.LocalSizeX), 1, 1);
+			if(IsClusterCullEnabled)
+			{
+				vkCmdDispatchIndirect(CommandBuffer, ClusterDispatchBuffer.Handle, offsetof(cluster_dispatch, Dispatch));
+			}
+			else
+			{
+				DispatchGroupRows(CommandBuffer, GetGroupCount(DrawCount, DrawCullCommandComputeShader.LocalSizeX));
+			}
+
+			if(IsInstancingEnabled)
+			{
+				VkBufferMemoryBarrier BucketBarrier = CreateBufferBarrier(DrawBucketBuffer.Handle, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+				vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, 1, &BucketBarrier, 0, 0);
+
+				draw_emit_data DrawEmitData = {u32(DrawBuckets.size())};
+
+				vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, DrawEmitCmdPipeline);
+
+				descriptor_template EmitDescriptors[] = {{DrawBucketBuffer.Handle}, {MeshBuffer.Handle}, {DrawCommandBuffer.Handle}, {DrawCommandCountBuffer.Handle}, {DrawCommandBuffer.Handle}, {DrawIdBuffer.Handle}};
+				vkCmdPushDescriptorSetWithTemplateKHR(CommandBuffer, DrawEmitComputeProgram.DescriptorTemplate, DrawEmitComputeProgram.Layout, 0, EmitDescriptors);
+
+				vkCmdPushConstants(CommandBuffer, DrawEmitComputeProgram.Layout, DrawEmitComputeProgram.Stages, 0, sizeof(draw_emit_data), &DrawEmitData);
+
+				vkCmdDispatch(CommandBuffer, GetGroupCount(DrawBuckets.size(), DrawEmitCommandComputeShader.LocalSizeX), 1, 1);
+			}
 
 			VkBufferMemoryBarrier CmdEndBufferBarrier[] = 
 			{
 				CreateBufferBarrier(DrawCommandBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
-				CreateBufferBarrier(DrawCommandCountBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT)
+				CreateBufferBarrier(DrawCommandCountBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+				CreateBufferBarrier(InstanceIdBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+				CreateBufferBarrier(DrawIdBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT)
 			};
-			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, 0, 2, CmdEndBufferBarrier, 0, 0);
-		}
+			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, DrawReadStages, 0, 0, 0, ArraySize(CmdEndBufferBarrier), CmdEndBufferBarrier, 0, 0);
 
-		std::vector<VkImageMemoryBarrier> ImageBeginRenderBarriers = 
-		{
-			CreateImageBarrier(ColorTarget.Handle, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
-			CreateImageBarrier(DepthTarget.Handle, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT),
-		};
+			// NOTE: only the early pass drops draws by contribution, so the counts are final here
+			VkBufferMemoryBarrier ContributionBarrier = CreateBufferBarrier(ContributionCulledBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 1, &ContributionBarrier, 0, 0);
+
+			VkBufferCopy ContributionRegion = {0, 0, VkDeviceSize(sizeof(u32) * DrawBuckets.size())};
+			vkCmdCopyBuffer(CommandBuffer, ContributionCulledBuffer.Handle, ContributionReadbackBuffer.Handle, 1, &ContributionRegion);
+
+
+			if(IsDepthSortActive)
+			{
+				SortDrawCommands(CommandBuffer, DrawSortComputeProgram, DrawSortCmdPipeline, SortDescriptors, SortOffsetBuffer.Handle, SortedDrawCommandBuffer.Handle, SortedDrawIdBuffer.Handle, 
+								 DrawReadStages, DrawSortComputeShader.LocalSizeX, DrawCount, SortKeyScale);
+			}
+		}
 
-		ImageBarrier(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT|VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, ImageBeginRenderBarriers);
+		UseRenderGraphImage(RenderGraph, ColorTargetImage, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		UseRenderGraphImage(RenderGraph, DepthTargetImage, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 
+							VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+		FlushRenderGraph(RenderGraph, CommandBuffer);
 
 		vkCmdResetQueryPool(CommandBuffer, PipelineQueryPool, 0, 1);
 		vkCmdBeginQuery(CommandBuffer, PipelineQueryPool, 0, 0);
@@ -989,73 +2754,123 @@ WinMain(HINSTANCE CurrInst,
 				MeshletBufferInfo.offset = 0;
 				MeshletBufferInfo.range = MeshletBuffer.Size;
 
-				descriptor_template DescriptorInfo[] = {{DrawBuffer.Handle, 0, DrawBuffer.Size},
-														{DrawCommandBuffer.Handle, 0, DrawCommandBuffer.Size},
+				descriptor_template PyramidDesc(DepthSampler, DepthPyramid.View, VK_IMAGE_LAYOUT_GENERAL);
+				descriptor_template DescriptorInfo[] = {{DrawTransformBuffer.Handle, 0, DrawTransformBuffer.Size},
+														{DrawIdSource.Handle, 0, DrawIdSource.Size},
 														{VertexBuffer.Handle, 0, VertexBuffer.Size}, 
-														{MeshletBuffer.Handle, 0, MeshletBuffer.Size}};
+														{MeshletBuffer.Handle, 0, MeshletBuffer.Size},
+														{InstanceIdBuffer.Handle, 0, InstanceIdBuffer.Size},
+														{MeshBuffer.Handle, 0, MeshBuffer.Size},
+														{PackedTransformBuffer.Handle, 0, PackedTransformBuffer.Size},
+														PyramidDesc,
+														{MeshletVisibilityBuffer.Handle, 0, MeshletVisibilityBuffer.Size},
+														{MeshletVisibilityOffsetBuffer.Handle, 0, MeshletVisibilityOffsetBuffer.Size}};
 
 				vkCmdPushDescriptorSetWithTemplateKHR(CommandBuffer, RtxProgram.DescriptorTemplate, RtxProgram.Layout, 0, DescriptorInfo);
 
 				vkCmdPushConstants(CommandBuffer, RtxProgram.Layout, RtxProgram.Stages, 0, sizeof(globals), &Globals);
-				vkCmdDrawMeshTasksIndirectCountNV(CommandBuffer, DrawCommandBuffer.Handle, offsetof(mesh_draw_command, MeshletDrawCommand), DrawCommandCountBuffer.Handle, 0, DrawCount, sizeof(mesh_draw_command));
+				vkCmdDrawMeshTasksIndirectCountNV(CommandBuffer, DrawCommandSource.Handle, 0, DrawCommandCountBuffer.Handle, 0, DrawCount, sizeof(VkDrawMeshTasksIndirectCommandNV));
 			}
 			else
 			{
 				vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, MeshPipeline);
-				descriptor_template DescriptorInfo[] = {{DrawBuffer.Handle, 0, DrawBuffer.Size},
-														{DrawCommandBuffer.Handle, 0, DrawCommandBuffer.Size},
-														{VertexBuffer.Handle, 0, VertexBuffer.Size}};
+				descriptor_template DescriptorInfo[] = {{DrawTransformBuffer.Handle, 0, DrawTransformBuffer.Size},
+														{DrawIdSource.Handle, 0, DrawIdSource.Size},
+														{VertexBuffer.Handle, 0, VertexBuffer.Size},
+														{MeshletBuffer.Handle, 0, MeshletBuffer.Size},
+														{InstanceIdBuffer.Handle, 0, InstanceIdBuffer.Size},
+														{MeshBuffer.Handle, 0, MeshBuffer.Size},
+														{PackedTransformBuffer.Handle, 0, PackedTransformBuffer.Size}};
 
 				vkCmdPushDescriptorSetWithTemplateKHR(CommandBuffer, MeshProgram.DescriptorTemplate, MeshProgram.Layout, 0, DescriptorInfo);
 				vkCmdBindIndexBuffer(CommandBuffer, IndexBuffer.Handle, 0, VK_INDEX_TYPE_UINT32);
 
 				vkCmdPushConstants(CommandBuffer, MeshProgram.Layout, MeshProgram.Stages, 0, sizeof(globals), &Globals);
-				vkCmdDrawIndexedIndirectCountKHR(CommandBuffer, DrawCommandBuffer.Handle, offsetof(mesh_draw_command, DrawCommand), DrawCommandCountBuffer.Handle, 0, DrawCount, sizeof(mesh_draw_command));
+				vkCmdDrawIndexedIndirectCountKHR(CommandBuffer, DrawCommandSource.Handle, 0, DrawCommandCountBuffer.Handle, 0, DrawCount, sizeof(VkDrawIndexedIndirectCommand));
 			}
 
 			vkCmdEndRenderPass(CommandBuffer);
 		}
 
-		std::vector<VkImageMemoryBarrier> DepthReadBarriers = 
+		vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TimestampsQueryPool, 2);
+
+		// NOTE: Depth pyramid generation
+		if(IsDepthPyramidSinglePass && DepthPyramidLevels <= DEPTH_PYRAMID_SINGLE_PASS_LEVELS)
 		{
-			CreateImageBarrier(DepthTarget.Handle, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT),
-			CreateImageBarrier(DepthPyramid.Handle, 0, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL),
-		};
-		ImageBarrier(CommandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, DepthReadBarriers);
+			// NOTE: the single pass reads the levels it wrote itself, the barriers between them are in the shader
+			UseRenderGraphImage(RenderGraph, DepthTargetImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			UseRenderGraphImage(RenderGraph, DepthPyramidImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+			FlushRenderGraph(RenderGraph, CommandBuffer);
 
-		vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, DepthReducePipeline);
+			vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, DepthPyramidPipeline);
 
-		// NOTE: Depth pyramid generation
-		for(u32 PyramidIndex = 0;
-			PyramidIndex < DepthPyramidLevels;
-			++PyramidIndex)
+			// NOTE: bindings of levels the pyramid doesn't have point at its last level, the shader never writes them
+			descriptor_template ComputeDescriptors[DEPTH_PYRAMID_SINGLE_PASS_LEVELS + 2] = 
+			{
+				descriptor_template(DepthSampler, DepthTarget.View, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+				descriptor_template(DepthPyramidMips[0], VK_IMAGE_LAYOUT_GENERAL), descriptor_template(DepthPyramidMips[min(1u, DepthPyramidLevels - 1)], VK_IMAGE_LAYOUT_GENERAL),
+				descriptor_template(DepthPyramidMips[min(2u, DepthPyramidLevels - 1)], VK_IMAGE_LAYOUT_GENERAL), descriptor_template(DepthPyramidMips[min(3u, DepthPyramidLevels - 1)], VK_IMAGE_LAYOUT_GENERAL),
+				descriptor_template(DepthPyramidMips[min(4u, DepthPyramidLevels - 1)], VK_IMAGE_LAYOUT_GENERAL), descriptor_template(DepthPyramidMips[min(5u, DepthPyramidLevels - 1)], VK_IMAGE_LAYOUT_GENERAL),
+				descriptor_template(DepthPyramidMips[min(6u, DepthPyramidLevels - 1)], VK_IMAGE_LAYOUT_GENERAL), descriptor_template(DepthPyramidMips[min(7u, DepthPyramidLevels - 1)], VK_IMAGE_LAYOUT_GENERAL),
+				descriptor_template(DepthPyramidMips[min(8u, DepthPyramidLevels - 1)], VK_IMAGE_LAYOUT_GENERAL), descriptor_template(DepthPyramidMips[min(9u, DepthPyramidLevels - 1)], VK_IMAGE_LAYOUT_GENERAL),
+				descriptor_template(DepthPyramidMips[min(10u, DepthPyramidLevels - 1)], VK_IMAGE_LAYOUT_GENERAL), descriptor_template(DepthPyramidMips[min(11u, DepthPyramidLevels - 1)], VK_IMAGE_LAYOUT_GENERAL),
+				descriptor_template(DepthPyramidCounterBuffer.Handle),
+			};
+			vkCmdPushDescriptorSetWithTemplateKHR(CommandBuffer, DepthPyramidProgram.DescriptorTemplate, DepthPyramidProgram.Layout, 0, ComputeDescriptors);
+
+			u32 GroupCountX = GetGroupCount(DepthPyramidWidth, 64);
+			u32 GroupCountY = GetGroupCount(DepthPyramidHeight, 64);
+
+			depth_pyramid_data DepthPyramidData = {};
+			DepthPyramidData.SourceSize = glm::vec2(Swapchain.Width, Swapchain.Height);
+			DepthPyramidData.PyramidWidth  = DepthPyramidWidth;
+			DepthPyramidData.PyramidHeight = DepthPyramidHeight;
+			DepthPyramidData.LevelCount = DepthPyramidLevels;
+			DepthPyramidData.GroupCount = GroupCountX * GroupCountY;
+
+			vkCmdPushConstants(CommandBuffer, DepthPyramidProgram.Layout, DepthPyramidProgram.Stages, 0, sizeof(depth_pyramid_data), &DepthPyramidData);
+			vkCmdDispatch(CommandBuffer, GroupCountX, GroupCountY, 1);
+		}
+		else
 		{
-			descriptor_template SourceDepth = (PyramidIndex == 0) ? 
-				descriptor_template(DepthSampler, DepthTarget.View, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) : 
-				descriptor_template(DepthSampler, DepthPyramidMips[PyramidIndex - 1], VK_IMAGE_LAYOUT_GENERAL);
-			descriptor_template ComputeDescriptors[] = {SourceDepth, {DepthPyramidMips[PyramidIndex], VK_IMAGE_LAYOUT_GENERAL}};
-			vkCmdPushDescriptorSetWithTemplateKHR(CommandBuffer, DepthReduceProgram.DescriptorTemplate, DepthReduceProgram.Layout, 0, ComputeDescriptors);
+			vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, DepthReducePipeline);
+
+			for(u32 PyramidIndex = 0;
+				PyramidIndex < DepthPyramidLevels;
+				++PyramidIndex)
+			{
+				// NOTE: only the level before has to be written, the one a level writes was last read by culling
+				if(PyramidIndex == 0)
+				{
+					UseRenderGraphImage(RenderGraph, DepthTargetImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				}
+				else
+				{
+					UseRenderGraphImage(RenderGraph, DepthPyramidImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, PyramidIndex - 1, 1);
+				}
+				UseRenderGraphImage(RenderGraph, DepthPyramidImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, PyramidIndex, 1);
+				FlushRenderGraph(RenderGraph, CommandBuffer);
 
-			u32 LevelWidth  = max(1u, (DepthPyramidWidth) >> PyramidIndex);
-			u32 LevelHeight = max(1u, (DepthPyramidHeight) >> PyramidIndex);
+				descriptor_template SourceDepth = (PyramidIndex == 0) ? 
+					descriptor_template(DepthSampler, DepthTarget.View, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) : 
+					descriptor_template(DepthSampler, DepthPyramidMips[PyramidIndex - 1], VK_IMAGE_LAYOUT_GENERAL);
+				descriptor_template ComputeDescriptors[] = {SourceDepth, {DepthPyramidMips[PyramidIndex], VK_IMAGE_LAYOUT_GENERAL}};
+				vkCmdPushDescriptorSetWithTemplateKHR(CommandBuffer, DepthReduceProgram.DescriptorTemplate, DepthReduceProgram.Layout, 0, ComputeDescriptors);
 
-			depth_reduce_data DepthReduceData = {};
-			DepthReduceData.Dims = glm::vec2(LevelWidth, LevelHeight);
+				u32 LevelWidth  = max(1u, (DepthPyramidWidth) >> PyramidIndex);
+				u32 LevelHeight = max(1u, (DepthPyramidHeight) >> PyramidIndex);
 
-			vkCmdPushConstants(CommandBuffer, DepthReduceProgram.Layout, DepthReduceProgram.Stages, 0, sizeof(depth_reduce_data), &DepthReduceData);
-			vkCmdDispatch(CommandBuffer, GetGroupCount(LevelWidth, DepthReduceComputeShader.LocalSizeX), GetGroupCount(LevelHeight, DepthReduceComputeShader.LocalSizeY), 1);
+				depth_reduce_data DepthReduceData = {};
+				DepthReduceData.Dims = glm::vec2(LevelWidth, LevelHeight);
 
-			VkImageMemoryBarrier ReduceBarrier = CreateImageBarrier(DepthPyramid.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, 0, 0, 1, &ReduceBarrier);
+				vkCmdPushConstants(CommandBuffer, DepthReduceProgram.Layout, DepthReduceProgram.Stages, 0, sizeof(depth_reduce_data), &DepthReduceData);
+				vkCmdDispatch(CommandBuffer, GetGroupCount(LevelWidth, DepthReduceComputeShader.LocalSizeX), GetGroupCount(LevelHeight, DepthReduceComputeShader.LocalSizeY), 1);
+			}
 		}
 
-		std::vector<VkImageMemoryBarrier> DepthWriteBarriers = 
-		{
-			CreateImageBarrier(DepthTarget.Handle, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT),
-		};
-		ImageBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, DepthWriteBarriers);
+		vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TimestampsQueryPool, 3);
 
-		// NOTE: late culling. Frustrum + Occlusion culling and fill objects that were not visible last frame
+		// NOTE: late culling. Occlusion culling of the draws the early pass found in the frustum, fill objects that were not visible last frame
 		{
 			VkBufferMemoryBarrier ZeroInitBarrier = CreateBufferBarrier(DrawCommandCountBuffer.Handle, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
 			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 1, &ZeroInitBarrier, 0, 0);
@@ -1065,22 +2880,69 @@ WinMain(HINSTANCE CurrInst,
 			ZeroInitBarrier = CreateBufferBarrier(DrawCommandCountBuffer.Handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
 			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, 1, &ZeroInitBarrier, 0, 0);
 
+			VkBufferMemoryBarrier LateListBarriers[] = 
+			{
+				CreateBufferBarrier(LateListBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+				CreateBufferBarrier(LateDispatchBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+			};
+			UseRenderGraphImage(RenderGraph, DepthPyramidImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+			FlushRenderGraph(RenderGraph, CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, ArraySize(LateListBarriers), LateListBarriers);
+
 			vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, DrawCullateCmdPipeline);
 
 			descriptor_template PyramidDesc(DepthSampler, DepthPyramid.View, VK_IMAGE_LAYOUT_GENERAL);
-			descriptor_template ComputeDescriptors[] = {{DrawBuffer.Handle}, {MeshBuffer.Handle}, {DrawCommandBuffer.Handle}, {DrawCommandCountBuffer.Handle}, {DrawVisibilityBuffer.Handle}, PyramidDesc};
-			vkCmdPushDescriptorSetWithTemplateKHR(CommandBuffer, DrawCullateComputeProgram.DescriptorTemplate, DrawCullateComputeProgram.Layout, 0, ComputeDescriptors);
+			descriptor_template ComputeDescriptors[] = {{DrawSphereBuffer.Handle}, {MeshBuffer.Handle}, {DrawCommandBuffer.Handle}, {DrawCommandCountBuffer.Handle}, {DrawVisibilityBuffer.Handle}, PyramidDesc, 
+														{InstanceIdBuffer.Handle}, {DrawBucketBuffer.Handle}, {ClusterBuffer.Handle}, {ClusterListBuffer.Handle}, 
+														{LateListBuffer.Handle}, {LateDispatchBuffer.Handle}, {DrawCommandBuffer.Handle}, {DrawIdBuffer.Handle}, 
+														{DrawTransformBuffer.Handle}, {ContributionCulledBuffer.Handle}, {ClusterDispatchBuffer.Handle}};
+			vkCmdPushDescriptorSetWithTemplateKHR(CommandBuffer, DrawCullComputeProgram.DescriptorTemplate, DrawCullComputeProgram.Layout, 0, ComputeDescriptors);
 
-			vkCmdPushConstants(CommandBuffer, DrawCullateComputeProgram.Layout, DrawCullateComputeProgram.Stages, 0, sizeof(draw_cull_data), &DrawCullData);
+			vkCmdPushConstants(CommandBuffer, DrawCullComputeProgram.Layout, DrawCullComputeProgram.Stages, 0, sizeof(draw_cull_data), &DrawCullData);
 			
-			vkCmdDispatch(CommandBuffer, GetGroupCount(DrawOffsets.size(), DrawCullateCommandComputeShader.LocalSizeX), 1, 1);
+			vkCmdDispatchIndirect(CommandBuffer, LateDispatchBuffer.Handle, offsetof(late_dispatch, Dispatch));
+
+			if(IsInstancingEnabled)
+			{
+				VkBufferMemoryBarrier BucketBarrier = CreateBufferBarrier(DrawBucketBuffer.Handle, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+				vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, 1, &BucketBarrier, 0, 0);
+
+				draw_emit_data DrawEmitData = {u32(DrawBuckets.size())};
+
+				vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, DrawEmitCmdPipeline);
+
+				descriptor_template EmitDescriptors[] = {{DrawBucketBuffer.Handle}, {MeshBuffer.Handle}, {DrawCommandBuffer.Handle}, {DrawCommandCountBuffer.Handle}, {DrawCommandBuffer.Handle}, {DrawIdBuffer.Handle}};
+				vkCmdPushDescriptorSetWithTemplateKHR(CommandBuffer, DrawEmitComputeProgram.DescriptorTemplate, DrawEmitComputeProgram.Layout, 0, EmitDescriptors);
+
+				vkCmdPushConstants(CommandBuffer, DrawEmitComputeProgram.Layout, DrawEmitComputeProgram.Stages, 0, sizeof(draw_emit_data), &DrawEmitData);
+
+				vkCmdDispatch(CommandBuffer, GetGroupCount(DrawBuckets.size(), DrawEmitCommandComputeShader.LocalSizeX), 1, 1);
+			}
 
 			VkBufferMemoryBarrier CmdEndBufferBarrier[] = 
 			{
 				CreateBufferBarrier(DrawCommandBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
-				CreateBufferBarrier(DrawCommandCountBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT)
+				CreateBufferBarrier(DrawCommandCountBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+				CreateBufferBarrier(InstanceIdBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+				CreateBufferBarrier(DrawIdBuffer.Handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT)
 			};
-			vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, 0, 2, CmdEndBufferBarrier, 0, 0);
+
+			// NOTE: the late task shader tests meshlets against the pyramid too, the late pass loads the targets of the early one
+			if(IsRtxEnabled)
+			{
+				UseRenderGraphImage(RenderGraph, DepthPyramidImage, DrawReadStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+			}
+			UseRenderGraphImage(RenderGraph, ColorTargetImage, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 
+								VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+			UseRenderGraphImage(RenderGraph, DepthTargetImage, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 
+								VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+			FlushRenderGraph(RenderGraph, CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, DrawReadStages, ArraySize(CmdEndBufferBarrier), CmdEndBufferBarrier);
+
+
+			if(IsDepthSortActive)
+			{
+				SortDrawCommands(CommandBuffer, DrawSortComputeProgram, DrawSortCmdPipeline, SortDescriptors, SortOffsetBuffer.Handle, SortedDrawCommandBuffer.Handle, SortedDrawIdBuffer.Handle, 
+								 DrawReadStages, DrawSortComputeShader.LocalSizeX, DrawCount, SortKeyScale);
+			}
 		}
 
 		// NOTE: Late rendering
@@ -1095,35 +2957,46 @@ WinMain(HINSTANCE CurrInst,
 
 			if(IsRtxEnabled)
 			{
-				vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, RtxPipeline);
+				vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, RtxLatePipeline);
 
 				VkDescriptorBufferInfo MeshletBufferInfo = {};
 				MeshletBufferInfo.buffer = MeshletBuffer.Handle;
 				MeshletBufferInfo.offset = 0;
 				MeshletBufferInfo.range = MeshletBuffer.Size;
 
-				descriptor_template DescriptorInfo[] = {{DrawBuffer.Handle, 0, DrawBuffer.Size},
-														{DrawCommandBuffer.Handle, 0, DrawCommandBuffer.Size},
+				descriptor_template PyramidDesc(DepthSampler, DepthPyramid.View, VK_IMAGE_LAYOUT_GENERAL);
+				descriptor_template DescriptorInfo[] = {{DrawTransformBuffer.Handle, 0, DrawTransformBuffer.Size},
+														{DrawIdSource.Handle, 0, DrawIdSource.Size},
 														{VertexBuffer.Handle, 0, VertexBuffer.Size}, 
-														{MeshletBuffer.Handle, 0, MeshletBuffer.Size}};
+														{MeshletBuffer.Handle, 0, MeshletBuffer.Size},
+														{InstanceIdBuffer.Handle, 0, InstanceIdBuffer.Size},
+														{MeshBuffer.Handle, 0, MeshBuffer.Size},
+														{PackedTransformBuffer.Handle, 0, PackedTransformBuffer.Size},
+														PyramidDesc,
+														{MeshletVisibilityBuffer.Handle, 0, MeshletVisibilityBuffer.Size},
+														{MeshletVisibilityOffsetBuffer.Handle, 0, MeshletVisibilityOffsetBuffer.Size}};
 
 				vkCmdPushDescriptorSetWithTemplateKHR(CommandBuffer, RtxProgram.DescriptorTemplate, RtxProgram.Layout, 0, DescriptorInfo);
 
 				vkCmdPushConstants(CommandBuffer, RtxProgram.Layout, RtxProgram.Stages, 0, sizeof(globals), &Globals);
-				vkCmdDrawMeshTasksIndirectCountNV(CommandBuffer, DrawCommandBuffer.Handle, offsetof(mesh_draw_command, MeshletDrawCommand), DrawCommandCountBuffer.Handle, 0, DrawCount, sizeof(mesh_draw_command));
+				vkCmdDrawMeshTasksIndirectCountNV(CommandBuffer, DrawCommandSource.Handle, 0, DrawCommandCountBuffer.Handle, 0, DrawCount, sizeof(VkDrawMeshTasksIndirectCommandNV));
 			}
 			else
 			{
 				vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, MeshPipeline);
-				descriptor_template DescriptorInfo[] = {{DrawBuffer.Handle, 0, DrawBuffer.Size},
-														{DrawCommandBuffer.Handle, 0, DrawCommandBuffer.Size},
-														{VertexBuffer.Handle, 0, VertexBuffer.Size}};
+				descriptor_template DescriptorInfo[] = {{DrawTransformBuffer.Handle, 0, DrawTransformBuffer.Size},
+														{DrawIdSource.Handle, 0, DrawIdSource.Size},
+														{VertexBuffer.Handle, 0, VertexBuffer.Size},
+														{MeshletBuffer.Handle, 0, MeshletBuffer.Size},
+														{InstanceIdBuffer.Handle, 0, InstanceIdBuffer.Size},
+														{MeshBuffer.Handle, 0, MeshBuffer.Size},
+														{PackedTransformBuffer.Handle, 0, PackedTransformBuffer.Size}};
 
 				vkCmdPushDescriptorSetWithTemplateKHR(CommandBuffer, MeshProgram.DescriptorTemplate, MeshProgram.Layout, 0, DescriptorInfo);
 				vkCmdBindIndexBuffer(CommandBuffer, IndexBuffer.Handle, 0, VK_INDEX_TYPE_UINT32);
 
 				vkCmdPushConstants(CommandBuffer, MeshProgram.Layout, MeshProgram.Stages, 0, sizeof(globals), &Globals);
-				vkCmdDrawIndexedIndirectCountKHR(CommandBuffer, DrawCommandBuffer.Handle, offsetof(mesh_draw_command, DrawCommand), DrawCommandCountBuffer.Handle, 0, DrawCount, sizeof(mesh_draw_command));
+				vkCmdDrawIndexedIndirectCountKHR(CommandBuffer, DrawCommandSource.Handle, 0, DrawCommandCountBuffer.Handle, 0, DrawCount, sizeof(VkDrawIndexedIndirectCommand));
 			}
 
 			vkCmdEndRenderPass(CommandBuffer);
@@ -1131,13 +3004,16 @@ WinMain(HINSTANCE CurrInst,
 
 		vkCmdEndQuery(CommandBuffer, PipelineQueryPool, 0);
 
-		std::vector<VkImageMemoryBarrier> ImageCopyBarriers = 
+		if(IsPyramidVisualized)
 		{
-			CreateImageBarrier(ColorTarget.Handle, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL),
-			CreateImageBarrier(Swapchain.Images[ImageIndex], 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL),
-		};
-
-		ImageBarrier(CommandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, ImageCopyBarriers);
+			UseRenderGraphImage(RenderGraph, DepthPyramidImage, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+		}
+		else
+		{
+			UseRenderGraphImage(RenderGraph, ColorTargetImage, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		}
+		UseRenderGraphImage(RenderGraph, SwapchainImage, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		FlushRenderGraph(RenderGraph, CommandBuffer);
 
 		if(IsPyramidVisualized)
 		{
@@ -1168,63 +3044,85 @@ WinMain(HINSTANCE CurrInst,
 
 		vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TimestampsQueryPool, 1);
 
-		std::vector<VkImageMemoryBarrier> ImagePresentBarrier = 
-		{
-			CreateImageBarrier(Swapchain.Images[ImageIndex], VK_ACCESS_TRANSFER_WRITE_BIT, 0, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR),
-		};
-		ImageBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, ImagePresentBarrier);
+		UseRenderGraphImage(RenderGraph, SwapchainImage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		FlushRenderGraph(RenderGraph, CommandBuffer);
 
 		vkEndCommandBuffer(CommandBuffer);
 
+#if VK_DEBUG
+		u32 RenderGraphHazardCount = ValidateRenderGraph(RenderGraph, true);
+		assert(RenderGraphHazardCount == 0);
+#endif
+
 		VkPipelineStageFlags SubmitStageFlag = VK_PIPELINE_STAGE_TRANSFER_BIT;
 		VkSubmitInfo SubmitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
 		SubmitInfo.pWaitDstStageMask = &SubmitStageFlag;
 		SubmitInfo.commandBufferCount = 1;
 		SubmitInfo.pCommandBuffers = &CommandBuffer;
 		SubmitInfo.waitSemaphoreCount = 1;
-		SubmitInfo.pWaitSemaphores = &AcquireSemaphore;
+		SubmitInfo.pWaitSemaphores = &Frame.AcquireSemaphore;
 		SubmitInfo.signalSemaphoreCount = 1;
-		SubmitInfo.pSignalSemaphores = &ReleaseSemaphore;
-		vkQueueSubmit(Queue, 1, &SubmitInfo, VK_NULL_HANDLE);
+		SubmitInfo.pSignalSemaphores = &Swapchain.ReleaseSemaphores[ImageIndex];
+
+		VK_CHECK(vkResetFences(Device, 1, &Frame.Fence));
+		vkQueueSubmit(Queue, 1, &SubmitInfo, Frame.Fence);
 
 		VkPresentInfoKHR PresentInfo = {VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
 		PresentInfo.waitSemaphoreCount = 1;
-		PresentInfo.pWaitSemaphores = &ReleaseSemaphore;
+		PresentInfo.pWaitSemaphores = &Swapchain.ReleaseSemaphores[ImageIndex];
 		PresentInfo.swapchainCount = 1;
 		PresentInfo.pSwapchains = &Swapchain.Handle;
 		PresentInfo.pImageIndices = &ImageIndex;
 		vkQueuePresentKHR(Queue, &PresentInfo);
 
-		vkDeviceWaitIdle(Device);
+		Frame.IsSubmitted = true;
+		Frame.IsCullValidationFrame = IsCullValidationFrame;
+		Frame.IsViewCullBenchmarkFrame = IsViewCullBenchmarkFrame;
+		Frame.SortBenchmarkHalf = SortBenchmarkFrame ? (IsDepthSortEnabled ? 2 : 1) : 0;
+		Frame.DrawCullData = DrawCullData;
+		FrameIndex = (FrameIndex + 1) % FramesInFlight;
 
-		u64 TimeResults[2] = {};
-		vkGetQueryPoolResults(Device, TimestampsQueryPool, 0, ArraySize(TimeResults), sizeof(TimeResults), TimeResults, sizeof(TimeResults[0]), VK_QUERY_RESULT_64_BIT);
-
-		u64 PipelineResults[1] = {};
-		vkGetQueryPoolResults(Device, PipelineQueryPool, 0, 1, sizeof(PipelineResults), PipelineResults, sizeof(PipelineResults[0]), 0);
-
-		TriangleCount = PipelineResults[0];
+		// NOTE: the toggles go back once the last benchmark frame is recorded, its results come in later
+		if(SortBenchmarkFrame && ++SortBenchmarkFrame > 2 * SORT_BENCHMARK_FRAMES)
+		{
+			IsDepthSortEnabled = IsSortBenchmarkDepthSortEnabled;
+			IsInstancingEnabled = IsSortBenchmarkInstancingEnabled;
+			SortBenchmarkFrame = 0;
+		}
 
 		QueryPerformanceCounter(&EndTime);
 
 		CpuAvgTime = CpuAvgTime * 0.75f + ((float)(EndTime.QuadPart - BegTime.QuadPart) / (float)TimeFreq.QuadPart * 1000.0f) * 0.25f;
-		GpuAvgTime = GpuAvgTime * 0.75f + ((float)(TimeResults[1] - TimeResults[0]) * (float)Props.limits.timestampPeriod * 1.e-6f) * 0.25f;
-
-		char Title[512];
-		sprintf(Title, "%s; %s; %s; %s; Vulkan Engine - cpu: %.2f ms, gpu: %.2f ms; %0.2f cpu FPS; %0.2f gpu FPS; %llu triangles; %llu meshlets", 
+		char Title[768];
+		sprintf(Title, "%s; %s; %s; %s; %s; %s; %s; %s; %s; Vulkan Engine - cpu: %.2f ms, gpu: %.2f ms, pyramid (%s): %.3f ms, sw occl: %.2f ms (%u visible); %0.2f cpu FPS; %0.2f gpu FPS; %llu triangles; %llu meshlets; %llu fragments; under %.0f px: %u draws, %llu triangles", 
 				IsRtxEnabled ? "RTX Is Enabled" : "RTX Is Disabled",
 				IsCullEnabled == 1 ? "Cull Is Enabled" : "Cull Is Disabled",
 				IsLodEnabled == 1 ? "Lod Is Enabled" : "Lod Is Disabled",
 				IsOcclusionEnabled == 1 ? "Occl Is Enabled" : "Occl Is Disabled",
+				IsInstancingEnabled == 1 ? "Instancing Is Enabled" : "Instancing Is Disabled",
+				IsSoftwareOcclusionEnabled == 1 ? "Sw Occl Is Enabled" : "Sw Occl Is Disabled",
+				IsClusterCullEnabled == 1 ? "Cluster Cull Is Enabled" : "Cluster Cull Is Disabled",
+				IsTransformPackingEnabled == 1 ? "Packed Transforms" : (IsTransformPackingSupported ? "Full Transforms" : "Full Transforms Only"),
+				IsDepthSortEnabled == 1 ? (IsInstancingEnabled ? "Depth Sort Needs No Instancing" : "Depth Sort Is Enabled") : "Depth Sort Is Disabled",
 				CpuAvgTime, 
 			    GpuAvgTime,
+				IsDepthPyramidSinglePass ? "single pass" : "per level",
+				PyramidAvgTime,
+				SoftwareOcclusionAvgTime,
+				SoftwareOcclusion.VisibleCount,
 				1.0f / (CpuAvgTime) * 1000.0f,
 				1.0f / (GpuAvgTime) * 1000.0f,
 				TriangleCount,
-				Geometries.Meshlets.size());
+				Geometries.Meshlets.size(),
+				FragmentCount,
+				ContributionCullPixels,
+				ContributionCulledDraws,
+				ContributionCulledTriangles);
 		SetWindowTextA(Window, Title);
 	}
 
+	VK_CHECK(vkDeviceWaitIdle(Device));
+
 	for(u32 DepthPyramidIdx = 0;
 		DepthPyramidIdx < DepthPyramidLevels;
 		++DepthPyramidIdx)
@@ -1234,30 +3132,74 @@ WinMain(HINSTANCE CurrInst,
 
 	vkDestroyFramebuffer(Device, TargetFramebuffer, 0);
 	if(DepthPyramid.Handle)
-		DestroyImage(DepthPyramid, Device);
+		DestroyImage(DepthPyramid, Device, GpuMemory);
 	if(ColorTarget.View)
-		DestroyImage(ColorTarget, Device);
+		DestroyImage(ColorTarget, Device, GpuMemory);
 	if(DepthTarget.View)
-		DestroyImage(DepthTarget, Device);
+		DestroyImage(DepthTarget, Device, GpuMemory);
+	DestroyRenderGraph(RenderGraph, Device, GpuMemory);
 
 	if(IsRtxSupported)
 	{
-		DestroyBuffer(MeshletBuffer, Device);
-		DestroyBuffer(MeshletDataBuffer, Device);
+		DestroyBuffer(MeshletBuffer, Device, GpuMemory);
+		DestroyBuffer(MeshletDataBuffer, Device, GpuMemory);
 	}
 
-	DestroyBuffer(MeshBuffer, Device);
-	DestroyBuffer(DrawCommandCountBuffer, Device);
-	DestroyBuffer(DrawBuffer, Device);
-	DestroyBuffer(DrawCommandBuffer, Device);
-	DestroyBuffer(VertexBuffer, Device);
-	DestroyBuffer(IndexBuffer, Device);
-	DestroyBuffer(ScratchBuffer, Device);
+	DestroyBuffer(MeshBuffer, Device, GpuMemory);
+	DestroyBuffer(DrawCommandCountBuffer, Device, GpuMemory);
+	DestroyBuffer(DrawSphereBuffer, Device, GpuMemory);
+	DestroyBuffer(DrawTransformBuffer, Device, GpuMemory);
+	DestroyBuffer(PackedTransformBuffer, Device, GpuMemory);
+	DestroyBuffer(DrawVisibilityBuffer, Device, GpuMemory);
+	DestroyBuffer(ContributionCulledBuffer, Device, GpuMemory);
+	DestroyBuffer(SortedDrawCommandBuffer, Device, GpuMemory);
+	DestroyBuffer(SortedDrawIdBuffer, Device, GpuMemory);
+	DestroyBuffer(SortOffsetBuffer, Device, GpuMemory);
+	DestroyBuffer(MeshletVisibilityBuffer, Device, GpuMemory);
+	DestroyBuffer(MeshletVisibilityOffsetBuffer, Device, GpuMemory);
+	DestroyBuffer(DrawCommandBuffer, Device, GpuMemory);
+	DestroyBuffer(DrawIdBuffer, Device, GpuMemory);
+	DestroyBuffer(DepthPyramidCounterBuffer, Device, GpuMemory);
+	DestroyBuffer(CullReadbackBuffer, Device, GpuMemory);
+	DestroyBuffer(ClusterBuffer, Device, GpuMemory);
+	DestroyBuffer(ClusterVisibilityBuffer, Device, GpuMemory);
+	DestroyBuffer(ClusterListBuffer, Device, GpuMemory);
+	DestroyBuffer(ClusterDispatchBuffer, Device, GpuMemory);
+	DestroyBuffer(CullViewBuffer, Device, GpuMemory);
+	DestroyBuffer(ViewCommandBuffer, Device, GpuMemory);
+	DestroyBuffer(ViewInstanceIdBuffer, Device, GpuMemory);
+	DestroyBuffer(ViewDrawIdBuffer, Device, GpuMemory);
+	DestroyBuffer(ViewDrawCountBuffer, Device, GpuMemory);
+	DestroyBuffer(ViewCountReadbackBuffer, Device, GpuMemory);
+	DestroyBuffer(LateListBuffer, Device, GpuMemory);
+	DestroyBuffer(LateDispatchBuffer, Device, GpuMemory);
+
+	DestroyWorkerPool(WorkerPool);
+	DestroyBuffer(DrawBucketBuffer, Device, GpuMemory);
+	DestroyBuffer(InstanceIdBuffer, Device, GpuMemory);
+	DestroyBuffer(VertexBuffer, Device, GpuMemory);
+	DestroyBuffer(IndexBuffer, Device, GpuMemory);
+	DestroyBuffer(ScratchBuffer, Device, GpuMemory);
+
+	for(u32 FrameIndex = 0;
+		FrameIndex < FramesInFlight;
+		++FrameIndex)
+	{
+		frame& Frame = Frames[FrameIndex];
+
+		DestroyBuffer(Frame.SoftwareVisibilityBuffer, Device, GpuMemory);
+		DestroyBuffer(Frame.ContributionReadbackBuffer, Device, GpuMemory);
+
+		vkDestroyQueryPool(Device, Frame.TimestampsQueryPool, 0);
+		vkDestroyQueryPool(Device, Frame.PipelineQueryPool, 0);
 
-	vkDestroyQueryPool(Device, TimestampsQueryPool, 0);
-	vkDestroyQueryPool(Device, PipelineQueryPool, 0);
+		vkDestroyCommandPool(Device, Frame.CommandPool, 0);
+
+		vkDestroyFence(Device, Frame.Fence, 0);
+		vkDestroySemaphore(Device, Frame.AcquireSemaphore, 0);
+	}
 
-	vkDestroyCommandPool(Device, CommandPool, 0);
+	vkDestroyCommandPool(Device, UploadCommandPool, 0);
 
 	vkDestroySampler(Device, DepthSampler, 0);
 
@@ -1269,18 +3211,51 @@ WinMain(HINSTANCE CurrInst,
 	vkDestroyPipeline(Device, DepthReducePipeline, 0);
 	DeleteProgram(DepthReduceProgram, Device);
 
-	vkDestroyPipeline(Device, DrawCullCmdPipeline, 0);
+	vkDestroyPipeline(Device, DepthPyramidPipeline, 0);
+	DeleteProgram(DepthPyramidProgram, Device);
+
+	for(VkPipeline Pipeline : DrawCullCmdPipelines)
+	{
+		vkDestroyPipeline(Device, Pipeline, 0);
+	}
 	DeleteProgram(DrawCullComputeProgram, Device);
 
-	vkDestroyPipeline(Device, DrawCullateCmdPipeline, 0);
-	DeleteProgram(DrawCullateComputeProgram, Device);
+	for(VkPipeline Pipeline : ClusterCullCmdPipelines)
+	{
+		vkDestroyPipeline(Device, Pipeline, 0);
+	}
+	DeleteProgram(ClusterCullComputeProgram, Device);
+
+	for(VkPipeline Pipeline : DrawCullViewsCmdPipelines)
+	{
+		vkDestroyPipeline(Device, Pipeline, 0);
+	}
+	DeleteProgram(DrawCullViewsComputeProgram, Device);
+
+	for(VkPipeline Pipeline : DrawEmitCmdPipelines)
+	{
+		vkDestroyPipeline(Device, Pipeline, 0);
+	}
+	DeleteProgram(DrawEmitComputeProgram, Device);
+
+	for(VkPipeline Pipeline : DrawSortCmdPipelines)
+	{
+		vkDestroyPipeline(Device, Pipeline, 0);
+	}
+	DeleteProgram(DrawSortComputeProgram, Device);
 
-	vkDestroyPipeline(Device, MeshPipeline, 0);
+	for(VkPipeline Pipeline : MeshPipelines)
+	{
+		vkDestroyPipeline(Device, Pipeline, 0);
+	}
 	DeleteProgram(MeshProgram, Device);
 
 	if(IsRtxSupported)
 	{
-		vkDestroyPipeline(Device, RtxPipeline, 0);
+		for(VkPipeline Pipeline : RtxPipelines)
+		{
+			vkDestroyPipeline(Device, Pipeline, 0);
+		}
 		DeleteProgram(RtxProgram, Device);
 
 		vkDestroyShaderModule(Device, ObjectMeshShader.Handle, 0);
@@ -1288,13 +3263,17 @@ WinMain(HINSTANCE CurrInst,
 	}
 
 	vkDestroyShaderModule(Device, DepthReduceComputeShader.Handle, 0);
+	vkDestroyShaderModule(Device, DepthPyramidComputeShader.Handle, 0);
 	vkDestroyShaderModule(Device, DrawCullCommandComputeShader.Handle, 0);
-	vkDestroyShaderModule(Device, DrawCullateCommandComputeShader.Handle, 0);
+	vkDestroyShaderModule(Device, ClusterCullComputeShader.Handle, 0);
+	vkDestroyShaderModule(Device, DrawCullViewsComputeShader.Handle, 0);
+	vkDestroyShaderModule(Device, DrawEmitCommandComputeShader.Handle, 0);
+	vkDestroyShaderModule(Device, DrawSortComputeShader.Handle, 0);
 	vkDestroyShaderModule(Device, ObjectFragmentShader.Handle, 0);
 	vkDestroyShaderModule(Device, ObjectVertexShader.Handle, 0);
 
-	vkDestroySemaphore(Device, AcquireSemaphore, 0);
-	vkDestroySemaphore(Device, ReleaseSemaphore, 0);
+	DestroyGpuMemory(GpuMemory, Device);
+	assert(GpuMemory.DeviceAllocationCount == 0);
 
 	vkDestroySurfaceKHR(Instance, Surface, 0);
 	vkDestroyDevice(Device, 0);
@@ -1368,6 +3347,51 @@ DispatchMessages()
 					{
 						IsCullEnabled = !IsCullEnabled;
 					}
+					if(KeyCode == 'I')
+					{
+						IsInstancingEnabled = !IsInstancingEnabled;
+					}
+					if(KeyCode == 'D')
+					{
+						IsDepthPyramidSinglePass = !IsDepthPyramidSinglePass;
+					}
+					if(KeyCode == 'H')
+					{
+						IsClusterCullEnabled = !IsClusterCullEnabled;
+					}
+					if(KeyCode == 'T')
+					{
+						IsTransformPackingEnabled = IsTransformPackingSupported && !IsTransformPackingEnabled;
+					}
+					// NOTE: steps the contribution threshold through 0, 1, 2, 4 and 8 pixels
+					if(KeyCode == 'K')
+					{
+						ContributionCullPixels = (ContributionCullPixels >= 8.0f) ? 0.0f : max(ContributionCullPixels * 2.0f, 1.0f);
+					}
+					if(KeyCode == 'M')
+					{
+						IsSoftwareOcclusionEnabled = !IsSoftwareOcclusionEnabled;
+					}
+					if(KeyCode == 'G')
+					{
+						IsCullValidationRequested = true;
+					}
+					if(KeyCode == 'B')
+					{
+						IsCullBenchmarkRequested = true;
+					}
+					if(KeyCode == 'V')
+					{
+						IsViewCullBenchmarkRequested = true;
+					}
+					if(KeyCode == 'F')
+					{
+						IsDepthSortEnabled = !IsDepthSortEnabled;
+					}
+					if(KeyCode == 'N')
+					{
+						IsSortBenchmarkRequested = true;
+					}
 					if(KeyCode == 'P')
 					{
 						if(IsPyramidVisualized)
@@ -22,6 +22,10 @@ struct meshlet
 struct alignas(16) globals
 {
 	glm::mat4x4 Projection;
+
+	// NOTE: for meshlet occlusion in the task shader, the same values as in draw_cull_data
+	float P00, P11, znear;
+	float PyramidWidth, PyramidHeight;
 };
 
 struct alignas(16) mesh_offset
@@ -37,11 +41,56 @@ struct alignas(16) mesh_offset
 	u32 VertexOffset;
 };
 
+// NOTE: what the gpu gets of a mesh_offset, split into two streams. Culling reads the world space
+// sphere of every draw, the transform is only read for draws that survived it
+struct alignas(16) draw_sphere
+{
+	glm::vec3 Center;
+	float Radius;
+};
+
+struct alignas(16) draw_transform
+{
+	float Pos[3];
+	float Scale;
+	glm::quat Orient;
+
+	u32 MeshIndex;
+	u32 VertexOffset;
+};
+
+// NOTE: optional 20 byte encoding of a draw_transform. The position is split into a cell of
+// TRANSFORM_CELL_SIZE units, with signed 10 bit coordinates, and 16 bit unorm offsets inside of it.
+// The quaternion keeps its three smallest components at 10 bits with the index of the largest one
+// in the low 2 bits, the scale is a half. The vertex offset is the one of the mesh
+#define TRANSFORM_CELL_SIZE 64.0f
+#define TRANSFORM_CELL_BIAS 512
+
+struct packed_transform
+{
+	u32 Cell;
+	u32 PosXY;
+	u32 PosZScale;
+	u32 Orient;
+	u32 MeshIndex;
+};
+
+#define MAX_LODS 8
+
+// NOTE: draw ids of the gpu command streams, see mesh_headers.hlsl
+#define DRAW_ID_LOD_SHIFT 29
+#define DRAW_ID_INSTANCE_MASK ((1u << DRAW_ID_LOD_SHIFT) - 1)
+
+// NOTE: a command with the fields of both paths, cpu culling and its validation use it.
+// The gpu writes only the command of the active path and a draw id
 struct mesh_draw_command
 {
 	u32 DrawIndex;
 	VkDrawIndexedIndirectCommand DrawCommand;
 	VkDrawMeshTasksIndirectCommandNV MeshletDrawCommand;
+
+	// NOTE: task groups per instance, instanced commands launch this many groups for every instance
+	u32 MeshletGroupCount;
 };
 
 struct mesh_lod
@@ -51,6 +100,10 @@ struct mesh_lod
 
 	u32 MeshletOffset;
 	u32 MeshletCount;
+
+	// NOTE: vertices used by this lod are [VertexOffset, VertexOffset + VertexCount) of the mesh
+	// With progressive ordering this is a prefix that shrinks with every coarser lod
+	u32 VertexCount;
 };
 
 struct alignas(16) mesh
@@ -62,7 +115,17 @@ struct alignas(16) mesh
 	u32 VertexCount;
 
 	u32 LodCount;
-	mesh_lod Lods[8];
+
+	// NOTE: scales the contribution threshold of culling, important meshes use less than 1 and 0 never drops them
+	float ContributionScale;
+	mesh_lod Lods[MAX_LODS];
+};
+
+// NOTE: meshes loaded from one asset; they share the instance transform and are drawn together
+struct mesh_group
+{
+	u32 MeshOffset;
+	u32 MeshCount;
 };
 
 struct geometry
@@ -71,8 +134,237 @@ struct geometry
 	std::vector<u32> Indices;
 	std::vector<meshlet> Meshlets;
 	std::vector<mesh> Meshes;
+	std::vector<mesh_group> MeshGroups;
+};
+
+struct mesh_cook_options
+{
+	// NOTE: reorder vertices so that every lod references a prefix of the mesh vertex range
+	bool IsVertexOrderProgressive;
+
+	// NOTE: positions closer than this are merged and thinner triangles are dropped, 0 disables welding
+	float WeldEpsilon;
+
+	// NOTE: meshes with more triangles are split into spatially compact meshes of at most this many triangles, 0 disables splitting
+	u32 ChunkTriangleThreshold;
+
+	// NOTE: when not 0 the source is streamed through temporary files next to it and cooked
+	// in spatial partitions, so the working set of the cook stays below this many bytes.
+	// The geometry it produces is not a part of the budget, it is kept in a temporary file
+	// until the last partition is cooked and then read into the result at once
+	size_t MemoryBudget;
+};
+
+struct mapped_file
+{
+	HANDLE File;
+	HANDLE Mapping;
+
+	void* Data;
+	size_t Size;
 };
 
+// NOTE: writable mappings create the file with the requested size, read only mappings cover the whole file
+internal bool
+MapFile(mapped_file& Result, const char* Path, bool IsWritable = false, size_t Size = 0)
+{
+	Result = {};
+	Result.File = CreateFileA(Path, IsWritable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ, FILE_SHARE_READ, 0, 
+							  IsWritable ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if(Result.File == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	if(!IsWritable)
+	{
+		LARGE_INTEGER FileSize;
+		GetFileSizeEx(Result.File, &FileSize);
+		Size = size_t(FileSize.QuadPart);
+	}
+
+	Result.Size = Size;
+	if(Size == 0)
+	{
+		// NOTE: empty files can't be mapped
+		return true;
+	}
+
+	Result.Mapping = CreateFileMappingA(Result.File, 0, IsWritable ? PAGE_READWRITE : PAGE_READONLY, DWORD(u64(Size) >> 32), DWORD(u64(Size) & 0xffffffff), 0);
+	if(Result.Mapping)
+	{
+		Result.Data = MapViewOfFile(Result.Mapping, IsWritable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, Size);
+	}
+
+	if(!Result.Data)
+	{
+		if(Result.Mapping) CloseHandle(Result.Mapping);
+		CloseHandle(Result.File);
+		Result = {};
+		return false;
+	}
+
+	return true;
+}
+
+internal void
+UnmapFile(mapped_file& File)
+{
+	if(File.Data) UnmapViewOfFile(File.Data);
+	if(File.Mapping) CloseHandle(File.Mapping);
+	if(File.File && File.File != INVALID_HANDLE_VALUE) CloseHandle(File.File);
+	File = {};
+}
+
+internal vertex
+MakeVertex(const float* Position, const float* TextureCoord, const float* Normal)
+{
+	vertex Result = {};
+
+	Result.vx = Position[0];
+	Result.vy = Position[1];
+	Result.vz = Position[2];
+
+	float nx = Normal ? Normal[0] : 0.f;
+	float ny = Normal ? Normal[1] : 0.f;
+	float nz = Normal ? Normal[2] : 0.f;
+
+	Result.norm = ((u8)(nx * 127 + 127) << 24) | ((u8)(ny * 127 + 127) << 16) | ((u8)(nz * 127 + 127) << 8) | 0;
+
+	Result.tu = meshopt_quantizeHalf(TextureCoord ? TextureCoord[0] : 0.f);
+	Result.tv = meshopt_quantizeHalf(TextureCoord ? TextureCoord[1] : 0.f);
+
+	return Result;
+}
+
+internal float
+DequantizeHalf(u16 Value)
+{
+	u32 Exponent = (Value >> 10) & 0x1f;
+	u32 Mantissa = Value & 0x3ff;
+	assert(Exponent != 0x1f);
+
+	float Result = ldexpf(float(Mantissa), -24);
+	if(Exponent)
+	{
+		u32 Bits = ((Exponent + 112) << 23) | (Mantissa << 13);
+		memcpy(&Result, &Bits, sizeof(Result));
+	}
+
+	return (Value & 0x8000) ? -Result : Result;
+}
+
+// NOTE: the cells reach +-TRANSFORM_CELL_BIAS cells from the origin, about 32k units with 64 unit cells
+internal bool
+IsDrawTransformPackable(const draw_transform& Transform)
+{
+	for(u32 Axis = 0;
+		Axis < 3;
+		++Axis)
+	{
+		float CellPosition = floorf(Transform.Pos[Axis] / TRANSFORM_CELL_SIZE);
+		if(!(CellPosition >= -TRANSFORM_CELL_BIAS && CellPosition < 1024 - TRANSFORM_CELL_BIAS))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+internal packed_transform
+PackDrawTransform(const draw_transform& Transform)
+{
+	packed_transform Result = {};
+
+	u32 Cell[3], Offset[3];
+	for(u32 Axis = 0;
+		Axis < 3;
+		++Axis)
+	{
+		float Position = Transform.Pos[Axis] / TRANSFORM_CELL_SIZE;
+		float CellPosition = floorf(Position);
+		s32 CellIndex = s32(CellPosition) + TRANSFORM_CELL_BIAS;
+		assert(CellIndex >= 0 && CellIndex < 1024);
+
+		Cell[Axis] = u32(CellIndex);
+		Offset[Axis] = u32(meshopt_quantizeUnorm(Position - CellPosition, 16));
+	}
+
+	Result.Cell = (Cell[0] << 20) | (Cell[1] << 10) | Cell[2];
+	Result.PosXY = (Offset[1] << 16) | Offset[0];
+	Result.PosZScale = (u32(meshopt_quantizeHalf(Transform.Scale)) << 16) | Offset[2];
+
+	// NOTE: q and -q are the same rotation, the largest component is made positive so it can be
+	// rebuilt from the other three, which are then within [-1/sqrt(2), 1/sqrt(2)]
+	float Quat[4] = {Transform.Orient.x, Transform.Orient.y, Transform.Orient.z, Transform.Orient.w};
+	u32 Largest = 0;
+	for(u32 Component = 1;
+		Component < 4;
+		++Component)
+	{
+		Largest = fabsf(Quat[Component]) > fabsf(Quat[Largest]) ? Component : Largest;
+	}
+
+	float Sign = Quat[Largest] < 0.0f ? -1.0f : 1.0f;
+	u32 Shift = 22;
+	Result.Orient = Largest;
+	for(u32 Component = 0;
+		Component < 4;
+		++Component)
+	{
+		if(Component == Largest) continue;
+
+		float Value = Quat[Component] * Sign * 0.70710678f + 0.5f;
+		Result.Orient |= u32(meshopt_quantizeUnorm(Value, 10)) << Shift;
+		Shift -= 10;
+	}
+
+	Result.MeshIndex = Transform.MeshIndex;
+	return Result;
+}
+
+// NOTE: the same decoding as UnpackDrawTransform in mesh_headers.hlsl
+internal draw_transform
+UnpackDrawTransform(const packed_transform& Packed, u32 VertexOffset)
+{
+	draw_transform Result = {};
+
+	u32 Offset[3] = {Packed.PosXY & 0xffff, Packed.PosXY >> 16, Packed.PosZScale & 0xffff};
+	for(u32 Axis = 0;
+		Axis < 3;
+		++Axis)
+	{
+		s32 CellIndex = s32((Packed.Cell >> (20 - Axis * 10)) & 1023) - TRANSFORM_CELL_BIAS;
+		Result.Pos[Axis] = (float(CellIndex) + float(Offset[Axis]) / 65535.0f) * TRANSFORM_CELL_SIZE;
+	}
+	Result.Scale = DequantizeHalf(u16(Packed.PosZScale >> 16));
+
+	float Small[3];
+	for(u32 Component = 0;
+		Component < 3;
+		++Component)
+	{
+		u32 Value = (Packed.Orient >> (22 - Component * 10)) & 1023;
+		Small[Component] = (float(Value) / 1023.0f - 0.5f) * 1.41421356f;
+	}
+
+	u32 Largest = Packed.Orient & 3;
+	float Quat[4];
+	for(u32 Component = 0, SmallIndex = 0;
+		Component < 4;
+		++Component)
+	{
+		Quat[Component] = Component == Largest ? 0.0f : Small[SmallIndex++];
+	}
+	Quat[Largest] = sqrtf(max(1.0f - (Small[0] * Small[0] + Small[1] * Small[1] + Small[2] * Small[2]), 0.0f));
+
+	Result.Orient = glm::quat(Quat[3], Quat[0], Quat[1], Quat[2]);
+	Result.MeshIndex = Packed.MeshIndex;
+	Result.VertexOffset = VertexOffset;
+	return Result;
+}
+
 internal size_t
 BuildMeshlets(geometry& Result, std::vector<vertex>& Vertices, std::vector<u32>& Indices)
 {
@@ -125,56 +417,294 @@ BuildMeshlets(geometry& Result, std::vector<vertex>& Vertices, std::vector<u32>&
 	return BuildMeshlets.size();
 }
 
-internal bool
-LoadMesh(geometry& Result, const char* Path, bool MakeMeshlets)
+internal u32
+HashWeldCell(s32 X, s32 Y, s32 Z)
 {
-	ObjFile File;
-	if(!objParseFile(File, Path))
+	return (u32(X) * 73856093) ^ (u32(Y) * 19349663) ^ (u32(Z) * 83492791);
+}
+
+// NOTE: snaps every position to the first position found within Epsilon of it.
+// Positions are bucketed into a grid with Epsilon sized cells, so only 27 neighbour cells are searched
+internal void
+WeldVertexPositions(std::vector<vertex>& Vertices, float Epsilon)
+{
+	size_t TableSize = 1;
+	while(TableSize < Vertices.size() * 2)
 	{
-		return false;
+		TableSize *= 2;
 	}
-	size_t IndexCount = File.f_size / 3;
-	std::vector<vertex> TriangleVertices(IndexCount);
+
+	std::vector<u32> Table(TableSize, ~0u);
+	std::vector<s32> Cells(Vertices.size() * 3);
+
+	float InvCellSize = 1.0f / Epsilon;
+	float EpsilonSq = Epsilon * Epsilon;
 
 	for(u32 VertexIndex = 0;
-		VertexIndex < IndexCount;
+		VertexIndex < Vertices.size();
 		++VertexIndex)
 	{
-		vertex& V = TriangleVertices[VertexIndex];
+		vertex& Vertex = Vertices[VertexIndex];
 
-		int VIndex = File.f[VertexIndex * 3 + 0];
-		int VTextureIndex = File.f[VertexIndex * 3 + 1];
-		int VNormalIndex = File.f[VertexIndex * 3 + 2];
+		s32 CellX = s32(floorf(Vertex.vx * InvCellSize));
+		s32 CellY = s32(floorf(Vertex.vy * InvCellSize));
+		s32 CellZ = s32(floorf(Vertex.vz * InvCellSize));
+
+		u32 Representative = ~0u;
+		for(s32 NeighbourIndex = 0;
+			NeighbourIndex < 27 && Representative == ~0u;
+			++NeighbourIndex)
+		{
+			s32 NeighbourX = CellX + NeighbourIndex % 3 - 1;
+			s32 NeighbourY = CellY + (NeighbourIndex / 3) % 3 - 1;
+			s32 NeighbourZ = CellZ + NeighbourIndex / 9 - 1;
+
+			for(u32 Slot = HashWeldCell(NeighbourX, NeighbourY, NeighbourZ) & (TableSize - 1);
+				Table[Slot] != ~0u;
+				Slot = (Slot + 1) & (TableSize - 1))
+			{
+				u32 Candidate = Table[Slot];
+				if(Cells[Candidate * 3 + 0] != NeighbourX || Cells[Candidate * 3 + 1] != NeighbourY || Cells[Candidate * 3 + 2] != NeighbourZ)
+				{
+					continue;
+				}
 
-		V.vx = File.v[VIndex * 3 + 0];
-		V.vy = File.v[VIndex * 3 + 1];
-		V.vz = File.v[VIndex * 3 + 2];
+				const vertex& Other = Vertices[Candidate];
+				float dx = Other.vx - Vertex.vx;
+				float dy = Other.vy - Vertex.vy;
+				float dz = Other.vz - Vertex.vz;
+				if(dx * dx + dy * dy + dz * dz <= EpsilonSq)
+				{
+					Representative = Candidate;
+					break;
+				}
+			}
+		}
 
-		float nx = VNormalIndex < 0 ? 0.f : File.vn[VNormalIndex * 3 + 0];
-		float ny = VNormalIndex < 0 ? 0.f : File.vn[VNormalIndex * 3 + 1];
-		float nz = VNormalIndex < 0 ? 0.f : File.vn[VNormalIndex * 3 + 2];
+		if(Representative != ~0u)
+		{
+			Vertex.vx = Vertices[Representative].vx;
+			Vertex.vy = Vertices[Representative].vy;
+			Vertex.vz = Vertices[Representative].vz;
+			continue;
+		}
 
-		V.norm = ((u8)(nx * 127 + 127) << 24) | ((u8)(ny * 127 + 127) << 16) | ((u8)(nz * 127 + 127) << 8) | 0;
+		Cells[VertexIndex * 3 + 0] = CellX;
+		Cells[VertexIndex * 3 + 1] = CellY;
+		Cells[VertexIndex * 3 + 2] = CellZ;
 
-		V.tu = meshopt_quantizeHalf(VTextureIndex < 0 ? 0.f : File.vt[VTextureIndex * 3 + 0]);
-		V.tv = meshopt_quantizeHalf(VTextureIndex < 0 ? 0.f : File.vt[VTextureIndex * 3 + 1]);
+		u32 Slot = HashWeldCell(CellX, CellY, CellZ) & (TableSize - 1);
+		while(Table[Slot] != ~0u)
+		{
+			Slot = (Slot + 1) & (TableSize - 1);
+		}
+		Table[Slot] = VertexIndex;
 	}
+}
 
-	std::vector<u32> Remap(IndexCount);
-	size_t VertexCount = meshopt_generateVertexRemap(Remap.data(), 0, IndexCount, TriangleVertices.data(), IndexCount, sizeof(vertex));
+// NOTE: drops triangles that reference one vertex twice or whose smallest height is below Epsilon
+internal size_t
+RemoveDegenerateTriangles(std::vector<u32>& Indices, const std::vector<vertex>& Vertices, float Epsilon)
+{
+	size_t IndexCount = 0;
+	for(size_t TriangleIndex = 0;
+		TriangleIndex < Indices.size() / 3;
+		++TriangleIndex)
+	{
+		u32 A = Indices[TriangleIndex * 3 + 0];
+		u32 B = Indices[TriangleIndex * 3 + 1];
+		u32 C = Indices[TriangleIndex * 3 + 2];
 
-	std::vector<vertex> Vertices(VertexCount);
-	std::vector<u32> Indices(IndexCount);
+		if(A == B || B == C || C == A)
+		{
+			continue;
+		}
 
-	meshopt_remapVertexBuffer(Vertices.data(), TriangleVertices.data(), IndexCount, sizeof(vertex), Remap.data());
-	meshopt_remapIndexBuffer(Indices.data(), 0, IndexCount, Remap.data());
+		glm::vec3 PosA(Vertices[A].vx, Vertices[A].vy, Vertices[A].vz);
+		glm::vec3 PosB(Vertices[B].vx, Vertices[B].vy, Vertices[B].vz);
+		glm::vec3 PosC(Vertices[C].vx, Vertices[C].vy, Vertices[C].vz);
+
+		float DoubleArea = glm::length(glm::cross(PosB - PosA, PosC - PosA));
+		float LongestEdge = max(glm::distance(PosA, PosB), max(glm::distance(PosB, PosC), glm::distance(PosC, PosA)));
+
+		if(DoubleArea <= Epsilon * LongestEdge)
+		{
+			continue;
+		}
+
+		Indices[IndexCount++] = A;
+		Indices[IndexCount++] = B;
+		Indices[IndexCount++] = C;
+	}
+
+	size_t RemovedTriangleCount = (Indices.size() - IndexCount) / 3;
+	Indices.resize(IndexCount);
+
+	return RemovedTriangleCount;
+}
+
+// NOTE: welds the positions of an indexed mesh, merges the vertices that became equal and drops the
+// degenerate triangles. Returns false when no triangle is left
+internal bool
+WeldMesh(std::vector<vertex>& Vertices, std::vector<u32>& Indices, float Epsilon, const char* Path)
+{
+	size_t UnweldedVertexCount = Vertices.size();
+	WeldVertexPositions(Vertices, Epsilon);
+
+	std::vector<u32> Remap(Vertices.size());
+	size_t VertexCount = meshopt_generateVertexRemap(Remap.data(), Indices.data(), Indices.size(), Vertices.data(), Vertices.size(), sizeof(vertex));
+	meshopt_remapVertexBuffer(Vertices.data(), Vertices.data(), Vertices.size(), sizeof(vertex), Remap.data());
+	meshopt_remapIndexBuffer(Indices.data(), Indices.data(), Indices.size(), Remap.data());
+	Vertices.resize(VertexCount);
+
+	size_t RemovedTriangleCount = RemoveDegenerateTriangles(Indices, Vertices, Epsilon);
+	if(Indices.empty())
+	{
+		printf("%s: all %zu triangles are degenerate at weld epsilon %g\n", Path, RemovedTriangleCount, Epsilon);
+		return false;
+	}
+
+	// NOTE: vertices only referenced by removed triangles are dropped by the fetch optimization
+	size_t WeldedVertexCount = meshopt_optimizeVertexFetch(Vertices.data(), Indices.data(), Indices.size(), Vertices.data(), VertexCount, sizeof(vertex));
+	Vertices.resize(WeldedVertexCount);
+
+	printf("%s: welded %zu -> %zu vertices (%.1f%%), removed %zu degenerate triangles\n", Path,
+		   UnweldedVertexCount, WeldedVertexCount, 100.0 * (1.0 - double(WeldedVertexCount) / double(UnweldedVertexCount)), RemovedTriangleCount);
+
+	return true;
+}
+
+// NOTE: vertices of the coarsest lod go first, then the ones each finer lod adds.
+// Simplification only removes vertices, so every lod ends up referencing a prefix of the range
+internal void
+OptimizeVertexFetchProgressive(std::vector<vertex>& Vertices, std::vector<std::vector<u32>>& LodIndices, u32* LodVertexCounts)
+{
+	std::vector<u32> Remap(Vertices.size(), ~0u);
+	u32 NextVertex = 0;
+
+	for(size_t LodIndex = LodIndices.size();
+		LodIndex > 0;
+		--LodIndex)
+	{
+		for(u32 Index : LodIndices[LodIndex - 1])
+		{
+			if(Remap[Index] == ~0u)
+			{
+				Remap[Index] = NextVertex++;
+			}
+		}
+
+		LodVertexCounts[LodIndex - 1] = NextVertex;
+	}
+
+	std::vector<vertex> NewVertices(NextVertex);
+	for(u32 VertexIndex = 0;
+		VertexIndex < Vertices.size();
+		++VertexIndex)
+	{
+		if(Remap[VertexIndex] != ~0u)
+		{
+			NewVertices[Remap[VertexIndex]] = Vertices[VertexIndex];
+		}
+	}
+
+	for(std::vector<u32>& Indices : LodIndices)
+	{
+		for(u32& Index : Indices)
+		{
+			Index = Remap[Index];
+		}
+	}
+
+	Vertices.swap(NewVertices);
+}
+
+// NOTE: positions for the simplifier, which never moves a position shared by more vertices than it can
+// classify as a seam. An unreferenced copy of the position puts a vertex into that class, so every
+// locked vertex gets one appended after the vertices of the mesh. Debug builds check at startup that
+// no lod loses a border position, see ValidateChunkBorders
+internal void
+BuildLockedPositions(std::vector<float>& Positions, const std::vector<vertex>& Vertices, const std::vector<u8>& VertexLock)
+{
+	Positions.clear();
+	Positions.reserve(Vertices.size() * 3);
+	for(const vertex& Vertex : Vertices)
+	{
+		Positions.insert(Positions.end(), {Vertex.vx, Vertex.vy, Vertex.vz});
+	}
+
+	for(size_t VertexIndex = 0;
+		VertexIndex < VertexLock.size();
+		++VertexIndex)
+	{
+		if(VertexLock[VertexIndex])
+		{
+			const vertex& Vertex = Vertices[VertexIndex];
+			Positions.insert(Positions.end(), {Vertex.vx, Vertex.vy, Vertex.vz});
+		}
+	}
+}
+
+internal void
+CookMesh(geometry& Result, std::vector<vertex>& Vertices, std::vector<u32>& Indices, bool MakeMeshlets, const mesh_cook_options& Options, std::vector<u8>& VertexLock)
+{
+	size_t VertexCount = Vertices.size();
+	size_t IndexCount = Indices.size();
 
 	meshopt_optimizeVertexCache(Indices.data(), Indices.data(), IndexCount, VertexCount);
-	meshopt_optimizeVertexFetch(Vertices.data(), Indices.data(), IndexCount, Vertices.data(), VertexCount, sizeof(vertex));
+
+	std::vector<u32> FetchRemap(VertexCount);
+	VertexCount = meshopt_optimizeVertexFetchRemap(FetchRemap.data(), Indices.data(), IndexCount, VertexCount);
+	meshopt_remapIndexBuffer(Indices.data(), Indices.data(), IndexCount, FetchRemap.data());
+	meshopt_remapVertexBuffer(Vertices.data(), Vertices.data(), Vertices.size(), sizeof(vertex), FetchRemap.data());
+	if(!VertexLock.empty())
+	{
+		meshopt_remapVertexBuffer(VertexLock.data(), VertexLock.data(), VertexLock.size(), sizeof(u8), FetchRemap.data());
+		VertexLock.resize(VertexCount);
+	}
+	Vertices.resize(VertexCount);
 
 	mesh NewMeshData = {};
 
-	//meshopt_simplify();
+	std::vector<float> SimplifyPositions;
+	BuildLockedPositions(SimplifyPositions, Vertices, VertexLock);
+
+	std::vector<std::vector<u32>> LodIndices;
+	LodIndices.push_back(Indices);
+
+	while(LodIndices.size() < ArraySize(NewMeshData.Lods))
+	{
+		std::vector<u32> NextLodIndices = LodIndices.back();
+
+		size_t NextIndicesTarget = size_t(NextLodIndices.size() * 0.75);
+		size_t NextIndices = meshopt_simplify(NextLodIndices.data(), NextLodIndices.data(), NextLodIndices.size(), SimplifyPositions.data(), SimplifyPositions.size() / 3, sizeof(float) * 3, 
+											  NextIndicesTarget, 1e-4f);
+
+		if(NextIndices == NextLodIndices.size())
+		{
+			break;
+		}
+
+		NextLodIndices.resize(NextIndices);
+		meshopt_optimizeVertexCache(NextLodIndices.data(), NextLodIndices.data(), NextLodIndices.size(), VertexCount);
+
+		LodIndices.push_back(NextLodIndices);
+	}
+	std::vector<float>().swap(SimplifyPositions);
+
+	u32 LodVertexCounts[ArraySize(NewMeshData.Lods)];
+	if(Options.IsVertexOrderProgressive)
+	{
+		OptimizeVertexFetchProgressive(Vertices, LodIndices, LodVertexCounts);
+		VertexCount = Vertices.size();
+	}
+	else
+	{
+		for(u32& LodVertexCount : LodVertexCounts)
+		{
+			LodVertexCount = u32(VertexCount);
+		}
+	}
 
 	NewMeshData.VertexOffset = u32(Result.Vertices.size());
 	NewMeshData.VertexCount = (u32)VertexCount;
@@ -192,44 +722,901 @@ LoadMesh(geometry& Result, const char* Path, bool MakeMeshlets)
 	for(const vertex& Vertex : Vertices)
 	{
 		float NewRadius = glm::distance(Center, glm::vec3(Vertex.vx, Vertex.vy, Vertex.vz));
-		Radius += Radius < NewRadius ? Radius : NewRadius;
+		Radius = max(Radius, NewRadius);
 	}
 
 	NewMeshData.Radius   = Radius;
 	NewMeshData.Center   = Center;
+	NewMeshData.ContributionScale = 1.0f;
 
-	u32 LodIndex = 0;
-	std::vector<u32> LodIndices = Indices;
-
-	while(NewMeshData.LodCount < ArraySize(NewMeshData.Lods))
+	for(std::vector<u32>& CurrentLodIndices : LodIndices)
 	{
-		mesh_lod& Lod = NewMeshData.Lods[NewMeshData.LodCount++];
+		mesh_lod& Lod = NewMeshData.Lods[NewMeshData.LodCount];
 
 		Lod.IndexOffset   = u32(Result.Indices.size());
-		Lod.IndexCount    = u32(LodIndices.size());
+		Lod.IndexCount    = u32(CurrentLodIndices.size());
+		Lod.VertexCount   = LodVertexCounts[NewMeshData.LodCount];
 
-		Result.Indices.insert(Result.Indices.end(), LodIndices.begin(), LodIndices.end());
+		Result.Indices.insert(Result.Indices.end(), CurrentLodIndices.begin(), CurrentLodIndices.end());
 
 		Lod.MeshletOffset = u32(Result.Meshlets.size());
-		Lod.MeshletCount  = MakeMeshlets ? (u32)BuildMeshlets(Result, Vertices, LodIndices) : 0;
+		Lod.MeshletCount  = MakeMeshlets ? (u32)BuildMeshlets(Result, Vertices, CurrentLodIndices) : 0;
 
-		if(NewMeshData.LodCount < ArraySize(NewMeshData.Lods))
-		{
-			size_t NextIndicesTarget = size_t(LodIndices.size() * 0.75);
-			size_t NextIndices = meshopt_simplify(LodIndices.data(), LodIndices.data(), LodIndices.size(), &Vertices[0].vx, Vertices.size(), sizeof(vertex), NextIndicesTarget, 1e-4f);
+		NewMeshData.LodCount++;
+	}
+
+	Result.Meshes.push_back(NewMeshData);
+}
+
+// NOTE: triangles are sorted along a space filling curve and cut into runs of ChunkTriangleCount,
+// so every chunk is spatially compact. Positions shared between chunks are locked for simplification
+// to keep the borders between chunk lods watertight
+internal void
+CookMeshChunks(geometry& Result, const std::vector<vertex>& Vertices, std::vector<u32>& Indices, bool MakeMeshlets, const mesh_cook_options& Options, u32 ChunkTriangleCount)
+{
+	size_t VertexCount = Vertices.size();
+	size_t TriangleCount = Indices.size() / 3;
+
+	meshopt_spatialSortTriangles(Indices.data(), Indices.data(), Indices.size(), &Vertices[0].vx, VertexCount, sizeof(vertex));
+
+	// NOTE: the remap compares tightly packed vertices of whole triangles, so it gets the positions alone
+	// and identity indices padded with the last vertex
+	std::vector<float> Positions;
+	BuildLockedPositions(Positions, Vertices, {});
+
+	std::vector<u32> PositionIndices((VertexCount + 2) / 3 * 3);
+	for(size_t Index = 0;
+		Index < PositionIndices.size();
+		++Index)
+	{
+		PositionIndices[Index] = u32(min(Index, VertexCount - 1));
+	}
 
-			if(NextIndices == LodIndices.size())
+	std::vector<u32> PositionRemap(VertexCount);
+	meshopt_generateVertexRemap(PositionRemap.data(), PositionIndices.data(), PositionIndices.size(), Positions.data(), VertexCount, sizeof(float) * 3);
+	std::vector<float>().swap(Positions);
+
+	std::vector<u32> PositionChunk(VertexCount, ~0u);
+	std::vector<u8> IsPositionShared(VertexCount, 0);
+	for(size_t TriangleIndex = 0;
+		TriangleIndex < TriangleCount;
+		++TriangleIndex)
+	{
+		u32 ChunkIndex = u32(TriangleIndex / ChunkTriangleCount);
+		for(u32 CornerIndex = 0;
+			CornerIndex < 3;
+			++CornerIndex)
+		{
+			u32 Position = PositionRemap[Indices[TriangleIndex * 3 + CornerIndex]];
+			if(PositionChunk[Position] == ~0u)
 			{
-				break;
+				PositionChunk[Position] = ChunkIndex;
+			}
+			else if(PositionChunk[Position] != ChunkIndex)
+			{
+				IsPositionShared[Position] = 1;
 			}
-
-			LodIndices.resize(NextIndices);
-			meshopt_optimizeVertexCache(LodIndices.data(), LodIndices.data(), LodIndices.size(), VertexCount);
 		}
 	}
 
-	Result.Meshes.push_back(NewMeshData);
+	// NOTE: vertices are numbered in the order the chunk first uses them. Only the entries of the chunk
+	// are touched and reset afterwards, so the split costs the size of the chunks and not of the mesh
+	std::vector<u32> ChunkRemap(VertexCount, ~0u);
+	for(size_t FirstTriangle = 0;
+		FirstTriangle < TriangleCount;
+		FirstTriangle += ChunkTriangleCount)
+	{
+		size_t ChunkIndexCount = min(size_t(ChunkTriangleCount), TriangleCount - FirstTriangle) * 3;
+		const u32* SourceIndices = Indices.data() + FirstTriangle * 3;
+
+		std::vector<u32> ChunkIndices(ChunkIndexCount);
+		std::vector<vertex> ChunkVertices;
+		std::vector<u8> ChunkVertexLock;
+		for(size_t Index = 0;
+			Index < ChunkIndexCount;
+			++Index)
+		{
+			u32 VertexIndex = SourceIndices[Index];
+			if(ChunkRemap[VertexIndex] == ~0u)
+			{
+				ChunkRemap[VertexIndex] = u32(ChunkVertices.size());
+				ChunkVertices.push_back(Vertices[VertexIndex]);
+				ChunkVertexLock.push_back(IsPositionShared[PositionRemap[VertexIndex]]);
+			}
+
+			ChunkIndices[Index] = ChunkRemap[VertexIndex];
+		}
+
+		for(size_t Index = 0;
+			Index < ChunkIndexCount;
+			++Index)
+		{
+			ChunkRemap[SourceIndices[Index]] = ~0u;
+		}
+
+		CookMesh(Result, ChunkVertices, ChunkIndices, MakeMeshlets, Options, ChunkVertexLock);
+	}
+}
+
+// NOTE: out of core cook. The first pass streams the obj into flat temporary files of positions,
+// texture coordinates, normals and triangles. The triangles are then split at the midpoint of the
+// longest axis of their centroid bounds until a partition fits the memory budget. Positions referenced
+// by more than one partition are locked, so that partitions can be simplified independently
+// and still meet at the borders. Every partition becomes one mesh of the loaded mesh group.
+// Welding is skipped here, snapped positions would differ between partitions
+struct out_of_core_stream
+{
+	FILE* Positions;
+	FILE* TextureCoords;
+	FILE* Normals;
+	FILE* Triangles;
+
+	size_t TriangleCount;
+	float Min[3];
+	float Max[3];
+};
+
+struct mesh_partition
+{
+	char Path[MAX_PATH];
+	size_t TriangleCount;
+
+	// NOTE: bounds of triangle centroids
+	float Min[3];
+	float Max[3];
+};
+
+#define OUT_OF_CORE_BLOCK_TRIANGLES 4096
+
+internal void
+OutOfCoreVertex(void* Context, char Type, const float* Data)
+{
+	out_of_core_stream* Stream = (out_of_core_stream*)Context;
+
+	if(Type == 'v')
+	{
+		fwrite(Data, sizeof(float), 3, Stream->Positions);
+		for(u32 Axis = 0; Axis < 3; ++Axis)
+		{
+			Stream->Min[Axis] = min(Stream->Min[Axis], Data[Axis]);
+			Stream->Max[Axis] = max(Stream->Max[Axis], Data[Axis]);
+		}
+	}
+	else
+	{
+		fwrite(Data, sizeof(float), 3, Type == 't' ? Stream->TextureCoords : Stream->Normals);
+	}
+}
+
+internal void
+OutOfCoreTriangle(void* Context, const int* Indices)
+{
+	out_of_core_stream* Stream = (out_of_core_stream*)Context;
+
+	fwrite(Indices, sizeof(int), 9, Stream->Triangles);
+	Stream->TriangleCount++;
+}
+
+internal void
+ResetPartitionBounds(mesh_partition& Partition)
+{
+	for(u32 Axis = 0; Axis < 3; ++Axis)
+	{
+		Partition.Min[Axis] =  FLT_MAX;
+		Partition.Max[Axis] = -FLT_MAX;
+	}
+}
+
+internal void
+GetTriangleCentroid(float* Centroid, const int* Triangle, const float* Positions)
+{
+	for(u32 Axis = 0; Axis < 3; ++Axis)
+	{
+		Centroid[Axis] = (Positions[Triangle[0] * 3 + Axis] + Positions[Triangle[3] * 3 + Axis] + Positions[Triangle[6] * 3 + Axis]) / 3.0f;
+	}
+}
+
+// NOTE: triangles are streamed through a fixed block, so splitting doesn't depend on the partition size.
+// Partitions whose centroids all coincide are split by triangle order instead
+internal bool
+SplitMeshPartition(const mesh_partition& Source, mesh_partition& Left, mesh_partition& Right, const float* Positions)
+{
+	u32 SplitAxis = 0;
+	for(u32 Axis = 1; Axis < 3; ++Axis)
+	{
+		if(Source.Max[Axis] - Source.Min[Axis] > Source.Max[SplitAxis] - Source.Min[SplitAxis])
+		{
+			SplitAxis = Axis;
+		}
+	}
+
+	float SplitPosition = (Source.Min[SplitAxis] + Source.Max[SplitAxis]) * 0.5f;
+	bool IsSplitByOrder = Source.Max[SplitAxis] <= Source.Min[SplitAxis];
+
+	FILE* SourceFile = fopen(Source.Path, "rb");
+	FILE* LeftFile = fopen(Left.Path, "wb");
+	FILE* RightFile = fopen(Right.Path, "wb");
+	if(!SourceFile || !LeftFile || !RightFile)
+	{
+		if(SourceFile) fclose(SourceFile);
+		if(LeftFile) fclose(LeftFile);
+		if(RightFile) fclose(RightFile);
+		return false;
+	}
+
+	Left.TriangleCount = Right.TriangleCount = 0;
+	ResetPartitionBounds(Left);
+	ResetPartitionBounds(Right);
+
+	std::vector<int> Block(OUT_OF_CORE_BLOCK_TRIANGLES * 9);
+	size_t TriangleIndex = 0;
+	while(size_t BlockTriangleCount = fread(Block.data(), sizeof(int) * 9, OUT_OF_CORE_BLOCK_TRIANGLES, SourceFile))
+	{
+		for(size_t BlockTriangle = 0;
+			BlockTriangle < BlockTriangleCount;
+			++BlockTriangle, ++TriangleIndex)
+		{
+			const int* Triangle = &Block[BlockTriangle * 9];
+
+			float Centroid[3];
+			GetTriangleCentroid(Centroid, Triangle, Positions);
+
+			bool IsLeft = IsSplitByOrder ? (TriangleIndex < Source.TriangleCount / 2) : (Centroid[SplitAxis] < SplitPosition);
+			mesh_partition& Target = IsLeft ? Left : Right;
+
+			fwrite(Triangle, sizeof(int), 9, IsLeft ? LeftFile : RightFile);
+			Target.TriangleCount++;
+			for(u32 Axis = 0; Axis < 3; ++Axis)
+			{
+				Target.Min[Axis] = min(Target.Min[Axis], Centroid[Axis]);
+				Target.Max[Axis] = max(Target.Max[Axis], Centroid[Axis]);
+			}
+		}
+	}
+
+	fclose(SourceFile);
+	fclose(LeftFile);
+	fclose(RightFile);
+
+	return true;
+}
+
+// NOTE: peak memory of cooking a partition of TriangleCount triangles, with at most 3 vertices per
+// triangle. The partition mesh with its lock and the fetch remap of CookMesh are alive through all of it,
+// the peak is either the lod chain or the output of the partition:
+// - the lod chain is at most 4 times the source indices. Next to it are the simplifier positions with
+//   a copy of every locked vertex and what meshopt_simplify allocates: adjacency, position table, remap,
+//   wedge, loop, positions, quadric, collapse remap, kind and lock per vertex, adjacency, collapse and
+//   its order per index
+// - the output gets the vertices, the lod chain and the meshlets of every lod, counted at the bound of
+//   meshopt_buildMeshletsBound. Indices and meshlets grow one lod at a time, so they count 3 times,
+//   the old and the new allocation are alive while they grow
+internal size_t
+GetPartitionCookBytes(size_t TriangleCount)
+{
+	size_t VertexCount = TriangleCount * 3;
+	size_t IndexCount = TriangleCount * 3;
+	size_t SimplifyVertexCount = VertexCount * 2;
+	size_t LodIndexCount = IndexCount * 4;
+
+	size_t MeshBytes = VertexCount * (sizeof(vertex) + sizeof(u8) + sizeof(u32)) + IndexCount * sizeof(u32);
+
+	size_t LodChainBytes = (LodIndexCount + IndexCount) * sizeof(u32) + SimplifyVertexCount * sizeof(float) * 3 + 
+						   SimplifyVertexCount * (sizeof(u32) * 7 + sizeof(float) * 3 + sizeof(float) * 11 + sizeof(u32) + sizeof(u8) * 2) + 
+						   IndexCount * sizeof(u32) * 5;
+
+	size_t OutputBytes = LodIndexCount * sizeof(u32) + VertexCount * sizeof(vertex) + LodIndexCount * sizeof(u32) * 3 + 
+						 meshopt_buildMeshletsBound(LodIndexCount, 64, 126) * sizeof(meshlet) * 3 + 
+						 meshopt_buildMeshletsBound(IndexCount, 64, 126) * sizeof(meshopt_Meshlet);
+
+	return MeshBytes + max(LodChainBytes, OutputBytes);
+}
+
+internal void
+CookMeshPartition(geometry& Result, const mesh_partition& Partition, u32 PartitionTag, const mapped_file& Positions, const mapped_file& TextureCoords, const mapped_file& Normals, 
+				  const u32* PositionOwners, bool MakeMeshlets, const mesh_cook_options& Options)
+{
+	size_t IndexCount = Partition.TriangleCount * 3;
+	std::vector<int> Triangles(IndexCount * 3);
+
+	FILE* File = fopen(Partition.Path, "rb");
+	if(!File)
+	{
+		return;
+	}
+	size_t ReadTriangleCount = fread(Triangles.data(), sizeof(int) * 9, Partition.TriangleCount, File);
+	fclose(File);
+	assert(ReadTriangleCount == Partition.TriangleCount);
+
+	const float* PositionData = (const float*)Positions.Data;
+	const float* TextureCoordData = (const float*)TextureCoords.Data;
+	const float* NormalData = (const float*)Normals.Data;
+
+	std::vector<vertex> TriangleVertices(IndexCount);
+	std::vector<u8> TriangleVertexLock(IndexCount);
+	for(size_t VertexIndex = 0;
+		VertexIndex < IndexCount;
+		++VertexIndex)
+	{
+		int VIndex = Triangles[VertexIndex * 3 + 0];
+		int VTextureIndex = Triangles[VertexIndex * 3 + 1];
+		int VNormalIndex = Triangles[VertexIndex * 3 + 2];
+
+		TriangleVertices[VertexIndex] = MakeVertex(PositionData + VIndex * 3, 
+												   (VTextureIndex < 0 || !TextureCoordData) ? 0 : TextureCoordData + VTextureIndex * 3, 
+												   (VNormalIndex < 0 || !NormalData) ? 0 : NormalData + VNormalIndex * 3);
+		TriangleVertexLock[VertexIndex] = PositionOwners[VIndex] != PartitionTag;
+	}
+
+	std::vector<int>().swap(Triangles);
+
+	std::vector<u32> Remap(IndexCount);
+	size_t VertexCount = meshopt_generateVertexRemap(Remap.data(), 0, IndexCount, TriangleVertices.data(), IndexCount, sizeof(vertex));
+
+	std::vector<vertex> Vertices(VertexCount);
+	std::vector<u32> Indices(IndexCount);
+	std::vector<u8> VertexLock(VertexCount);
+
+	meshopt_remapVertexBuffer(Vertices.data(), TriangleVertices.data(), IndexCount, sizeof(vertex), Remap.data());
+	meshopt_remapVertexBuffer(VertexLock.data(), TriangleVertexLock.data(), IndexCount, sizeof(u8), Remap.data());
+	meshopt_remapIndexBuffer(Indices.data(), 0, IndexCount, Remap.data());
+
+	std::vector<vertex>().swap(TriangleVertices);
+	std::vector<u32>().swap(Remap);
+
+	CookMesh(Result, Vertices, Indices, MakeMeshlets, Options, VertexLock);
+}
+
+// NOTE: cooked partitions are written to temporary files and read back into the result once its size
+// is known. Growing the result partition by partition keeps the old and the new copy of it alive
+struct out_of_core_output
+{
+	char Paths[4][MAX_PATH];
+	FILE* Files[4];
+
+	size_t VertexCount;
+	size_t IndexCount;
+	size_t MeshletCount;
+	size_t MeshCount;
+};
+
+internal bool
+OpenOutOfCoreOutput(out_of_core_output& Output, const char* Path)
+{
+	Output = {};
+
+	const char* Suffixes[] = {"outv", "outi", "outm", "outmesh"};
+	bool IsOpened = true;
+	for(u32 FileIndex = 0;
+		FileIndex < ArraySize(Output.Files);
+		++FileIndex)
+	{
+		snprintf(Output.Paths[FileIndex], sizeof(Output.Paths[FileIndex]), "%s.%s.tmp", Path, Suffixes[FileIndex]);
+		Output.Files[FileIndex] = fopen(Output.Paths[FileIndex], "w+b");
+		IsOpened = IsOpened && Output.Files[FileIndex];
+	}
+
+	return IsOpened;
+}
+
+internal void
+CloseOutOfCoreOutput(out_of_core_output& Output)
+{
+	for(u32 FileIndex = 0;
+		FileIndex < ArraySize(Output.Files);
+		++FileIndex)
+	{
+		if(Output.Files[FileIndex]) fclose(Output.Files[FileIndex]);
+		remove(Output.Paths[FileIndex]);
+	}
+}
+
+// NOTE: offsets of the meshes are made relative to the start of the output
+internal bool
+WriteOutOfCoreOutput(out_of_core_output& Output, geometry& Partition)
+{
+	for(mesh& Mesh : Partition.Meshes)
+	{
+		Mesh.VertexOffset += u32(Output.VertexCount);
+		for(u32 LodIndex = 0;
+			LodIndex < Mesh.LodCount;
+			++LodIndex)
+		{
+			Mesh.Lods[LodIndex].IndexOffset += u32(Output.IndexCount);
+			Mesh.Lods[LodIndex].MeshletOffset += u32(Output.MeshletCount);
+		}
+	}
+
+	bool IsWritten = fwrite(Partition.Vertices.data(), sizeof(vertex), Partition.Vertices.size(), Output.Files[0]) == Partition.Vertices.size();
+	IsWritten = IsWritten && fwrite(Partition.Indices.data(), sizeof(u32), Partition.Indices.size(), Output.Files[1]) == Partition.Indices.size();
+	IsWritten = IsWritten && fwrite(Partition.Meshlets.data(), sizeof(meshlet), Partition.Meshlets.size(), Output.Files[2]) == Partition.Meshlets.size();
+	IsWritten = IsWritten && fwrite(Partition.Meshes.data(), sizeof(mesh), Partition.Meshes.size(), Output.Files[3]) == Partition.Meshes.size();
+
+	Output.VertexCount += Partition.Vertices.size();
+	Output.IndexCount += Partition.Indices.size();
+	Output.MeshletCount += Partition.Meshlets.size();
+	Output.MeshCount += Partition.Meshes.size();
+
+	return IsWritten;
+}
+
+template<typename T> bool
+ReadOutOfCoreArray(std::vector<T>& Result, FILE* File, size_t Count)
+{
+	size_t FirstElement = Result.size();
+	Result.reserve(FirstElement + Count);
+	Result.resize(FirstElement + Count);
+
+	rewind(File);
+	return fread(Result.data() + FirstElement, sizeof(T), Count, File) == Count;
+}
+
+// NOTE: meshlet counts of the result and the partitions are multiples of 32, so the output stays aligned
+internal bool
+ReadOutOfCoreOutput(geometry& Result, out_of_core_output& Output)
+{
+	u32 FirstVertex = u32(Result.Vertices.size());
+	u32 FirstIndex = u32(Result.Indices.size());
+	u32 FirstMeshlet = u32(Result.Meshlets.size());
+	size_t FirstMesh = Result.Meshes.size();
+
+	bool IsRead = ReadOutOfCoreArray(Result.Vertices, Output.Files[0], Output.VertexCount);
+	IsRead = IsRead && ReadOutOfCoreArray(Result.Indices, Output.Files[1], Output.IndexCount);
+	IsRead = IsRead && ReadOutOfCoreArray(Result.Meshlets, Output.Files[2], Output.MeshletCount);
+	IsRead = IsRead && ReadOutOfCoreArray(Result.Meshes, Output.Files[3], Output.MeshCount);
+
+	for(size_t MeshIndex = FirstMesh;
+		MeshIndex < Result.Meshes.size();
+		++MeshIndex)
+	{
+		mesh& Mesh = Result.Meshes[MeshIndex];
+		Mesh.VertexOffset += FirstVertex;
+		for(u32 LodIndex = 0;
+			LodIndex < Mesh.LodCount;
+			++LodIndex)
+		{
+			Mesh.Lods[LodIndex].IndexOffset += FirstIndex;
+			Mesh.Lods[LodIndex].MeshletOffset += FirstMeshlet;
+		}
+	}
+
+	return IsRead;
+}
+
+internal size_t
+GetGeometryBytes(const geometry& Geometry)
+{
+	return Geometry.Vertices.capacity() * sizeof(vertex) + Geometry.Indices.capacity() * sizeof(u32) + Geometry.Meshlets.capacity() * sizeof(meshlet) + 
+		   Geometry.Meshes.capacity() * sizeof(mesh) + Geometry.MeshGroups.capacity() * sizeof(mesh_group);
+}
+
+// NOTE: the working set is measured as the peak private memory of the process until the partitions are
+// cooked, file mappings are paged by the system and don't count. The peak counter can't be reset, when
+// the cook doesn't reach an earlier peak the reported value is an upper bound
+internal bool
+LoadMeshOutOfCore(geometry& Result, const char* Path, bool MakeMeshlets, const mesh_cook_options& Options)
+{
+	PROCESS_MEMORY_COUNTERS MemoryBefore = {sizeof(MemoryBefore)};
+	GetProcessMemoryInfo(GetCurrentProcess(), &MemoryBefore, sizeof(MemoryBefore));
+	size_t GeometryBytesBefore = GetGeometryBytes(Result);
+
+	char PositionsPath[MAX_PATH], TextureCoordsPath[MAX_PATH], NormalsPath[MAX_PATH], OwnersPath[MAX_PATH];
+	snprintf(PositionsPath, sizeof(PositionsPath), "%s.v.tmp", Path);
+	snprintf(TextureCoordsPath, sizeof(TextureCoordsPath), "%s.vt.tmp", Path);
+	snprintf(NormalsPath, sizeof(NormalsPath), "%s.vn.tmp", Path);
+	snprintf(OwnersPath, sizeof(OwnersPath), "%s.owners.tmp", Path);
+
+	u32 PartitionFileCount = 0;
+	mesh_partition Root = {};
+	snprintf(Root.Path, sizeof(Root.Path), "%s.part%u.tmp", Path, PartitionFileCount++);
+
+	out_of_core_stream Stream = {};
+	Stream.Positions = fopen(PositionsPath, "wb");
+	Stream.TextureCoords = fopen(TextureCoordsPath, "wb");
+	Stream.Normals = fopen(NormalsPath, "wb");
+	Stream.Triangles = fopen(Root.Path, "wb");
+	for(u32 Axis = 0; Axis < 3; ++Axis)
+	{
+		Stream.Min[Axis] =  FLT_MAX;
+		Stream.Max[Axis] = -FLT_MAX;
+	}
+
+	bool IsParsed = false;
+	ObjStream Obj = {};
+	if(Stream.Positions && Stream.TextureCoords && Stream.Normals && Stream.Triangles)
+	{
+		Obj.context = &Stream;
+		Obj.vertex = OutOfCoreVertex;
+		Obj.triangle = OutOfCoreTriangle;
+		IsParsed = objStreamFile(Obj, Path);
+	}
+
+	if(Stream.Positions) fclose(Stream.Positions);
+	if(Stream.TextureCoords) fclose(Stream.TextureCoords);
+	if(Stream.Normals) fclose(Stream.Normals);
+	if(Stream.Triangles) fclose(Stream.Triangles);
+
+	mapped_file Positions = {}, TextureCoords = {}, Normals = {}, Owners = {};
+	IsParsed = IsParsed && Stream.TriangleCount > 0;
+	IsParsed = IsParsed && MapFile(Positions, PositionsPath) && MapFile(TextureCoords, TextureCoordsPath) && MapFile(Normals, NormalsPath);
+	IsParsed = IsParsed && MapFile(Owners, OwnersPath, true, Obj.v_count * sizeof(u32));
+
+	std::vector<mesh_partition> Partitions;
+	size_t PartitionTriangleLimit = 0;
+	if(IsParsed)
+	{
+		const float* PositionData = (const float*)Positions.Data;
+
+		// NOTE: the cost is linear, measured on a large partition so the meshlet bound doesn't round up
+		size_t CostTriangleCount = 1 << 16;
+		PartitionTriangleLimit = size_t(double(Options.MemoryBudget) / double(GetPartitionCookBytes(CostTriangleCount)) * CostTriangleCount);
+		PartitionTriangleLimit = max(PartitionTriangleLimit, size_t(OUT_OF_CORE_BLOCK_TRIANGLES));
+		if(Options.ChunkTriangleThreshold)
+		{
+			PartitionTriangleLimit = min(PartitionTriangleLimit, size_t(Options.ChunkTriangleThreshold));
+		}
+
+		// NOTE: centroid bounds of the root are not known without another pass, the vertex bounds contain them
+		Root.TriangleCount = Stream.TriangleCount;
+		memcpy(Root.Min, Stream.Min, sizeof(Root.Min));
+		memcpy(Root.Max, Stream.Max, sizeof(Root.Max));
+
+		std::vector<mesh_partition> PendingPartitions;
+		PendingPartitions.push_back(Root);
+		while(!PendingPartitions.empty())
+		{
+			mesh_partition Partition = PendingPartitions.back();
+			PendingPartitions.pop_back();
+
+			if(Partition.TriangleCount <= PartitionTriangleLimit)
+			{
+				if(Partition.TriangleCount)
+				{
+					Partitions.push_back(Partition);
+				}
+				else
+				{
+					remove(Partition.Path);
+				}
+				continue;
+			}
+
+			mesh_partition Left = {}, Right = {};
+			snprintf(Left.Path, sizeof(Left.Path), "%s.part%u.tmp", Path, PartitionFileCount++);
+			snprintf(Right.Path, sizeof(Right.Path), "%s.part%u.tmp", Path, PartitionFileCount++);
+
+			bool IsSplit = SplitMeshPartition(Partition, Left, Right, PositionData);
+			remove(Partition.Path);
+			if(!IsSplit)
+			{
+				IsParsed = false;
+				break;
+			}
+
+			PendingPartitions.push_back(Left);
+			PendingPartitions.push_back(Right);
+		}
+
+		for(const mesh_partition& Partition : PendingPartitions)
+		{
+			remove(Partition.Path);
+		}
+	}
+
+	if(IsParsed)
+	{
+		// NOTE: owner is partition index + 1, positions referenced by several partitions get the high bit
+		u32* PositionOwners = (u32*)Owners.Data;
+		std::vector<int> Block(OUT_OF_CORE_BLOCK_TRIANGLES * 9);
+		for(u32 PartitionIndex = 0;
+			PartitionIndex < Partitions.size();
+			++PartitionIndex)
+		{
+			FILE* File = fopen(Partitions[PartitionIndex].Path, "rb");
+			if(!File)
+			{
+				IsParsed = false;
+				break;
+			}
+
+			while(size_t BlockTriangleCount = fread(Block.data(), sizeof(int) * 9, OUT_OF_CORE_BLOCK_TRIANGLES, File))
+			{
+				for(size_t Corner = 0;
+					Corner < BlockTriangleCount * 3;
+					++Corner)
+				{
+					u32& Owner = PositionOwners[Block[Corner * 3]];
+					if(Owner == 0)
+					{
+						Owner = PartitionIndex + 1;
+					}
+					else if(Owner != PartitionIndex + 1)
+					{
+						Owner |= 0x80000000;
+					}
+				}
+			}
+
+			fclose(File);
+		}
+	}
+
+	if(IsParsed)
+	{
+		mesh_group NewGroup = {};
+		NewGroup.MeshOffset = u32(Result.Meshes.size());
+
+		out_of_core_output Output;
+		IsParsed = OpenOutOfCoreOutput(Output, Path);
+		for(u32 PartitionIndex = 0;
+			PartitionIndex < Partitions.size() && IsParsed;
+			++PartitionIndex)
+		{
+			geometry PartitionGeometry;
+			CookMeshPartition(PartitionGeometry, Partitions[PartitionIndex], PartitionIndex + 1, Positions, TextureCoords, Normals, (const u32*)Owners.Data, MakeMeshlets, Options);
+			IsParsed = WriteOutOfCoreOutput(Output, PartitionGeometry);
+		}
+
+		PROCESS_MEMORY_COUNTERS MemoryAfter = {sizeof(MemoryAfter)};
+		GetProcessMemoryInfo(GetCurrentProcess(), &MemoryAfter, sizeof(MemoryAfter));
+
+		IsParsed = IsParsed && ReadOutOfCoreOutput(Result, Output);
+		CloseOutOfCoreOutput(Output);
+
+		NewGroup.MeshCount = u32(Result.Meshes.size()) - NewGroup.MeshOffset;
+		Result.MeshGroups.push_back(NewGroup);
+
+		double PeakWorkingSet = double(MemoryAfter.PeakPagefileUsage - MemoryBefore.PagefileUsage) / (1024 * 1024);
+		double GeometrySize = double(GetGeometryBytes(Result) - GeometryBytesBefore) / (1024 * 1024);
+		printf("%s: cooked %zu triangles out of core in %zu partitions of at most %zu triangles\n", Path, Stream.TriangleCount, Partitions.size(), PartitionTriangleLimit);
+		printf("%s: peak working set %.2f MB with %.2f MB of cooked geometry, budget %.2f MB\n", Path, PeakWorkingSet, GeometrySize, double(Options.MemoryBudget) / (1024 * 1024));
+	}
+
+	for(const mesh_partition& Partition : Partitions)
+	{
+		remove(Partition.Path);
+	}
+
+	UnmapFile(Positions);
+	UnmapFile(TextureCoords);
+	UnmapFile(Normals);
+	UnmapFile(Owners);
+
+	remove(Root.Path);
+	remove(PositionsPath);
+	remove(TextureCoordsPath);
+	remove(NormalsPath);
+	remove(OwnersPath);
+
+	return IsParsed;
+}
+
+internal void
+CookMeshGroup(geometry& Result, std::vector<vertex>& Vertices, std::vector<u32>& Indices, bool MakeMeshlets, const mesh_cook_options& Options)
+{
+	mesh_group NewGroup = {};
+	NewGroup.MeshOffset = u32(Result.Meshes.size());
+
+	if(Options.ChunkTriangleThreshold && Indices.size() / 3 > Options.ChunkTriangleThreshold)
+	{
+		CookMeshChunks(Result, Vertices, Indices, MakeMeshlets, Options, Options.ChunkTriangleThreshold);
+	}
+	else
+	{
+		std::vector<u8> VertexLock;
+		CookMesh(Result, Vertices, Indices, MakeMeshlets, Options, VertexLock);
+	}
+
+	NewGroup.MeshCount = u32(Result.Meshes.size()) - NewGroup.MeshOffset;
+	Result.MeshGroups.push_back(NewGroup);
+}
+
+// NOTE: every glTF mesh becomes a mesh group, its triangle primitives are merged. Attributes are
+// read straight from the mapped file (or from the decoded buffer view when it is meshopt compressed)
+// and indexed primitives skip the triangle soup and vertex remap. With a weld epsilon the merged mesh
+// is welded like obj meshes, a mesh without triangles left is skipped. Node transforms are ignored
+internal bool
+LoadMeshGlbFromMemory(geometry& Result, const char* Path, const void* Data, size_t Size, bool MakeMeshlets, const mesh_cook_options& Options)
+{
+	GlbFile Glb;
+	bool IsParsed = Data && glbParse(Glb, Data, Size);
+
+	for(const GlbMesh& Mesh : Glb.meshes)
+	{
+		if(!IsParsed)
+		{
+			break;
+		}
+
+		std::vector<vertex> Vertices;
+		std::vector<u32> Indices;
+
+		for(size_t PrimitiveIndex = Mesh.primitive_offset;
+			PrimitiveIndex < Mesh.primitive_offset + Mesh.primitive_count && IsParsed;
+			++PrimitiveIndex)
+		{
+			const GlbPrimitive& Primitive = Glb.primitives[PrimitiveIndex];
+			if(Primitive.mode != 4 || Primitive.position < 0)
+			{
+				continue;
+			}
+
+			const GlbAccessor& Positions = Glb.accessors[Primitive.position];
+			const GlbAccessor* Normals = Primitive.normal < 0 ? 0 : &Glb.accessors[Primitive.normal];
+			const GlbAccessor* TextureCoords = Primitive.texcoord < 0 ? 0 : &Glb.accessors[Primitive.texcoord];
+
+			u32 BaseVertex = u32(Vertices.size());
+			size_t VertexCount = Positions.count;
+			if((Normals && Normals->count < VertexCount) || (TextureCoords && TextureCoords->count < VertexCount))
+			{
+				IsParsed = false;
+				break;
+			}
+
+			Vertices.resize(BaseVertex + VertexCount);
+			for(size_t VertexIndex = 0;
+				VertexIndex < VertexCount;
+				++VertexIndex)
+			{
+				float Position[3], Normal[3], TextureCoord[2];
+				glbReadFloat(Glb, Positions, VertexIndex, Position, 3);
+				if(Normals) glbReadFloat(Glb, *Normals, VertexIndex, Normal, 3);
+				if(TextureCoords) glbReadFloat(Glb, *TextureCoords, VertexIndex, TextureCoord, 2);
+
+				Vertices[BaseVertex + VertexIndex] = MakeVertex(Position, TextureCoords ? TextureCoord : 0, Normals ? Normal : 0);
+			}
+
+			if(Primitive.indices >= 0)
+			{
+				const GlbAccessor& PrimitiveIndices = Glb.accessors[Primitive.indices];
+				size_t IndexCount = PrimitiveIndices.count / 3 * 3;
+
+				size_t BaseIndex = Indices.size();
+				Indices.resize(BaseIndex + IndexCount);
+				for(size_t Index = 0;
+					Index < IndexCount;
+					++Index)
+				{
+					u32 VertexIndex = glbReadIndex(Glb, PrimitiveIndices, Index);
+					if(VertexIndex >= VertexCount)
+					{
+						IsParsed = false;
+						break;
+					}
+
+					Indices[BaseIndex + Index] = BaseVertex + VertexIndex;
+				}
+			}
+			else
+			{
+				// NOTE: non indexed primitives are a triangle soup, so they still go through the vertex remap
+				size_t IndexCount = VertexCount / 3 * 3;
+
+				std::vector<u32> Remap(IndexCount);
+				size_t UniqueVertexCount = meshopt_generateVertexRemap(Remap.data(), 0, IndexCount, &Vertices[BaseVertex], IndexCount, sizeof(vertex));
+
+				meshopt_remapVertexBuffer(&Vertices[BaseVertex], &Vertices[BaseVertex], IndexCount, sizeof(vertex), Remap.data());
+				Vertices.resize(BaseVertex + UniqueVertexCount);
+
+				for(u32 Index : Remap)
+				{
+					Indices.push_back(BaseVertex + Index);
+				}
+			}
+		}
+
+		if(IsParsed && !Indices.empty() && (Options.WeldEpsilon <= 0 || WeldMesh(Vertices, Indices, Options.WeldEpsilon, Path)))
+		{
+			CookMeshGroup(Result, Vertices, Indices, MakeMeshlets, Options);
+		}
+	}
+
+	return IsParsed;
+}
+
+internal bool
+LoadMeshGlb(geometry& Result, const char* Path, bool MakeMeshlets, const mesh_cook_options& Options)
+{
+	mapped_file File;
+	if(!MapFile(File, Path))
+	{
+		return false;
+	}
+
+	bool IsParsed = LoadMeshGlbFromMemory(Result, Path, File.Data, File.Size, MakeMeshlets, Options);
+
+	UnmapFile(File);
+
+	return IsParsed;
+}
+
+internal bool
+IsGlbPath(const char* Path)
+{
+	size_t PathLength = strlen(Path);
+	return PathLength > 4 && _stricmp(Path + PathLength - 4, ".glb") == 0;
+}
+
+internal bool
+LoadMeshObj(geometry& Result, const ObjFile& File, const char* Path, bool MakeMeshlets, const mesh_cook_options& Options)
+{
+	size_t IndexCount = File.f_size / 3;
+	std::vector<vertex> TriangleVertices(IndexCount);
+
+	for(u32 VertexIndex = 0;
+		VertexIndex < IndexCount;
+		++VertexIndex)
+	{
+		int VIndex = File.f[VertexIndex * 3 + 0];
+		int VTextureIndex = File.f[VertexIndex * 3 + 1];
+		int VNormalIndex = File.f[VertexIndex * 3 + 2];
+
+		TriangleVertices[VertexIndex] = MakeVertex(File.v + VIndex * 3, 
+												   VTextureIndex < 0 ? 0 : File.vt + VTextureIndex * 3, 
+												   VNormalIndex < 0 ? 0 : File.vn + VNormalIndex * 3);
+	}
+
+	std::vector<u32> Remap(IndexCount);
+	size_t VertexCount = meshopt_generateVertexRemap(Remap.data(), 0, IndexCount, TriangleVertices.data(), IndexCount, sizeof(vertex));
+
+	std::vector<vertex> Vertices(VertexCount);
+	std::vector<u32> Indices(IndexCount);
+
+	meshopt_remapVertexBuffer(Vertices.data(), TriangleVertices.data(), IndexCount, sizeof(vertex), Remap.data());
+	meshopt_remapIndexBuffer(Indices.data(), 0, IndexCount, Remap.data());
+
+	if(Options.WeldEpsilon > 0 && !WeldMesh(Vertices, Indices, Options.WeldEpsilon, Path))
+	{
+		return false;
+	}
+
+	CookMeshGroup(Result, Vertices, Indices, MakeMeshlets, Options);
 
 	return true;
 }
 
+internal bool
+LoadMesh(geometry& Result, const char* Path, bool MakeMeshlets, const mesh_cook_options& Options = mesh_cook_options())
+{
+	if(IsGlbPath(Path))
+	{
+		return LoadMeshGlb(Result, Path, MakeMeshlets, Options);
+	}
+
+	if(Options.MemoryBudget)
+	{
+		return LoadMeshOutOfCore(Result, Path, MakeMeshlets, Options);
+	}
+
+	ObjFile File;
+	if(!objParseFile(File, Path))
+	{
+		return false;
+	}
+
+	return LoadMeshObj(Result, File, Path, MakeMeshlets, Options);
+}
+
+// NOTE: Data has to be zero-terminated, obj text is parsed in place.
+// The out of core mode streams from the file itself and doesn't use the data
+internal bool
+LoadMeshFromMemory(geometry& Result, const char* Path, void* Data, size_t Size, bool MakeMeshlets, const mesh_cook_options& Options = mesh_cook_options())
+{
+	if(IsGlbPath(Path))
+	{
+		return LoadMeshGlbFromMemory(Result, Path, Data, Size, MakeMeshlets, Options);
+	}
+
+	if(Options.MemoryBudget)
+	{
+		return LoadMeshOutOfCore(Result, Path, MakeMeshlets, Options);
+	}
+
+	ObjFile File;
+	if(!objParseBuffer(File, (char*)Data, Size))
+	{
+		return false;
+	}
+
+	return LoadMeshObj(Result, File, Path, MakeMeshlets, Options);
+}
@@ -301,7 +301,63 @@ void objParseLine(ObjFile& result, const char* line)
 	}
 }
 
-bool objParseFile(ObjFile& result, const char* path)
+void objStreamLine(ObjStream& stream, const char* line)
+{
+	if (line[0] == 'v' && (line[1] == ' ' || ((line[1] == 't' || line[1] == 'n') && line[2] == ' ')))
+	{
+		const char* s = line + (line[1] == ' ' ? 2 : 3);
+		char type = line[1] == ' ' ? 'v' : line[1];
+
+		float data[3];
+		data[0] = parseFloat(s, &s);
+		data[1] = parseFloat(s, &s);
+		data[2] = parseFloat(s, &s);
+
+		stream.v_count += (type == 'v');
+		stream.vt_count += (type == 't');
+		stream.vn_count += (type == 'n');
+
+		if (stream.vertex)
+			stream.vertex(stream.context, type, data);
+	}
+	else if (line[0] == 'f' && line[1] == ' ')
+	{
+		const char* s = line + 2;
+
+		int fv = 0;
+		int f[3][3] = {};
+
+		while (*s)
+		{
+			int vi = 0, vti = 0, vni = 0;
+			s = parseFace(s, vi, vti, vni);
+
+			if (vi == 0)
+				break;
+
+			f[fv][0] = fixupIndex(vi, stream.v_count);
+			f[fv][1] = fixupIndex(vti, stream.vt_count);
+			f[fv][2] = fixupIndex(vni, stream.vn_count);
+
+			if (fv == 2)
+			{
+				if (stream.triangle)
+					stream.triangle(stream.context, &f[0][0]);
+
+				f[1][0] = f[2][0];
+				f[1][1] = f[2][1];
+				f[1][2] = f[2][2];
+			}
+			else
+			{
+				fv++;
+			}
+		}
+	}
+}
+
+template <typename T, typename F>
+static bool parseFileLines(T& result, const char* path, F parseLine)
 {
 	FILE* file = fopen(path, "rb");
 	if (!file)
@@ -323,13 +379,13 @@ bool objParseFile(ObjFile& result, const char* path)
 			if (!eol)
 				break;
 
-			// zero-terminate for objParseLine
+			// zero-terminate for parseLine
 			size_t next = static_cast<char*>(eol) - buffer;
 
 			buffer[next] = 0;
 
 			// process next line
-			objParseLine(result, buffer + line);
+			parseLine(result, buffer + line);
 
 			line = next + 1;
 		}
@@ -347,13 +403,44 @@ bool objParseFile(ObjFile& result, const char* path)
 		assert(size < sizeof(buffer));
 		buffer[size] = 0;
 
-		objParseLine(result, buffer);
+		parseLine(result, buffer);
 	}
 
 	fclose(file);
 	return true;
 }
 
+bool objParseFile(ObjFile& result, const char* path)
+{
+	return parseFileLines(result, path, objParseLine);
+}
+
+bool objParseBuffer(ObjFile& result, char* data, size_t size)
+{
+	assert(data[size] == 0);
+
+	size_t line = 0;
+
+	while (line < size)
+	{
+		char* eol = static_cast<char*>(memchr(data + line, '\n', size - line));
+		size_t next = eol ? eol - data : size;
+
+		data[next] = 0;
+
+		objParseLine(result, data + line);
+
+		line = next + 1;
+	}
+
+	return true;
+}
+
+bool objStreamFile(ObjStream& stream, const char* path)
+{
+	return parseFileLines(stream, path, objStreamLine);
+}
+
 bool objValidate(const ObjFile& result)
 {
 	size_t v = result.v_size / 3;
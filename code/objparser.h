@@ -36,7 +36,29 @@ private:
 	ObjFile& operator=(const ObjFile&);
 };
 
+struct ObjStream
+{
+	void* context;
+
+	// called for every v/vt/vn line; type is 'v', 't' or 'n', data has 3 floats
+	void (*vertex)(void* context, char type, const float* data);
+
+	// called for every triangle; indices has 3 groups of indices into v/vt/vn, -1 if missing
+	void (*triangle)(void* context, const int* indices);
+
+	size_t v_count;
+	size_t vt_count;
+	size_t vn_count;
+};
+
 void objParseLine(ObjFile& result, const char* line);
 bool objParseFile(ObjFile& result, const char* path);
 
+// data has to be zero-terminated (data[size] == 0); line ends are replaced with zeros in place
+bool objParseBuffer(ObjFile& result, char* data, size_t size);
+
+// parses the file without storing it; memory use doesn't depend on the file size
+void objStreamLine(ObjStream& stream, const char* line);
+bool objStreamFile(ObjStream& stream, const char* path);
+
 bool objValidate(const ObjFile& result);
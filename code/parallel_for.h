@@ -0,0 +1,155 @@
+
+// NOTE: small persistent thread pool for cpu side work that is split into independent items.
+// ParallelFor hands items out through an atomic counter, the calling thread works on them too
+// and returns once every item is done. Which thread runs an item is not fixed, so jobs that have
+// to be deterministic write only to memory owned by their item
+typedef void parallel_for_func(void* Data, u32 Index);
+
+#define MAX_WORKER_THREADS 16
+
+struct worker_pool
+{
+	HANDLE Threads[MAX_WORKER_THREADS];
+	u32 ThreadCount;
+
+	HANDLE WorkSemaphore;
+	HANDLE DoneEvent;
+
+	parallel_for_func* Func;
+	void* Data;
+	volatile LONG ItemCount;
+	volatile LONG NextItem;
+
+	// NOTE: every woken worker and the calling thread count themselves out when the items run out,
+	// so no worker is still looking at a job when the next one is set up
+	volatile LONG ParticipantCount;
+	volatile LONG FinishedCount;
+
+	volatile bool IsStopping;
+};
+
+internal void
+DoParallelWork(worker_pool& Pool)
+{
+	for(;;)
+	{
+		LONG Item = InterlockedIncrement(&Pool.NextItem) - 1;
+		if(Item >= Pool.ItemCount)
+		{
+			break;
+		}
+
+		Pool.Func(Pool.Data, u32(Item));
+	}
+
+	// NOTE: the pool may already run the next job once the count is in, so nothing of it is read after
+	LONG ParticipantCount = Pool.ParticipantCount;
+	if(InterlockedIncrement(&Pool.FinishedCount) == ParticipantCount)
+	{
+		SetEvent(Pool.DoneEvent);
+	}
+}
+
+internal DWORD WINAPI
+WorkerThreadProc(void* Param)
+{
+	worker_pool& Pool = *(worker_pool*)Param;
+	for(;;)
+	{
+		WaitForSingleObject(Pool.WorkSemaphore, INFINITE);
+		if(Pool.IsStopping)
+		{
+			return 0;
+		}
+
+		DoParallelWork(Pool);
+	}
+}
+
+// NOTE: ThreadCount of 0 uses a worker per logical core besides the calling thread
+internal void
+CreateWorkerPool(worker_pool& Pool, u32 ThreadCount = 0)
+{
+	if(!ThreadCount)
+	{
+		SYSTEM_INFO SystemInfo;
+		GetSystemInfo(&SystemInfo);
+		ThreadCount = max(u32(SystemInfo.dwNumberOfProcessors), 2u) - 1;
+	}
+
+	Pool.ThreadCount = min(ThreadCount, u32(MAX_WORKER_THREADS));
+	Pool.WorkSemaphore = CreateSemaphoreA(0, 0, MAX_WORKER_THREADS, 0);
+	Pool.DoneEvent = CreateEventA(0, FALSE, FALSE, 0);
+	assert(Pool.WorkSemaphore && Pool.DoneEvent);
+
+	for(u32 ThreadIndex = 0;
+		ThreadIndex < Pool.ThreadCount;
+		++ThreadIndex)
+	{
+		Pool.Threads[ThreadIndex] = CreateThread(0, 0, WorkerThreadProc, &Pool, 0, 0);
+		assert(Pool.Threads[ThreadIndex]);
+	}
+}
+
+internal void
+DestroyWorkerPool(worker_pool& Pool)
+{
+	Pool.IsStopping = true;
+	ReleaseSemaphore(Pool.WorkSemaphore, Pool.ThreadCount, 0);
+	if(Pool.ThreadCount)
+	{
+		WaitForMultipleObjects(Pool.ThreadCount, Pool.Threads, TRUE, INFINITE);
+	}
+
+	for(u32 ThreadIndex = 0;
+		ThreadIndex < Pool.ThreadCount;
+		++ThreadIndex)
+	{
+		CloseHandle(Pool.Threads[ThreadIndex]);
+	}
+
+	CloseHandle(Pool.WorkSemaphore);
+	CloseHandle(Pool.DoneEvent);
+	Pool = {};
+}
+
+internal void
+RunParallelFor(worker_pool& Pool, u32 ItemCount, parallel_for_func* Func, void* Data)
+{
+	if(!ItemCount)
+	{
+		return;
+	}
+
+	// NOTE: a zeroed pool or a single item runs on the calling thread
+	u32 WorkerCount = min(Pool.ThreadCount, ItemCount - 1);
+	if(!WorkerCount)
+	{
+		for(u32 Item = 0;
+			Item < ItemCount;
+			++Item)
+		{
+			Func(Data, Item);
+		}
+		return;
+	}
+
+	Pool.Func = Func;
+	Pool.Data = Data;
+	Pool.ItemCount = LONG(ItemCount);
+	Pool.ParticipantCount = LONG(WorkerCount + 1);
+	Pool.FinishedCount = 0;
+	InterlockedExchange(&Pool.NextItem, 0);
+
+	ReleaseSemaphore(Pool.WorkSemaphore, WorkerCount, 0);
+
+	DoParallelWork(Pool);
+	WaitForSingleObject(Pool.DoneEvent, INFINITE);
+}
+
+// NOTE: Func is called as Func(u32 Index) for every index in [0, ItemCount)
+template<typename F> void
+ParallelFor(worker_pool& Pool, u32 ItemCount, const F& Func)
+{
+	RunParallelFor(Pool, ItemCount, [](void* Data, u32 Index) { (*(const F*)Data)(Index); }, (void*)&Func);
+}
@@ -0,0 +1,737 @@
+
+// NOTE: passes declare how they use the images of the frame and the graph derives the barriers between
+// them from the state every mip was left in. A pass is the set of uses declared before a flush, all of
+// its barriers go to one vkCmdPipelineBarrier. Buffers keep their hand written barriers, a flush can
+// batch them with the image ones.
+// Frames are ordered by the full barrier each of them starts with, so the state only tracks a frame
+#define RENDER_GRAPH_MAX_MIPS 16
+
+#define RENDER_GRAPH_WRITE_ACCESS (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | \
+								   VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT)
+
+// NOTE: the last write of a mip and the reads since. A layout transition counts as a write of the stages
+// it was done for without access, later uses in other stages still have to wait for it
+struct render_graph_state
+{
+	VkImageLayout Layout;
+	VkPipelineStageFlags WriteStages;
+	VkAccessFlags WriteAccess;
+	VkPipelineStageFlags ReadStages;
+	// NOTE: the first batch recorded after the reads, ~0u until the pass of the last one is flushed
+	u32 ReadBatch;
+
+	// NOTE: stages and accesses the last write was already made visible to
+	VkPipelineStageFlags VisibleStages;
+	VkAccessFlags VisibleAccess;
+};
+
+// NOTE: transient images don't keep their contents between frames, every frame starts them undefined.
+// They get their memory from the heap of the graph and the ones that are never alive together share it
+struct render_graph_image
+{
+	const char* Name;
+	VkImage Handle;
+	VkImageAspectFlags Aspect;
+	u32 MipCount;
+	bool IsTransient;
+
+	// NOTE: passes of the last recorded frame, FirstPass is ~0u when the image wasn't used
+	u32 FirstPass;
+	u32 LastPass;
+
+	VkMemoryRequirements Requirements;
+	VkDeviceSize HeapOffset;
+	std::vector<u32> Aliases;
+
+	// NOTE: stages and writes of the aliases its first use has to wait for
+	VkPipelineStageFlags AliasStages;
+	VkAccessFlags AliasAccess;
+
+	VkImageLayout FrameLayouts[RENDER_GRAPH_MAX_MIPS];
+	render_graph_state Mips[RENDER_GRAPH_MAX_MIPS];
+};
+
+struct render_graph_batch
+{
+	VkPipelineStageFlags SrcStages;
+	VkPipelineStageFlags DstStages;
+};
+
+// NOTE: uses and barriers of a mip in recording order, the validation only looks at these. Uses run
+// after the batches before Batch, barriers are a part of batch Batch
+struct render_graph_event
+{
+	u32 Image;
+	u32 Mip;
+	u32 Pass;
+	u32 Batch;
+	bool IsBarrier;
+	bool IsWrite;
+
+	VkPipelineStageFlags Stages;
+	VkAccessFlags SrcAccess;
+	VkAccessFlags Access;
+	VkImageLayout OldLayout;
+	VkImageLayout Layout;
+};
+
+struct render_graph
+{
+	std::vector<render_graph_image> Images;
+
+	u32 PassIndex;
+	std::vector<render_graph_batch> Batches;
+	std::vector<render_graph_event> Events;
+	u32 BarrierCount;
+
+	VkPipelineStageFlags PendingSrcStages;
+	VkPipelineStageFlags PendingDstStages;
+	std::vector<VkImageMemoryBarrier> PendingBarriers;
+	std::vector<render_graph_event> PendingEvents;
+
+	gpu_allocation Heap;
+};
+
+internal u32
+AddRenderGraphImage(render_graph& Graph, const char* Name, VkImageAspectFlags Aspect, bool IsTransient)
+{
+	render_graph_image Image = {};
+	Image.Name = Name;
+	Image.Aspect = Aspect;
+	Image.IsTransient = IsTransient;
+	Image.FirstPass = ~0u;
+	Graph.Images.push_back(Image);
+	return u32(Graph.Images.size() - 1);
+}
+
+// NOTE: called when the image is (re)created, it starts undefined. Transient images pass their memory
+// requirements and are bound by BindRenderGraphImages
+internal void
+SetRenderGraphImage(render_graph& Graph, u32 ImageIndex, VkImage Handle, u32 MipCount, VkMemoryRequirements Requirements = {})
+{
+	assert(MipCount <= RENDER_GRAPH_MAX_MIPS);
+
+	render_graph_image& Image = Graph.Images[ImageIndex];
+	Image.Handle = Handle;
+	Image.MipCount = MipCount;
+	Image.Requirements = Requirements;
+	for(u32 MipIndex = 0;
+		MipIndex < RENDER_GRAPH_MAX_MIPS;
+		++MipIndex)
+	{
+		Image.Mips[MipIndex] = {};
+		Image.FrameLayouts[MipIndex] = VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+}
+
+// NOTE: for images the graph gets every frame, like the swapchain ones. The first use waits for
+// WaitStages, the stages the wait for the image blocks
+internal void
+ImportRenderGraphImage(render_graph& Graph, u32 ImageIndex, VkImage Handle, VkPipelineStageFlags WaitStages)
+{
+	SetRenderGraphImage(Graph, ImageIndex, Handle, 1);
+	Graph.Images[ImageIndex].Mips[0].WriteStages = WaitStages;
+}
+
+internal void
+BeginRenderGraph(render_graph& Graph)
+{
+	Graph.PassIndex = 0;
+	Graph.Batches.clear();
+	Graph.Events.clear();
+	Graph.BarrierCount = 0;
+
+	for(render_graph_image& Image : Graph.Images)
+	{
+		Image.FirstPass = ~0u;
+		Image.LastPass = 0;
+		for(u32 MipIndex = 0;
+			MipIndex < Image.MipCount;
+			++MipIndex)
+		{
+			render_graph_state& State = Image.Mips[MipIndex];
+			State = {Image.IsTransient ? VK_IMAGE_LAYOUT_UNDEFINED : State.Layout};
+			Image.FrameLayouts[MipIndex] = State.Layout;
+		}
+	}
+}
+
+internal void
+AddRenderGraphBarrier(render_graph& Graph, u32 ImageIndex, u32 MipIndex, VkPipelineStageFlags SrcStages, VkAccessFlags SrcAccess,
+					  VkPipelineStageFlags DstStages, VkAccessFlags DstAccess, VkImageLayout OldLayout, VkImageLayout NewLayout)
+{
+	const render_graph_image& Image = Graph.Images[ImageIndex];
+
+	Graph.PendingSrcStages |= SrcStages ? SrcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	Graph.PendingDstStages |= DstStages;
+
+	render_graph_event Event = {};
+	Event.Image = ImageIndex;
+	Event.Mip = MipIndex;
+	Event.Pass = Graph.PassIndex;
+	Event.IsBarrier = true;
+	Event.SrcAccess = SrcAccess;
+	Event.Access = DstAccess;
+	Event.OldLayout = OldLayout;
+	Event.Layout = NewLayout;
+	Graph.PendingEvents.push_back(Event);
+
+	// NOTE: neighbouring mips that need the same barrier share it
+	if(!Graph.PendingBarriers.empty())
+	{
+		VkImageMemoryBarrier& Last = Graph.PendingBarriers.back();
+		if(Last.image == Image.Handle && Last.srcAccessMask == SrcAccess && Last.dstAccessMask == DstAccess &&
+		   Last.oldLayout == OldLayout && Last.newLayout == NewLayout &&
+		   Last.subresourceRange.baseMipLevel + Last.subresourceRange.levelCount == MipIndex)
+		{
+			Last.subresourceRange.levelCount++;
+			return;
+		}
+	}
+
+	VkImageMemoryBarrier Barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+	Barrier.srcAccessMask = SrcAccess;
+	Barrier.dstAccessMask = DstAccess;
+	Barrier.oldLayout = OldLayout;
+	Barrier.newLayout = NewLayout;
+	Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	Barrier.image = Image.Handle;
+	Barrier.subresourceRange.aspectMask = Image.Aspect;
+	Barrier.subresourceRange.baseMipLevel = MipIndex;
+	Barrier.subresourceRange.levelCount = 1;
+	Barrier.subresourceRange.layerCount = 1;
+	Graph.PendingBarriers.push_back(Barrier);
+}
+
+// NOTE: a batch recorded after the reads already ordered them before Stages
+internal bool
+IsRenderGraphReadOrdered(const render_graph& Graph, u32 ReadBatch, VkPipelineStageFlags ReadStages, VkPipelineStageFlags Stages)
+{
+	for(u32 BatchIndex = ReadBatch;
+		BatchIndex < Graph.Batches.size();
+		++BatchIndex)
+	{
+		const render_graph_batch& Batch = Graph.Batches[BatchIndex];
+		if((ReadStages & ~Batch.SrcStages) == 0 && (Stages & ~Batch.DstStages) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// NOTE: declares a use of the pass being recorded, every mip once per pass. Writes are the uses with
+// a write access, a use in another layout transitions the mips to it
+internal void
+UseRenderGraphImage(render_graph& Graph, u32 ImageIndex, VkPipelineStageFlags Stages, VkAccessFlags Access, VkImageLayout Layout,
+					u32 BaseMip = 0, u32 MipCount = ~0u)
+{
+	render_graph_image& Image = Graph.Images[ImageIndex];
+	MipCount = min(MipCount, Image.MipCount - BaseMip);
+	assert(Image.Handle && BaseMip + MipCount <= Image.MipCount);
+
+	// NOTE: the first use of a transient image waits for the aliases that were used before it this frame
+	if(Image.FirstPass == ~0u)
+	{
+		Image.FirstPass = Graph.PassIndex;
+		Image.AliasStages = 0;
+		Image.AliasAccess = 0;
+		for(u32 AliasIndex : Image.Aliases)
+		{
+			const render_graph_image& Alias = Graph.Images[AliasIndex];
+			if(Alias.FirstPass == ~0u)
+			{
+				continue;
+			}
+
+			for(u32 MipIndex = 0;
+				MipIndex < Alias.MipCount;
+				++MipIndex)
+			{
+				Image.AliasStages |= Alias.Mips[MipIndex].WriteStages | Alias.Mips[MipIndex].ReadStages;
+				Image.AliasAccess |= Alias.Mips[MipIndex].WriteAccess;
+			}
+		}
+	}
+	Image.LastPass = Graph.PassIndex;
+
+	bool IsWrite = (Access & RENDER_GRAPH_WRITE_ACCESS) != 0;
+	for(u32 MipIndex = BaseMip;
+		MipIndex < BaseMip + MipCount;
+		++MipIndex)
+	{
+		render_graph_state& State = Image.Mips[MipIndex];
+
+		render_graph_event Event = {};
+		Event.Image = ImageIndex;
+		Event.Mip = MipIndex;
+		Event.Pass = Graph.PassIndex;
+		Event.IsWrite = IsWrite;
+		Event.Stages = Stages;
+		Event.Access = Access;
+		Event.Layout = Layout;
+
+		if(State.Layout != Layout || IsWrite)
+		{
+			VkPipelineStageFlags SrcStages = State.WriteStages;
+			VkAccessFlags SrcAccess = State.WriteAccess;
+
+			// NOTE: a transition has to wait for the reads itself, a write only needs them ordered before it
+			if(State.ReadStages && (State.Layout != Layout || !IsRenderGraphReadOrdered(Graph, State.ReadBatch, State.ReadStages, Stages)))
+			{
+				SrcStages |= State.ReadStages;
+			}
+
+			bool IsUntouched = !State.WriteStages && !State.ReadStages && State.Layout == VK_IMAGE_LAYOUT_UNDEFINED;
+			if(Image.IsTransient && IsUntouched)
+			{
+				SrcStages |= Image.AliasStages;
+				SrcAccess |= Image.AliasAccess;
+			}
+
+			if(SrcStages || State.Layout != Layout)
+			{
+				AddRenderGraphBarrier(Graph, ImageIndex, MipIndex, SrcStages, SrcAccess, Stages, Access, State.Layout, Layout);
+			}
+
+			if(IsWrite)
+			{
+				State = {Layout, Stages, Access & RENDER_GRAPH_WRITE_ACCESS};
+			}
+			else
+			{
+				State = {Layout, Stages, 0, Stages, ~0u, Stages, Access};
+			}
+		}
+		else
+		{
+			if(State.WriteStages && ((Stages & ~State.VisibleStages) || (Access & ~State.VisibleAccess)))
+			{
+				AddRenderGraphBarrier(Graph, ImageIndex, MipIndex, State.WriteStages, State.WriteAccess, Stages, Access, Layout, Layout);
+				State.VisibleStages |= Stages;
+				State.VisibleAccess |= Access;
+			}
+
+			State.ReadStages |= Stages;
+			State.ReadBatch = ~0u;
+		}
+
+		Graph.PendingEvents.push_back(Event);
+	}
+}
+
+// NOTE: ends the declarations of a pass. The barriers of its images and the buffer barriers passed here
+// are recorded with one call, a null command buffer only records the batch for the validation
+internal void
+FlushRenderGraph(render_graph& Graph, VkCommandBuffer CommandBuffer,
+				 VkPipelineStageFlags BufferSrcStages = 0, VkPipelineStageFlags BufferDstStages = 0, u32 BufferBarrierCount = 0, const VkBufferMemoryBarrier* BufferBarriers = 0)
+{
+	VkPipelineStageFlags SrcStages = Graph.PendingSrcStages | BufferSrcStages;
+	VkPipelineStageFlags DstStages = Graph.PendingDstStages | BufferDstStages;
+
+	u32 BatchIndex = u32(Graph.Batches.size());
+	bool IsBatched = !Graph.PendingBarriers.empty() || BufferBarrierCount;
+	if(IsBatched)
+	{
+		if(CommandBuffer)
+		{
+			vkCmdPipelineBarrier(CommandBuffer, SrcStages, DstStages, 0, 0, 0, BufferBarrierCount, BufferBarriers,
+								 u32(Graph.PendingBarriers.size()), Graph.PendingBarriers.data());
+		}
+		Graph.Batches.push_back({SrcStages, DstStages});
+		Graph.BarrierCount += u32(Graph.PendingBarriers.size());
+	}
+
+	for(render_graph_event& Event : Graph.PendingEvents)
+	{
+		Event.Batch = (Event.IsBarrier) ? BatchIndex : u32(Graph.Batches.size());
+		Graph.Events.push_back(Event);
+	}
+
+	// NOTE: reads declared in this pass run after its batch
+	for(render_graph_image& Image : Graph.Images)
+	{
+		for(u32 MipIndex = 0;
+			MipIndex < Image.MipCount;
+			++MipIndex)
+		{
+			if(Image.Mips[MipIndex].ReadBatch == ~0u)
+			{
+				Image.Mips[MipIndex].ReadBatch = u32(Graph.Batches.size());
+			}
+		}
+	}
+
+	Graph.PendingSrcStages = 0;
+	Graph.PendingDstStages = 0;
+	Graph.PendingBarriers.clear();
+	Graph.PendingEvents.clear();
+	Graph.PassIndex++;
+}
+
+internal bool
+IsRenderGraphAliveTogether(const render_graph_image& A, const render_graph_image& B)
+{
+	if(A.FirstPass == ~0u || B.FirstPass == ~0u)
+	{
+		return true;
+	}
+	return A.FirstPass <= B.LastPass && B.FirstPass <= A.LastPass;
+}
+
+// NOTE: places the transient images in the heap by the lifetimes of the last recorded frame, biggest
+// first at the lowest offset that no image alive together with it takes. Before a frame was recorded
+// all of them are alive together and nothing is shared. Returns the size of the heap
+internal VkDeviceSize
+PlaceRenderGraphImages(render_graph& Graph)
+{
+	std::vector<u32> Order;
+	for(u32 ImageIndex = 0;
+		ImageIndex < Graph.Images.size();
+		++ImageIndex)
+	{
+		Graph.Images[ImageIndex].Aliases.clear();
+		if(Graph.Images[ImageIndex].IsTransient && Graph.Images[ImageIndex].Handle)
+		{
+			Order.push_back(ImageIndex);
+		}
+	}
+	std::sort(Order.begin(), Order.end(), [&Graph](u32 A, u32 B) { return Graph.Images[A].Requirements.size > Graph.Images[B].Requirements.size; });
+
+	VkDeviceSize HeapSize = 0;
+	for(u32 OrderIndex = 0;
+		OrderIndex < Order.size();
+		++OrderIndex)
+	{
+		render_graph_image& Image = Graph.Images[Order[OrderIndex]];
+		VkDeviceSize Size = Image.Requirements.size;
+
+		VkDeviceSize Offset = 0;
+		for(bool IsMoved = true; IsMoved;)
+		{
+			IsMoved = false;
+			for(u32 PlacedIndex = 0;
+				PlacedIndex < OrderIndex;
+				++PlacedIndex)
+			{
+				const render_graph_image& Placed = Graph.Images[Order[PlacedIndex]];
+				VkDeviceSize PlacedEnd = Placed.HeapOffset + Placed.Requirements.size;
+				if(IsRenderGraphAliveTogether(Image, Placed) && Offset < PlacedEnd && Placed.HeapOffset < Offset + Size)
+				{
+					Offset = AlignGpuOffset(PlacedEnd, Image.Requirements.alignment);
+					IsMoved = true;
+				}
+			}
+		}
+
+		Image.HeapOffset = Offset;
+		HeapSize = max(HeapSize, Offset + Size);
+
+		for(u32 PlacedIndex = 0;
+			PlacedIndex < OrderIndex;
+			++PlacedIndex)
+		{
+			render_graph_image& Placed = Graph.Images[Order[PlacedIndex]];
+			if(Offset < Placed.HeapOffset + Placed.Requirements.size && Placed.HeapOffset < Offset + Size)
+			{
+				Image.Aliases.push_back(Order[PlacedIndex]);
+				Placed.Aliases.push_back(Order[OrderIndex]);
+			}
+		}
+	}
+
+	return HeapSize;
+}
+
+// NOTE: the heap is kept while the images fit, so a smaller resolution reuses the memory of the bigger
+// one without a new allocation. The images have to be idle when they are rebound
+internal void
+BindRenderGraphImages(render_graph& Graph, VkDevice Device, gpu_memory& Memory)
+{
+	VkMemoryRequirements Requirements = {PlaceRenderGraphImages(Graph), 1, ~0u};
+
+	VkDeviceSize ImageSize = 0;
+	u32 ImageCount = 0;
+	for(const render_graph_image& Image : Graph.Images)
+	{
+		if(Image.IsTransient && Image.Handle)
+		{
+			Requirements.alignment = max(Requirements.alignment, Image.Requirements.alignment);
+			Requirements.memoryTypeBits &= Image.Requirements.memoryTypeBits;
+			ImageSize += Image.Requirements.size;
+			ImageCount++;
+		}
+	}
+	assert(Requirements.memoryTypeBits);
+
+	if(!Graph.Heap.Memory || Graph.Heap.Size < Requirements.size || (Graph.Heap.Offset % Requirements.alignment) != 0 ||
+	   !(Requirements.memoryTypeBits & (1 << Graph.Heap.MemoryTypeIndex)))
+	{
+		FreeGpuMemory(Memory, Device, Graph.Heap);
+		Graph.Heap = AllocateGpuMemory(Memory, Device, Requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GpuPool_Images);
+	}
+
+	for(const render_graph_image& Image : Graph.Images)
+	{
+		if(Image.IsTransient && Image.Handle)
+		{
+			VK_CHECK(vkBindImageMemory(Device, Image.Handle, Graph.Heap.Memory, Graph.Heap.Offset + Image.HeapOffset));
+		}
+	}
+
+	printf("Render graph: %u transient images, %.2f MB placed in %.2f MB of a %.2f MB heap\n", ImageCount,
+		   double(ImageSize) / (1024 * 1024), double(Requirements.size) / (1024 * 1024), double(Graph.Heap.Size) / (1024 * 1024));
+}
+
+internal void
+DestroyRenderGraph(render_graph& Graph, VkDevice Device, gpu_memory& Memory)
+{
+	FreeGpuMemory(Memory, Device, Graph.Heap);
+	Graph.Images.clear();
+}
+
+// NOTE: the stages the batches from FirstBatch up to EndBatch order after work in Stages, Reached are
+// stages already ordered after it. Dependencies chain when a batch waits for stages an earlier one blocked
+internal VkPipelineStageFlags
+GetRenderGraphReach(const render_graph& Graph, VkPipelineStageFlags Stages, u32 FirstBatch, u32 EndBatch, VkPipelineStageFlags Reached)
+{
+	for(u32 BatchIndex = FirstBatch;
+		BatchIndex < EndBatch;
+		++BatchIndex)
+	{
+		const render_graph_batch& Batch = Graph.Batches[BatchIndex];
+		if((Stages && (Stages & ~Batch.SrcStages) == 0) || (Batch.SrcStages & Reached))
+		{
+			Reached |= Batch.DstStages;
+		}
+	}
+	return Reached;
+}
+
+internal bool
+IsRenderGraphBeforeBatch(const render_graph& Graph, const render_graph_event& Use, u32 BatchIndex)
+{
+	if(Use.Batch > BatchIndex)
+	{
+		return false;
+	}
+
+	VkPipelineStageFlags Reached = GetRenderGraphReach(Graph, Use.Stages, Use.Batch, BatchIndex, 0);
+	const render_graph_batch& Batch = Graph.Batches[BatchIndex];
+	return (Use.Stages & ~Batch.SrcStages) == 0 || (Batch.SrcStages & Reached) != 0;
+}
+
+internal bool
+IsRenderGraphAfterBatch(const render_graph& Graph, u32 BatchIndex, const render_graph_event& Use)
+{
+	if(Use.Batch <= BatchIndex)
+	{
+		return false;
+	}
+
+	VkPipelineStageFlags Reached = GetRenderGraphReach(Graph, 0, BatchIndex + 1, Use.Batch, Graph.Batches[BatchIndex].DstStages);
+	return (Use.Stages & ~Reached) == 0;
+}
+
+internal void
+ReportRenderGraphHazard(const render_graph& Graph, const render_graph_event& Event, const char* Hazard, bool IsVerbose)
+{
+	if(IsVerbose)
+	{
+		printf("Render graph: %s mip %u in pass %u, %s\n", Graph.Images[Event.Image].Name, Event.Mip, Event.Pass, Hazard);
+	}
+}
+
+// NOTE: checks the recorded frame on the cpu without the barriers the graph meant to record: every use has
+// to be in the layout the mip is in, ordered after the uses it conflicts with and see their writes, and
+// every transition has to wait for the uses before it. Images sharing heap memory can't be alive together
+// and the first use of one has to wait for the other. Returns the count of the hazards it found
+internal u32
+ValidateRenderGraph(const render_graph& Graph, bool IsVerbose)
+{
+	u32 HazardCount = 0;
+	for(u32 ImageIndex = 0;
+		ImageIndex < Graph.Images.size();
+		++ImageIndex)
+	{
+		const render_graph_image& Image = Graph.Images[ImageIndex];
+		for(u32 MipIndex = 0;
+			MipIndex < Image.MipCount;
+			++MipIndex)
+		{
+			std::vector<const render_graph_event*> Events;
+			for(const render_graph_event& Event : Graph.Events)
+			{
+				if(Event.Image == ImageIndex && Event.Mip == MipIndex)
+				{
+					Events.push_back(&Event);
+				}
+			}
+
+			VkImageLayout Layout = Image.FrameLayouts[MipIndex];
+			u32 TransitionIndex = ~0u;
+			u32 FirstUseIndex = 0;
+			for(u32 EventIndex = 0;
+				EventIndex < Events.size();
+				++EventIndex)
+			{
+				const render_graph_event& Event = *Events[EventIndex];
+				if(Event.IsBarrier)
+				{
+					if(Event.OldLayout != Layout && Event.OldLayout != VK_IMAGE_LAYOUT_UNDEFINED)
+					{
+						ReportRenderGraphHazard(Graph, Event, "barrier from another layout", IsVerbose);
+						HazardCount++;
+					}
+
+					if(Event.OldLayout != Event.Layout)
+					{
+						for(u32 UseIndex = FirstUseIndex;
+							UseIndex < EventIndex;
+							++UseIndex)
+						{
+							const render_graph_event& Use = *Events[UseIndex];
+							if(Use.IsBarrier)
+							{
+								continue;
+							}
+							if(!IsRenderGraphBeforeBatch(Graph, Use, Event.Batch))
+							{
+								ReportRenderGraphHazard(Graph, Event, "transition not ordered after an earlier use", IsVerbose);
+								HazardCount++;
+							}
+							else if(Use.IsWrite && (Use.Access & RENDER_GRAPH_WRITE_ACCESS & ~Event.SrcAccess))
+							{
+								ReportRenderGraphHazard(Graph, Event, "transition without the writes of an earlier use", IsVerbose);
+								HazardCount++;
+							}
+						}
+
+						TransitionIndex = EventIndex;
+						FirstUseIndex = EventIndex + 1;
+					}
+
+					Layout = Event.Layout;
+					continue;
+				}
+
+				if(Event.Layout != Layout)
+				{
+					ReportRenderGraphHazard(Graph, Event, "used in another layout", IsVerbose);
+					HazardCount++;
+				}
+
+				for(u32 UseIndex = FirstUseIndex;
+					UseIndex < EventIndex;
+					++UseIndex)
+				{
+					const render_graph_event& Use = *Events[UseIndex];
+					if(Use.IsBarrier || Use.Pass == Event.Pass || (!Use.IsWrite && !Event.IsWrite))
+					{
+						continue;
+					}
+
+					VkPipelineStageFlags Reached = GetRenderGraphReach(Graph, Use.Stages, Use.Batch, Event.Batch, 0);
+					if(Event.Stages & ~Reached)
+					{
+						ReportRenderGraphHazard(Graph, Event, Use.IsWrite ? "not ordered after an earlier write" : "write not ordered after an earlier read", IsVerbose);
+						HazardCount++;
+						continue;
+					}
+
+					if(Use.IsWrite)
+					{
+						bool IsVisible = false;
+						for(u32 BarrierIndex = UseIndex + 1;
+							BarrierIndex < EventIndex && !IsVisible;
+							++BarrierIndex)
+						{
+							const render_graph_event& Barrier = *Events[BarrierIndex];
+							IsVisible = Barrier.IsBarrier && !(Use.Access & RENDER_GRAPH_WRITE_ACCESS & ~Barrier.SrcAccess) && !(Event.Access & ~Barrier.Access) &&
+										IsRenderGraphBeforeBatch(Graph, Use, Barrier.Batch) && IsRenderGraphAfterBatch(Graph, Barrier.Batch, Event);
+						}
+
+						if(!IsVisible)
+						{
+							ReportRenderGraphHazard(Graph, Event, "doesn't see an earlier write", IsVerbose);
+							HazardCount++;
+						}
+					}
+				}
+
+				// NOTE: the transition is a write that is only visible to the accesses of its barrier, later
+				// barriers of the mip can make it visible to others
+				if(TransitionIndex != ~0u)
+				{
+					const render_graph_event& Transition = *Events[TransitionIndex];
+					VkAccessFlags VisibleAccess = 0;
+					for(u32 BarrierIndex = TransitionIndex;
+						BarrierIndex < EventIndex;
+						++BarrierIndex)
+					{
+						const render_graph_event& Barrier = *Events[BarrierIndex];
+						if(Barrier.IsBarrier && IsRenderGraphAfterBatch(Graph, Barrier.Batch, Event))
+						{
+							VisibleAccess |= Barrier.Access;
+						}
+					}
+
+					if(!IsRenderGraphAfterBatch(Graph, Transition.Batch, Event))
+					{
+						ReportRenderGraphHazard(Graph, Event, "not ordered after the transition", IsVerbose);
+						HazardCount++;
+					}
+					else if(Event.Access & ~VisibleAccess)
+					{
+						ReportRenderGraphHazard(Graph, Event, "doesn't see the transition", IsVerbose);
+						HazardCount++;
+					}
+				}
+			}
+		}
+
+		for(u32 AliasIndex : Image.Aliases)
+		{
+			const render_graph_image& Alias = Graph.Images[AliasIndex];
+			if(Image.FirstPass == ~0u || Alias.FirstPass == ~0u || Alias.FirstPass > Image.FirstPass)
+			{
+				continue;
+			}
+
+			render_graph_event AliasEvent = {ImageIndex};
+			AliasEvent.Pass = Image.FirstPass;
+			if(IsRenderGraphAliveTogether(Image, Alias))
+			{
+				ReportRenderGraphHazard(Graph, AliasEvent, "alive together with an image sharing its memory", IsVerbose);
+				HazardCount++;
+				continue;
+			}
+
+			// NOTE: every use of the alias has to be done before the barriers of the first pass of the image
+			for(const render_graph_event& Barrier : Graph.Events)
+			{
+				if(!Barrier.IsBarrier || Barrier.Image != ImageIndex || Barrier.Pass != Image.FirstPass)
+				{
+					continue;
+				}
+
+				for(const render_graph_event& Use : Graph.Events)
+				{
+					if(Use.IsBarrier || Use.Image != AliasIndex)
+					{
+						continue;
+					}
+					if(!IsRenderGraphBeforeBatch(Graph, Use, Barrier.Batch) || (Use.IsWrite && (Use.Access & RENDER_GRAPH_WRITE_ACCESS & ~Barrier.SrcAccess)))
+					{
+						ReportRenderGraphHazard(Graph, Barrier, "first use not ordered after an image sharing its memory", IsVerbose);
+						HazardCount++;
+					}
+				}
+			}
+		}
+	}
+
+	return HazardCount;
+}
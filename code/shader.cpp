@@ -99,6 +99,11 @@ ParseShader(shader& Shader, const u32* Code, u32 CodeSize)
 					{
 						Vars[Id].Binding = DecVal;
 					} break;
+					case SpvDecorationSpecId:
+					{
+						assert(DecVal < 32);
+						Shader.SpecializationMask |= 1 << DecVal;
+					} break;
 				}
 			} break;
 			case SpvOpTypePointer:
@@ -217,6 +222,24 @@ ParseShader(shader& Shader, const u32* Code, u32 CodeSize)
 	}
 }
 
+internal bool
+LoadShaderFromMemory(shader& Shader, VkDevice Device, const void* Code, size_t CodeSize)
+{
+	if(!Code || CodeSize == 0 || CodeSize % 4 != 0)
+	{
+		return false;
+	}
+
+	ParseShader(Shader, reinterpret_cast<const u32*>(Code), u32(CodeSize / 4));
+
+	VkShaderModuleCreateInfo CreateInfo = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+	CreateInfo.codeSize = CodeSize;
+	CreateInfo.pCode = reinterpret_cast<const u32*>(Code);
+
+	VK_CHECK(vkCreateShaderModule(Device, &CreateInfo, 0, &Shader.Handle));
+	return true;
+}
+
 internal bool
 LoadShader(shader& Shader, VkDevice Device, const char* Path)
 {
@@ -233,20 +256,12 @@ LoadShader(shader& Shader, VkDevice Device, const char* Path)
 
 		size_t ReadSize = fread(Buffer, 1, FileLength, File);
 		assert(ReadSize == size_t(FileLength));
-		assert(FileLength % 4 == 0);
-
-		ParseShader(Shader, reinterpret_cast<const u32*>(Buffer), FileLength / 4);
 
-		VkShaderModuleCreateInfo CreateInfo = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
-		CreateInfo.codeSize = FileLength;
-		CreateInfo.pCode = reinterpret_cast<const u32*>(Buffer);
-
-		VK_CHECK(vkCreateShaderModule(Device, &CreateInfo, 0, &Shader.Handle));
-		Result = true;
+		Result = LoadShaderFromMemory(Shader, Device, Buffer, FileLength);
 
 		free(Buffer);
+		fclose(File);
 	}
-	fclose(File);
 	return Result;
 }
 
@@ -384,20 +399,45 @@ CreateDescriptorTemplate(VkDevice Device, VkPipelineBindPoint BindPoint, VkPipel
 	return Result;
 }
 
+// NOTE: the same constants are given to every stage, ids that a stage doesn't declare are ignored
+internal VkSpecializationInfo
+FillSpecializationInfo(std::vector<VkSpecializationMapEntry>& Entries, constants Constants)
+{
+	for(u32 ConstantIndex = 0;
+		ConstantIndex < Constants.size();
+		++ConstantIndex)
+	{
+		Entries.push_back({ConstantIndex, ConstantIndex * u32(sizeof(u32)), sizeof(u32)});
+	}
+
+	VkSpecializationInfo Result = {};
+	Result.mapEntryCount = u32(Entries.size());
+	Result.pMapEntries = Entries.data();
+	Result.dataSize = Constants.size() * sizeof(u32);
+	Result.pData = Constants.begin();
+	return Result;
+}
+
 internal VkPipeline
-CreateGraphicsPipeline(VkDevice Device, VkPipelineCache PipelineCache, VkPipelineLayout Layout, VkRenderPass RenderPass, shaders Shaders)
+CreateGraphicsPipeline(VkDevice Device, VkPipelineCache PipelineCache, VkPipelineLayout Layout, VkRenderPass RenderPass, shaders Shaders, constants Constants = {})
 {
 	VkGraphicsPipelineCreateInfo CreateInfo = {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
 
+	std::vector<VkSpecializationMapEntry> SpecializationEntries;
+	VkSpecializationInfo SpecializationInfo = FillSpecializationInfo(SpecializationEntries, Constants);
+
 	std::vector<VkPipelineShaderStageCreateInfo> Stages;
 	for(const shader* Shader : Shaders)
 	{
+		assert(Constants.size() >= 32 || (Shader->SpecializationMask >> Constants.size()) == 0);
+
 		VkPipelineShaderStageCreateInfo Stage = {};
 
 		Stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		Stage.module = Shader->Handle;
 		Stage.stage = Shader->Stage;
 		Stage.pName = "main";
+		Stage.pSpecializationInfo = &SpecializationInfo;
 
 		Stages.push_back(Stage);
 	}
@@ -492,9 +532,13 @@ DeleteProgram(program& Program, VkDevice Device)
 }
 
 internal VkPipeline 
-CreateComputePipeline(VkDevice Device, VkPipelineCache PipelineCache, VkPipelineLayout Layout, shader Shader)
+CreateComputePipeline(VkDevice Device, VkPipelineCache PipelineCache, VkPipelineLayout Layout, const shader& Shader, constants Constants = {})
 {
 	assert(Shader.Stage == VK_SHADER_STAGE_COMPUTE_BIT);
+	assert(Constants.size() >= 32 || (Shader.SpecializationMask >> Constants.size()) == 0);
+
+	std::vector<VkSpecializationMapEntry> SpecializationEntries;
+	VkSpecializationInfo SpecializationInfo = FillSpecializationInfo(SpecializationEntries, Constants);
 
 	VkPipeline Pipeline = 0;
 	VkComputePipelineCreateInfo CreateInfo = {VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
@@ -505,6 +549,7 @@ CreateComputePipeline(VkDevice Device, VkPipelineCache PipelineCache, VkPipeline
 	Stage.module = Shader.Handle;
 	Stage.stage = Shader.Stage;
 	Stage.pName = "main";
+	Stage.pSpecializationInfo = &SpecializationInfo;
 
 	CreateInfo.stage = Stage;
 	CreateInfo.layout = Layout;
@@ -11,6 +11,9 @@ struct shader
 	u32 LocalSizeY;
 	u32 LocalSizeZ;
 	bool IsUsingPushConstant;
+
+	// NOTE: constant_id of every specialization constant the shader declares
+	u32 SpecializationMask;
 };
 
 struct program
@@ -23,6 +26,9 @@ struct program
 
 using shaders = std::initializer_list<const shader*>;
 
+// NOTE: value i specializes constant_id i; booleans are passed as 0 or 1
+using constants = std::initializer_list<u32>;
+
 struct descriptor_template
 {
 	union
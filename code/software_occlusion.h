@@ -0,0 +1,420 @@
+
+// NOTE: cpu mirror of the depth pyramid. Levels[0] is the finest level, every texel of a coarser
+// level holds the min (farthest with reverse z) depth of its 2x2 children
+struct depth_pyramid
+{
+	u32 Width;
+	u32 Height;
+	std::vector<std::vector<float>> Levels;
+};
+
+internal float
+GetPyramidDepth(const depth_pyramid& Pyramid, u32 Level, s32 X, s32 Y)
+{
+	s32 LevelWidth  = max(1, s32(Pyramid.Width  >> Level));
+	s32 LevelHeight = max(1, s32(Pyramid.Height >> Level));
+	X = min(max(X, 0), LevelWidth  - 1);
+	Y = min(max(Y, 0), LevelHeight - 1);
+	return Pyramid.Levels[Level][Y * LevelWidth + X];
+}
+
+internal void
+BuildDepthPyramid(depth_pyramid& Pyramid)
+{
+	u32 LevelCount = GetImageMipLevels(Pyramid.Width, Pyramid.Height);
+	Pyramid.Levels.resize(LevelCount);
+	for(u32 Level = 1;
+		Level < LevelCount;
+		++Level)
+	{
+		s32 LevelWidth  = max(1, s32(Pyramid.Width  >> Level));
+		s32 LevelHeight = max(1, s32(Pyramid.Height >> Level));
+		Pyramid.Levels[Level].resize(LevelWidth * LevelHeight);
+		for(s32 Y = 0; Y < LevelHeight; ++Y)
+		{
+			for(s32 X = 0; X < LevelWidth; ++X)
+			{
+				float Depth = min(min(GetPyramidDepth(Pyramid, Level - 1, X * 2, Y * 2), GetPyramidDepth(Pyramid, Level - 1, X * 2 + 1, Y * 2)),
+								  min(GetPyramidDepth(Pyramid, Level - 1, X * 2, Y * 2 + 1), GetPyramidDepth(Pyramid, Level - 1, X * 2 + 1, Y * 2 + 1)));
+				Pyramid.Levels[Level][Y * LevelWidth + X] = Depth;
+			}
+		}
+	}
+}
+
+// NOTE: same as the occlusion test of draw_cull.comp: 2x2 texels at the level where the box is at most one texel wide
+internal bool
+IsOccludedConservative(const depth_pyramid& Pyramid, const glm::vec4& AABB, float DepthSphere)
+{
+	glm::vec2 BoxMin(min(AABB.x, AABB.z), min(AABB.y, AABB.w));
+	glm::vec2 BoxMax(max(AABB.x, AABB.z), max(AABB.y, AABB.w));
+
+	float Width  = (BoxMax.x - BoxMin.x) * Pyramid.Width;
+	float Height = (BoxMax.y - BoxMin.y) * Pyramid.Height;
+
+	float MaxLevel = float(Pyramid.Levels.size() - 1);
+	u32 Level = u32(min(max(ceilf(log2f(max(max(Width, Height), 1.0f))), 0.0f), MaxLevel));
+
+	// NOTE: a box that isn't aligned badly still fits into 2x2 texels one level finer
+	if(Level > 0)
+	{
+		s32 FinerWidth  = max(1, s32(Pyramid.Width  >> (Level - 1)));
+		s32 FinerHeight = max(1, s32(Pyramid.Height >> (Level - 1)));
+		if((s32(BoxMax.x * FinerWidth) - s32(BoxMin.x * FinerWidth) <= 1) && (s32(BoxMax.y * FinerHeight) - s32(BoxMin.y * FinerHeight) <= 1))
+		{
+			Level--;
+		}
+	}
+
+	s32 LevelWidth  = max(1, s32(Pyramid.Width  >> Level));
+	s32 LevelHeight = max(1, s32(Pyramid.Height >> Level));
+	s32 MinX = s32(BoxMin.x * LevelWidth), MinY = s32(BoxMin.y * LevelHeight);
+	s32 MaxX = s32(BoxMax.x * LevelWidth), MaxY = s32(BoxMax.y * LevelHeight);
+
+	float Depth = min(min(GetPyramidDepth(Pyramid, Level, MinX, MinY), GetPyramidDepth(Pyramid, Level, MaxX, MinY)),
+					  min(GetPyramidDepth(Pyramid, Level, MinX, MaxY), GetPyramidDepth(Pyramid, Level, MaxX, MaxY)));
+	return DepthSphere <= Depth;
+}
+
+// NOTE: cpu occlusion culling. The lowest lods of designated occluders are rasterized into a small
+// reverse z depth buffer, which is reduced into a depth_pyramid and every draw is tested against it
+// with the same conservative test the gpu uses. The result seeds DrawVisibilityBuffer, so the early
+// pass starts from a visibility set of this frame instead of the last one.
+// Occluder lods and pixel center coverage aren't exact, which only means the late pass picks up
+// what was rejected wrongly, same as with a stale visibility buffer.
+//
+// Everything runs on a worker_pool: occluder triangles are set up into fixed slots per occluder,
+// every screen tile is rasterized by one item that walks all triangles in slot order, and draws are
+// tested in fixed chunks. The depth of a pixel is the max over the triangles that cover it, so the
+// result doesn't depend on the thread count or on which thread runs which item
+#define SOFTWARE_OCCLUSION_WIDTH  256
+#define SOFTWARE_OCCLUSION_HEIGHT 128
+#define SOFTWARE_OCCLUSION_TILE_WIDTH  32
+#define SOFTWARE_OCCLUSION_TILE_HEIGHT 16
+// NOTE: a multiple of 32, so every chunk writes whole visibility words
+#define SOFTWARE_OCCLUSION_TEST_CHUNK 1024
+#define SOFTWARE_OCCLUDER_COUNT 64
+
+// NOTE: screen space triangle, pixel units. A pixel is covered when all edge functions
+// A * x + B * y + C are >= 0 at its center. Depth is a plane as reverse z is linear in screen space
+struct occluder_triangle
+{
+	float EdgeA[3];
+	float EdgeB[3];
+	float EdgeC[3];
+
+	float DepthA;
+	float DepthB;
+	float DepthC;
+
+	// NOTE: inclusive pixel bounds, empty if the triangle was rejected
+	s32 MinX, MinY;
+	s32 MaxX, MaxY;
+};
+
+struct software_occlusion
+{
+	depth_pyramid Pyramid;
+
+	std::vector<u32> Occluders;
+	std::vector<u32> OccluderTriangleOffsets;
+	std::vector<occluder_triangle> Triangles;
+
+	u32 VisibleCount;
+};
+
+internal void
+GetDrawSphere(const mesh_offset& Draw, glm::vec3& Center, float& Radius)
+{
+	Center = (Draw.Orient * Draw.Center) * Draw.Scale + glm::vec3(Draw.Pos[0], Draw.Pos[1], Draw.Pos[2]);
+	Radius = Draw.Radius * Draw.Scale;
+}
+
+internal bool
+IsSphereInFrustum(const draw_cull_data& CullData, const glm::vec3& Center, float Radius)
+{
+	for(u32 PlaneIndex = 0;
+		PlaneIndex < 6;
+		++PlaneIndex)
+	{
+		if(glm::dot(CullData.Frustrum[PlaneIndex], glm::vec4(Center, 1)) <= -Radius)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// NOTE: the largest draws in world space are the occluders, every one gets slots for all triangles of its lowest lod
+internal void
+SelectOccluders(software_occlusion& Occlusion, const geometry& Geometries, const std::vector<mesh_offset>& Draws, u32 MaxOccluderCount)
+{
+	Occlusion.Pyramid.Width  = SOFTWARE_OCCLUSION_WIDTH;
+	Occlusion.Pyramid.Height = SOFTWARE_OCCLUSION_HEIGHT;
+	Occlusion.Pyramid.Levels.resize(1);
+	Occlusion.Pyramid.Levels[0].assign(SOFTWARE_OCCLUSION_WIDTH * SOFTWARE_OCCLUSION_HEIGHT, 0.0f);
+
+	Occlusion.Occluders.resize(Draws.size());
+	for(u32 DrawIndex = 0;
+		DrawIndex < Draws.size();
+		++DrawIndex)
+	{
+		Occlusion.Occluders[DrawIndex] = DrawIndex;
+	}
+
+	// NOTE: stable, so equal sizes keep draw order and the selection is the same on every run
+	std::stable_sort(Occlusion.Occluders.begin(), Occlusion.Occluders.end(), [&Draws](u32 A, u32 B)
+	{
+		return Draws[A].Radius * Draws[A].Scale > Draws[B].Radius * Draws[B].Scale;
+	});
+	Occlusion.Occluders.resize(min(u32(Occlusion.Occluders.size()), MaxOccluderCount));
+
+	u32 TriangleCount = 0;
+	Occlusion.OccluderTriangleOffsets.resize(Occlusion.Occluders.size() + 1);
+	for(u32 OccluderIndex = 0;
+		OccluderIndex < Occlusion.Occluders.size();
+		++OccluderIndex)
+	{
+		const mesh& Mesh = Geometries.Meshes[Draws[Occlusion.Occluders[OccluderIndex]].MeshIndex];
+
+		Occlusion.OccluderTriangleOffsets[OccluderIndex] = TriangleCount;
+		TriangleCount += Mesh.Lods[Mesh.LodCount - 1].IndexCount / 3;
+	}
+	Occlusion.OccluderTriangleOffsets[Occlusion.Occluders.size()] = TriangleCount;
+
+	Occlusion.Triangles.resize(TriangleCount);
+}
+
+internal void
+RejectOccluderTriangle(occluder_triangle& Triangle)
+{
+	Triangle.MinX = SOFTWARE_OCCLUSION_WIDTH;
+	Triangle.MinY = SOFTWARE_OCCLUSION_HEIGHT;
+	Triangle.MaxX = -1;
+	Triangle.MaxY = -1;
+}
+
+internal void
+SetupOccluderTriangle(occluder_triangle& Triangle, const glm::vec3 (&Positions)[3], const draw_cull_data& CullData)
+{
+	RejectOccluderTriangle(Triangle);
+
+	// NOTE: triangles crossing the near plane are dropped instead of clipped, that only removes occlusion
+	glm::vec3 Screen[3];
+	for(u32 VertexIndex = 0;
+		VertexIndex < 3;
+		++VertexIndex)
+	{
+		const glm::vec3& P = Positions[VertexIndex];
+		if(P.z < CullData.znear)
+		{
+			return;
+		}
+
+		Screen[VertexIndex].x = ( P.x / P.z * CullData.P00 * 0.5f + 0.5f) * SOFTWARE_OCCLUSION_WIDTH;
+		Screen[VertexIndex].y = (-P.y / P.z * CullData.P11 * 0.5f + 0.5f) * SOFTWARE_OCCLUSION_HEIGHT;
+		Screen[VertexIndex].z = CullData.znear / P.z;
+	}
+
+	float Area = (Screen[1].x - Screen[0].x) * (Screen[2].y - Screen[0].y) - (Screen[2].x - Screen[0].x) * (Screen[1].y - Screen[0].y);
+	if(fabsf(Area) < 1e-6f)
+	{
+		return;
+	}
+
+	// NOTE: both windings are rasterized, edges are flipped so the inside is positive
+	float Sign = Area > 0 ? 1.0f : -1.0f;
+	for(u32 EdgeIndex = 0;
+		EdgeIndex < 3;
+		++EdgeIndex)
+	{
+		const glm::vec3& E0 = Screen[EdgeIndex];
+		const glm::vec3& E1 = Screen[(EdgeIndex + 1) % 3];
+		Triangle.EdgeA[EdgeIndex] = (E0.y - E1.y) * Sign;
+		Triangle.EdgeB[EdgeIndex] = (E1.x - E0.x) * Sign;
+		Triangle.EdgeC[EdgeIndex] = (E0.x * E1.y - E0.y * E1.x) * Sign;
+	}
+
+	float DepthDelta1 = Screen[1].z - Screen[0].z;
+	float DepthDelta2 = Screen[2].z - Screen[0].z;
+	Triangle.DepthA = (DepthDelta1 * (Screen[2].y - Screen[0].y) - DepthDelta2 * (Screen[1].y - Screen[0].y)) / Area;
+	Triangle.DepthB = (DepthDelta2 * (Screen[1].x - Screen[0].x) - DepthDelta1 * (Screen[2].x - Screen[0].x)) / Area;
+
+	// NOTE: the plane is shifted to its min over a pixel, a pixel never gets nearer than the triangle is inside it
+	Triangle.DepthC = Screen[0].z - Triangle.DepthA * Screen[0].x - Triangle.DepthB * Screen[0].y -
+					  0.5f * (fabsf(Triangle.DepthA) + fabsf(Triangle.DepthB));
+
+	float MinX = min(min(Screen[0].x, Screen[1].x), Screen[2].x);
+	float MinY = min(min(Screen[0].y, Screen[1].y), Screen[2].y);
+	float MaxX = max(max(Screen[0].x, Screen[1].x), Screen[2].x);
+	float MaxY = max(max(Screen[0].y, Screen[1].y), Screen[2].y);
+
+	Triangle.MinX = max(s32(floorf(MinX)), 0);
+	Triangle.MinY = max(s32(floorf(MinY)), 0);
+	Triangle.MaxX = min(s32(ceilf(MaxX)), SOFTWARE_OCCLUSION_WIDTH - 1);
+	Triangle.MaxY = min(s32(ceilf(MaxY)), SOFTWARE_OCCLUSION_HEIGHT - 1);
+}
+
+// NOTE: 4 pixels of a row per step. Tile columns are multiples of 4, so a step never leaves the tile
+internal void
+RasterizeOccluderTile(depth_pyramid& Pyramid, const std::vector<occluder_triangle>& Triangles, s32 TileX, s32 TileY)
+{
+	s32 TileMinX = TileX * SOFTWARE_OCCLUSION_TILE_WIDTH;
+	s32 TileMinY = TileY * SOFTWARE_OCCLUSION_TILE_HEIGHT;
+	s32 TileMaxX = TileMinX + SOFTWARE_OCCLUSION_TILE_WIDTH - 1;
+	s32 TileMaxY = TileMinY + SOFTWARE_OCCLUSION_TILE_HEIGHT - 1;
+
+	float* Depths = Pyramid.Levels[0].data();
+	for(s32 Y = TileMinY; Y <= TileMaxY; ++Y)
+	{
+		memset(Depths + Y * SOFTWARE_OCCLUSION_WIDTH + TileMinX, 0, sizeof(float) * SOFTWARE_OCCLUSION_TILE_WIDTH);
+	}
+
+	__m128 LaneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	__m128 Zero = _mm_setzero_ps();
+	for(const occluder_triangle& Triangle : Triangles)
+	{
+		s32 MinX = max(Triangle.MinX, TileMinX) & ~3;
+		s32 MinY = max(Triangle.MinY, TileMinY);
+		s32 MaxX = min(Triangle.MaxX, TileMaxX);
+		s32 MaxY = min(Triangle.MaxY, TileMaxY);
+		if(MinX > MaxX || MinY > MaxY)
+		{
+			continue;
+		}
+
+		__m128 EdgeA0 = _mm_set1_ps(Triangle.EdgeA[0]), EdgeA1 = _mm_set1_ps(Triangle.EdgeA[1]), EdgeA2 = _mm_set1_ps(Triangle.EdgeA[2]);
+		__m128 DepthA = _mm_set1_ps(Triangle.DepthA);
+
+		for(s32 Y = MinY; Y <= MaxY; ++Y)
+		{
+			float PixelY = float(Y) + 0.5f;
+			__m128 RowE0 = _mm_set1_ps(Triangle.EdgeB[0] * PixelY + Triangle.EdgeC[0]);
+			__m128 RowE1 = _mm_set1_ps(Triangle.EdgeB[1] * PixelY + Triangle.EdgeC[1]);
+			__m128 RowE2 = _mm_set1_ps(Triangle.EdgeB[2] * PixelY + Triangle.EdgeC[2]);
+			__m128 RowDepth = _mm_set1_ps(Triangle.DepthB * PixelY + Triangle.DepthC);
+
+			float* Row = Depths + Y * SOFTWARE_OCCLUSION_WIDTH;
+			for(s32 X = MinX; X <= MaxX; X += 4)
+			{
+				__m128 PixelX = _mm_add_ps(_mm_set1_ps(float(X)), LaneOffsets);
+
+				__m128 E0 = _mm_add_ps(_mm_mul_ps(EdgeA0, PixelX), RowE0);
+				__m128 E1 = _mm_add_ps(_mm_mul_ps(EdgeA1, PixelX), RowE1);
+				__m128 E2 = _mm_add_ps(_mm_mul_ps(EdgeA2, PixelX), RowE2);
+				__m128 Mask = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(E0, Zero), _mm_cmpge_ps(E1, Zero)), _mm_cmpge_ps(E2, Zero));
+				if(!_mm_movemask_ps(Mask))
+				{
+					continue;
+				}
+
+				__m128 Depth = _mm_add_ps(_mm_mul_ps(DepthA, PixelX), RowDepth);
+				_mm_storeu_ps(Row + X, _mm_max_ps(_mm_loadu_ps(Row + X), _mm_and_ps(Mask, Depth)));
+			}
+		}
+	}
+}
+
+internal void
+RasterizeOccluders(software_occlusion& Occlusion, worker_pool& Pool, const geometry& Geometries, const std::vector<mesh_offset>& Draws, const draw_cull_data& CullData)
+{
+	ParallelFor(Pool, u32(Occlusion.Occluders.size()), [&](u32 OccluderIndex)
+	{
+		const mesh_offset& Draw = Draws[Occlusion.Occluders[OccluderIndex]];
+		const mesh& Mesh = Geometries.Meshes[Draw.MeshIndex];
+		const mesh_lod& Lod = Mesh.Lods[Mesh.LodCount - 1];
+
+		glm::vec3 Center;
+		float Radius;
+		GetDrawSphere(Draw, Center, Radius);
+
+		bool IsVisible = IsSphereInFrustum(CullData, Center, Radius);
+
+		glm::vec3 Pos(Draw.Pos[0], Draw.Pos[1], Draw.Pos[2]);
+		occluder_triangle* Triangles = Occlusion.Triangles.data() + Occlusion.OccluderTriangleOffsets[OccluderIndex];
+		for(u32 TriangleIndex = 0;
+			TriangleIndex < Lod.IndexCount / 3;
+			++TriangleIndex)
+		{
+			if(!IsVisible)
+			{
+				RejectOccluderTriangle(Triangles[TriangleIndex]);
+				continue;
+			}
+
+			glm::vec3 Positions[3];
+			for(u32 VertexIndex = 0;
+				VertexIndex < 3;
+				++VertexIndex)
+			{
+				const vertex& Vertex = Geometries.Vertices[Mesh.VertexOffset + Geometries.Indices[Lod.IndexOffset + TriangleIndex * 3 + VertexIndex]];
+				Positions[VertexIndex] = (Draw.Orient * glm::vec3(Vertex.vx, Vertex.vy, Vertex.vz)) * Draw.Scale + Pos;
+			}
+
+			SetupOccluderTriangle(Triangles[TriangleIndex], Positions, CullData);
+		}
+	});
+
+	u32 TileCountX = SOFTWARE_OCCLUSION_WIDTH  / SOFTWARE_OCCLUSION_TILE_WIDTH;
+	u32 TileCountY = SOFTWARE_OCCLUSION_HEIGHT / SOFTWARE_OCCLUSION_TILE_HEIGHT;
+	ParallelFor(Pool, TileCountX * TileCountY, [&](u32 TileIndex)
+	{
+		RasterizeOccluderTile(Occlusion.Pyramid, Occlusion.Triangles, s32(TileIndex % TileCountX), s32(TileIndex / TileCountX));
+	});
+
+	BuildDepthPyramid(Occlusion.Pyramid);
+}
+
+// NOTE: bit i of VisibilityWords is set for draws that are in the frustum and not hidden by the occluders.
+// Laid out like DrawVisibilityBuffer, (Draws.size() + 31) / 32 words. Every chunk packs its own words and
+// stores them, so they can go straight into the mapped seed buffer
+internal void
+TestSoftwareOcclusion(software_occlusion& Occlusion, worker_pool& Pool, const std::vector<mesh_offset>& Draws, const draw_cull_data& CullData, u32* VisibilityWords)
+{
+	static_assert(SOFTWARE_OCCLUSION_TEST_CHUNK % 32 == 0, "test chunks have to cover whole visibility words");
+
+	volatile LONG VisibleCount = 0;
+	u32 ChunkCount = (u32(Draws.size()) + SOFTWARE_OCCLUSION_TEST_CHUNK - 1) / SOFTWARE_OCCLUSION_TEST_CHUNK;
+	ParallelFor(Pool, ChunkCount, [&](u32 ChunkIndex)
+	{
+		u32 FirstDraw = ChunkIndex * SOFTWARE_OCCLUSION_TEST_CHUNK;
+		u32 LastDraw  = min(FirstDraw + SOFTWARE_OCCLUSION_TEST_CHUNK, u32(Draws.size()));
+		LONG ChunkVisibleCount = 0;
+		u32 Word = 0;
+		for(u32 DrawIndex = FirstDraw;
+			DrawIndex < LastDraw;
+			++DrawIndex)
+		{
+			glm::vec3 Center;
+			float Radius;
+			GetDrawSphere(Draws[DrawIndex], Center, Radius);
+
+			bool IsVisible = IsSphereInFrustum(CullData, Center, Radius);
+
+			glm::vec4 AABB;
+			if(IsVisible && ProjectSphere(Center, Radius, CullData.znear, CullData.P00, CullData.P11, AABB))
+			{
+				float DepthSphere = CullData.znear / (Center.z - Radius);
+				IsVisible = !IsOccludedConservative(Occlusion.Pyramid, AABB, DepthSphere);
+			}
+
+			Word |= u32(IsVisible) << (DrawIndex & 31);
+			ChunkVisibleCount += IsVisible;
+
+			// NOTE: the last word of the last chunk may be partial, its upper bits stay clear
+			if((DrawIndex & 31) == 31 || DrawIndex + 1 == LastDraw)
+			{
+				VisibilityWords[DrawIndex / 32] = Word;
+				Word = 0;
+			}
+		}
+
+		if(ChunkVisibleCount)
+		{
+			InterlockedExchangeAdd(&VisibleCount, ChunkVisibleCount);
+		}
+	});
+
+	Occlusion.VisibleCount = u32(VisibleCount);
+}
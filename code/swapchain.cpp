@@ -76,11 +76,22 @@ CreateSwapchain(swapchain& Swapchain, VkRenderPass RenderPass, VkDevice Device,
 	std::vector<VkImage> SwapchainImages(SwapchainImageCount);
 	vkGetSwapchainImagesKHR(Device, Swapchain.Handle, &SwapchainImageCount, SwapchainImages.data());
 	Swapchain.Images = std::move(SwapchainImages);
+
+	Swapchain.ReleaseSemaphores.resize(SwapchainImageCount);
+	for(VkSemaphore& Semaphore : Swapchain.ReleaseSemaphores)
+	{
+		VkSemaphoreCreateInfo SemaphoreCreateInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+		VK_CHECK(vkCreateSemaphore(Device, &SemaphoreCreateInfo, 0, &Semaphore));
+	}
 }
 
 internal void
 DestroySwapchain(const swapchain& Swapchain, VkDevice Device)
 {
+	for(VkSemaphore Semaphore : Swapchain.ReleaseSemaphores)
+	{
+		vkDestroySemaphore(Device, Semaphore, 0);
+	}
 	vkDestroySwapchainKHR(Device, Swapchain.Handle, 0);
 }
 
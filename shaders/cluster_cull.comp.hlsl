@@ -0,0 +1,55 @@
+
+#include "mesh_headers.hlsl"
+#include "cull_headers.hlsl"
+
+// NOTE: specialized with the draw_cull.comp flags, constant ids are shared with it
+[[vk::constant_id(1)]] const bool CULL = true;
+
+[[vk::binding(0)]] StructuredBuffer<draw_cluster> Clusters;
+[[vk::binding(1)]] RWStructuredBuffer<uint> ClusterVisibility;
+[[vk::binding(2)]] RWStructuredBuffer<uint> ClusterList;
+[[vk::binding(3)]] RWStructuredBuffer<cluster_dispatch> ClusterDispatch;
+
+[[vk::push_constant]] draw_cull_data DrawCullData;
+
+// NOTE: one thread per draw cluster, runs before the early pass. Clusters in the frustum are appended to
+// ClusterList, the indirect dispatch of draw_cull.comp grows to a group per listed cluster in rows.
+// The late pass takes the draws the early pass listed, so only the frustum is tested here
+[numthreads(64, 1, 1)]
+void main(uint3 GroupID : SV_GroupID, uint3 GroupThreadID : SV_GroupThreadID)
+{
+	uint ci = GetFlatGroupIndex(GroupID) * 64 + GroupThreadID.x;
+
+	if(ci >= DrawCullData.ClusterCount)
+	{
+		return;
+	}
+
+	bool WasVisible = ClusterVisibility[ci] != 0;
+
+	draw_cluster Cluster = Clusters[ci];
+
+	bool IsVisible = IsSphereInFrustum(DrawCullData, Cluster.Center, Cluster.Radius);
+
+	IsVisible = CULL ? IsVisible : true;
+
+	// NOTE: one atomic per wave, lanes of visible clusters take consecutive list slots
+	uint VisibleCount = WaveActiveCountBits(IsVisible);
+	uint ListIndex = 0;
+	if(WaveIsFirstLane() && VisibleCount > 0)
+	{
+		InterlockedAdd(ClusterDispatch[0].ClusterCount, VisibleCount, ListIndex);
+
+		uint GroupCount = ListIndex + VisibleCount;
+		InterlockedMax(ClusterDispatch[0].GroupCountX, min(GroupCount, DISPATCH_ROW_GROUPS));
+		InterlockedMax(ClusterDispatch[0].GroupCountY, (GroupCount + DISPATCH_ROW_GROUPS - 1) / DISPATCH_ROW_GROUPS);
+	}
+	ListIndex = WaveReadLaneFirst(ListIndex) + WavePrefixCountBits(IsVisible);
+
+	if(IsVisible)
+	{
+		ClusterList[ListIndex] = ci | (WasVisible ? 0 : DRAW_CLUSTER_NEWLY_VISIBLE);
+	}
+
+	ClusterVisibility[ci] = IsVisible ? 1 : 0;
+}
@@ -13,10 +13,11 @@ struct draw_count
 	uint Data;
 };
 
-[[vk::binding(0)]] StructuredBuffer<mesh_offset> MeshOffsetBuffer;
+[[vk::binding(0)]] StructuredBuffer<draw_sphere> DrawSpheres;
 [[vk::binding(1)]] StructuredBuffer<mesh> MeshDataBuffer;
-[[vk::binding(2)]] RWStructuredBuffer<mesh_draw_command> DrawCommands;
+[[vk::binding(2)]] RWStructuredBuffer<draw_indexed_command> DrawCommands;
 [[vk::binding(3)]] RWStructuredBuffer<draw_count> DrawCount;
+[[vk::binding(4)]] StructuredBuffer<draw_transform> DrawTransforms;
 [[vk::push_constant]] draw_cull_data DrawCullData;
 
 
@@ -25,10 +26,10 @@ void main(uint3 GlobalInvocationID : SV_DispatchThreadID)
 {
 	uint di = GlobalInvocationID.x;
 
-	uint MeshIndex = MeshOffsetBuffer[di].MeshIndex;
+	uint MeshIndex = DrawTransforms[di].MeshIndex;
 
-	float3 Center = MeshOffsetBuffer[di].Center * MeshOffsetBuffer[di].Scale + MeshOffsetBuffer[di].Pos;
-	float Radius = MeshOffsetBuffer[di].Radius * MeshOffsetBuffer[di].Scale;
+	float3 Center = DrawSpheres[di].Center;
+	float Radius = DrawSpheres[di].Radius;
 
 	bool IsVisible = true;
 	IsVisible = IsVisible && dot(DrawCullData.Data[0], float4(Center, 1)) > -Radius;
@@ -52,15 +53,11 @@ void main(uint3 GlobalInvocationID : SV_DispatchThreadID)
 
 		mesh_lod Lod = MeshDataBuffer[MeshIndex].Lods[LodIndex];
 
-		DrawCommands[DrawCommandIndex].DrawIndex = di;
 		DrawCommands[DrawCommandIndex].IndexCount = Lod.IndexCount;
 		DrawCommands[DrawCommandIndex].InstanceCount = 1;
 		DrawCommands[DrawCommandIndex].FirstIndex = Lod.IndexOffset;
 		DrawCommands[DrawCommandIndex].VertexOffset = MeshDataBuffer[MeshIndex].VertexOffset;
 		DrawCommands[DrawCommandIndex].FirstInstance = 0;
-
-		DrawCommands[DrawCommandIndex].TaskCount = (Lod.MeshletCount + 31) / 32;
-		DrawCommands[DrawCommandIndex].FirstTask = Lod.MeshletOffset / 32;
 	}
 }
 
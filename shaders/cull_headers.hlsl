@@ -0,0 +1,149 @@
+
+struct draw_cull_data
+{
+	float4 Data[6];
+
+	float P00, P11, znear;
+	float PyramidWidth, PyramidHeight;
+
+	uint DrawCount;
+	uint ClusterCount;
+
+	// NOTE: minimum projected diameter in pixels divided by P11 * ScreenHeight, 0 disables contribution culling
+	float ContributionThreshold;
+};
+
+// NOTE: one view of the multi-view cull, the planes are in the space of the draws and the commands
+// of the view start at CommandOffset, see draw_cull_views.comp
+struct draw_cull_view
+{
+	float4 Frustrum[6];
+
+	float3 Origin;
+	uint CommandOffset;
+};
+
+// NOTE: a draw cluster is a contiguous range of draws, see draw_cluster.h
+struct draw_cluster
+{
+	float3 Center;
+	float Radius;
+
+	uint FirstDraw;
+	uint DrawCount;
+};
+
+// NOTE: indirect dispatch of draw_cull.comp over the clusters cluster_cull.comp listed
+struct cluster_dispatch
+{
+	uint GroupCountX;
+	uint GroupCountY;
+	uint GroupCountZ;
+
+	uint ClusterCount;
+};
+
+#define DRAW_CLUSTER_NEWLY_VISIBLE 0x80000000
+
+struct project_sphere_result
+{
+	bool IsProjected;
+	float4 aabb;
+};
+
+project_sphere_result ProjectSphere(in float3 C, // camera-space sphere center
+								   in float  r, // sphere radius
+								   in float  NearZ, // near clipping plane position (negative)
+								   in float  P00,
+								   in float  P11)
+{
+	project_sphere_result Result = {0, float4(0, 0, 0, 0)};
+	if(C.z < r + NearZ)
+	{
+		Result.IsProjected = false;
+		return Result;
+	}
+
+	float2 cx = -C.xz;
+	float2 vx = float2(sqrt(dot(cx, cx) - r * r), r) / length(cx);
+	float2 minx = mul(float2x2(vx.x, vx.y, -vx.y, vx.x), cx);
+	float2 maxx = mul(float2x2(vx.x, -vx.y, vx.y, vx.x), cx);
+
+	float2 cy = -C.yz;
+	float2 vy = float2(sqrt(dot(cy, cy) - r * r), r) / length(cy);
+	float2 miny = mul(float2x2(vy.x, -vy.y, vy.y, vy.x), cy);
+	float2 maxy = mul(float2x2(vy.x, vy.y, -vy.y, vy.x), cy);
+
+	Result.IsProjected = true;
+	Result.aabb = float4(minx.x / minx.y * P00, miny.x / miny.y * P11, maxx.x / maxx.y * P00, maxy.x / maxy.y * P11) * 
+		   float4(0.5f, -0.5f, 0.5f, -0.5f) + float4(0.5f, 0.5f, 0.5f, 0.5f);
+
+	return Result;
+}
+
+bool IsSphereInsidePlanes(float4 Planes[6], float3 Center, float Radius)
+{
+	bool IsVisible = true;
+	IsVisible = IsVisible && dot(Planes[0], float4(Center, 1)) > -Radius;
+	IsVisible = IsVisible && dot(Planes[1], float4(Center, 1)) > -Radius;
+	IsVisible = IsVisible && dot(Planes[2], float4(Center, 1)) > -Radius;
+	IsVisible = IsVisible && dot(Planes[3], float4(Center, 1)) > -Radius;
+	IsVisible = IsVisible && dot(Planes[4], float4(Center, 1)) > -Radius;
+	IsVisible = IsVisible && dot(Planes[5], float4(Center, 1)) > -Radius;
+	return IsVisible;
+}
+
+bool IsSphereInFrustum(draw_cull_data CullData, float3 Center, float Radius)
+{
+	return IsSphereInsidePlanes(CullData.Data, Center, Radius);
+}
+
+// NOTE: the projected diameter is about 2 * Radius / z * P11 * ScreenHeight / 2 pixels, with the threshold
+// divided by P11 * ScreenHeight up front the test needs no division. Scale is the override of the mesh
+bool IsSphereBelowContribution(draw_cull_data CullData, float3 Center, float Radius, float Scale)
+{
+	return Radius < CullData.ContributionThreshold * Scale * Center.z;
+}
+
+// NOTE: spheres crossing the near plane can't be projected and are never occluded
+bool IsSphereOccluded(Texture2D<float> DepthPyramid, draw_cull_data CullData, float3 Center, float Radius)
+{
+	project_sphere_result ProjectionResult = ProjectSphere(Center, Radius, CullData.znear, CullData.P00, CullData.P11);
+	if(!ProjectionResult.IsProjected)
+	{
+		return false;
+	}
+
+	float4 aabb = ProjectionResult.aabb;
+
+	// NOTE: y is flipped by the projection, so the corners are sorted first
+	float2 BoxMin = min(aabb.xy, aabb.zw);
+	float2 BoxMax = max(aabb.xy, aabb.zw);
+
+	float Width  = (BoxMax.x - BoxMin.x) * CullData.PyramidWidth;
+	float Height = (BoxMax.y - BoxMin.y) * CullData.PyramidHeight;
+
+	// NOTE: at this level the box is at most one texel wide, so the 2x2 texels it touches cover it whole.
+	// A single filtered tap at the finer floor() level could miss texels of the footprint
+	float MaxLevel = floor(log2(max(CullData.PyramidWidth, CullData.PyramidHeight)));
+	uint Level = uint(clamp(ceil(log2(max(max(Width, Height), 1))), 0, MaxLevel));
+
+	// NOTE: a box that isn't aligned badly still fits into 2x2 texels one level finer
+	if(Level > 0)
+	{
+		int2 FinerSize = max(int2(CullData.PyramidWidth, CullData.PyramidHeight) >> (Level - 1), 1);
+		int2 FinerSpan = int2(BoxMax * FinerSize) - int2(BoxMin * FinerSize);
+		Level = all(FinerSpan <= 1) ? Level - 1 : Level;
+	}
+
+	int2 LevelSize = max(int2(CullData.PyramidWidth, CullData.PyramidHeight) >> Level, 1);
+	int2 TexelMin = clamp(int2(BoxMin * LevelSize), 0, LevelSize - 1);
+	int2 TexelMax = clamp(int2(BoxMax * LevelSize), 0, LevelSize - 1);
+
+	float Depth = min(min(DepthPyramid.Load(int3(TexelMin.x, TexelMin.y, Level)), DepthPyramid.Load(int3(TexelMax.x, TexelMin.y, Level))), 
+					  min(DepthPyramid.Load(int3(TexelMin.x, TexelMax.y, Level)), DepthPyramid.Load(int3(TexelMax.x, TexelMax.y, Level))));
+
+	float DepthSphere = CullData.znear / (Center.z - Radius);
+
+	return DepthSphere <= Depth;
+}
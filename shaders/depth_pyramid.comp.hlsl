@@ -0,0 +1,197 @@
+
+// NOTE: builds the whole depth pyramid in one dispatch. Every group reduces a 64x64 tile of level 0
+// down to level 6 in groupshared memory; the last group to finish reduces level 6 to the remaining levels.
+// Every texel keeps the min (farthest with reverse z) depth it covers, so the pyramid stays conservative
+
+#define TILE_LEVELS 6
+
+struct depth_pyramid_data
+{
+	float2 SourceSize;
+	uint2 PyramidSize;
+	uint LevelCount;
+	uint GroupCount;
+};
+
+[[vk::combinedImageSampler]][[vk::binding(0)]]
+Texture2D<float> SourceDepth;
+[[vk::combinedImageSampler]][[vk::binding(0)]]
+SamplerState SourceDepthSampler;
+
+[[vk::binding(1)]]  globallycoherent RWTexture2D<float> Level0;
+[[vk::binding(2)]]  globallycoherent RWTexture2D<float> Level1;
+[[vk::binding(3)]]  globallycoherent RWTexture2D<float> Level2;
+[[vk::binding(4)]]  globallycoherent RWTexture2D<float> Level3;
+[[vk::binding(5)]]  globallycoherent RWTexture2D<float> Level4;
+[[vk::binding(6)]]  globallycoherent RWTexture2D<float> Level5;
+[[vk::binding(7)]]  globallycoherent RWTexture2D<float> Level6;
+[[vk::binding(8)]]  globallycoherent RWTexture2D<float> Level7;
+[[vk::binding(9)]]  globallycoherent RWTexture2D<float> Level8;
+[[vk::binding(10)]] globallycoherent RWTexture2D<float> Level9;
+[[vk::binding(11)]] globallycoherent RWTexture2D<float> Level10;
+[[vk::binding(12)]] globallycoherent RWTexture2D<float> Level11;
+[[vk::binding(13)]] globallycoherent RWStructuredBuffer<uint> GroupCounter;
+[[vk::push_constant]] depth_pyramid_data DepthPyramidData;
+
+groupshared float Tile[16][16];
+groupshared bool IsLastGroup;
+
+static const float NoDepth = asfloat(0x7f7fffff);
+
+uint2 GetLevelSize(uint Level)
+{
+	return max(DepthPyramidData.PyramidSize >> Level, 1);
+}
+
+void StoreLevel(uint Level, uint2 Pos, float Depth)
+{
+	if(Level >= DepthPyramidData.LevelCount || any(Pos >= GetLevelSize(Level)))
+	{
+		return;
+	}
+
+	switch(Level)
+	{
+		case 0:  Level0[Pos]  = Depth; break;
+		case 1:  Level1[Pos]  = Depth; break;
+		case 2:  Level2[Pos]  = Depth; break;
+		case 3:  Level3[Pos]  = Depth; break;
+		case 4:  Level4[Pos]  = Depth; break;
+		case 5:  Level5[Pos]  = Depth; break;
+		case 6:  Level6[Pos]  = Depth; break;
+		case 7:  Level7[Pos]  = Depth; break;
+		case 8:  Level8[Pos]  = Depth; break;
+		case 9:  Level9[Pos]  = Depth; break;
+		case 10: Level10[Pos] = Depth; break;
+		case 11: Level11[Pos] = Depth; break;
+	}
+}
+
+// NOTE: texel of the tile's first level. Level 0 takes the min of every source pixel it overlaps,
+// which is up to 3x3 pixels when the source is less than twice the pyramid size
+float LoadTileTexel(uint BaseLevel, uint2 Pos)
+{
+	if(any(Pos >= GetLevelSize(BaseLevel)))
+	{
+		return NoDepth;
+	}
+
+	if(BaseLevel != 0)
+	{
+		return Level6[Pos];
+	}
+
+	float2 Ratio = DepthPyramidData.SourceSize / float2(DepthPyramidData.PyramidSize);
+	int2 PixelMin = int2(floor(float2(Pos) * Ratio));
+	int2 PixelMax = min(int2(ceil(float2(Pos + 1) * Ratio)) - 1, int2(DepthPyramidData.SourceSize) - 1);
+
+	float Depth = NoDepth;
+	for(int y = PixelMin.y; y <= PixelMax.y; ++y)
+	{
+		for(int x = PixelMin.x; x <= PixelMax.x; ++x)
+		{
+			Depth = min(Depth, SourceDepth.Load(int3(x, y, 0)));
+		}
+	}
+
+	return Depth;
+}
+
+// NOTE: reduces a 64x64 tile of BaseLevel down to a single texel of BaseLevel + 6.
+// Every thread takes a 4x4 block first, the last four levels go through groupshared memory
+void ReduceTile(uint BaseLevel, uint2 TileBase, uint ThreadIndex)
+{
+	uint2 ThreadPos = uint2(ThreadIndex % 16, ThreadIndex / 16);
+
+	float Level1Depths[2][2];
+	for(uint by = 0; by < 2; ++by)
+	{
+		for(uint bx = 0; bx < 2; ++bx)
+		{
+			float Depth = NoDepth;
+			for(uint y = 0; y < 2; ++y)
+			{
+				for(uint x = 0; x < 2; ++x)
+				{
+					uint2 Pos = TileBase + ThreadPos * 4 + uint2(bx * 2 + x, by * 2 + y);
+					float TexelDepth = LoadTileTexel(BaseLevel, Pos);
+					if(BaseLevel == 0)
+					{
+						StoreLevel(0, Pos, TexelDepth);
+					}
+					Depth = min(Depth, TexelDepth);
+				}
+			}
+
+			Level1Depths[by][bx] = Depth;
+			StoreLevel(BaseLevel + 1, TileBase / 2 + ThreadPos * 2 + uint2(bx, by), Depth);
+		}
+	}
+
+	float Level2Depth = min(min(Level1Depths[0][0], Level1Depths[0][1]), min(Level1Depths[1][0], Level1Depths[1][1]));
+	StoreLevel(BaseLevel + 2, TileBase / 4 + ThreadPos, Level2Depth);
+	Tile[ThreadPos.y][ThreadPos.x] = Level2Depth;
+
+	GroupMemoryBarrierWithGroupSync();
+
+	for(uint Level = 3, Size = 8;
+		Level <= TILE_LEVELS;
+		++Level, Size /= 2)
+	{
+		uint2 Pos = uint2(ThreadIndex % Size, ThreadIndex / Size);
+		bool IsActive = ThreadIndex < Size * Size;
+
+		float Depth = NoDepth;
+		if(IsActive)
+		{
+			Depth = min(min(Tile[Pos.y * 2][Pos.x * 2], Tile[Pos.y * 2][Pos.x * 2 + 1]),
+						min(Tile[Pos.y * 2 + 1][Pos.x * 2], Tile[Pos.y * 2 + 1][Pos.x * 2 + 1]));
+		}
+
+		GroupMemoryBarrierWithGroupSync();
+
+		if(IsActive)
+		{
+			Tile[Pos.y][Pos.x] = Depth;
+			StoreLevel(BaseLevel + Level, (TileBase >> Level) + Pos, Depth);
+		}
+
+		GroupMemoryBarrierWithGroupSync();
+	}
+}
+
+[numthreads(256, 1, 1)]
+void main(uint3 GroupID : SV_GroupID, uint ThreadIndex : SV_GroupIndex)
+{
+	ReduceTile(0, GroupID.xy * 64, ThreadIndex);
+
+	if(DepthPyramidData.LevelCount <= TILE_LEVELS + 1)
+	{
+		return;
+	}
+
+	// NOTE: level 6 texels of the other groups have to be visible before the counter says they are done
+	DeviceMemoryBarrierWithGroupSync();
+
+	if(ThreadIndex == 0)
+	{
+		uint FinishedCount;
+		InterlockedAdd(GroupCounter[0], 1, FinishedCount);
+		IsLastGroup = (FinishedCount == DepthPyramidData.GroupCount - 1);
+	}
+
+	GroupMemoryBarrierWithGroupSync();
+
+	if(!IsLastGroup)
+	{
+		return;
+	}
+
+	// NOTE: at most 12 levels, so level 6 is never larger than the 64x64 tile
+	ReduceTile(TILE_LEVELS, uint2(0, 0), ThreadIndex);
+
+	if(ThreadIndex == 0)
+	{
+		GroupCounter[0] = 0;
+	}
+}
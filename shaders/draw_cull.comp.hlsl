@@ -1,80 +1,260 @@
 
 #include "mesh_headers.hlsl"
+#include "cull_headers.hlsl"
 
-struct draw_cull_data
-{
-	float4 Data[6];
-	uint LodEnabled;
-	uint CullEnabled;
-
-	float P00, P11, znear;
-	float PyramidWidth, PyramidHeight;
-};
+// NOTE: pipelines are specialized per pass and per feature toggle, so disabled features compile out
+[[vk::constant_id(0)]] const bool LATE = false;
+[[vk::constant_id(1)]] const bool CULL = true;
+[[vk::constant_id(2)]] const bool LOD = true;
+[[vk::constant_id(3)]] const bool OCCLUSION = true;
+[[vk::constant_id(4)]] const bool INSTANCING = true;
+[[vk::constant_id(5)]] const bool CLUSTERED = false;
+[[vk::constant_id(6)]] const bool MESH_TASKS = false;
 
 struct draw_count
 {
 	uint Data;
 };
 
-struct draw_visibility
+// NOTE: indirect dispatch of the late pass over LateList, the groups always cover DrawCount
+struct late_dispatch
 {
-	uint IsVisible;
+	uint GroupCountX;
+	uint GroupCountY;
+	uint GroupCountZ;
+
+	uint DrawCount;
 };
 
-[[vk::binding(0)]] StructuredBuffer<mesh_offset> MeshOffsetBuffer;
+#define DRAW_CULL_GROUP_SIZE 64
+
+// NOTE: set on late list entries of draws the early pass has drawn
+#define LATE_DRAW_WAS_VISIBLE 0x80000000
+
+[[vk::binding(0)]] StructuredBuffer<draw_sphere> DrawSpheres;
 [[vk::binding(1)]] StructuredBuffer<mesh> MeshDataBuffer;
-[[vk::binding(2)]] RWStructuredBuffer<mesh_draw_command> DrawCommands;
+[[vk::binding(2)]] RWStructuredBuffer<draw_indexed_command> DrawCommands;
 [[vk::binding(3)]] RWStructuredBuffer<draw_count> DrawCount;
-[[vk::binding(4)]] RWStructuredBuffer<draw_visibility> DrawVisibility;
-[[vk::push_constant]] draw_cull_data DrawCullData;
+[[vk::binding(4)]] RWStructuredBuffer<uint> DrawVisibility;
+
+[[vk::combinedImageSampler]][[vk::binding(5)]]
+Texture2D<float> DepthPyramid;
+[[vk::combinedImageSampler]][[vk::binding(5)]]
+SamplerState DepthPyramidSampler;
 
+[[vk::binding(6)]] RWStructuredBuffer<uint> InstanceIds;
+[[vk::binding(7)]] RWStructuredBuffer<draw_bucket> DrawBuckets;
+[[vk::binding(8)]] StructuredBuffer<draw_cluster> Clusters;
+[[vk::binding(9)]] StructuredBuffer<uint> ClusterList;
+[[vk::binding(10)]] RWStructuredBuffer<uint> LateList;
+[[vk::binding(11)]] RWStructuredBuffer<late_dispatch> LateDispatch;
+[[vk::binding(12)]] RWStructuredBuffer<draw_mesh_tasks_command> TaskCommands;
+[[vk::binding(13)]] RWStructuredBuffer<uint> DrawIds;
+[[vk::binding(14)]] StructuredBuffer<draw_transform> DrawTransforms;
+[[vk::binding(15)]] RWStructuredBuffer<uint> ContributionCulled;
+[[vk::binding(16)]] StructuredBuffer<cluster_dispatch> ClusterDispatch;
+[[vk::push_constant]] draw_cull_data DrawCullData;
 
-[numthreads(64, 1, 1)]
-void main(uint3 GlobalInvocationID : SV_DispatchThreadID)
+// NOTE: the early pass tests the frustum of every draw, draws what was visible last frame and appends
+// every draw in the frustum to LateList. The late pass only runs over that list: it tests occlusion against
+// the depth pyramid, draws what became visible and keeps the visibility for the next frame.
+// With occlusion on the mesh task path visibility is also kept per meshlet, so the late pass draws every
+// visible draw again and the task shader skips the meshlets the early pass has drawn
+[numthreads(DRAW_CULL_GROUP_SIZE, 1, 1)]
+void main(uint3 GroupID : SV_GroupID, uint3 GroupThreadID : SV_GroupThreadID)
 {
-	uint di = GlobalInvocationID.x;
+	uint GroupIndex = GetFlatGroupIndex(GroupID);
+	uint di = GroupIndex * DRAW_CULL_GROUP_SIZE + GroupThreadID.x;
+	bool IsClusterNewlyVisible = false;
+	bool WasVisible = false;
 
-	if(DrawVisibility[di].IsVisible == 0)
+	if(LATE)
+	{
+		if(di >= LateDispatch[0].DrawCount)
+		{
+			return;
+		}
+
+		uint LateEntry = LateList[di];
+		di = LateEntry & ~LATE_DRAW_WAS_VISIBLE;
+		WasVisible = (LateEntry & LATE_DRAW_WAS_VISIBLE) != 0;
+	}
+	// NOTE: clustered variants are dispatched indirectly with one group per cluster that survived cluster_cull.comp.
+	// The rows of the dispatch can cover more groups than there are listed clusters
+	else if(CLUSTERED)
+	{
+		if(GroupIndex >= ClusterDispatch[0].ClusterCount)
+		{
+			return;
+		}
+
+		uint ClusterEntry = ClusterList[GroupIndex];
+		draw_cluster Cluster = Clusters[ClusterEntry & ~DRAW_CLUSTER_NEWLY_VISIBLE];
+		if(GroupThreadID.x >= Cluster.DrawCount)
+		{
+			return;
+		}
+
+		di = Cluster.FirstDraw + GroupThreadID.x;
+		IsClusterNewlyVisible = (ClusterEntry & DRAW_CLUSTER_NEWLY_VISIBLE) != 0;
+	}
+	else if(di >= DrawCullData.DrawCount)
 	{
 		return;
 	}
 
-	uint MeshIndex = MeshOffsetBuffer[di].MeshIndex;
+	// NOTE: visibility is one bit per draw
+	uint VisibilityBit = 1u << (di & 31);
+	bool IsBitSet = (DrawVisibility[di >> 5] & VisibilityBit) != 0;
+
+	// NOTE: draws of a cluster that was culled last frame weren't tested since, so they count as invisible
+	if(!LATE)
+	{
+		WasVisible = !IsClusterNewlyVisible && IsBitSet;
+	}
+
+	draw_sphere Sphere = DrawSpheres[di];
+	float3 Center = Sphere.Center;
+	float Radius = Sphere.Radius;
+
+	// NOTE: late list entries passed the frustum test in the early pass
+	bool IsVisible = LATE || IsSphereInFrustum(DrawCullData, Center, Radius);
+
+	IsVisible = CULL ? IsVisible : true;
+
+	// NOTE: draws too small to matter are dropped in the early pass, so they don't reach the late list
+	// and their visibility bit is cleared. The mesh override can only lower the threshold, so the mesh
+	// is only read for draws below the global one. Culled draws are counted per mesh and lod
+	// with the atomics shared like the instance buckets, the cpu turns them into triangles
+	bool IsContributionCulled = false;
+	uint ContributionBucket = 0;
+	if(!LATE && CULL && IsVisible && IsSphereBelowContribution(DrawCullData, Center, Radius, 1.0f))
+	{
+		uint MeshIndex = DrawTransforms[di].MeshIndex;
+		IsContributionCulled = IsSphereBelowContribution(DrawCullData, Center, Radius, MeshDataBuffer[MeshIndex].ContributionScale);
+
+		float LodDistance = log2(max(1, distance(Center, float3(0, 0, 0)) - Radius));
+		uint LodIndex = clamp(int(LodDistance), 0, MeshDataBuffer[MeshIndex].LodCount - 1);
+		ContributionBucket = MeshIndex * MAX_LODS + (LOD ? LodIndex : 0);
+	}
+
+	if(IsContributionCulled)
+	{
+		IsVisible = false;
+		for(;;)
+		{
+			if(ContributionBucket == WaveReadLaneFirst(ContributionBucket))
+			{
+				uint LaneCount = WaveActiveCountBits(true);
+				if(WaveIsFirstLane())
+				{
+					InterlockedAdd(ContributionCulled[ContributionBucket], LaneCount);
+				}
+				break;
+			}
+		}
+	}
 
-	float3 Center = MeshOffsetBuffer[di].Center * MeshOffsetBuffer[di].Scale + MeshOffsetBuffer[di].Pos;
-	float Radius = MeshOffsetBuffer[di].Radius * MeshOffsetBuffer[di].Scale;
+	if(LATE && OCCLUSION && IsVisible)
+	{
+		IsVisible = !IsSphereOccluded(DepthPyramid, DrawCullData, Center, Radius);
+	}
 
-	bool IsVisible = true;
-	IsVisible = IsVisible && dot(DrawCullData.Data[0], float4(Center, 1)) > -Radius;
-	IsVisible = IsVisible && dot(DrawCullData.Data[1], float4(Center, 1)) > -Radius;
-	IsVisible = IsVisible && dot(DrawCullData.Data[2], float4(Center, 1)) > -Radius;
-	IsVisible = IsVisible && dot(DrawCullData.Data[3], float4(Center, 1)) > -Radius;
-	IsVisible = IsVisible && dot(DrawCullData.Data[4], float4(Center, 1)) > -Radius;
-	IsVisible = IsVisible && dot(DrawCullData.Data[5], float4(Center, 1)) > -Radius;
+	if(!LATE)
+	{
+		// NOTE: one atomic per wave for the list. The dispatch grows to the rows of groups the list
+		// needs up to this wave's entries, the max doesn't depend on the order waves get there in
+		uint LateCount = WaveActiveCountBits(IsVisible);
+		uint LateIndex = 0;
+		if(WaveIsFirstLane() && LateCount > 0)
+		{
+			InterlockedAdd(LateDispatch[0].DrawCount, LateCount, LateIndex);
 
-	IsVisible = (DrawCullData.CullEnabled == 1) ? IsVisible : true;
+			uint GroupCount = (LateIndex + LateCount + DRAW_CULL_GROUP_SIZE - 1) / DRAW_CULL_GROUP_SIZE;
+			InterlockedMax(LateDispatch[0].GroupCountX, min(GroupCount, DISPATCH_ROW_GROUPS));
+			InterlockedMax(LateDispatch[0].GroupCountY, (GroupCount + DISPATCH_ROW_GROUPS - 1) / DISPATCH_ROW_GROUPS);
+		}
+		LateIndex = WaveReadLaneFirst(LateIndex) + WavePrefixCountBits(IsVisible);
 
-	if(IsVisible)
+		if(IsVisible)
+		{
+			LateList[LateIndex] = di | (WasVisible ? LATE_DRAW_WAS_VISIBLE : 0);
+		}
+	}
+
+	bool IsMeshletOcclusion = MESH_TASKS && OCCLUSION;
+	if(IsVisible && (LATE ? (!WasVisible || IsMeshletOcclusion) : WasVisible))
 	{
-		uint DrawCommandIndex;
-		InterlockedAdd(DrawCount[0].Data, 1, DrawCommandIndex);
+		uint MeshIndex = DrawTransforms[di].MeshIndex;
+		uint InstanceId = di | ((LATE && IsMeshletOcclusion && WasVisible) ? INSTANCE_ID_DRAWN_EARLY : 0);
 
 		float LodDistance = log2(max(1, distance(Center, float3(0, 0, 0)) - Radius));
 		uint LodIndex = clamp(int(LodDistance), 0, MeshDataBuffer[MeshIndex].LodCount - 1);
 
-		LodIndex = (DrawCullData.LodEnabled == 1) ? LodIndex : 0;
+		LodIndex = LOD ? LodIndex : 0;
+
+		if(INSTANCING)
+		{
+			// NOTE: lanes that land in the same bucket share one atomic. Every iteration serves the bucket
+			// of the first active lane, so a wave of instances of few meshes takes few iterations
+			uint BucketIndex = MeshIndex * MAX_LODS + LodIndex;
+			for(;;)
+			{
+				if(BucketIndex == WaveReadLaneFirst(BucketIndex))
+				{
+					uint LaneCount = WaveActiveCountBits(true);
+					uint LaneIndex = WavePrefixCountBits(true);
 
-		mesh_lod Lod = MeshDataBuffer[MeshIndex].Lods[LodIndex];
+					uint InstanceIndex = 0;
+					if(WaveIsFirstLane())
+					{
+						InterlockedAdd(DrawBuckets[BucketIndex].InstanceCount, LaneCount, InstanceIndex);
+					}
+					InstanceIndex = WaveReadLaneFirst(InstanceIndex) + LaneIndex;
 
-		DrawCommands[DrawCommandIndex].DrawIndex = di;
-		DrawCommands[DrawCommandIndex].IndexCount = Lod.IndexCount;
-		DrawCommands[DrawCommandIndex].InstanceCount = 1;
-		DrawCommands[DrawCommandIndex].FirstIndex = Lod.IndexOffset;
-		DrawCommands[DrawCommandIndex].VertexOffset = MeshDataBuffer[MeshIndex].VertexOffset;
-		DrawCommands[DrawCommandIndex].FirstInstance = 0;
+					InstanceIds[DrawBuckets[BucketIndex].InstanceOffset + InstanceIndex] = InstanceId;
+					break;
+				}
+			}
+		}
+		else
+		{
+			uint DrawCommandIndex;
+			InterlockedAdd(DrawCount[0].Data, 1, DrawCommandIndex);
 
-		DrawCommands[DrawCommandIndex].TaskCount = (Lod.MeshletCount + 31) / 32;
-		DrawCommands[DrawCommandIndex].FirstTask = Lod.MeshletOffset / 32;
+			mesh_lod Lod = MeshDataBuffer[MeshIndex].Lods[LodIndex];
+
+			InstanceIds[DrawCommandIndex] = InstanceId;
+			DrawIds[DrawCommandIndex] = PackDrawId(DrawCommandIndex, LodIndex);
+
+			if(MESH_TASKS)
+			{
+				TaskCommands[DrawCommandIndex].TaskCount = (Lod.MeshletCount + 31) / 32;
+				TaskCommands[DrawCommandIndex].FirstTask = Lod.MeshletOffset / 32;
+			}
+			else
+			{
+				DrawCommands[DrawCommandIndex].IndexCount = Lod.IndexCount;
+				DrawCommands[DrawCommandIndex].InstanceCount = 1;
+				DrawCommands[DrawCommandIndex].FirstIndex = Lod.IndexOffset;
+				DrawCommands[DrawCommandIndex].VertexOffset = MeshDataBuffer[MeshIndex].VertexOffset;
+				DrawCommands[DrawCommandIndex].FirstInstance = DrawCommandIndex;
+			}
+		}
+	}
+
+	// NOTE: draws that left the frustum don't reach the late pass. Neighbouring draws share a word,
+	// so bits are only written atomically and only when they change
+	if((LATE || !IsVisible) && IsVisible != IsBitSet)
+	{
+		if(IsVisible)
+		{
+			InterlockedOr(DrawVisibility[di >> 5], VisibilityBit);
+		}
+		else
+		{
+			InterlockedAnd(DrawVisibility[di >> 5], ~VisibilityBit);
+		}
 	}
 }
 
@@ -0,0 +1,94 @@
+
+#include "mesh_headers.hlsl"
+#include "cull_headers.hlsl"
+
+// NOTE: specialized with the draw_cull.comp flags, constant ids are shared with it
+[[vk::constant_id(1)]] const bool CULL = true;
+[[vk::constant_id(2)]] const bool LOD = true;
+[[vk::constant_id(6)]] const bool MESH_TASKS = false;
+
+struct draw_cull_views_data
+{
+	uint DrawCount;
+	uint FirstView;
+	uint ViewCount;
+};
+
+[[vk::binding(0)]] StructuredBuffer<draw_sphere> DrawSpheres;
+[[vk::binding(1)]] StructuredBuffer<mesh> MeshDataBuffer;
+[[vk::binding(2)]] StructuredBuffer<draw_cull_view> Views;
+[[vk::binding(3)]] RWStructuredBuffer<draw_indexed_command> DrawCommands;
+[[vk::binding(4)]] RWStructuredBuffer<uint> ViewDrawCounts;
+[[vk::binding(5)]] RWStructuredBuffer<uint> InstanceIds;
+[[vk::binding(6)]] RWStructuredBuffer<draw_mesh_tasks_command> TaskCommands;
+[[vk::binding(7)]] RWStructuredBuffer<uint> DrawIds;
+[[vk::binding(8)]] StructuredBuffer<draw_transform> DrawTransforms;
+
+[[vk::push_constant]] draw_cull_views_data DrawCullViewsData;
+
+// NOTE: one thread per draw, the draw is read once and tested against every view of [FirstView, FirstView + ViewCount).
+// Every view has its own compacted command stream at its CommandOffset and its own count, instance ids
+// and draw ids are laid out the same way, so a stream can be drawn like the one of draw_cull.comp
+[numthreads(64, 1, 1)]
+void main(uint3 GroupID : SV_GroupID, uint3 GroupThreadID : SV_GroupThreadID)
+{
+	uint di = GetFlatGroupIndex(GroupID) * 64 + GroupThreadID.x;
+
+	if(di >= DrawCullViewsData.DrawCount)
+	{
+		return;
+	}
+
+	draw_sphere Sphere = DrawSpheres[di];
+	float3 Center = Sphere.Center;
+	float Radius = Sphere.Radius;
+
+	for(uint ViewIndex = DrawCullViewsData.FirstView;
+		ViewIndex < DrawCullViewsData.FirstView + DrawCullViewsData.ViewCount;
+		++ViewIndex)
+	{
+		draw_cull_view View = Views[ViewIndex];
+
+		bool IsVisible = IsSphereInsidePlanes(View.Frustrum, Center, Radius);
+
+		IsVisible = CULL ? IsVisible : true;
+
+		// NOTE: one atomic per wave and view, lanes of visible draws take consecutive command slots
+		uint VisibleCount = WaveActiveCountBits(IsVisible);
+		uint CommandIndex = 0;
+		if(WaveIsFirstLane() && VisibleCount > 0)
+		{
+			InterlockedAdd(ViewDrawCounts[ViewIndex], VisibleCount, CommandIndex);
+		}
+		CommandIndex = View.CommandOffset + WaveReadLaneFirst(CommandIndex) + WavePrefixCountBits(IsVisible);
+
+		if(IsVisible)
+		{
+			uint MeshIndex = DrawTransforms[di].MeshIndex;
+
+			float LodDistance = log2(max(1, distance(Center, View.Origin) - Radius));
+			uint LodIndex = clamp(int(LodDistance), 0, MeshDataBuffer[MeshIndex].LodCount - 1);
+
+			LodIndex = LOD ? LodIndex : 0;
+
+			mesh_lod Lod = MeshDataBuffer[MeshIndex].Lods[LodIndex];
+
+			InstanceIds[CommandIndex] = di;
+			DrawIds[CommandIndex] = PackDrawId(CommandIndex, LodIndex);
+
+			if(MESH_TASKS)
+			{
+				TaskCommands[CommandIndex].TaskCount = (Lod.MeshletCount + 31) / 32;
+				TaskCommands[CommandIndex].FirstTask = Lod.MeshletOffset / 32;
+			}
+			else
+			{
+				DrawCommands[CommandIndex].IndexCount = Lod.IndexCount;
+				DrawCommands[CommandIndex].InstanceCount = 1;
+				DrawCommands[CommandIndex].FirstIndex = Lod.IndexOffset;
+				DrawCommands[CommandIndex].VertexOffset = MeshDataBuffer[MeshIndex].VertexOffset;
+				DrawCommands[CommandIndex].FirstInstance = CommandIndex;
+			}
+		}
+	}
+}
@@ -0,0 +1,88 @@
+
+#include "mesh_headers.hlsl"
+
+// NOTE: specialized with the draw_cull.comp flags, constant ids are shared with it
+[[vk::constant_id(6)]] const bool MESH_TASKS = false;
+
+struct draw_emit_data
+{
+	uint BucketCount;
+};
+
+struct draw_count
+{
+	uint Data;
+};
+
+[[vk::binding(0)]] RWStructuredBuffer<draw_bucket> DrawBuckets;
+[[vk::binding(1)]] StructuredBuffer<mesh> MeshDataBuffer;
+[[vk::binding(2)]] RWStructuredBuffer<draw_indexed_command> DrawCommands;
+[[vk::binding(3)]] RWStructuredBuffer<draw_count> DrawCount;
+[[vk::binding(4)]] RWStructuredBuffer<draw_mesh_tasks_command> TaskCommands;
+[[vk::binding(5)]] RWStructuredBuffer<uint> DrawIds;
+[[vk::push_constant]] draw_emit_data DrawEmitData;
+
+
+// NOTE: one thread per (mesh, lod) bucket; every non-empty bucket becomes one instanced draw command
+[numthreads(64, 1, 1)]
+void main(uint3 GlobalInvocationID : SV_DispatchThreadID)
+{
+	uint bi = GlobalInvocationID.x;
+
+	if(bi >= DrawEmitData.BucketCount)
+	{
+		return;
+	}
+
+	uint InstanceCount = DrawBuckets[bi].InstanceCount;
+	if(InstanceCount == 0)
+	{
+		return;
+	}
+
+	DrawBuckets[bi].InstanceCount = 0;
+
+	uint MeshIndex = bi / MAX_LODS;
+	uint LodIndex  = bi % MAX_LODS;
+
+	mesh_lod Lod = MeshDataBuffer[MeshIndex].Lods[LodIndex];
+	uint MeshletGroupCount = (Lod.MeshletCount + 31) / 32;
+
+	// NOTE: a mesh task command can't launch more than 65535 task groups, so buckets with many instances
+	// of a mesh with many meshlets are split into several commands
+	uint CommandInstanceCount = max(1, 65535 / max(1, MeshletGroupCount));
+	uint CommandCount = (InstanceCount + CommandInstanceCount - 1) / CommandInstanceCount;
+
+	uint DrawCommandIndex;
+	InterlockedAdd(DrawCount[0].Data, CommandCount, DrawCommandIndex);
+
+	for(uint CommandIndex = 0;
+		CommandIndex < CommandCount;
+		++CommandIndex)
+	{
+		uint FirstInstance = DrawBuckets[bi].InstanceOffset + CommandIndex * CommandInstanceCount;
+		uint Instances = min(CommandInstanceCount, InstanceCount - CommandIndex * CommandInstanceCount);
+
+		DrawIds[DrawCommandIndex + CommandIndex] = PackDrawId(FirstInstance, LodIndex);
+
+		if(MESH_TASKS)
+		{
+			draw_mesh_tasks_command Command;
+			Command.TaskCount = MeshletGroupCount * Instances;
+			Command.FirstTask = Lod.MeshletOffset / 32;
+
+			TaskCommands[DrawCommandIndex + CommandIndex] = Command;
+		}
+		else
+		{
+			draw_indexed_command Command;
+			Command.IndexCount = Lod.IndexCount;
+			Command.InstanceCount = Instances;
+			Command.FirstIndex = Lod.IndexOffset;
+			Command.VertexOffset = MeshDataBuffer[MeshIndex].VertexOffset;
+			Command.FirstInstance = FirstInstance;
+
+			DrawCommands[DrawCommandIndex + CommandIndex] = Command;
+		}
+	}
+}
@@ -0,0 +1,118 @@
+#include "mesh_headers.hlsl"
+
+// NOTE: specialized with the draw_cull.comp flags, constant ids are shared with it
+[[vk::constant_id(6)]] const bool MESH_TASKS = false;
+
+#define DRAW_SORT_GROUP_SIZE 256
+#define DRAW_SORT_KEY_COUNT 65536
+#define DRAW_SORT_KEYS_PER_THREAD (DRAW_SORT_KEY_COUNT / DRAW_SORT_GROUP_SIZE)
+
+#define DRAW_SORT_PASS_COUNT 0
+#define DRAW_SORT_PASS_SCAN 1
+#define DRAW_SORT_PASS_SCATTER 2
+
+struct draw_sort_data
+{
+	float KeyScale;
+	uint Pass;
+};
+
+struct draw_count
+{
+	uint Data;
+};
+
+[[vk::binding(0)]] StructuredBuffer<draw_sphere> DrawSpheres;
+[[vk::binding(1)]] StructuredBuffer<draw_count> DrawCount;
+[[vk::binding(2)]] StructuredBuffer<draw_indexed_command> DrawCommands;
+[[vk::binding(3)]] StructuredBuffer<draw_mesh_tasks_command> TaskCommands;
+[[vk::binding(4)]] StructuredBuffer<uint> DrawIds;
+[[vk::binding(5)]] StructuredBuffer<uint> InstanceIds;
+[[vk::binding(6)]] RWStructuredBuffer<uint> SortOffsets;
+[[vk::binding(7)]] RWStructuredBuffer<draw_indexed_command> SortedDrawCommands;
+[[vk::binding(8)]] RWStructuredBuffer<draw_mesh_tasks_command> SortedTaskCommands;
+[[vk::binding(9)]] RWStructuredBuffer<uint> SortedDrawIds;
+[[vk::push_constant]] draw_sort_data DrawSortData;
+
+groupshared uint GroupSums[DRAW_SORT_GROUP_SIZE];
+
+// NOTE: quantized view depth of the nearest point of the draw sphere. Commands keep pointing to
+// their instance id slots, so the first instance of a command is found through its draw id
+uint GetSortKey(uint CommandIndex)
+{
+	uint FirstInstance = DrawIds[CommandIndex] & DRAW_ID_INSTANCE_MASK;
+	draw_sphere Sphere = DrawSpheres[InstanceIds[FirstInstance] & ~INSTANCE_ID_DRAWN_EARLY];
+	return uint(clamp((Sphere.Center.z - Sphere.Radius) * DrawSortData.KeyScale, 0, DRAW_SORT_KEY_COUNT - 1));
+}
+
+// NOTE: counting sort of the commands of a non instanced cull, front to back. The count pass builds
+// a histogram of the keys, the scan pass turns it into the first slot of every key in one group and
+// the scatter pass moves every command and its draw id to the next slot of its key. Commands with
+// the same key land in any order, they are at the same depth anyway
+[numthreads(DRAW_SORT_GROUP_SIZE, 1, 1)]
+void main(uint3 GroupID : SV_GroupID, uint3 GroupThreadID : SV_GroupThreadID)
+{
+	if(DrawSortData.Pass == DRAW_SORT_PASS_SCAN)
+	{
+		uint FirstKey = GroupThreadID.x * DRAW_SORT_KEYS_PER_THREAD;
+
+		uint Sum = 0;
+		for(uint KeyIndex = 0;
+			KeyIndex < DRAW_SORT_KEYS_PER_THREAD;
+			++KeyIndex)
+		{
+			Sum += SortOffsets[FirstKey + KeyIndex];
+		}
+
+		GroupSums[GroupThreadID.x] = Sum;
+		GroupMemoryBarrierWithGroupSync();
+
+		for(uint Stride = 1;
+			Stride < DRAW_SORT_GROUP_SIZE;
+			Stride *= 2)
+		{
+			uint Value = (GroupThreadID.x >= Stride) ? GroupSums[GroupThreadID.x - Stride] : 0;
+			GroupMemoryBarrierWithGroupSync();
+			GroupSums[GroupThreadID.x] += Value;
+			GroupMemoryBarrierWithGroupSync();
+		}
+
+		uint Offset = GroupSums[GroupThreadID.x] - Sum;
+		for(uint KeyIndex = 0;
+			KeyIndex < DRAW_SORT_KEYS_PER_THREAD;
+			++KeyIndex)
+		{
+			uint KeyCount = SortOffsets[FirstKey + KeyIndex];
+			SortOffsets[FirstKey + KeyIndex] = Offset;
+			Offset += KeyCount;
+		}
+
+		return;
+	}
+
+	uint ci = GetFlatGroupIndex(GroupID) * DRAW_SORT_GROUP_SIZE + GroupThreadID.x;
+	if(ci >= DrawCount[0].Data)
+	{
+		return;
+	}
+
+	uint Key = GetSortKey(ci);
+	if(DrawSortData.Pass == DRAW_SORT_PASS_COUNT)
+	{
+		InterlockedAdd(SortOffsets[Key], 1);
+		return;
+	}
+
+	uint SortedIndex;
+	InterlockedAdd(SortOffsets[Key], 1, SortedIndex);
+
+	if(MESH_TASKS)
+	{
+		SortedTaskCommands[SortedIndex] = TaskCommands[ci];
+	}
+	else
+	{
+		SortedDrawCommands[SortedIndex] = DrawCommands[ci];
+	}
+	SortedDrawIds[SortedIndex] = DrawIds[ci];
+}
@@ -1,4 +1,6 @@
 
+#define MAX_LODS 8
+
 struct vertex
 {
 	float vx, vy, vz;
@@ -13,6 +15,8 @@ struct mesh_lod
 
 	uint MeshletOffset;
 	uint MeshletCount;
+
+	uint VertexCount;
 };
 
 struct mesh
@@ -24,7 +28,8 @@ struct mesh
 	uint VertexCount;
 
 	uint LodCount;
-	mesh_lod Lods[8];
+	float ContributionScale;
+	mesh_lod Lods[MAX_LODS];
 };
 
 struct meshlet
@@ -43,35 +48,113 @@ struct meshlet
 struct globals
 {
 	float4x4 Proj;
+
+	float P00, P11, znear;
+	float PyramidWidth, PyramidHeight;
+};
+
+// NOTE: per draw data is split by who reads it. Culling reads the world space sphere of every draw,
+// the transform is only read for draws that are drawn
+struct draw_sphere
+{
+	float3 Center;
+	float Radius;
 };
 
-struct mesh_offset
+struct draw_transform
 {
 	float3 Pos;
 	float Scale;
 	float4 Orient;
 
-	float3 Center;
-	float Radius;
-
 	uint MeshIndex;
 	uint VertexOffset;
 };
 
-struct mesh_draw_command
+// NOTE: culling writes only the command layout of the active path, tightly packed
+struct draw_indexed_command
 {
-	uint DrawIndex;
-
 	uint IndexCount;
 	uint InstanceCount;
 	uint FirstIndex;
 	uint VertexOffset;
 	uint FirstInstance;
+};
 
+struct draw_mesh_tasks_command
+{
 	uint TaskCount;
 	uint FirstTask;
 };
 
+// NOTE: x of a dispatch is only guaranteed to go up to 65535 groups, dispatches over draws are laid
+// out in rows of this many groups instead, see DispatchGroupRows in main.cpp
+#define DISPATCH_ROW_GROUPS 32768
+
+uint GetFlatGroupIndex(uint3 GroupID)
+{
+	return GroupID.y * DISPATCH_ROW_GROUPS + GroupID.x;
+}
+
+// NOTE: every command also gets a draw id next to it: the first instance id slot of the command
+// with its lod in the top bits. The task shader finds the mesh and the lod of a command with it
+#define DRAW_ID_LOD_SHIFT 29
+#define DRAW_ID_INSTANCE_MASK ((1u << DRAW_ID_LOD_SHIFT) - 1)
+
+uint PackDrawId(uint FirstInstance, uint LodIndex)
+{
+	return FirstInstance | (LodIndex << DRAW_ID_LOD_SHIFT);
+}
+
+// NOTE: set by the late cull pass on instance ids of draws the early pass has drawn, so the task
+// shader can tell which of their meshlets were drawn already
+#define INSTANCE_ID_DRAWN_EARLY 0x80000000
+
+// NOTE: optional encoding of a draw_transform, see PackDrawTransform. The vertex offset is read from the mesh
+#define TRANSFORM_CELL_SIZE 64.0f
+#define TRANSFORM_CELL_BIAS 512
+
+struct packed_transform
+{
+	uint Cell;
+	uint PosXY;
+	uint PosZScale;
+	uint Orient;
+	uint MeshIndex;
+};
+
+draw_transform UnpackDrawTransform(packed_transform Packed, uint VertexOffset)
+{
+	draw_transform Result;
+
+	int3 CellIndex = int3((Packed.Cell >> uint3(20, 10, 0)) & 1023) - TRANSFORM_CELL_BIAS;
+	float3 Offset = float3(Packed.PosXY & 0xffff, Packed.PosXY >> 16, Packed.PosZScale & 0xffff) / 65535.0f;
+	Result.Pos = (float3(CellIndex) + Offset) * TRANSFORM_CELL_SIZE;
+	Result.Scale = f16tof32(Packed.PosZScale >> 16);
+
+	float3 Small = (float3((Packed.Orient >> uint3(22, 12, 2)) & 1023) / 1023.0f - 0.5f) * 1.41421356f;
+	float Largest = sqrt(saturate(1.0f - dot(Small, Small)));
+	switch(Packed.Orient & 3)
+	{
+		case 0: Result.Orient = float4(Largest, Small.x, Small.y, Small.z); break;
+		case 1: Result.Orient = float4(Small.x, Largest, Small.y, Small.z); break;
+		case 2: Result.Orient = float4(Small.x, Small.y, Largest, Small.z); break;
+		default: Result.Orient = float4(Small.x, Small.y, Small.z, Largest); break;
+	}
+
+	Result.MeshIndex = Packed.MeshIndex;
+	Result.VertexOffset = VertexOffset;
+	return Result;
+}
+
+// NOTE: visible instances of one (mesh, lod) pair. InstanceOffset is filled on the cpu,
+// InstanceCount is appended to by culling and reset when the bucket is emitted
+struct draw_bucket
+{
+	uint InstanceOffset;
+	uint InstanceCount;
+};
+
 float3 RotateQuat(float3 V, float4 Q)
 {
 	return V + 2.0f * cross(Q.xyz, cross(Q.xyz, V) + Q.w * V);
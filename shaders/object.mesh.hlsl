@@ -1,8 +1,12 @@
 
 #include "mesh_headers.hlsl"
 
+// NOTE: transforms are read from PackedTransforms instead of MeshOffsetBuffer, specialized by the pipeline
+[[vk::constant_id(1)]] const bool PACKED_TRANSFORMS = false;
+
 struct TsOutput
 {
+	uint DrawIndex;
 	uint Meshlets[32];
 };
 
@@ -12,12 +16,24 @@ struct VsOutput
 	float4 Color : COLOR;
 };
 
-[[vk::binding(0)]] StructuredBuffer<mesh_offset> MeshOffsetBuffer;
-[[vk::binding(1)]] StructuredBuffer<mesh_draw_command> DrawCommands;
+[[vk::binding(0)]] StructuredBuffer<draw_transform> MeshOffsetBuffer;
 [[vk::binding(2)]] StructuredBuffer<vertex> VertexBuffer;
 [[vk::binding(3)]] StructuredBuffer<meshlet> MeshletBuffer;
+[[vk::binding(5)]] StructuredBuffer<mesh> MeshDataBuffer;
+[[vk::binding(6)]] StructuredBuffer<packed_transform> PackedTransforms;
 [[vk::push_constant]] ConstantBuffer<globals> Globals;
 
+draw_transform LoadDrawTransform(uint DrawIndex)
+{
+	if(PACKED_TRANSFORMS)
+	{
+		packed_transform Packed = PackedTransforms[DrawIndex];
+		return UnpackDrawTransform(Packed, MeshDataBuffer[Packed.MeshIndex].VertexOffset);
+	}
+
+	return MeshOffsetBuffer[DrawIndex];
+}
+
 uint Hash(uint a)
 {
    a = (a+0x7ed55d16) + (a<<12);
@@ -31,13 +47,12 @@ uint Hash(uint a)
 
 [numthreads(32, 1, 1)]
 [outputtopology("triangle")]
-void main([[vk::builtin("DrawIndex")]] int DrawIndex : A,
-		  uint3 WorkGroupID : SV_GroupID, uint3 LocalInvocation : SV_GroupThreadID, uint ThreadIndex : SV_GroupIndex, in payload TsOutput TaskOutput,
+void main(uint3 WorkGroupID : SV_GroupID, uint3 LocalInvocation : SV_GroupThreadID, uint ThreadIndex : SV_GroupIndex, in payload TsOutput TaskOutput,
 		  out vertices VsOutput OutVertices[64], out indices uint3 OutIndices[126])
 {
 	uint mi = TaskOutput.Meshlets[WorkGroupID.x];
 	meshlet CurrentMeshlet = MeshletBuffer[mi];
-	mesh_offset MeshOffsetData = MeshOffsetBuffer[DrawCommands[DrawIndex].DrawIndex];
+	draw_transform MeshOffsetData = LoadDrawTransform(TaskOutput.DrawIndex);
 
 	SetMeshOutputCounts(CurrentMeshlet.VertexCount, CurrentMeshlet.TriangleCount);
 #if VK_DEBUG
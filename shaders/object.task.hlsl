@@ -1,19 +1,50 @@
 
 #include "mesh_headers.hlsl"
+#include "cull_headers.hlsl"
 
-#define CULL 1
+// NOTE: meshlet cone culling, specialized by the pipeline
+[[vk::constant_id(0)]] const bool CULL = true;
+// NOTE: transforms are read from PackedTransforms instead of MeshOffsetBuffer
+[[vk::constant_id(1)]] const bool PACKED_TRANSFORMS = false;
+// NOTE: meshlet occlusion, the early pass draws meshlets that were visible last frame and the late pass tests the rest
+[[vk::constant_id(2)]] const bool LATE = false;
+[[vk::constant_id(3)]] const bool OCCLUSION = false;
 
 struct TsOutput
 {
+	uint DrawIndex;
 	uint Meshlets[32];
 };
 
 
-[[vk::binding(0)]] StructuredBuffer<mesh_offset> MeshOffsetBuffer;
-[[vk::binding(1)]] StructuredBuffer<mesh_draw_command> DrawCommands;
+[[vk::binding(0)]] StructuredBuffer<draw_transform> MeshOffsetBuffer;
+[[vk::binding(1)]] StructuredBuffer<uint> DrawIds;
 [[vk::binding(3)]] StructuredBuffer<meshlet> MeshletBuffer;
+[[vk::binding(4)]] StructuredBuffer<uint> InstanceIds;
+[[vk::binding(5)]] StructuredBuffer<mesh> MeshDataBuffer;
+[[vk::binding(6)]] StructuredBuffer<packed_transform> PackedTransforms;
+
+[[vk::combinedImageSampler]][[vk::binding(7)]]
+Texture2D<float> DepthPyramid;
+[[vk::combinedImageSampler]][[vk::binding(7)]]
+SamplerState DepthPyramidSampler;
+
+[[vk::binding(8)]] RWStructuredBuffer<uint> MeshletVisibility;
+[[vk::binding(9)]] StructuredBuffer<uint> MeshletVisibilityOffsets;
 [[vk::push_constant]] ConstantBuffer<globals> Globals;
 
+// NOTE: the vertex offset is only read by the mesh shader
+draw_transform LoadDrawTransform(uint DrawIndex)
+{
+	if(PACKED_TRANSFORMS)
+	{
+		packed_transform Packed = PackedTransforms[DrawIndex];
+		return UnpackDrawTransform(Packed, 0);
+	}
+
+	return MeshOffsetBuffer[DrawIndex];
+}
+
 groupshared TsOutput TaskOutput;
 groupshared uint MeshletCount;
 
@@ -22,21 +53,90 @@ groupshared uint MeshletCount;
 void main([[vk::builtin("DrawIndex")]] int DrawIndex : A, 
 		  uint3 WorkGroupID : SV_GroupID, uint3 LocalInvocation : SV_GroupThreadID, uint ThreadIndex : SV_GroupIndex)
 {
+	// NOTE: all instances of a command share the mesh and the lod, the first one gives both
+	uint DrawId = DrawIds[DrawIndex];
+	uint FirstInstance = DrawId & DRAW_ID_INSTANCE_MASK;
+	uint LodIndex = DrawId >> DRAW_ID_LOD_SHIFT;
+
+	mesh_lod Lod = MeshDataBuffer[LoadDrawTransform(InstanceIds[FirstInstance] & ~INSTANCE_ID_DRAWN_EARLY).MeshIndex].Lods[LodIndex];
+	uint FirstTask = Lod.MeshletOffset / 32;
+	uint MeshletGroupCount = (Lod.MeshletCount + 31) / 32;
+
+	// NOTE: an instanced command launches MeshletGroupCount task groups per instance, one after another
+	uint TaskIndex = WorkGroupID.x - FirstTask;
+	uint InstanceId = InstanceIds[FirstInstance + TaskIndex / MeshletGroupCount];
+	uint DrawInstanceIndex = InstanceId & ~INSTANCE_ID_DRAWN_EARLY;
+
 	uint ti  = LocalInvocation.x;
-	uint mgi = WorkGroupID.x;
+	uint mgi = FirstTask + TaskIndex % MeshletGroupCount;
 
-	mesh_offset MeshOffsetData = MeshOffsetBuffer[DrawCommands[DrawIndex].DrawIndex];
+	draw_transform MeshOffsetData = LoadDrawTransform(DrawInstanceIndex);
+	TaskOutput.DrawIndex = DrawInstanceIndex;
 
 	uint mi = mgi * 32 + ti;
 
-#if CULL
-	meshlet CurrentMeshlet = MeshletBuffer[mi];
-	uint Accepted = !ConeCullTest(RotateQuat(CurrentMeshlet.Center, MeshOffsetData.Orient) * MeshOffsetData.Scale + MeshOffsetData.Pos, 
-							 CurrentMeshlet.Radius,
-							 RotateQuat(CurrentMeshlet.ConeAxis, MeshOffsetData.Orient), CurrentMeshlet.ConeCutoff, float3(0, 0, 0));
+	bool Accepted = true;
+	if(CULL)
+	{
+		meshlet CurrentMeshlet = MeshletBuffer[mi];
+		Accepted = !ConeCullTest(RotateQuat(CurrentMeshlet.Center, MeshOffsetData.Orient) * MeshOffsetData.Scale + MeshOffsetData.Pos, 
+								 CurrentMeshlet.Radius,
+								 RotateQuat(CurrentMeshlet.ConeAxis, MeshOffsetData.Orient), CurrentMeshlet.ConeCutoff, float3(0, 0, 0));
+	}
 
-	uint CurrentIndex = WavePrefixSum(Accepted);
+	// NOTE: every draw owns a range of bits in MeshletVisibility that starts at its word offset and is indexed
+	// by the meshlet of the lod. Lods share the range, so bits can be stale after a lod switch, which
+	// only moves meshlets between the passes. Bits are written atomically and only when they change
+	if(OCCLUSION)
+	{
+		uint MeshletIndex = mi - Lod.MeshletOffset;
+		bool IsMeshletValid = MeshletIndex < Lod.MeshletCount;
+
+		uint VisibilityWord = MeshletVisibilityOffsets[DrawInstanceIndex] + (MeshletIndex >> 5);
+		uint VisibilityBit = 1u << (MeshletIndex & 31);
+		bool IsBitSet = IsMeshletValid && (MeshletVisibility[VisibilityWord] & VisibilityBit) != 0;
+
+		if(LATE)
+		{
+			bool IsVisible = Accepted && IsMeshletValid;
+			if(IsVisible)
+			{
+				meshlet CurrentMeshlet = MeshletBuffer[mi];
+				float3 Center = RotateQuat(CurrentMeshlet.Center, MeshOffsetData.Orient) * MeshOffsetData.Scale + MeshOffsetData.Pos;
+				float Radius = CurrentMeshlet.Radius * MeshOffsetData.Scale;
+
+				draw_cull_data CullData = (draw_cull_data)0;
+				CullData.P00 = Globals.P00;
+				CullData.P11 = Globals.P11;
+				CullData.znear = Globals.znear;
+				CullData.PyramidWidth = Globals.PyramidWidth;
+				CullData.PyramidHeight = Globals.PyramidHeight;
+
+				IsVisible = !IsSphereOccluded(DepthPyramid, CullData, Center, Radius);
+			}
+
+			if(IsMeshletValid && IsVisible != IsBitSet)
+			{
+				if(IsVisible)
+				{
+					InterlockedOr(MeshletVisibility[VisibilityWord], VisibilityBit);
+				}
+				else
+				{
+					InterlockedAnd(MeshletVisibility[VisibilityWord], ~VisibilityBit);
+				}
+			}
+
+			bool IsDrawnEarly = (InstanceId & INSTANCE_ID_DRAWN_EARLY) != 0 && IsBitSet;
+			Accepted = IsVisible && !IsDrawnEarly;
+		}
+		else
+		{
+			Accepted = Accepted && IsBitSet;
+		}
+	}
 
+	uint CurrentIndex = WavePrefixCountBits(Accepted);
 	if(Accepted)
 	{
 		TaskOutput.Meshlets[CurrentIndex] = mi;
@@ -44,17 +144,8 @@ void main([[vk::builtin("DrawIndex")]] int DrawIndex : A,
 
 	uint Count = WaveActiveCountBits(Accepted);
 
-    if(ti == 0)
-    {
-        DispatchMesh(Count, 1, 1, TaskOutput);
-    }
-#else
-	TaskOutput.Meshlets[ti] = mi;
-
 	if(ti == 0)
 	{
-		DispatchMesh(32, 1, 1, TaskOutput);
+		DispatchMesh(Count, 1, 1, TaskOutput);
 	}
-#endif
 }
-
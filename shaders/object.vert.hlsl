@@ -1,20 +1,37 @@
 
 #include "mesh_headers.hlsl"
 
+// NOTE: transforms are read from PackedTransforms instead of MeshOffsetBuffer, specialized by the pipeline
+[[vk::constant_id(1)]] const bool PACKED_TRANSFORMS = false;
+
 struct VsOutput
 {
 	float4 Position : SV_Position;
 	float4 Color : COLOR;
 };
 
-[[vk::binding(0)]] StructuredBuffer<mesh_offset> MeshOffsetBuffer;
-[[vk::binding(1)]] StructuredBuffer<mesh_draw_command> DrawCommands;
+[[vk::binding(0)]] StructuredBuffer<draw_transform> MeshOffsetBuffer;
 [[vk::binding(2)]] StructuredBuffer<vertex> VertexBuffer;
+[[vk::binding(4)]] StructuredBuffer<uint> InstanceIds;
+[[vk::binding(6)]] StructuredBuffer<packed_transform> PackedTransforms;
 [[vk::push_constant]] ConstantBuffer<globals> Globals;
 
-VsOutput main([[vk::builtin("DrawIndex")]] int DrawIndex : A, uint VertexIndex:SV_VertexID)
+// NOTE: the vertex offset comes with the draw command here
+draw_transform LoadDrawTransform(uint DrawIndex)
+{
+	if(PACKED_TRANSFORMS)
+	{
+		packed_transform Packed = PackedTransforms[DrawIndex];
+		return UnpackDrawTransform(Packed, 0);
+	}
+
+	return MeshOffsetBuffer[DrawIndex];
+}
+
+VsOutput main(uint VertexIndex : SV_VertexID, uint InstanceIndex : SV_InstanceID)
 {
-	mesh_offset MeshOffsetData = MeshOffsetBuffer[DrawCommands[DrawIndex].DrawIndex];
+	// NOTE: the instance index includes FirstInstance of the command, which points into the instance id list
+	draw_transform MeshOffsetData = LoadDrawTransform(InstanceIds[InstanceIndex]);
 
 	vertex Vertex = VertexBuffer[VertexIndex];
 	float3 DrawOffset = MeshOffsetData.Pos;